@@ -0,0 +1,410 @@
+// the query benchmarks and their stubs are left out when the fake api provides the C functions
+#![cfg_attr(feature = "fake-api", allow(dead_code, unused_imports))]
+
+use std::env;
+use std::ffi::{c_char, CString};
+use std::hint::black_box;
+use std::os::raw;
+use std::ptr;
+use std::sync::OnceLock;
+use std::time::{Duration, Instant};
+
+use quasar_rs::batch::Batch;
+use quasar_rs::codec::{self, Codec};
+use quasar_rs::ffi_str::{with_c_str, AliasList};
+use quasar_rs::histogram::LatencyHistogram;
+use quasar_rs::mpsc_ring::MpscRing;
+use quasar_rs::perf::{Measurement, Profile};
+use quasar_rs::query_cache::{normalize_query, QueryCache, QueryCacheConfig};
+use quasar_rs::query_splitter::{time_slices, SlicedQuery};
+use quasar_rs::spsc_queue;
+use quasar_rs::{handle, perf_trace, utils_ptr};
+use quasar_rs::{qdb_error_t, qdb_handle_t, qdb_point_result_t, qdb_point_result_t__bindgen_ty_1, qdb_protocol_t,
+                qdb_query_result_t, qdb_query_result_value_type_t_qdb_query_result_double,
+                qdb_query_result_value_type_t_qdb_query_result_int64,
+                qdb_query_result_value_type_t_qdb_query_result_string,
+                qdb_query_result_value_type_t_qdb_query_result_timestamp, qdb_string_t, qdb_timespec_t};
+
+// Measures the overhead of the client layer itself, no server is needed:
+// the few qdb_* functions on the measured paths are replaced by the in-process stubs below,
+// which take precedence over the ones of libqdb_api when the benchmark is linked.
+//
+// cargo bench --bench client_overhead [-- <filter>]
+
+const QUERY_ROWS: usize = 1024;
+const MEASURE_TIME: Duration = Duration::from_millis(500);
+
+fn main() {
+    let filter: Option<String> = env::args().skip(1).find(|a| !a.starts_with("--"));
+    let mut runner = Runner { filter };
+
+    println!("{:<48} {:>14} {:>14}", "Benchmark", "Time", "Iterations");
+    println!("{}", "-".repeat(78));
+
+    bench_string_vector(&mut runner);
+    bench_alias_list(&mut runner);
+    bench_c_str(&mut runner);
+    bench_batch(&mut runner);
+    // the fake api answers queries from its own tables, these need the fixture below
+    #[cfg(not(feature = "fake-api"))]
+    bench_query(&mut runner);
+    #[cfg(not(feature = "fake-api"))]
+    bench_query_cache(&mut runner);
+    bench_splitter(&mut runner);
+    bench_histogram(&mut runner);
+    bench_queues(&mut runner);
+    bench_perf_trace(&mut runner);
+    bench_codec(&mut runner);
+}
+
+struct Runner {
+    filter: Option<String>,
+}
+
+impl Runner {
+    fn selected(&self, name: &str) -> bool {
+        self.filter.as_ref().map_or(true, |filter| name.contains(filter.as_str()))
+    }
+
+    // Doubles the batch size until a batch takes a measurable time, then repeats batches
+    // for MEASURE_TIME and reports the mean time of one call, which it returns in nanoseconds.
+    fn run<F: FnMut()>(&mut self, name: &str, mut f: F) -> Option<f64> {
+        if !self.selected(name) {
+            return None;
+        }
+
+        let mut batch: u64 = 1;
+        loop {
+            let started = Instant::now();
+            for _ in 0..batch {
+                f();
+            }
+            if started.elapsed() >= Duration::from_millis(10) || batch >= 1 << 30 {
+                break;
+            }
+            batch *= 2;
+        }
+
+        let mut iterations: u64 = 0;
+        let started = Instant::now();
+        while started.elapsed() < MEASURE_TIME {
+            for _ in 0..batch {
+                f();
+            }
+            iterations += batch;
+        }
+        let elapsed = started.elapsed();
+
+        let mean = elapsed.as_nanos() as f64 / iterations as f64;
+        println!("{:<48} {:>11.1} ns {:>14}", name, mean, iterations);
+        Some(mean)
+    }
+
+    // Reports a figure that is not a time, next to the benchmark it belongs to.
+    fn report(&self, name: &str, value: f64, unit: &str) {
+        if self.selected(name) {
+            println!("{:<48} {:>11.1} {}", name, value, unit);
+        }
+    }
+}
+
+fn bench_string_vector(runner: &mut Runner) {
+    for count in [16usize, 256, 4096] {
+        let strings: Vec<CString> = (0..count).map(|i| CString::new(format!("tag_{:08}", i)).unwrap()).collect();
+        let pointers: Vec<*const c_char> = strings.iter().map(|s| s.as_ptr()).collect();
+        let raw_ptr = pointers.as_ptr();
+
+        runner.run(&format!("raw_pointer_to_string_vector/{}", count), || {
+            // the strings outlive the runs
+            black_box(unsafe { utils_ptr::raw_pointer_to_string_vector(black_box(raw_ptr), count) }.unwrap());
+        });
+    }
+}
+
+fn bench_alias_list(runner: &mut Runner) {
+    let handle = handle::new_handle().unwrap();
+
+    for count in [16usize, 256, 4096] {
+        let strings: Vec<CString> = (0..count).map(|i| CString::new(format!("tag_{:08}", i)).unwrap()).collect();
+        let pointers: Vec<*const c_char> = strings.iter().map(|s| s.as_ptr()).collect();
+        let raw_ptr = pointers.as_ptr();
+
+        runner.run(&format!("alias_list/{}", count), || {
+            // the stubbed qdb_release leaves the fixture alone when the list is dropped
+            let list = unsafe { AliasList::from_api(&handle, black_box(raw_ptr), count).unwrap() };
+            black_box(list.iter().map(|a| a.len()).sum::<usize>());
+        });
+    }
+}
+
+fn bench_c_str(runner: &mut Runner) {
+    let alias = "timeseries.btc-usd.2021";
+
+    runner.run("c_str/cstring_new", || {
+        let c = CString::new(black_box(alias)).unwrap();
+        black_box(c.as_ptr());
+    });
+    runner.run("c_str/with_c_str", || {
+        with_c_str(black_box(alias), |p| black_box(p)).unwrap();
+    });
+}
+
+// Setting up the operations of a batch, not running it: alias copies and qdb_init_operations,
+// in a new batch and in one cleared and reused.
+fn bench_batch(runner: &mut Runner) {
+    for count in [16usize, 256, 4096] {
+        let aliases: Vec<String> = (0..count).map(|i| format!("counters.requests.{:08}", i)).collect();
+        let build = |batch: &mut Batch| {
+            for (i, alias) in aliases.iter().enumerate() {
+                if i % 2 == 0 {
+                    black_box(batch.blob_get(alias).unwrap());
+                } else {
+                    black_box(batch.int_add(alias, 1).unwrap());
+                }
+            }
+        };
+
+        let name = format!("batch/build/{}", count);
+        if let Some(ns) = runner.run(&name, || {
+            let mut batch = Batch::new();
+            build(&mut batch);
+            black_box(batch.len());
+        }) {
+            runner.report(&name, ns / count as f64, "ns/op");
+        }
+
+        let name = format!("batch/build_reused/{}", count);
+        let mut batch = Batch::with_capacity(count);
+        if let Some(ns) = runner.run(&name, || {
+            batch.clear();
+            build(&mut batch);
+            black_box(batch.len());
+        }) {
+            runner.report(&name, ns / count as f64, "ns/op");
+        }
+    }
+}
+
+fn bench_query(runner: &mut Runner) {
+    let handle = handle::new_handle().unwrap();
+    let query = "select timestamp, price, volume, symbol from trades in range(2021, +1d)";
+
+    runner.run("query/round_trip", || {
+        black_box(handle.query(black_box(query)).unwrap());
+    });
+
+    let result = handle.query(query).unwrap();
+    runner.run(&format!("query/columns/{}", QUERY_ROWS), || {
+        black_box(result.columns());
+    });
+    runner.run(&format!("query/byte_size/{}", QUERY_ROWS), || {
+        black_box(result.byte_size());
+    });
+    runner.run("query/row", || {
+        black_box(result.row(black_box(QUERY_ROWS / 2)));
+    });
+}
+
+fn bench_query_cache(runner: &mut Runner) {
+    let handle = handle::new_handle().unwrap();
+    let cache = QueryCache::new(&handle, QueryCacheConfig::default());
+    let query = "SELECT  price FROM trades\n  IN RANGE(2021, +1d)  ";
+    cache.query(query).unwrap();
+
+    runner.run("query_cache/normalize_query", || {
+        black_box(normalize_query(black_box(query)));
+    });
+    runner.run("query_cache/hit", || {
+        black_box(cache.query(black_box(query)).unwrap());
+    });
+}
+
+fn bench_splitter(runner: &mut Runner) {
+    let query = SlicedQuery {
+        select: "sum(volume)".to_string(),
+        table: "trades".to_string(),
+        begin: 1_609_459_200_000_000_000,
+        end: 1_609_545_600_000_000_000,
+        filter: Some("symbol = 'BTC'".to_string()),
+    };
+    let hour = 3_600_000_000_000i64;
+
+    runner.run("query_splitter/time_slices/16", || {
+        black_box(time_slices(black_box(query.begin), query.end, hour, 16));
+    });
+    runner.run("query_splitter/render", || {
+        black_box(query.render(black_box(query.begin), query.end));
+    });
+}
+
+fn bench_histogram(runner: &mut Runner) {
+    let mut histogram = LatencyHistogram::new();
+    let mut value: u64 = 1;
+
+    runner.run("histogram/record", || {
+        // xorshift, spreads the values over the whole range of buckets
+        value ^= value << 13;
+        value ^= value >> 7;
+        value ^= value << 17;
+        histogram.record(black_box(value >> 34));
+    });
+    runner.run("histogram/percentile", || {
+        black_box(histogram.percentile(black_box(99.0)));
+    });
+}
+
+fn bench_queues(runner: &mut Runner) {
+    let (producer, consumer) = spsc_queue::channel::<u64>(1024);
+    runner.run("spsc_queue/push_pop", || {
+        producer.push(black_box(42)).unwrap();
+        black_box(consumer.pop());
+    });
+
+    let mpsc: MpscRing<[u64; 8]> = MpscRing::with_capacity(1024);
+    let mut consumer = mpsc.consumer().unwrap();
+    runner.run("mpsc_ring/push_pop", || {
+        mpsc.push_with(|slot| slot[0] = black_box(42));
+        consumer.pop_with(|slot| { black_box(slot[0]); });
+    });
+}
+
+fn bench_perf_trace(runner: &mut Runner) {
+    let labels = [quasar_rs::qdb_perf_label_t_qdb_pl_accepted,
+        quasar_rs::qdb_perf_label_t_qdb_pl_received,
+        quasar_rs::qdb_perf_label_t_qdb_pl_deserialization_starts,
+        quasar_rs::qdb_perf_label_t_qdb_pl_deserialization_ends,
+        quasar_rs::qdb_perf_label_t_qdb_pl_processing_starts,
+        quasar_rs::qdb_perf_label_t_qdb_pl_processing_ends];
+    let profiles: Vec<Profile> = (0..64)
+        .map(|i| Profile {
+            name: format!("profile_{}", i),
+            measurements: labels.iter().enumerate()
+                .map(|(j, label)| Measurement { label: *label, elapsed: j as i64 * 1_500 })
+                .collect(),
+        })
+        .collect();
+
+    runner.run("perf_trace/chrome_trace/64", || {
+        black_box(perf_trace::chrome_trace(black_box(&profiles)));
+    });
+}
+
+// JSON blobs of the shape our services store: arrays of small records sharing their keys and most values.
+fn json_blob(records: usize) -> Vec<u8> {
+    let mut json = String::from("[");
+    for i in 0..records {
+        json += &format!("{{\"id\":{},\"account\":\"acc-{:05}\",\"symbol\":\"{}\",\"price\":{}.{:02},\"quantity\":{},\
+                          \"side\":\"{}\",\"venue\":\"XNAS\",\"timestamp\":\"2021-01-01T00:{:02}:{:02}.000Z\"}},",
+                         i, i * 7919 % 3000, ["BTC-USD", "ETH-USD", "SOL-USD"][i % 3], 29_000 + i * 37 % 1_000,
+                         i * 13 % 100, 1 + i % 50, if i % 2 == 0 { "buy" } else { "sell" }, i / 60 % 60, i % 60);
+    }
+    json.push(']');
+    json.into_bytes()
+}
+
+// CPU cost of the blob codec against the bytes it saves, per codec and blob size.
+fn bench_codec(runner: &mut Runner) {
+    for (records, size) in [(16usize, "2k"), (128, "16k"), (1024, "128k")] {
+        let json = json_blob(records);
+
+        for (c, name) in [(Codec::Fast, "fast"), (Codec::Best, "best")] {
+            let payload = codec::encode(c, &json).unwrap();
+            let saved = 100.0 * (1.0 - payload.len() as f64 / json.len() as f64);
+            runner.report(&format!("codec/{}/saved/{}", name, size), saved, "% saved");
+
+            if let Some(ns) = runner.run(&format!("codec/{}/encode/{}", name, size), || {
+                black_box(codec::encode(c, black_box(&json)).unwrap());
+            }) {
+                runner.report(&format!("codec/{}/encode/{}", name, size), json.len() as f64 * 1e3 / ns, "MB/s");
+            }
+            if let Some(ns) = runner.run(&format!("codec/{}/decode/{}", name, size), || {
+                black_box(codec::decode(black_box(&payload)).unwrap());
+            }) {
+                runner.report(&format!("codec/{}/decode/{}", name, size), json.len() as f64 * 1e3 / ns, "MB/s");
+            }
+        }
+    }
+}
+
+// In-process stubs of the C API, provided by the fake-api feature when it is enabled
+
+#[cfg(not(feature = "fake-api"))]
+mod stubs {
+    use super::*;
+
+    struct QueryFixture {
+        result: qdb_query_result_t,
+        _names: Vec<qdb_string_t>,
+        _rows: Vec<*mut qdb_point_result_t>,
+        _points: Vec<qdb_point_result_t>,
+    }
+
+    // The fixture is built once and only ever read afterwards.
+    unsafe impl Send for QueryFixture {}
+    unsafe impl Sync for QueryFixture {}
+
+    static QUERY_FIXTURE: OnceLock<QueryFixture> = OnceLock::new();
+    static SYMBOL: &[u8] = b"BTC-USD\0";
+
+    fn query_fixture() -> &'static QueryFixture {
+        QUERY_FIXTURE.get_or_init(|| {
+            static NAMES: [&[u8]; 4] = [b"timestamp\0", b"price\0", b"volume\0", b"symbol\0"];
+            let mut names: Vec<qdb_string_t> = NAMES.iter()
+                .map(|n| qdb_string_t { data: n.as_ptr() as *const raw::c_char, length: n.len() - 1 })
+                .collect();
+
+            let mut points: Vec<qdb_point_result_t> = Vec::with_capacity(QUERY_ROWS * NAMES.len());
+            for i in 0..QUERY_ROWS {
+                let mut payload: qdb_point_result_t__bindgen_ty_1 = unsafe { std::mem::zeroed() };
+                payload.timestamp.value = qdb_timespec_t { tv_sec: 1_609_459_200 + i as i64, tv_nsec: 0 };
+                points.push(qdb_point_result_t { type_: qdb_query_result_value_type_t_qdb_query_result_timestamp, payload });
+
+                let mut payload: qdb_point_result_t__bindgen_ty_1 = unsafe { std::mem::zeroed() };
+                payload.double_.value = 29_000.0 + i as f64;
+                points.push(qdb_point_result_t { type_: qdb_query_result_value_type_t_qdb_query_result_double, payload });
+
+                let mut payload: qdb_point_result_t__bindgen_ty_1 = unsafe { std::mem::zeroed() };
+                payload.int64_.value = i as i64;
+                points.push(qdb_point_result_t { type_: qdb_query_result_value_type_t_qdb_query_result_int64, payload });
+
+                let mut payload: qdb_point_result_t__bindgen_ty_1 = unsafe { std::mem::zeroed() };
+                payload.string.content = SYMBOL.as_ptr() as *const raw::c_char;
+                payload.string.content_length = SYMBOL.len() - 1;
+                points.push(qdb_point_result_t { type_: qdb_query_result_value_type_t_qdb_query_result_string, payload });
+            }
+
+            let mut rows: Vec<*mut qdb_point_result_t> = (0..QUERY_ROWS)
+                .map(|i| unsafe { points.as_mut_ptr().add(i * NAMES.len()) })
+                .collect();
+
+            let result = qdb_query_result_t {
+                column_names: names.as_mut_ptr(),
+                column_count: NAMES.len(),
+                rows: rows.as_mut_ptr(),
+                row_count: QUERY_ROWS,
+                scanned_point_count: (QUERY_ROWS * NAMES.len()),
+                error_message: qdb_string_t { data: ptr::null(), length: 0 },
+            };
+
+            QueryFixture { result, _names: names, _rows: rows, _points: points }
+        })
+    }
+
+    #[no_mangle]
+    pub unsafe extern "C" fn qdb_open(handle: *mut qdb_handle_t, _proto: qdb_protocol_t) -> qdb_error_t {
+        *handle = ptr::NonNull::dangling().as_ptr();
+        0
+    }
+
+    #[no_mangle]
+    pub unsafe extern "C" fn qdb_query(_handle: qdb_handle_t, _query: *const raw::c_char,
+                                       result: *mut *mut qdb_query_result_t) -> qdb_error_t {
+        *result = &query_fixture().result as *const _ as *mut _;
+        0
+    }
+
+    #[no_mangle]
+    pub unsafe extern "C" fn qdb_release(_handle: qdb_handle_t, _buffer: *const raw::c_void) {
+        // the fixture is static, nothing to free
+    }
+}
@@ -17,16 +17,17 @@ fn main() {
     // https://www.reddit.com/r/rust/comments/885t1h/bindgen_linking_question/
     // println!("cargo:rustc-link-lib=dylib=c++");
     // println!("cargo:rustc-link-lib=dylib=c++abi");
-    println!("cargo:rustc-link-lib=libqdb_api");
+    // The fake-api feature provides the qdb_* symbols in-process instead.
+    let fake_api = env::var("CARGO_FEATURE_FAKE_API").is_ok();
+    if !fake_api {
+        println!("cargo:rustc-link-lib=libqdb_api");
+    }
 
     // Set the dylib search path relative to the current crate
     // https://stackoverflow.com/questions/41917096/how-do-i-make-rustc-link-search-relative-to-the-project-location
     let dir = env::var("CARGO_MANIFEST_DIR").unwrap();
     println!("cargo:rustc-link-search=native={}", Path::new(&dir).join("qdb/lib").display());
 
-    // Tell rustc to link the qdb library.
-    println!("cargo:rustc-link-lib=libqdb_api");
-
     // Tell cargo to invalidate the built crate whenever the wrapper changes
     println!("cargo:rerun-if-changed=wrapper.h");
 
@@ -0,0 +1,45 @@
+use std::env;
+use std::fs;
+
+use quasar_rs::{handle, perf_trace};
+
+// Runs a query with client tracking enabled and writes the server side phases
+// of every request as a Chrome trace, to be opened in https://ui.perfetto.dev
+//
+// cargo run --example perf_trace -- qdb://127.0.0.1:2836 "select * from btc in range(2021, +1d)" trace.json
+fn main() {
+    let args: Vec<String> = env::args().collect();
+    if args.len() < 3 {
+        eprintln!("Usage: {} <uri> <query> [output.json] [repeat]", args[0]);
+        std::process::exit(1);
+    }
+
+    let cluster_uri = &args[1];
+    let query = &args[2];
+    let output = args.get(3).map(|s| s.as_str()).unwrap_or("trace.json");
+    let repeat: usize = args.get(4).and_then(|s| s.parse().ok()).unwrap_or(1);
+
+    let handle = handle::must_setup_handle(cluster_uri, 60 * 1000).unwrap();
+
+    if let Some(e) = handle.perf_enable_client_tracking() {
+        panic!("Unable to enable client tracking: {:?}", e);
+    }
+
+    for _ in 0..repeat {
+        match handle.query(query) {
+            Ok(r) => println!("{} row(s), {} scanned point(s)", r.row_count(), r.scanned_point_count()),
+            Err(e) => panic!("Query failed: {:?}", e),
+        }
+    }
+
+    let profiles = handle.perf_get_profiles().expect("Unable to get profiles");
+    if let Some(e) = handle.perf_disable_client_tracking() {
+        // the profiles are already read, the trace is still worth writing
+        eprintln!("Unable to disable client tracking: {:?}", e);
+    }
+
+    let trace = perf_trace::chrome_trace(&profiles);
+    fs::write(output, serde_json::to_string_pretty(&trace).unwrap()).expect("Unable to write trace");
+
+    println!("{} profile(s) written to {}", profiles.len(), output);
+}
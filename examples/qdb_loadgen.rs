@@ -0,0 +1,54 @@
+use std::env;
+use std::fs;
+
+use quasar_rs::{handle_pool, loadgen};
+
+// Replays a declarative workload against a cluster and reports throughput and latency percentiles
+// per operation, see loadgen::WorkloadSpec for the format and examples/workloads for samples.
+//
+// cargo run --release --example qdb_loadgen -- examples/workloads/mixed.json qdb://127.0.0.1:2836
+//
+// Built with --features fake-api it runs against the in-process fake instead of a cluster,
+// QDB_FAKE_LATENCY_US then sets the simulated round trip.
+fn main() {
+    let args: Vec<String> = env::args().collect();
+    if args.len() < 2 {
+        eprintln!("Usage: {} <workload.json> [uri] [pool size]", args[0]);
+        std::process::exit(1);
+    }
+
+    let content = fs::read_to_string(&args[1]).expect("Unable to read the workload file");
+    let spec = match loadgen::parse_workload(&content) {
+        Ok(s) => s,
+        Err(e) => {
+            eprintln!("Invalid workload {}: {}", args[1], e);
+            std::process::exit(1);
+        }
+    };
+    let cluster_uri = args.get(2).map(|s| s.as_str()).unwrap_or("qdb://127.0.0.1:2836");
+    let pool_size: usize = args.get(3).and_then(|s| s.parse().ok()).unwrap_or(spec.workers);
+
+    #[cfg(feature = "fake-api")]
+    {
+        let latency_us: u64 = env::var("QDB_FAKE_LATENCY_US").ok().and_then(|s| s.parse().ok()).unwrap_or(200);
+        quasar_rs::fake_api::configure(quasar_rs::fake_api::FakeConfig {
+            latency: std::time::Duration::from_micros(latency_us),
+            jitter: std::time::Duration::from_micros(latency_us / 4),
+            ..Default::default()
+        });
+    }
+
+    let pool = handle_pool::new_handle_pool(cluster_uri, 60 * 1000, pool_size).expect("Unable to connect");
+
+    if spec.preload {
+        println!("Preloading {} key(s)...", spec.keys.count);
+        if let Err(e) = loadgen::preload(&pool, &spec) {
+            panic!("Preload failed: {:?}", e);
+        }
+    }
+
+    println!("Running {} op/s for {}ms after a {}ms warmup, {} worker(s)...",
+             spec.rate, spec.duration_ms, spec.warmup_ms, spec.workers);
+    let report = loadgen::run_workload(&pool, &spec);
+    println!("{}", report);
+}
@@ -1896,6 +1896,10 @@ pub const qdb_entry_type_t_qdb_entry_deque: qdb_entry_type_t = 4;
 pub const qdb_entry_type_t_qdb_entry_stream: qdb_entry_type_t = 5;
 #[doc = "! Distributed time series."]
 pub const qdb_entry_type_t_qdb_entry_ts: qdb_entry_type_t = 6;
+#[doc = "! 64-bit floating point number."]
+pub const qdb_entry_type_t_qdb_entry_double: qdb_entry_type_t = 10;
+#[doc = "! Timestamp."]
+pub const qdb_entry_type_t_qdb_entry_timestamp: qdb_entry_type_t = 11;
 #[doc = "! Distributed time series."]
 pub const qdb_entry_type_t_qdb_entry_internal_ts_double_bucket: qdb_entry_type_t = 20;
 #[doc = "! Distributed time series."]
@@ -2411,6 +2415,22 @@ extern "C" {
     #[doc = "! EXPERIMENTAL. Use at your own risk!"]
     pub fn qdb_option_cluster_tidy_memory(handle: qdb_handle_t) -> qdb_error_t;
 }
+extern "C" {
+    #[doc = "! EXPERIMENTAL. Use at your own risk!"]
+    pub fn qdb_option_set_client_soft_memory_limit(handle: qdb_handle_t, limit: qdb_uint_t) -> qdb_error_t;
+}
+extern "C" {
+    #[doc = "! EXPERIMENTAL. Use at your own risk!"]
+    pub fn qdb_option_client_get_memory_info(
+        handle: qdb_handle_t,
+        content: *mut *const ::std::os::raw::c_char,
+        content_length: *mut qdb_size_t,
+    ) -> qdb_error_t;
+}
+extern "C" {
+    #[doc = "! EXPERIMENTAL. Use at your own risk!"]
+    pub fn qdb_option_client_tidy_memory(handle: qdb_handle_t) -> qdb_error_t;
+}
 extern "C" {
     #[doc = "! EXPERIMENTAL. Use at your own risk!"]
     pub fn qdb_option_cluster_disable_async_pipelines(handle: qdb_handle_t) -> qdb_error_t;
@@ -2445,6 +2465,14 @@ pub const qdb_operation_type_t_qdb_op_int_add: qdb_operation_type_t = 12;
 pub const qdb_operation_type_t_qdb_op_get_entry_type: qdb_operation_type_t = 13;
 #[doc = "! A value get operation"]
 pub const qdb_operation_type_t_qdb_op_value_get: qdb_operation_type_t = 14;
+#[doc = "! A double put operation"]
+pub const qdb_operation_type_t_qdb_op_double_put: qdb_operation_type_t = 15;
+#[doc = "! A double update operation"]
+pub const qdb_operation_type_t_qdb_op_double_update: qdb_operation_type_t = 16;
+#[doc = "! A double get operation"]
+pub const qdb_operation_type_t_qdb_op_double_get: qdb_operation_type_t = 17;
+#[doc = "! A double increase/decrease operation"]
+pub const qdb_operation_type_t_qdb_op_double_add: qdb_operation_type_t = 18;
 #[doc = "! \\ingroup batch\n! \\typedef qdb_operation_type_t\n! \\brief An enumeration of possible operation type.\n!\n! Operations are used by batches and transactions."]
 pub type qdb_operation_type_t = ::std::os::raw::c_int;
 #[doc = "! \\ingroup batch\n! \\brief The required parameters for an integer operation within a batch"]
@@ -2547,6 +2575,50 @@ fn bindgen_test_layout_blob_put_update_t() {
         )
     );
 }
+#[doc = "! \\ingroup batch\n! \\brief The required parameters for a double operation within a batch"]
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct double_put_update_t {
+    #[doc = "! The value of the 64-bit floating-point number to use."]
+    pub value: f64,
+    #[doc = "! The optional expiration time. Use \\ref qdb_never_expires for no\n! expiration."]
+    pub expiry_time: qdb_time_t,
+}
+#[test]
+fn bindgen_test_layout_double_put_update_t() {
+    const UNINIT: ::std::mem::MaybeUninit<double_put_update_t> = ::std::mem::MaybeUninit::uninit();
+    let ptr = UNINIT.as_ptr();
+    assert_eq!(
+        ::std::mem::size_of::<double_put_update_t>(),
+        16usize,
+        concat!("Size of: ", stringify!(double_put_update_t))
+    );
+    assert_eq!(
+        ::std::mem::align_of::<double_put_update_t>(),
+        8usize,
+        concat!("Alignment of ", stringify!(double_put_update_t))
+    );
+    assert_eq!(
+        unsafe { ::std::ptr::addr_of!((*ptr).value) as usize - ptr as usize },
+        0usize,
+        concat!(
+            "Offset of field: ",
+            stringify!(double_put_update_t),
+            "::",
+            stringify!(value)
+        )
+    );
+    assert_eq!(
+        unsafe { ::std::ptr::addr_of!((*ptr).expiry_time) as usize - ptr as usize },
+        8usize,
+        concat!(
+            "Offset of field: ",
+            stringify!(double_put_update_t),
+            "::",
+            stringify!(expiry_time)
+        )
+    );
+}
 #[doc = "! \\ingroup batch\n! \\brief A single operation containing all parameters to execute the\n! operation in a batch or in a transaction.\n!\n! You should initialize operations before usage with the \\ref\n! qdb_init_operations function.\n!"]
 #[repr(C)]
 #[derive(Copy, Clone)]
@@ -2579,6 +2651,12 @@ pub union qdb_operation_t__bindgen_ty_1 {
     pub blob_get: qdb_operation_t__bindgen_ty_1__bindgen_ty_6,
     pub blob_get_and_update: qdb_operation_t__bindgen_ty_1__bindgen_ty_7,
     pub value_get: qdb_operation_t__bindgen_ty_1__bindgen_ty_8,
+    pub double_add: qdb_operation_t__bindgen_ty_1__bindgen_ty_9,
+    pub double_get: qdb_operation_t__bindgen_ty_1__bindgen_ty_10,
+    #[doc = "! Double put specific operation parameters"]
+    pub double_put: double_put_update_t,
+    #[doc = "! Double update specific operation parameters"]
+    pub double_update: double_put_update_t,
 }
 #[doc = "! Tag specific operation parameters"]
 #[repr(C)]
@@ -3032,6 +3110,10 @@ pub struct qdb_operation_t__bindgen_ty_1__bindgen_ty_8 {
     pub blob_content_size: qdb_size_t,
     #[doc = "! The result of the get operation when the returned type is\n! integer"]
     pub int_result: qdb_int_t,
+    #[doc = "! The result of the get operation when the returned type is\n! double"]
+    pub double_result: f64,
+    #[doc = "! The result of the get operation when the returned type is\n! timestap"]
+    pub timestamp_result: qdb_timespec_t,
 }
 #[test]
 fn bindgen_test_layout_qdb_operation_t__bindgen_ty_1__bindgen_ty_8() {
@@ -3040,7 +3122,7 @@ fn bindgen_test_layout_qdb_operation_t__bindgen_ty_1__bindgen_ty_8() {
     let ptr = UNINIT.as_ptr();
     assert_eq!(
         ::std::mem::size_of::<qdb_operation_t__bindgen_ty_1__bindgen_ty_8>(),
-        32usize,
+        56usize,
         concat!(
             "Size of: ",
             stringify!(qdb_operation_t__bindgen_ty_1__bindgen_ty_8)
@@ -3094,6 +3176,66 @@ fn bindgen_test_layout_qdb_operation_t__bindgen_ty_1__bindgen_ty_8() {
             stringify!(int_result)
         )
     );
+    assert_eq!(
+        unsafe { ::std::ptr::addr_of!((*ptr).double_result) as usize - ptr as usize },
+        32usize,
+        concat!(
+            "Offset of field: ",
+            stringify!(qdb_operation_t__bindgen_ty_1__bindgen_ty_8),
+            "::",
+            stringify!(double_result)
+        )
+    );
+    assert_eq!(
+        unsafe { ::std::ptr::addr_of!((*ptr).timestamp_result) as usize - ptr as usize },
+        40usize,
+        concat!(
+            "Offset of field: ",
+            stringify!(qdb_operation_t__bindgen_ty_1__bindgen_ty_8),
+            "::",
+            stringify!(timestamp_result)
+        )
+    );
+}
+#[doc = "! Double increment/decrement specific operation parameters"]
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct qdb_operation_t__bindgen_ty_1__bindgen_ty_9 {
+    #[doc = "! A 64-bit floating-point representing the result of the\n! operation"]
+    pub result: f64,
+    #[doc = "! The value to add or subtract to the entry"]
+    pub addend: f64,
+}
+#[test]
+fn bindgen_test_layout_qdb_operation_t__bindgen_ty_1__bindgen_ty_9() {
+    const UNINIT: ::std::mem::MaybeUninit<qdb_operation_t__bindgen_ty_1__bindgen_ty_9> =
+        ::std::mem::MaybeUninit::uninit();
+    let ptr = UNINIT.as_ptr();
+    assert_eq!(
+        ::std::mem::size_of::<qdb_operation_t__bindgen_ty_1__bindgen_ty_9>(),
+        16usize,
+        concat!(
+            "Size of: ",
+            stringify!(qdb_operation_t__bindgen_ty_1__bindgen_ty_9)
+        )
+    );
+    assert_eq!(
+        unsafe { ::std::ptr::addr_of!((*ptr).addend) as usize - ptr as usize },
+        8usize,
+        concat!(
+            "Offset of field: ",
+            stringify!(qdb_operation_t__bindgen_ty_1__bindgen_ty_9),
+            "::",
+            stringify!(addend)
+        )
+    );
+}
+#[doc = "! Double get specific operation parameters"]
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct qdb_operation_t__bindgen_ty_1__bindgen_ty_10 {
+    #[doc = "! The result of the double get operation"]
+    pub result: f64,
 }
 #[test]
 fn bindgen_test_layout_qdb_operation_t__bindgen_ty_1() {
@@ -5964,6 +6106,9 @@ pub const qdb_exp_batch_push_options_t_qdb_exp_batch_option_standard: qdb_exp_ba
 #[doc = "! Operation works with the duplicated data removing."]
 pub const qdb_exp_batch_push_options_t_qdb_exp_batch_option_unique: qdb_exp_batch_push_options_t =
     1;
+#[doc = "! Operation works with the duplicated data updating."]
+pub const qdb_exp_batch_push_options_t_qdb_exp_batch_option_unique_upsert: qdb_exp_batch_push_options_t =
+    2;
 #[doc = "! \\ingroup ts\n! \\brief Ways of working with duplicated data in \\ref qdb_exp_batch_push."]
 pub type qdb_exp_batch_push_options_t = ::std::os::raw::c_uint;
 #[doc = "! \\ingroup ts\n! \\brief Data and metadata of a table sent to the server in a batch."]
@@ -6148,6 +6293,93 @@ extern "C" {
         column_count: qdb_size_t,
     ) -> qdb_error_t;
 }
+#[doc = "! \\ingroup ts\n! \\brief Description of a time series column, perhaps with its symtable."]
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct qdb_ts_column_info_ex_t {
+    #[doc = "! \\brief A pointer to a null-terminated UTF-8 string representing the\n! name of the column."]
+    pub name: *const ::std::os::raw::c_char,
+    #[doc = "! The type of the column."]
+    pub type_: qdb_ts_column_type_t,
+    #[doc = "! \\brief An optional pointer to a null-terminated UTF-8 string\n! representing the symbol table name of the symbol column."]
+    pub symtable: *const ::std::os::raw::c_char,
+}
+#[doc = "! \\ingroup ts\n! \\brief Description of a time series aggregated column."]
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct qdb_ts_aggregated_column_info_t {
+    #[doc = "! \\brief The common column information."]
+    pub info: qdb_ts_column_info_ex_t,
+    #[doc = "! \\brief The aggregation type of column."]
+    pub aggregation: qdb_ts_aggregation_type_t,
+    #[doc = "! \\brief The index of the source column."]
+    pub index: qdb_ts_column_index_t,
+}
+pub const qdb_aggregation_window_type_t_qdb_window_by_duration: qdb_aggregation_window_type_t = 0;
+pub const qdb_aggregation_window_type_t_qdb_window_by_row_count: qdb_aggregation_window_type_t = 1;
+#[doc = "! \\ingroup ts\n! \\brief The aggregation window type."]
+pub type qdb_aggregation_window_type_t = ::std::os::raw::c_uint;
+#[doc = "! \\ingroup ts\n! \\brief The aggregated table parameters."]
+#[repr(C)]
+#[derive(Copy, Clone)]
+pub struct qdb_aggregated_table_t {
+    #[doc = "! \\brief The type of aggregation window."]
+    pub window_type: qdb_aggregation_window_type_t,
+    pub window_params: qdb_aggregated_table_t__bindgen_ty_1,
+    #[doc = "! \\brief pointer to an array that contain descriptions of columns\n! present in the aggregated table."]
+    pub columns: *mut qdb_ts_aggregated_column_info_t,
+    #[doc = "! \\brief the number of columns in array."]
+    pub column_count: qdb_size_t,
+    #[doc = "! \\brief The number of data points to aggregate."]
+    pub sample_size: qdb_uint_t,
+    #[doc = "! \\brief The watermark of the windows."]
+    pub watermark: qdb_duration_t,
+}
+#[repr(C)]
+#[derive(Copy, Clone)]
+pub union qdb_aggregated_table_t__bindgen_ty_1 {
+    pub duration: qdb_aggregated_table_t__bindgen_ty_1__bindgen_ty_1,
+    pub count: qdb_aggregated_table_t__bindgen_ty_1__bindgen_ty_2,
+}
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct qdb_aggregated_table_t__bindgen_ty_1__bindgen_ty_1 {
+    #[doc = "! \\brief The duration of the windows."]
+    pub size: qdb_duration_t,
+    #[doc = "! \\brief The hopping duration step or advance in window."]
+    pub hopping: qdb_duration_t,
+}
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct qdb_aggregated_table_t__bindgen_ty_1__bindgen_ty_2 {
+    #[doc = "! \\brief The size of the window in rows count."]
+    pub size: qdb_uint_t,
+    #[doc = "! \\brief The hopping step or advance in window in rows count."]
+    pub hopping: qdb_uint_t,
+}
+#[doc = "! \\ingroup ts\n! \\brief A time series metadata."]
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct qdb_ts_metadata_t {
+    #[doc = "! \\brief A pointer to an array that contain descriptions of columns\n! present in the time series."]
+    pub columns: *mut qdb_ts_column_info_ex_t,
+    #[doc = "! \\brief The number of columns in array."]
+    pub column_count: qdb_size_t,
+    #[doc = "! \\brief Shard size of the time series, in ms."]
+    pub shard_size: qdb_duration_t,
+    #[doc = "! \\brief TTL of the time series, in ms."]
+    pub ttl: qdb_duration_t,
+    #[doc = "! \\brief A pointer to the aggregated table parameters if it was\n! created"]
+    pub aggregated: *mut qdb_aggregated_table_t,
+}
+extern "C" {
+    #[doc = "! \\ingroup ts\n! \\brief Returns a metadata information about a time series.\n!\n! \\param handle A valid handle previously initialized by \\ref qdb_open or\n! \\ref qdb_open_tcp.\n!\n! \\param alias A pointer to a null-terminated UTF-8 string representing\n! the alias of the time series.\n!\n! \\param[out] metadata A pointer to an structure that will contain\n! information about the time series.\n!\n! \\return A \\ref qdb_error_t code indicating success or failure.\n!\n! \\see \\ref qdb_release"]
+    pub fn qdb_ts_get_metadata(
+        handle: qdb_handle_t,
+        alias: *const ::std::os::raw::c_char,
+        metadata: *mut *mut qdb_ts_metadata_t,
+    ) -> qdb_error_t;
+}
 extern "C" {
     #[doc = "! \\ingroup ts\n! \\brief Returns all the columns of a time series.\n!\n! \\param handle A valid handle previously initialized by \\ref qdb_open or\n! \\ref qdb_open_tcp.\n!\n! \\param alias A pointer to a null-terminated UTF-8 string representing\n! the alias of the time series.\n!\n! \\param[out] columns A pointer to an array that will contain descriptions\n! of columns present in the time series.\n!\n! \\param[out] column_count A pointer to an integer that will receive the\n! number of columns.\n!\n! \\return A \\ref qdb_error_t code indicating success or failure."]
     pub fn qdb_ts_list_columns(
@@ -6299,6 +6531,18 @@ extern "C" {
         point_count: *mut qdb_size_t,
     ) -> qdb_error_t;
 }
+extern "C" {
+    #[doc = "! \\ingroup ts\n! \\brief Retrieves doubles in the specified range of the time series\n! column.\n!\n! It is an error to call this function on a nonexisting time series.\n!\n! \\param handle A valid handle previously initialized by \\ref qdb_open or\n! \\ref qdb_open_tcp.\n!\n! \\param alias A pointer to a null-terminated UTF-8 string representing\n! the alias of the time series.\n!\n! \\param column A pointer to a null-terminated UTF-8 string representing\n! the name of the column to work on.\n!\n! \\param ranges An array of ranges (intervals) for which data\n! should be retrieved.\n!\n! \\param range_count The number of ranges.\n!\n! \\param points An array in which the data points from all given ranges\n! will be placed.\n!\n! \\param[in,out] point_count A pointer to an integer containing the\n! size of the given array on entry, will receive the number of retrieved\n! data points.\n!\n! \\return A \\ref qdb_error_t code indicating success or failure. Returns\n! \\ref qdb_e_buffer_too_small when the given array is not big enough to\n! store all retrieved data points, in which case point_count will contain\n! the necessary size for a successfull call."]
+    pub fn qdb_ts_double_get_ranges_no_copy(
+        handle: qdb_handle_t,
+        alias: *const ::std::os::raw::c_char,
+        column: *const ::std::os::raw::c_char,
+        ranges: *const qdb_ts_range_t,
+        range_count: qdb_size_t,
+        points: *mut qdb_ts_double_point,
+        point_count: *mut qdb_size_t,
+    ) -> qdb_error_t;
+}
 extern "C" {
     #[doc = "! \\ingroup ts\n! \\brief Retrieves 64-bit integers in the specified range of the time\n! series column.\n!\n! It is an error to call this function on a non existing time series.\n!\n! \\param handle A valid handle previously initialized by \\ref qdb_open or\n! \\ref qdb_open_tcp.\n!\n! \\param alias A pointer to a null-terminated UTF-8 string representing\n! the alias of the time series.\n!\n! \\param column A pointer to a null-terminated UTF-8 string representing\n! the name of the column to work on.\n!\n! \\param ranges An array of ranges (intervals) for which data\n! should be retrieved.\n!\n! \\param range_count The number of ranges.\n!\n! \\param[out] points A pointer to an array that will contain data points\n! from all given ranges.\n!\n! \\param[out] point_count A pointer to an integer that will receive the\n! number of returned points.\n!\n! \\return A \\ref qdb_error_t code indicating success or failure.\n!\n! \\see \\ref qdb_release"]
     pub fn qdb_ts_int64_get_ranges(
@@ -6311,6 +6555,18 @@ extern "C" {
         point_count: *mut qdb_size_t,
     ) -> qdb_error_t;
 }
+extern "C" {
+    #[doc = "! \\ingroup ts\n! \\brief Retrieves 64-bit integers in the specified range of the time series\n! column.\n!\n! It is an error to call this function on a nonexisting time series.\n!\n! \\param handle A valid handle previously initialized by \\ref qdb_open or\n! \\ref qdb_open_tcp.\n!\n! \\param alias A pointer to a null-terminated UTF-8 string representing\n! the alias of the time series.\n!\n! \\param column A pointer to a null-terminated UTF-8 string representing\n! the name of the column to work on.\n!\n! \\param ranges An array of ranges (intervals) for which data\n! should be retrieved.\n!\n! \\param range_count The number of ranges.\n!\n! \\param points An array in which the data points from all given ranges\n! will be placed.\n!\n! \\param[in,out] point_count A pointer to an integer containing the\n! size of the given array on entry, will receive the number of retrieved\n! data points.\n!\n! \\return A \\ref qdb_error_t code indicating success or failure. Returns\n! \\ref qdb_e_buffer_too_small when the given array is not big enough to\n! store all retrieved data points, in which case point_count will contain\n! the necessary size for a successfull call."]
+    pub fn qdb_ts_int64_get_ranges_no_copy(
+        handle: qdb_handle_t,
+        alias: *const ::std::os::raw::c_char,
+        column: *const ::std::os::raw::c_char,
+        ranges: *const qdb_ts_range_t,
+        range_count: qdb_size_t,
+        points: *mut qdb_ts_int64_point,
+        point_count: *mut qdb_size_t,
+    ) -> qdb_error_t;
+}
 extern "C" {
     #[doc = "! \\ingroup ts\n! \\brief Retrieves strings in the specified range of the time series\n! column.\n!\n! It is an error to call this function on a non existing time series.\n!\n! \\param handle A valid handle previously initialized by \\ref qdb_open or\n! \\ref qdb_open_tcp.\n!\n! \\param alias A pointer to a null-terminated UTF-8 string representing\n! the alias of the time series.\n!\n! \\param column A pointer to a null-terminated UTF-8 string representing\n! the name of the column to work on.\n!\n! \\param ranges An array of ranges (intervals) for which data\n! should be retrieved.\n!\n! \\param range_count The number of ranges.\n!\n! \\param[out] points A pointer to an array that will contain data points\n! from all given ranges.\n!\n! \\param[out] point_count A pointer to an integer that will receive the\n! number of returned points.\n!\n! \\return A \\ref qdb_error_t code indicating success or failure.\n!\n! \\see \\ref qdb_release"]
     pub fn qdb_ts_string_get_ranges(
@@ -7319,6 +7575,14 @@ extern "C" {
         result: *mut *mut qdb_query_result_t,
     ) -> qdb_error_t;
 }
+extern "C" {
+    #[doc = "! \\ingroup client\n! \\brief Creates a deep copy of a query result\n!\n! The allocated results have to be released later with \\ref qdb_release.\n!\n! \\param handle A valid handle previously initialized by \\ref qdb_open or\n! \\ref qdb_open_tcp.\n!\n! \\param result A pointer to a buffer to copy\n!\n! \\param[out] result_copy A pointer to a a pointer that will receive\n! API-allocated results whose content will be a copy of the source results\n!\n! \\return A \\ref qdb_error_t code indicating success or failure.\n!\n! \\see \\ref qdb_release"]
+    pub fn qdb_query_copy_results(
+        handle: qdb_handle_t,
+        result: *const qdb_query_result_t,
+        result_copy: *mut *mut qdb_query_result_t,
+    ) -> qdb_error_t;
+}
 #[doc = "! \\ingroup query\n! \\brief Holds a column of an experimental query\n!\n! \\warning This structure is still under development. Compatibility is not\n! guaranteed."]
 #[repr(C)]
 #[derive(Copy, Clone)]
@@ -7703,11 +7967,12 @@ pub const qdb_query_continuous_mode_type_t_qdb_query_continuous_new_values_only:
 #[doc = "! \\ingroup query\n! \\brief The continuous query mode"]
 pub type qdb_query_continuous_mode_type_t = ::std::os::raw::c_uint;
 extern "C" {
-    #[doc = "! \\ingroup query\n! \\brief Continuously and efficiently query the server with the given\n! query\n!\n! A continuous query receives results in a callback asynchronously as they\n! are available on the server. This API uses push notifications from the\n! server to minimize data exchange and resource usage.\n!\n! \\param handle A valid handle previously initialized by \\ref qdb_open or\n! \\ref qdb_open_tcp.\n!\n! \\param query A pointer to a null-terminated UTF-8 string representing\n! the query to perform. Any valid QuasarDB query is supported.\n!\n! \\param mode The mode of the query. Full will return all values at every\n! call whereas new values will only deliver updates values.\n!\n! \\param cb A pointer to a function that will be called when new data is\n! available\n!\n! \\param cb_context An opaque pointer to any client managed structure to\n! pass to the callback. May be null if no context is needed.\n!\n! \\param[out] cont_handle A handle to the continuous query handle. Updates\n! to the query will be received until qdb_release is called on this\n! handle.\n!\n! \\return A \\ref qdb_error_t code indicating success or failure.\n! \\see qdb_release"]
+    #[doc = "! \\ingroup query\n! \\brief Continuously and efficiently query the server with the given\n! query\n!\n! A continuous query receives results in a callback asynchronously as they\n! are available on the server. This API uses push notifications from the\n! server to minimize data exchange and resource usage.\n!\n! \\param handle A valid handle previously initialized by \\ref qdb_open or\n! \\ref qdb_open_tcp.\n!\n! \\param query A pointer to a null-terminated UTF-8 string representing\n! the query to perform. Any valid QuasarDB query is supported.\n!\n! \\param mode The mode of the query. Full will return all values at every\n! call whereas new values will only deliver updates values.\n!\n! \\param refresh_rate_ms The refresh rate (in ms) at which the query will\n! return results.\n!\n! \\param cb A pointer to a function that will be called when new data is\n! available\n!\n! \\param cb_context An opaque pointer to any client managed structure to\n! pass to the callback. May be null if no context is needed.\n!\n! \\param[out] cont_handle A handle to the continuous query handle. Updates\n! to the query will be received until qdb_release is called on this\n! handle.\n!\n! \\return A \\ref qdb_error_t code indicating success or failure.\n! \\see qdb_release"]
     pub fn qdb_query_continuous(
         handle: qdb_handle_t,
         query: *const ::std::os::raw::c_char,
         mode: qdb_query_continuous_mode_type_t,
+        refresh_rate_ms: ::std::os::raw::c_uint,
         cb: qdb_query_cont_callback_t,
         cb_context: *mut ::std::os::raw::c_void,
         cont_handle: *mut qdb_query_cont_handle_t,
@@ -0,0 +1,8 @@
+# bin/sh
+set -o errexit
+set -o nounset
+set -o pipefail
+
+# Client overhead benchmarks, the qdb_* functions they use are stubbed in-process.
+# Pass a filter to run a subset, e.g. BENCH_FILTER=query make bench
+cargo bench --bench client_overhead -- ${BENCH_FILTER:-}
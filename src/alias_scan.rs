@@ -0,0 +1,302 @@
+use std::sync::mpsc;
+use std::thread;
+
+use crate::error::ErrorType;
+use crate::ffi_str::AliasList;
+use crate::handle::HandleType;
+
+/// ScanKind : Whether a scan walks the aliases starting or ending with its pattern.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum ScanKind {
+    Prefix,
+    Suffix,
+}
+
+/// ScanConfig : Settings of a paged scan.
+///    page_size : most aliases in one page, the bound of the API buffer held by the scan.
+///    alphabet : characters aliases are made of, a pattern too large for a page is split by appending
+///        (or prepending for a suffix) each of them. Aliases using other characters are still found,
+///        in a page larger than page_size, see ScanStats::oversized.
+#[derive(Debug, Clone)]
+pub struct ScanConfig {
+    pub page_size: usize,
+    pub alphabet: Vec<char>,
+}
+
+impl Default for ScanConfig {
+    fn default() -> Self {
+        ScanConfig { page_size: 1024, alphabet: (' '..='~').collect() }
+    }
+}
+
+/// ScanStats : Calls made by a scan so far.
+///    counts : exact count calls, for the pattern of the scan and the patterns whose estimates did not add up.
+///    estimates : approximate count calls spent splitting patterns too large for a page.
+///    oversized : pages larger than page_size, patterns the alphabet could not split.
+#[derive(Debug, Default, Clone, Copy, PartialEq, Eq)]
+pub struct ScanStats {
+    pub pages: u64,
+    pub aliases: u64,
+    pub counts: u64,
+    pub estimates: u64,
+    pub oversized: u64,
+}
+
+/// ScanPage : One page of a scan.
+///    List : aliases read in place from the API buffer, released with the page.
+///    Alias : the pattern itself, when it is an alias and its extensions were split into other pages.
+#[derive(Debug)]
+pub enum ScanPage<'h> {
+    List(AliasList<'h>),
+    Alias(String),
+}
+
+impl ScanPage<'_> {
+    pub fn len(&self) -> usize {
+        match self {
+            ScanPage::List(list) => list.len(),
+            ScanPage::Alias(_) => 1,
+        }
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    pub fn get(&self, i: usize) -> Option<&str> {
+        match self {
+            ScanPage::List(list) => list.get(i),
+            ScanPage::Alias(alias) => (i == 0).then_some(alias.as_str()),
+        }
+    }
+
+    pub fn iter(&self) -> impl ExactSizeIterator<Item=&str> + '_ {
+        (0..self.len()).map(move |i| self.get(i).unwrap())
+    }
+}
+
+/// AliasScan : Walks the aliases matching a pattern page by page, instead of one prefix_get of max_count.
+///    The API has no continuation, a pattern matching more than page_size aliases is split into narrower
+///    patterns by counting them, until each fits in a page, so memory stays flat whatever the namespace size.
+///    The narrower patterns are counted with approximate counts, and exactly only when the estimates do not add up
+///    to the count of the pattern. A pattern whose estimate was too low is found out when its page overflows.
+///    The scan is not a snapshot: an alias added or removed while it runs may be missed or seen.
+///
+///    for page in handle.prefix_scan("orders.", ScanConfig::default()) {
+///        for alias in page?.iter() { .. }
+///    }
+pub struct AliasScan<'h> {
+    handle: &'h HandleType,
+    kind: ScanKind,
+    config: ScanConfig,
+    // patterns left to walk with their count, the next one last; None until the first page is asked for
+    pending: Option<Vec<(String, u64)>>,
+    pattern: String,
+    stats: ScanStats,
+}
+
+impl<'h> AliasScan<'h> {
+    pub fn new(handle: &'h HandleType, kind: ScanKind, pattern: &str, config: ScanConfig) -> AliasScan<'h> {
+        AliasScan { handle, kind, config, pending: None, pattern: pattern.to_string(), stats: ScanStats::default() }
+    }
+
+    /// Estimate : Returns the approximate number of aliases the scan walks, without walking them.
+    pub fn estimate(&self) -> Result<u64, ErrorType> {
+        match self.kind {
+            ScanKind::Prefix => self.handle.prefix_approximate_count(&self.pattern),
+            ScanKind::Suffix => self.handle.suffix_approximate_count(&self.pattern),
+        }
+    }
+
+    pub fn stats(&self) -> ScanStats {
+        self.stats
+    }
+
+    fn count(&mut self, pattern: &str, exact: bool) -> Result<u64, ErrorType> {
+        if exact {
+            self.stats.counts += 1;
+        } else {
+            self.stats.estimates += 1;
+        }
+        match (self.kind, exact) {
+            (ScanKind::Prefix, true) => self.handle.prefix_count(pattern),
+            (ScanKind::Suffix, true) => self.handle.suffix_count(pattern),
+            (ScanKind::Prefix, false) => self.handle.prefix_approximate_count(pattern),
+            (ScanKind::Suffix, false) => self.handle.suffix_approximate_count(pattern),
+        }
+    }
+
+    fn list(&mut self, pattern: &str, limit: u64) -> Result<Option<ScanPage<'h>>, ErrorType> {
+        let list = match self.kind {
+            ScanKind::Prefix => self.handle.prefix_get_list(pattern, limit as i64),
+            ScanKind::Suffix => self.handle.suffix_get_list(pattern, limit as i64),
+        };
+        match list {
+            Ok(list) => Ok(Some(ScanPage::List(list))),
+            // emptied since it was counted
+            Err(ErrorType::ErrAliasNotFound) => Ok(None),
+            Err(err) => Err(err),
+        }
+    }
+
+    fn extend(&self, pattern: &str, c: char) -> String {
+        let mut narrower = String::with_capacity(pattern.len() + c.len_utf8());
+        match self.kind {
+            ScanKind::Prefix => {
+                narrower.push_str(pattern);
+                narrower.push(c);
+            }
+            ScanKind::Suffix => {
+                narrower.push(c);
+                narrower.push_str(pattern);
+            }
+        }
+        narrower
+    }
+
+    // Counts the extensions of pattern by each character of the alphabet, returns those not empty and their sum.
+    fn split(&mut self, pattern: &str, count: u64, exact: bool) -> Result<(Vec<(String, u64)>, u64), ErrorType> {
+        let mut narrower = Vec::new();
+        let mut found = 0;
+        for i in 0..self.config.alphabet.len() {
+            // the remaining extensions are empty
+            if found >= count {
+                break;
+            }
+            let child = self.extend(pattern, self.config.alphabet[i]);
+            let n = self.count(&child, exact)?;
+            if n > 0 {
+                found += n;
+                narrower.push((child, n));
+            }
+        }
+        Ok((narrower, found))
+    }
+
+    fn exists(&self, pattern: &str) -> Result<bool, ErrorType> {
+        match self.handle.get_metadata(pattern) {
+            Ok(_) => Ok(true),
+            Err(ErrorType::ErrAliasNotFound) => Ok(false),
+            Err(err) => Err(err),
+        }
+    }
+
+    // Returns the page of pattern, or splits it into narrower patterns pushed on pending.
+    // count is exact for the pattern of the scan, an estimate for the narrower ones.
+    fn walk(&mut self, pattern: String, count: u64) -> Result<Option<ScanPage<'h>>, ErrorType> {
+        let page_size = self.config.page_size.max(1) as u64;
+        let mut count = count;
+        if count <= page_size {
+            // one more than a page tells an estimate that was too low
+            match self.list(&pattern, page_size + 1)? {
+                Some(page) if page.len() as u64 > page_size => count = self.count(&pattern, true)?,
+                page => return Ok(page),
+            }
+        }
+
+        let (mut narrower, mut found) = self.split(&pattern, count, false)?;
+        let mut exists = found < count && self.exists(&pattern)?;
+        if found + exists as u64 != count {
+            // the estimates do not add up, count again exactly
+            (narrower, found) = self.split(&pattern, count, true)?;
+            exists = found < count && self.exists(&pattern)?;
+        }
+        if found + exists as u64 != count {
+            // characters outside the alphabet, or entries changed while counting: the whole pattern in one page
+            self.stats.oversized += 1;
+            return self.list(&pattern, count.max(found) + page_size);
+        }
+
+        let pending = self.pending.as_mut().unwrap();
+        pending.extend(narrower.into_iter().rev());
+        Ok(exists.then(|| ScanPage::Alias(pattern)))
+    }
+
+    fn next_page(&mut self) -> Result<Option<ScanPage<'h>>, ErrorType> {
+        if self.pending.is_none() {
+            let pattern = self.pattern.clone();
+            let count = self.count(&pattern, true)?;
+            self.pending = Some(if count == 0 { Vec::new() } else { vec![(pattern, count)] });
+        }
+
+        while let Some((pattern, count)) = self.pending.as_mut().unwrap().pop() {
+            if let Some(page) = self.walk(pattern, count)? {
+                if page.is_empty() {
+                    continue;
+                }
+                self.stats.pages += 1;
+                self.stats.aliases += page.len() as u64;
+                return Ok(Some(page));
+            }
+        }
+        Ok(None)
+    }
+}
+
+impl<'h> Iterator for AliasScan<'h> {
+    type Item = Result<ScanPage<'h>, ErrorType>;
+
+    fn next(&mut self) -> Option<Self::Item> {
+        match self.next_page() {
+            Ok(page) => page.map(Ok),
+            Err(err) => {
+                // a failed scan ends
+                self.pending = Some(Vec::new());
+                Some(Err(err))
+            }
+        }
+    }
+}
+
+impl HandleType {
+    /// PrefixScan : Walks the aliases starting with prefix in pages of at most page_size aliases, see AliasScan.
+    pub fn prefix_scan(&self, prefix: &str, config: ScanConfig) -> AliasScan<'_> {
+        AliasScan::new(self, ScanKind::Prefix, prefix, config)
+    }
+
+    /// SuffixScan : Walks the aliases ending with suffix in pages of at most page_size aliases, see AliasScan.
+    pub fn suffix_scan(&self, suffix: &str, config: ScanConfig) -> AliasScan<'_> {
+        AliasScan::new(self, ScanKind::Suffix, suffix, config)
+    }
+
+    /// ForEachPage : Calls f with every page of a scan, the next page is fetched by another thread
+    ///    while f runs, at most two pages are held at once: the one f reads and the one waiting to be handed over. Returns the stats of the scan, or the first error.
+    pub fn for_each_page<F>(&self, kind: ScanKind, pattern: &str, config: ScanConfig, mut f: F) -> Result<ScanStats, ErrorType>
+        where F: FnMut(&ScanPage<'_>) {
+        let scan = AliasScan::new(self, kind, pattern, config);
+
+        thread::scope(|scope| {
+            // a rendezvous, the prefetched page waits with the thread that fetched it
+            let (sender, receiver) = mpsc::sync_channel(0);
+            let prefetch = scope.spawn(move || {
+                let mut scan = scan;
+                while let Some(page) = scan.next() {
+                    let failed = page.is_err();
+                    // the consumer stopped
+                    if sender.send(page).is_err() || failed {
+                        break;
+                    }
+                }
+                scan.stats()
+            });
+
+            let mut first_error = None;
+            for page in receiver.iter() {
+                match page {
+                    Ok(page) => f(&page),
+                    Err(err) => {
+                        first_error = Some(err);
+                        break;
+                    }
+                }
+            }
+            drop(receiver);
+
+            let stats = prefetch.join().expect("alias scan prefetch panicked");
+            match first_error {
+                None => Ok(stats),
+                Some(err) => Err(err),
+            }
+        })
+    }
+}
@@ -0,0 +1,449 @@
+use std::collections::VecDeque;
+use std::future::Future;
+use std::pin::Pin;
+use std::sync::atomic::{AtomicBool, AtomicU64, AtomicUsize, Ordering};
+use std::sync::{Arc, Condvar, Mutex};
+use std::task::{Context, Poll, Waker};
+use std::thread;
+
+use crate::entry::ts_batch::{PushMode, TsBatchTable};
+use crate::error::ErrorType;
+use crate::handle::HandleType;
+use crate::handle_pool::HandlePool;
+use crate::query::Column;
+use crate::{qdb_int_t, qdb_time_t, qdb_ts_double_point, qdb_ts_int64_point};
+
+/// AsyncConfig : Settings of an AsyncClient.
+///    queue_capacity : how many calls may wait for each handle, further calls wait to be queued.
+///    workers_per_handle : how many threads run the calls of each handle.
+#[derive(Debug, Clone, Copy)]
+pub struct AsyncConfig {
+    pub queue_capacity: usize,
+    pub workers_per_handle: usize,
+}
+
+impl Default for AsyncConfig {
+    fn default() -> Self {
+        AsyncConfig { queue_capacity: 1024, workers_per_handle: 1 }
+    }
+}
+
+/// AsyncStats : Counters of an AsyncClient since it was created.
+///    cancelled : calls whose future was dropped before they started, they never reached the cluster.
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct AsyncStats {
+    pub submitted: u64,
+    pub completed: u64,
+    pub cancelled: u64,
+    pub queued: usize,
+}
+
+// A call, run with the handle of its queue or with None when the client stops before it starts.
+type Job = Box<dyn FnOnce(Option<&HandleType>) + Send>;
+
+struct HandleQueue {
+    jobs: Mutex<VecDeque<Job>>,
+    ready: Condvar,
+    // futures waiting for a free slot, by the id of their registration
+    waiting: Mutex<VecDeque<(u64, Waker)>>,
+}
+
+impl HandleQueue {
+    fn wake_one(&self) {
+        if let Some((_, w)) = self.waiting.lock().unwrap().pop_front() {
+            w.wake();
+        }
+    }
+
+    // Withdraws a registration, returns false when it was already woken.
+    fn withdraw(&self, id: u64) -> bool {
+        let mut waiting = self.waiting.lock().unwrap();
+        match waiting.iter().position(|(i, _)| *i == id) {
+            Some(at) => {
+                waiting.remove(at);
+                true
+            }
+            None => false,
+        }
+    }
+}
+
+// Where a future waits for a free slot: its queue and the id of its registration.
+#[derive(Clone, Copy)]
+struct Registration {
+    queue: usize,
+    id: u64,
+}
+
+enum Submit {
+    Full(Job, Registration),
+    Stopped,
+}
+
+struct Shared {
+    pool: HandlePool,
+    queues: Vec<HandleQueue>,
+    capacity: usize,
+    next: AtomicUsize,
+    registrations: AtomicU64,
+    stopped: AtomicBool,
+    submitted: AtomicU64,
+    completed: AtomicU64,
+    cancelled: AtomicU64,
+}
+
+impl Shared {
+    // Queues the job on the first handle with a free slot, starting from first, or from the next one
+    // in round robin order. When they are all full, registers waker on the last queue tried, under the
+    // lock its workers pop with, so that a slot freed after the check always finds the waker.
+    fn try_submit(&self, job: Job, first: Option<usize>, waker: &Waker) -> Result<(), Submit> {
+        let first = first.unwrap_or_else(|| self.next.fetch_add(1, Ordering::Relaxed));
+        let count = self.queues.len();
+        for i in 0..count {
+            let q = (first + i) % count;
+            let mut jobs = self.queues[q].jobs.lock().unwrap();
+            // checked under the lock, so that no job is queued once the workers may have left
+            if self.stopped.load(Ordering::Acquire) {
+                return Err(Submit::Stopped);
+            }
+            if jobs.len() < self.capacity {
+                jobs.push_back(job);
+                drop(jobs);
+                self.submitted.fetch_add(1, Ordering::Relaxed);
+                self.queues[q].ready.notify_one();
+                return Ok(());
+            }
+            if i + 1 == count {
+                let id = self.registrations.fetch_add(1, Ordering::Relaxed);
+                self.queues[q].waiting.lock().unwrap().push_back((id, waker.clone()));
+                return Err(Submit::Full(job, Registration { queue: q, id }));
+            }
+        }
+        unreachable!("the last queue tried registers the waker")
+    }
+
+    fn run(&self, q: usize) {
+        let queue = &self.queues[q];
+        loop {
+            let job = {
+                let mut jobs = queue.jobs.lock().unwrap();
+                loop {
+                    if let Some(job) = jobs.pop_front() {
+                        break job;
+                    }
+                    if self.stopped.load(Ordering::Acquire) {
+                        return;
+                    }
+                    jobs = queue.ready.wait(jobs).unwrap();
+                }
+            };
+            queue.wake_one();
+
+            if self.stopped.load(Ordering::Acquire) {
+                job(None);
+            } else {
+                job(Some(self.pool.handle(q)));
+            }
+        }
+    }
+}
+
+struct OpInner<T> {
+    result: Option<Result<T, ErrorType>>,
+    waker: Option<Waker>,
+    cancelled: bool,
+}
+
+struct OpState<T> {
+    inner: Mutex<OpInner<T>>,
+}
+
+impl<T> OpState<T> {
+    fn complete(&self, result: Result<T, ErrorType>) {
+        let waker = {
+            let mut inner = self.inner.lock().unwrap();
+            inner.result = Some(result);
+            inner.waker.take()
+        };
+        if let Some(w) = waker {
+            w.wake();
+        }
+    }
+}
+
+enum Stage {
+    // not queued yet, with where it waits once every queue was found full
+    Pending(Job, Option<Registration>),
+    Queued,
+    Done,
+}
+
+/// OpFuture : The result of a call made through an AsyncClient.
+///    The call is queued when the future is first polled and runs on a worker of the client.
+///    Dropping the future cancels the call if it has not started yet, a call already running
+///    completes and its result is discarded.
+pub struct OpFuture<T> {
+    shared: Arc<Shared>,
+    state: Arc<OpState<T>>,
+    stage: Stage,
+}
+
+impl<T> OpFuture<T> {
+    pub fn is_queued(&self) -> bool {
+        matches!(self.stage, Stage::Queued)
+    }
+}
+
+impl<T> Future for OpFuture<T> {
+    type Output = Result<T, ErrorType>;
+
+    fn poll(self: Pin<&mut Self>, cx: &mut Context<'_>) -> Poll<Self::Output> {
+        let this = self.get_mut();
+
+        if let Stage::Pending(..) = this.stage {
+            let (job, registration) = match std::mem::replace(&mut this.stage, Stage::Queued) {
+                Stage::Pending(job, registration) => (job, registration),
+                _ => unreachable!(),
+            };
+            // polled before its wake up, or woken: either way the registration is spent
+            if let Some(r) = registration {
+                this.shared.queues[r.queue].withdraw(r.id);
+            }
+            // the waker is set before the job can run
+            this.state.inner.lock().unwrap().waker = Some(cx.waker().clone());
+            // the queue that woke the future first, its slot is the one freed for it
+            match this.shared.try_submit(job, registration.map(|r| r.queue), cx.waker()) {
+                Ok(()) => {}
+                Err(Submit::Full(job, registration)) => {
+                    this.stage = Stage::Pending(job, Some(registration));
+                    return Poll::Pending;
+                }
+                Err(Submit::Stopped) => {
+                    this.stage = Stage::Done;
+                    return Poll::Ready(Err(ErrorType::ErrInterrupted));
+                }
+            }
+        }
+
+        if let Stage::Done = this.stage {
+            panic!("OpFuture polled after completion");
+        }
+
+        let mut inner = this.state.inner.lock().unwrap();
+        match inner.result.take() {
+            Some(result) => {
+                drop(inner);
+                this.stage = Stage::Done;
+                Poll::Ready(result)
+            }
+            None => {
+                inner.waker = Some(cx.waker().clone());
+                Poll::Pending
+            }
+        }
+    }
+}
+
+impl<T> Drop for OpFuture<T> {
+    fn drop(&mut self) {
+        match self.stage {
+            Stage::Queued => self.state.inner.lock().unwrap().cancelled = true,
+            // a wake up received and not used goes to the next waiting future
+            Stage::Pending(_, Some(r)) => {
+                let queue = &self.shared.queues[r.queue];
+                if !queue.withdraw(r.id) {
+                    queue.wake_one();
+                }
+            }
+            _ => {}
+        }
+    }
+}
+
+/// AsyncClient : Runs the calls of a HandlePool on dedicated threads and returns them as futures.
+///    Every handle has its own bounded queue and workers, so a slow call only holds back its own queue,
+///    and any number of futures can be awaited with pool size x workers_per_handle threads.
+///    When every queue is full, futures wait for a free slot instead of growing the queues.
+///    The futures only rely on std::task and can be awaited from any executor, tokio included.
+///
+///    let client = AsyncClient::new(pool, AsyncConfig::default());
+///    let content = client.blob_get("alias").await?;
+pub struct AsyncClient {
+    shared: Arc<Shared>,
+    workers: Vec<thread::JoinHandle<()>>,
+}
+
+impl AsyncClient {
+    pub fn new(pool: HandlePool, config: AsyncConfig) -> AsyncClient {
+        let queues = (0..pool.size())
+            .map(|_| HandleQueue { jobs: Mutex::new(VecDeque::new()), ready: Condvar::new(), waiting: Mutex::new(VecDeque::new()) })
+            .collect();
+        let shared = Arc::new(Shared {
+            pool,
+            queues,
+            capacity: config.queue_capacity.max(1),
+            next: AtomicUsize::new(0),
+            registrations: AtomicU64::new(0),
+            stopped: AtomicBool::new(false),
+            submitted: AtomicU64::new(0),
+            completed: AtomicU64::new(0),
+            cancelled: AtomicU64::new(0),
+        });
+
+        let mut workers = Vec::new();
+        for q in 0..shared.queues.len() {
+            for w in 0..config.workers_per_handle.max(1) {
+                let shared = Arc::clone(&shared);
+                workers.push(thread::Builder::new()
+                    .name(format!("qdb-async-{}-{}", q, w))
+                    .spawn(move || shared.run(q))
+                    .expect("failed to spawn an async client worker"));
+            }
+        }
+
+        AsyncClient { shared, workers }
+    }
+
+    pub fn stats(&self) -> AsyncStats {
+        AsyncStats {
+            submitted: self.shared.submitted.load(Ordering::Relaxed),
+            completed: self.shared.completed.load(Ordering::Relaxed),
+            cancelled: self.shared.cancelled.load(Ordering::Relaxed),
+            queued: self.shared.queues.iter().map(|q| q.jobs.lock().unwrap().len()).sum(),
+        }
+    }
+
+    /// Run : Runs call with one of the handles of the pool, the building block of the other methods.
+    pub fn run<T, F>(&self, call: F) -> OpFuture<T>
+        where T: Send + 'static, F: FnOnce(&HandleType) -> Result<T, ErrorType> + Send + 'static {
+        let state = Arc::new(OpState { inner: Mutex::new(OpInner { result: None, waker: None, cancelled: false }) });
+
+        let job_state = Arc::clone(&state);
+        let shared = Arc::downgrade(&self.shared);
+        let job: Job = Box::new(move |handle| {
+            let shared = match shared.upgrade() {
+                Some(s) => s,
+                None => return,
+            };
+            if job_state.inner.lock().unwrap().cancelled {
+                shared.cancelled.fetch_add(1, Ordering::Relaxed);
+                return;
+            }
+            let result = match handle {
+                Some(h) => call(h),
+                None => Err(ErrorType::ErrInterrupted),
+            };
+            shared.completed.fetch_add(1, Ordering::Relaxed);
+            job_state.complete(result);
+        });
+
+        OpFuture { shared: Arc::clone(&self.shared), state, stage: Stage::Pending(job, None) }
+    }
+
+    pub fn blob_get(&self, alias: impl Into<String>) -> OpFuture<Vec<u8>> {
+        let alias = alias.into();
+        self.run(move |h| h.blob_get(&alias))
+    }
+
+    pub fn blob_put(&self, alias: impl Into<String>, content: Vec<u8>, expiry: qdb_time_t) -> OpFuture<()> {
+        let alias = alias.into();
+        self.run(move |h| status(h.blob_put(&alias, &content, expiry)))
+    }
+
+    pub fn blob_update(&self, alias: impl Into<String>, content: Vec<u8>, expiry: qdb_time_t) -> OpFuture<()> {
+        let alias = alias.into();
+        self.run(move |h| status(h.blob_update(&alias, &content, expiry)))
+    }
+
+    pub fn remove(&self, alias: impl Into<String>) -> OpFuture<()> {
+        let alias = alias.into();
+        self.run(move |h| status(h.remove(&alias)))
+    }
+
+    pub fn int_get(&self, alias: impl Into<String>) -> OpFuture<qdb_int_t> {
+        let alias = alias.into();
+        self.run(move |h| h.int_get(&alias))
+    }
+
+    pub fn int_put(&self, alias: impl Into<String>, value: qdb_int_t, expiry: qdb_time_t) -> OpFuture<()> {
+        let alias = alias.into();
+        self.run(move |h| status(h.int_put(&alias, value, expiry)))
+    }
+
+    pub fn int_update(&self, alias: impl Into<String>, value: qdb_int_t, expiry: qdb_time_t) -> OpFuture<()> {
+        let alias = alias.into();
+        self.run(move |h| status(h.int_update(&alias, value, expiry)))
+    }
+
+    pub fn int_add(&self, alias: impl Into<String>, addend: qdb_int_t) -> OpFuture<qdb_int_t> {
+        let alias = alias.into();
+        self.run(move |h| h.int_add(&alias, addend))
+    }
+
+    /// TsPushDoubles : Writes one double column of a table, timestamps in nanoseconds since epoch.
+    pub fn ts_push_doubles(&self, table: impl Into<String>, column: impl Into<String>, mode: PushMode,
+                           timestamps: Vec<i64>, values: Vec<f64>) -> OpFuture<()> {
+        let (table, column) = (table.into(), column.into());
+        self.run(move |h| {
+            let batch = TsBatchTable::from_nanos(&table, &timestamps).double_column(&column, &values)?;
+            status(h.ts_batch_push(mode, &[batch]))
+        })
+    }
+
+    /// TsPushInt64s : Writes one int64 column of a table, timestamps in nanoseconds since epoch.
+    pub fn ts_push_int64s(&self, table: impl Into<String>, column: impl Into<String>, mode: PushMode,
+                          timestamps: Vec<i64>, values: Vec<i64>) -> OpFuture<()> {
+        let (table, column) = (table.into(), column.into());
+        self.run(move |h| {
+            let batch = TsBatchTable::from_nanos(&table, &timestamps).int64_column(&column, &values)?;
+            status(h.ts_batch_push(mode, &[batch]))
+        })
+    }
+
+    /// TsDoubleGetRanges : Returns the points of a double column in the given [begin, end) ranges.
+    ///    The points are copied out of the API buffer on the worker.
+    pub fn ts_double_get_ranges(&self, table: impl Into<String>, column: impl Into<String>,
+                                ranges: Vec<(i64, i64)>) -> OpFuture<Vec<qdb_ts_double_point>> {
+        let (table, column) = (table.into(), column.into());
+        self.run(move |h| h.ts_double_get_ranges(&table, &column, &ranges).map(|v| v.to_vec()))
+    }
+
+    pub fn ts_int64_get_ranges(&self, table: impl Into<String>, column: impl Into<String>,
+                               ranges: Vec<(i64, i64)>) -> OpFuture<Vec<qdb_ts_int64_point>> {
+        let (table, column) = (table.into(), column.into());
+        self.run(move |h| h.ts_int64_get_ranges(&table, &column, &ranges).map(|v| v.to_vec()))
+    }
+
+    /// Query : Runs a query and returns its columns, copied out of the API buffer on the worker,
+    ///    which is released before the handle can be closed with the client.
+    pub fn query(&self, query: impl Into<String>) -> OpFuture<Vec<Column>> {
+        let query = query.into();
+        self.run(move |h| h.query(&query).map(|r| r.columns()))
+    }
+}
+
+impl Drop for AsyncClient {
+    fn drop(&mut self) {
+        // queued calls complete with ErrInterrupted, waiting futures are woken to see the client stopped
+        self.shared.stopped.store(true, Ordering::Release);
+        for q in &self.shared.queues {
+            let _guard = q.jobs.lock().unwrap();
+            q.ready.notify_all();
+        }
+        for q in &self.shared.queues {
+            for (_, w) in q.waiting.lock().unwrap().drain(..) {
+                w.wake();
+            }
+        }
+        for w in self.workers.drain(..) {
+            let _ = w.join();
+        }
+    }
+}
+
+fn status(err: Option<ErrorType>) -> Result<(), ErrorType> {
+    match err {
+        None => Ok(()),
+        Some(e) => Err(e),
+    }
+}
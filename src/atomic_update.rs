@@ -0,0 +1,208 @@
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::thread;
+use std::time::Duration;
+
+use crate::batch::Batch;
+use crate::error::ErrorType;
+use crate::handle::HandleType;
+use crate::random::{self, Rng};
+use crate::qdb_time_t;
+
+const VERSION_SIZE: usize = 8;
+
+enum Attempt {
+    Written,
+    // the blob changed since it was read, holds what it is now, None when it was removed
+    Changed(Option<Vec<u8>>),
+}
+
+/// CasConfig : Settings of the read-modify-write loop of atomic updates.
+///    max_attempts : compare and swaps tried before giving up with ErrConflict.
+///    backoff_base / backoff_max : after the n-th conflict, waits a random time in [0, min(backoff_max, backoff_base * 2^n)],
+///        full jitter spreads the writers that collided instead of making them collide again.
+///    version_offset : offset of a u64 LE version in the blobs, bumped by every update.
+///        Only these 8 bytes are compared instead of the whole content, see comparand_offset of blob_cas.
+///        None compares the whole content.
+///    expiry : absolute expiry time of the blobs written, in milliseconds since epoch, 0 for never.
+#[derive(Debug, Clone, Copy)]
+pub struct CasConfig {
+    pub max_attempts: u32,
+    pub backoff_base: Duration,
+    pub backoff_max: Duration,
+    pub version_offset: Option<usize>,
+    pub expiry: qdb_time_t,
+}
+
+impl Default for CasConfig {
+    fn default() -> Self {
+        CasConfig {
+            max_attempts: 16,
+            backoff_base: Duration::from_micros(100),
+            backoff_max: Duration::from_millis(20),
+            version_offset: None,
+            expiry: 0,
+        }
+    }
+}
+
+/// CasStats : Contention counters of an updater since its creation.
+///    updates : updates that wrote their content.
+///    conflicts : compare and swaps that found the blob changed since it was read.
+///    exhausted : updates that gave up after max_attempts.
+///    backoff : total time spent waiting between attempts.
+///    max_attempts : most attempts any single update needed.
+#[derive(Debug, Default, Clone, Copy, PartialEq, Eq)]
+pub struct CasStats {
+    pub updates: u64,
+    pub conflicts: u64,
+    pub exhausted: u64,
+    pub backoff: Duration,
+    pub max_attempts: u64,
+}
+
+/// AtomicUpdater : Optimistic read-modify-write of blobs with compare and swap.
+///    Reads the blob, lets the caller compute its new content and swaps it in if nobody changed the blob meanwhile.
+///    A failed swap carries the current content back, so a retry does not read the blob again.
+///
+///    let updater = AtomicUpdater::new(CasConfig { version_offset: Some(0), ..CasConfig::default() });
+///    updater.update(&handle, "config", |current| Some(edit(current?)))?;
+pub struct AtomicUpdater {
+    config: CasConfig,
+    updates: AtomicU64,
+    conflicts: AtomicU64,
+    exhausted: AtomicU64,
+    backoff_nanos: AtomicU64,
+    max_attempts: AtomicU64,
+}
+
+impl AtomicUpdater {
+    pub fn new(config: CasConfig) -> AtomicUpdater {
+        AtomicUpdater {
+            config,
+            updates: AtomicU64::new(0),
+            conflicts: AtomicU64::new(0),
+            exhausted: AtomicU64::new(0),
+            backoff_nanos: AtomicU64::new(0),
+            max_attempts: AtomicU64::new(0),
+        }
+    }
+
+    /// Update : Replaces the content of the blob at alias with f(current content), and returns the content written.
+    ///    f gets None when the blob does not exist, and the blob is then created.
+    ///    f returning None leaves the blob as it is, its current content is returned, or ErrAliasNotFound.
+    ///    f may be called several times, once per attempt, and must not have side effects.
+    ///    With version_offset set, f sees the whole blob and the version is stamped after it returns;
+    ///    its content must be at least version_offset + 8 bytes long.
+    pub fn update<F>(&self, handle: &HandleType, alias: &str, mut f: F) -> Result<Vec<u8>, ErrorType>
+        where F: FnMut(Option<&[u8]>) -> Option<Vec<u8>> {
+        let mut current = match handle.blob_get(alias) {
+            Ok(content) => Some(content),
+            Err(ErrorType::ErrAliasNotFound) => None,
+            Err(err) => return Err(err),
+        };
+        let mut rng: Option<Rng> = None;
+
+        for attempt in 0..self.config.max_attempts.max(1) {
+            let mut content = match f(current.as_deref()) {
+                Some(content) => content,
+                None => return current.ok_or(ErrorType::ErrAliasNotFound),
+            };
+            if let Some(offset) = self.config.version_offset {
+                let version = current.as_deref().map_or(Ok(0), |c| read_version(c, offset))?;
+                let stamp = content.get_mut(offset..offset + VERSION_SIZE).ok_or(ErrorType::ErrInvalidArgument)?;
+                stamp.copy_from_slice(&version.wrapping_add(1).to_le_bytes());
+            }
+
+            let attempted = match &current {
+                None => self.create(handle, alias, &content)?,
+                Some(previous) => self.swap(handle, alias, &content, previous)?,
+            };
+
+            match attempted {
+                Attempt::Written => {
+                    self.updates.fetch_add(1, Ordering::Relaxed);
+                    self.max_attempts.fetch_max(attempt as u64 + 1, Ordering::Relaxed);
+                    return Ok(content);
+                }
+                Attempt::Changed(found) => {
+                    self.conflicts.fetch_add(1, Ordering::Relaxed);
+                    current = found;
+                    let rng = rng.get_or_insert_with(|| Rng::new(random::seed(0)));
+                    self.backoff(attempt, rng);
+                }
+            }
+        }
+
+        self.exhausted.fetch_add(1, Ordering::Relaxed);
+        self.max_attempts.fetch_max(self.config.max_attempts.max(1) as u64, Ordering::Relaxed);
+        Err(ErrorType::ErrConflict)
+    }
+
+    fn create(&self, handle: &HandleType, alias: &str, content: &[u8]) -> Result<Attempt, ErrorType> {
+        match handle.blob_put(alias, content, self.config.expiry) {
+            None => Ok(Attempt::Written),
+            // created by someone else since it was read
+            Some(ErrorType::ErrAliasAlreadyExists) => match handle.blob_get(alias) {
+                Ok(found) => Ok(Attempt::Changed(Some(found))),
+                Err(ErrorType::ErrAliasNotFound) => Ok(Attempt::Changed(None)),
+                Err(err) => Err(err),
+            },
+            Some(err) => Err(err),
+        }
+    }
+
+    // One compare and swap against what was read, the blob carries back its current content when it changed.
+    fn swap(&self, handle: &HandleType, alias: &str, content: &[u8], previous: &[u8]) -> Result<Attempt, ErrorType> {
+        let offset = match self.config.version_offset {
+            Some(offset) => offset,
+            // the whole content, a comparand shorter than the blob would only compare its beginning
+            None => return match handle.blob_compare_and_swap(alias, content, previous, self.config.expiry) {
+                Ok(None) => Ok(Attempt::Written),
+                Ok(found) => Ok(Attempt::Changed(found)),
+                Err(ErrorType::ErrAliasNotFound) => Ok(Attempt::Changed(None)),
+                Err(err) => Err(err),
+            },
+        };
+        let comparand = previous.get(offset..offset + VERSION_SIZE).ok_or(ErrorType::ErrInvalidArgument)?;
+
+        let mut batch = Batch::with_capacity(1);
+        batch.blob_compare_and_swap(alias, content, comparand, offset, self.config.expiry)?;
+        let results = batch.run(handle);
+        match results.error(0) {
+            None => Ok(Attempt::Written),
+            Some(ErrorType::ErrUnmatchedContent) => Ok(Attempt::Changed(results.unmatched(0).map(|c| c.to_vec()))),
+            Some(ErrorType::ErrAliasNotFound) => Ok(Attempt::Changed(None)),
+            Some(err) => Err(err),
+        }
+    }
+
+    fn backoff(&self, attempt: u32, rng: &mut Rng) {
+        let wait = random::backoff(self.config.backoff_base, self.config.backoff_max, attempt, rng);
+        self.backoff_nanos.fetch_add(wait.as_nanos() as u64, Ordering::Relaxed);
+        thread::sleep(wait);
+    }
+
+    pub fn stats(&self) -> CasStats {
+        CasStats {
+            updates: self.updates.load(Ordering::Relaxed),
+            conflicts: self.conflicts.load(Ordering::Relaxed),
+            exhausted: self.exhausted.load(Ordering::Relaxed),
+            backoff: Duration::from_nanos(self.backoff_nanos.load(Ordering::Relaxed)),
+            max_attempts: self.max_attempts.load(Ordering::Relaxed),
+        }
+    }
+}
+
+fn read_version(content: &[u8], offset: usize) -> Result<u64, ErrorType> {
+    let bytes = content.get(offset..offset + VERSION_SIZE).ok_or(ErrorType::ErrInvalidArgument)?;
+    Ok(u64::from_le_bytes(bytes.try_into().unwrap()))
+}
+
+impl HandleType {
+    /// AtomicUpdate : Replaces the content of the blob at alias with f(current content) using compare and swap,
+    ///    with the default settings, see AtomicUpdater::update.
+    pub fn atomic_update<F>(&self, alias: &str, f: F) -> Result<Vec<u8>, ErrorType>
+        where F: FnMut(Option<&[u8]>) -> Option<Vec<u8>> {
+        AtomicUpdater::new(CasConfig::default()).update(self, alias, f)
+    }
+}
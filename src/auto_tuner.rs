@@ -0,0 +1,229 @@
+use std::sync::{Arc, Mutex};
+use std::thread;
+use std::time::{Duration, Instant};
+
+use crate::error::ErrorType;
+use crate::handle::HandleType;
+use crate::histogram::LatencyHistogram;
+
+/// AutoTunerConfig : Bounds and pace of the auto tuner.
+///    window : number of observed operations between two decisions.
+///    inbuf_errors : number of ErrNetworkInbufTooSmall within a window that grows the incoming buffer.
+///    min_gain : relative throughput change below which a parallelism step is considered noise.
+#[derive(Debug, Clone, Copy)]
+pub struct AutoTunerConfig {
+    pub min_parallelism: usize,
+    pub max_parallelism: usize,
+    pub min_in_buf_size: usize,
+    pub max_in_buf_size: usize,
+    pub window: usize,
+    pub inbuf_errors: usize,
+    pub min_gain: f64,
+}
+
+impl Default for AutoTunerConfig {
+    fn default() -> Self {
+        AutoTunerConfig {
+            min_parallelism: 1,
+            max_parallelism: 64,
+            min_in_buf_size: 16 * 1024 * 1024,
+            max_in_buf_size: 1024 * 1024 * 1024,
+            window: 256,
+            inbuf_errors: 2,
+            min_gain: 0.05,
+        }
+    }
+}
+
+/// AutoTunerState : The current settings and what the tuner has seen so far.
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct AutoTunerState {
+    pub parallelism: usize,
+    pub in_buf_size: usize,
+    pub last_throughput: f64,
+    pub best_throughput: f64,
+    pub last_p99: u64,
+    pub decisions: u64,
+}
+
+struct Window {
+    operations: usize,
+    bytes: u64,
+    inbuf_errors: usize,
+    latencies: LatencyHistogram,
+    // time at least one operation was running, idle time between operations left out
+    busy: Duration,
+    busy_until: Option<Instant>,
+}
+
+impl Window {
+    fn new() -> Window {
+        Window { operations: 0, bytes: 0, inbuf_errors: 0, latencies: LatencyHistogram::new(), busy: Duration::ZERO, busy_until: None }
+    }
+
+    // Adds the part of [ended - latency, ended] not already counted, operations come in the order they end.
+    fn add_busy(&mut self, ended: Instant, latency: Duration) {
+        let started = ended.checked_sub(latency).unwrap_or(ended);
+        match self.busy_until {
+            Some(until) if until >= ended => return,
+            Some(until) if until > started => self.busy += ended - until,
+            _ => self.busy += ended - started,
+        }
+        self.busy_until = Some(ended);
+    }
+}
+
+struct Tuner {
+    state: AutoTunerState,
+    // +1 while adding threads improves throughput, -1 while removing them does
+    direction: i64,
+    window: Window,
+}
+
+/// AutoTuner : Adjusts the client max parallelism and max incoming buffer size of a handle from what it observes.
+///    Parallelism is hill climbed on throughput, the work done over the time operations were running,
+///    so that a caller pausing between operations does not look like a slowdown: it keeps moving in the same direction while throughput
+///    improves by more than min_gain and turns around when it degrades, backing off when p99 latency
+///    doubles without a throughput gain.
+///    The incoming buffer doubles after repeated ErrNetworkInbufTooSmall and is never shrunk below what was needed.
+pub struct AutoTuner {
+    handle: Arc<HandleType>,
+    config: AutoTunerConfig,
+    tuner: Mutex<Tuner>,
+}
+
+impl AutoTuner {
+    /// New : Starts from the current settings of the handle, clamped to the bounds of the config.
+    ///    A parallelism of 0, all the cores for the API, starts from the number of cores.
+    pub fn new(handle: Arc<HandleType>, config: AutoTunerConfig) -> Result<AutoTuner, ErrorType> {
+        let parallelism = match handle.get_client_max_parallelism()? {
+            0 => thread::available_parallelism().map_or(1, |n| n.get()),
+            n => n,
+        };
+        let parallelism = parallelism.clamp(config.min_parallelism.max(1), config.max_parallelism.max(1));
+        let in_buf_size = handle.get_client_max_int_buffer_size()?
+            .clamp(config.min_in_buf_size, config.max_in_buf_size.max(config.min_in_buf_size));
+
+        if let Some(e) = handle.set_client_max_parallelism(parallelism) {
+            return Err(e);
+        }
+        if let Some(e) = handle.set_client_max_int_buffer_size(in_buf_size) {
+            return Err(e);
+        }
+
+        let state = AutoTunerState { parallelism, in_buf_size, last_throughput: 0.0, best_throughput: 0.0, last_p99: 0, decisions: 0 };
+
+        Ok(AutoTuner { handle, config, tuner: Mutex::new(Tuner { state, direction: 1, window: Window::new() }) })
+    }
+
+    /// Run : Times the operation, feeds the outcome to the tuner and retries once
+    ///    when the incoming buffer was too small and could be grown.
+    pub fn run<T, F>(&self, bytes: u64, mut operation: F) -> Result<T, ErrorType>
+        where F: FnMut(&HandleType) -> Result<T, ErrorType>
+    {
+        let started = Instant::now();
+        let result = operation(&self.handle);
+        let grown = self.observe(started.elapsed(), bytes, result.as_ref().err().copied());
+
+        match result {
+            Err(ErrorType::ErrNetworkInbufTooSmall) if grown => {
+                let started = Instant::now();
+                let result = operation(&self.handle);
+                self.observe(started.elapsed(), bytes, result.as_ref().err().copied());
+                result
+            }
+            result => result,
+        }
+    }
+
+    /// Observe : Records one operation timed by the caller, which has just ended.
+    ///    bytes may be zero, throughput is then measured in operations.
+    ///    Returns true if the incoming buffer was grown by this observation.
+    pub fn observe(&self, latency: Duration, bytes: u64, error: Option<ErrorType>) -> bool {
+        self.observe_at(Instant::now(), latency, bytes, error)
+    }
+
+    /// ObserveAt : Same as Observe for an operation that ended at ended.
+    ///    Operations are expected in the order they ended, one ending before the previous one
+    ///    only adds the time it ran after it.
+    pub fn observe_at(&self, ended: Instant, latency: Duration, bytes: u64, error: Option<ErrorType>) -> bool {
+        let mut tuner = self.tuner.lock().unwrap();
+
+        tuner.window.add_busy(ended, latency);
+        tuner.window.operations += 1;
+        tuner.window.bytes += bytes;
+        tuner.window.latencies.record(latency.as_nanos() as u64);
+
+        let mut grown = false;
+        if error == Some(ErrorType::ErrNetworkInbufTooSmall) {
+            tuner.window.inbuf_errors += 1;
+            if tuner.window.inbuf_errors >= self.config.inbuf_errors.max(1) {
+                grown = self.grow_in_buf(&mut tuner);
+                tuner.window.inbuf_errors = 0;
+            }
+        }
+
+        if tuner.window.operations >= self.config.window.max(1) {
+            self.decide(&mut tuner);
+            tuner.window = Window::new();
+        }
+
+        grown
+    }
+
+    /// State : Returns the current settings of the tuner.
+    pub fn state(&self) -> AutoTunerState {
+        self.tuner.lock().unwrap().state
+    }
+
+    fn grow_in_buf(&self, tuner: &mut Tuner) -> bool {
+        let size = tuner.state.in_buf_size.saturating_mul(2).min(self.config.max_in_buf_size);
+        if size <= tuner.state.in_buf_size {
+            return false;
+        }
+
+        if self.handle.set_client_max_int_buffer_size(size).is_some() {
+            return false;
+        }
+        tuner.state.in_buf_size = size;
+        true
+    }
+
+    fn decide(&self, tuner: &mut Tuner) {
+        let busy = tuner.window.busy.as_secs_f64().max(1e-9);
+        let work = if tuner.window.bytes > 0 { tuner.window.bytes as f64 } else { tuner.window.operations as f64 };
+        let throughput = work / busy;
+        let p99 = tuner.window.latencies.percentile(99.0);
+
+        let previous = tuner.state.last_throughput;
+        let previous_p99 = tuner.state.last_p99;
+
+        let mut direction = tuner.direction;
+        if previous > 0.0 {
+            let gain = (throughput - previous) / previous;
+            if gain < -self.config.min_gain {
+                // the last step hurt, go back the other way
+                direction = -direction;
+            } else if gain < self.config.min_gain {
+                // flat throughput, only worth it if latency did not blow up
+                direction = if previous_p99 > 0 && p99 > previous_p99 * 2 { -1 } else { 0 };
+            }
+        }
+
+        let current = tuner.state.parallelism as i64;
+        let step = (current / 4).max(1);
+        let next = (current + direction * step)
+            .clamp(self.config.min_parallelism.max(1) as i64, self.config.max_parallelism.max(1) as i64) as usize;
+
+        if next != tuner.state.parallelism && self.handle.set_client_max_parallelism(next).is_none() {
+            tuner.state.parallelism = next;
+        }
+
+        // resume probing upwards after settling
+        tuner.direction = if direction == 0 { 1 } else { direction };
+        tuner.state.last_throughput = throughput;
+        tuner.state.best_throughput = tuner.state.best_throughput.max(throughput);
+        tuner.state.last_p99 = p99;
+        tuner.state.decisions += 1;
+    }
+}
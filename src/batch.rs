@@ -0,0 +1,312 @@
+use std::marker::PhantomData;
+use std::mem::MaybeUninit;
+use std::os::raw;
+
+use crate::error::{ErrorType, makeErrorNone};
+use crate::ffi_str::CStrArena;
+use crate::handle::HandleType;
+use crate::query::timespec_to_nanos;
+use crate::{qdb_entry_type_t, qdb_entry_type_t_qdb_entry_blob, qdb_entry_type_t_qdb_entry_double, qdb_entry_type_t_qdb_entry_integer,
+            qdb_entry_type_t_qdb_entry_timestamp,
+            qdb_error_t_qdb_e_unmatched_content, qdb_init_operations, qdb_int_t, qdb_operation_t, qdb_operation_type_t,
+            qdb_operation_type_t_qdb_op_blob_cas, qdb_operation_type_t_qdb_op_blob_get,
+            qdb_operation_type_t_qdb_op_blob_put, qdb_operation_type_t_qdb_op_blob_update,
+            qdb_operation_type_t_qdb_op_double_add, qdb_operation_type_t_qdb_op_double_get,
+            qdb_operation_type_t_qdb_op_double_put, qdb_operation_type_t_qdb_op_double_update,
+            qdb_operation_type_t_qdb_op_int_add, qdb_operation_type_t_qdb_op_int_get,
+            qdb_operation_type_t_qdb_op_int_put, qdb_operation_type_t_qdb_op_int_update,
+            qdb_operation_type_t_qdb_op_value_get, qdb_release, qdb_run_batch, qdb_time_t};
+
+/// Batch : Operations on many entries sent to the cluster in a single call of qdb_run_batch.
+///    The cluster runs them in parallel and in no particular order, each operation succeeds or fails on its own.
+///    Aliases are copied into the batch, contents are borrowed until the batch is dropped.
+///
+///    let mut batch = Batch::new();
+///    let a = batch.blob_get("a")?;
+///    let b = batch.int_add("b", 1)?;
+///    let results = batch.run(&handle);
+///    let content = results.blob(a)?;
+pub struct Batch<'a> {
+    aliases: CStrArena,
+    operations: Vec<qdb_operation_t>,
+    _contents: PhantomData<&'a [u8]>,
+}
+
+impl<'a> Default for Batch<'a> {
+    fn default() -> Self {
+        Batch::new()
+    }
+}
+
+impl<'a> Batch<'a> {
+    pub fn new() -> Batch<'a> {
+        Batch::with_capacity(0)
+    }
+
+    pub fn with_capacity(count: usize) -> Batch<'a> {
+        Batch { aliases: CStrArena::with_capacity(count, count * 32), operations: Vec::with_capacity(count), _contents: PhantomData }
+    }
+
+    pub fn len(&self) -> usize {
+        self.operations.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.operations.is_empty()
+    }
+
+    /// Clear : Removes every operation but keeps the buffers for reuse.
+    pub fn clear(&mut self) {
+        self.aliases.clear();
+        self.operations.clear();
+    }
+
+    // Adds an initialized operation of the given type and returns its index, set lets the caller fill its parameters.
+    fn push(&mut self, alias: &str, op_type: qdb_operation_type_t, set: impl FnOnce(&mut qdb_operation_t)) -> Result<usize, ErrorType> {
+        self.aliases.push(alias)?;
+
+        let mut op = MaybeUninit::<qdb_operation_t>::zeroed();
+        let mut op = unsafe {
+            qdb_init_operations(op.as_mut_ptr(), 1);
+            op.assume_init()
+        };
+        op.type_ = op_type;
+        set(&mut op);
+        self.operations.push(op);
+        Ok(self.operations.len() - 1)
+    }
+
+    pub fn blob_get(&mut self, alias: &str) -> Result<usize, ErrorType> {
+        self.blob_get_at(alias, 0)
+    }
+
+    /// BlobGetAt : Gets the content of a blob from offset on.
+    pub fn blob_get_at(&mut self, alias: &str, offset: usize) -> Result<usize, ErrorType> {
+        self.push(alias, qdb_operation_type_t_qdb_op_blob_get, |op| op.__bindgen_anon_1.blob_get.content_offset = offset)
+    }
+
+    pub fn blob_put(&mut self, alias: &str, content: &'a [u8], expiry: qdb_time_t) -> Result<usize, ErrorType> {
+        self.push(alias, qdb_operation_type_t_qdb_op_blob_put, |op| unsafe {
+            let p = &mut op.__bindgen_anon_1.blob_put;
+            p.content = content.as_ptr() as *const raw::c_void;
+            p.content_size = content.len();
+            p.expiry_time = expiry;
+        })
+    }
+
+    pub fn blob_update(&mut self, alias: &str, content: &'a [u8], expiry: qdb_time_t) -> Result<usize, ErrorType> {
+        self.push(alias, qdb_operation_type_t_qdb_op_blob_update, |op| unsafe {
+            let p = &mut op.__bindgen_anon_1.blob_update;
+            p.content = content.as_ptr() as *const raw::c_void;
+            p.content_size = content.len();
+            p.expiry_time = expiry;
+        })
+    }
+
+    /// BlobCompareAndSwap : Replaces the content of a blob with content if comparand equals its content at comparand_offset.
+    ///    A comparand shorter than the blob compares only part of it, a version stored in the blob for instance.
+    pub fn blob_compare_and_swap(&mut self, alias: &str, content: &'a [u8], comparand: &'a [u8], comparand_offset: usize,
+                                 expiry: qdb_time_t) -> Result<usize, ErrorType> {
+        self.push(alias, qdb_operation_type_t_qdb_op_blob_cas, |op| unsafe {
+            let p = &mut op.__bindgen_anon_1.blob_cas;
+            p.new_content = content.as_ptr() as *const raw::c_void;
+            p.new_content_size = content.len();
+            p.comparand = comparand.as_ptr() as *const raw::c_void;
+            p.comparand_size = comparand.len();
+            p.comparand_offset = comparand_offset;
+            p.expiry_time = expiry;
+        })
+    }
+
+    pub fn int_get(&mut self, alias: &str) -> Result<usize, ErrorType> {
+        self.push(alias, qdb_operation_type_t_qdb_op_int_get, |_| {})
+    }
+
+    pub fn int_put(&mut self, alias: &str, value: qdb_int_t, expiry: qdb_time_t) -> Result<usize, ErrorType> {
+        self.push(alias, qdb_operation_type_t_qdb_op_int_put, |op| {
+            op.__bindgen_anon_1.int_put.value = value;
+            op.__bindgen_anon_1.int_put.expiry_time = expiry;
+        })
+    }
+
+    pub fn int_update(&mut self, alias: &str, value: qdb_int_t, expiry: qdb_time_t) -> Result<usize, ErrorType> {
+        self.push(alias, qdb_operation_type_t_qdb_op_int_update, |op| {
+            op.__bindgen_anon_1.int_update.value = value;
+            op.__bindgen_anon_1.int_update.expiry_time = expiry;
+        })
+    }
+
+    pub fn int_add(&mut self, alias: &str, addend: qdb_int_t) -> Result<usize, ErrorType> {
+        self.push(alias, qdb_operation_type_t_qdb_op_int_add, |op| op.__bindgen_anon_1.int_add.addend = addend)
+    }
+
+    pub fn double_get(&mut self, alias: &str) -> Result<usize, ErrorType> {
+        self.push(alias, qdb_operation_type_t_qdb_op_double_get, |_| {})
+    }
+
+    pub fn double_put(&mut self, alias: &str, value: f64, expiry: qdb_time_t) -> Result<usize, ErrorType> {
+        self.push(alias, qdb_operation_type_t_qdb_op_double_put, |op| {
+            op.__bindgen_anon_1.double_put.value = value;
+            op.__bindgen_anon_1.double_put.expiry_time = expiry;
+        })
+    }
+
+    pub fn double_update(&mut self, alias: &str, value: f64, expiry: qdb_time_t) -> Result<usize, ErrorType> {
+        self.push(alias, qdb_operation_type_t_qdb_op_double_update, |op| {
+            op.__bindgen_anon_1.double_update.value = value;
+            op.__bindgen_anon_1.double_update.expiry_time = expiry;
+        })
+    }
+
+    pub fn double_add(&mut self, alias: &str, addend: f64) -> Result<usize, ErrorType> {
+        self.push(alias, qdb_operation_type_t_qdb_op_double_add, |op| op.__bindgen_anon_1.double_add.addend = addend)
+    }
+
+    /// ValueGet : Gets the type of an entry together with its value, whatever its type.
+    pub fn value_get(&mut self, alias: &str) -> Result<usize, ErrorType> {
+        self.push(alias, qdb_operation_type_t_qdb_op_value_get, |_| {})
+    }
+
+    /// Run : Sends every operation to the cluster and returns their results.
+    ///    The buffers allocated by the API for the results are released when the results are dropped.
+    ///    Waits first while a memory governor on the handle holds its gate closed.
+    pub fn run<'b>(&'b mut self, handle: &'b HandleType) -> BatchResults<'b> {
+        // the arena does not move while the batch is borrowed
+        for (i, op) in self.operations.iter_mut().enumerate() {
+            op.alias = self.aliases.ptr(i);
+        }
+
+        let succeeded = if self.operations.is_empty() {
+            0
+        } else {
+            handle.admit_memory();
+            unsafe { qdb_run_batch(handle.handle, self.operations.as_mut_ptr(), self.operations.len()) }
+        };
+        BatchResults { handle, operations: &mut self.operations, succeeded }
+    }
+}
+
+/// EntryValue : The value of an entry read by value_get.
+///    Timestamp is in nanoseconds since epoch.
+///    Other carries the type of entries whose value value_get does not return.
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub enum EntryValue<'r> {
+    Blob(&'r [u8]),
+    Integer(qdb_int_t),
+    Double(f64),
+    Timestamp(i64),
+    Other(qdb_entry_type_t),
+}
+
+/// BatchResults : The outcome of every operation of a batch, by the index returned when it was added.
+pub struct BatchResults<'b> {
+    handle: &'b HandleType,
+    operations: &'b mut [qdb_operation_t],
+    succeeded: usize,
+}
+
+impl BatchResults<'_> {
+    pub fn len(&self) -> usize {
+        self.operations.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.operations.is_empty()
+    }
+
+    /// Succeeded : Returns the number of operations that succeeded.
+    pub fn succeeded(&self) -> usize {
+        self.succeeded
+    }
+
+    /// Error : Returns the error of operation i, None if it succeeded.
+    pub fn error(&self, i: usize) -> Option<ErrorType> {
+        makeErrorNone(self.operations[i].error)
+    }
+
+    /// Blob : Returns the content read by the blob_get operation i, in place in the API buffer.
+    pub fn blob(&self, i: usize) -> Result<&[u8], ErrorType> {
+        let op = &self.operations[i];
+        if op.type_ != qdb_operation_type_t_qdb_op_blob_get {
+            return Err(ErrorType::ErrInvalidArgument);
+        }
+        if let Some(err) = makeErrorNone(op.error) {
+            return Err(err);
+        }
+        let get = unsafe { op.__bindgen_anon_1.blob_get };
+        if get.content.is_null() {
+            return Ok(&[]);
+        }
+        Ok(unsafe { std::slice::from_raw_parts(get.content as *const u8, get.content_size) })
+    }
+
+    /// Unmatched : Returns the current content of the blob when the comparand of the blob_cas operation i did not match.
+    pub fn unmatched(&self, i: usize) -> Option<&[u8]> {
+        let op = &self.operations[i];
+        if op.type_ != qdb_operation_type_t_qdb_op_blob_cas || op.error != qdb_error_t_qdb_e_unmatched_content {
+            return None;
+        }
+        let cas = unsafe { op.__bindgen_anon_1.blob_cas };
+        if cas.original_content.is_null() {
+            return Some(&[]);
+        }
+        Some(unsafe { std::slice::from_raw_parts(cas.original_content as *const u8, cas.original_content_size) })
+    }
+
+    /// Value : Returns the value read by the value_get operation i.
+    pub fn value(&self, i: usize) -> Result<EntryValue<'_>, ErrorType> {
+        let op = &self.operations[i];
+        if op.type_ != qdb_operation_type_t_qdb_op_value_get {
+            return Err(ErrorType::ErrInvalidArgument);
+        }
+        if let Some(err) = makeErrorNone(op.error) {
+            return Err(err);
+        }
+        let get = unsafe { op.__bindgen_anon_1.value_get };
+        Ok(match get.type_ {
+            t if t == qdb_entry_type_t_qdb_entry_blob && get.blob_content.is_null() => EntryValue::Blob(&[]),
+            t if t == qdb_entry_type_t_qdb_entry_blob => EntryValue::Blob(unsafe {
+                std::slice::from_raw_parts(get.blob_content as *const u8, get.blob_content_size)
+            }),
+            t if t == qdb_entry_type_t_qdb_entry_integer => EntryValue::Integer(get.int_result),
+            t if t == qdb_entry_type_t_qdb_entry_double => EntryValue::Double(get.double_result),
+            t if t == qdb_entry_type_t_qdb_entry_timestamp => EntryValue::Timestamp(timespec_to_nanos(&get.timestamp_result)),
+            t => EntryValue::Other(t),
+        })
+    }
+
+    /// Int : Returns the value read by the int_get operation i, or the new value of the int_add operation i.
+    pub fn int(&self, i: usize) -> Result<qdb_int_t, ErrorType> {
+        let op = &self.operations[i];
+        if let Some(err) = makeErrorNone(op.error) {
+            return Err(err);
+        }
+        match op.type_ {
+            t if t == qdb_operation_type_t_qdb_op_int_get => Ok(unsafe { op.__bindgen_anon_1.int_get.result }),
+            t if t == qdb_operation_type_t_qdb_op_int_add => Ok(unsafe { op.__bindgen_anon_1.int_add.result }),
+            _ => Err(ErrorType::ErrInvalidArgument),
+        }
+    }
+
+    /// Double : Returns the value read by the double_get operation i, or the new value of the double_add operation i.
+    pub fn double(&self, i: usize) -> Result<f64, ErrorType> {
+        let op = &self.operations[i];
+        if let Some(err) = makeErrorNone(op.error) {
+            return Err(err);
+        }
+        match op.type_ {
+            t if t == qdb_operation_type_t_qdb_op_double_get => Ok(unsafe { op.__bindgen_anon_1.double_get.result }),
+            t if t == qdb_operation_type_t_qdb_op_double_add => Ok(unsafe { op.__bindgen_anon_1.double_add.result }),
+            _ => Err(ErrorType::ErrInvalidArgument),
+        }
+    }
+}
+
+impl Drop for BatchResults<'_> {
+    fn drop(&mut self) {
+        // releases every buffer allocated for the results of the batch
+        if !self.operations.is_empty() {
+            unsafe { qdb_release(self.handle.handle, self.operations.as_ptr() as *const raw::c_void) };
+        }
+    }
+}
@@ -0,0 +1,369 @@
+use std::fmt;
+
+// A container holds the ids sharing their high 16 bits; a sorted array while sparse, 8 KiB of bits once denser.
+const ARRAY_MAX: usize = 4096;
+const WORDS: usize = 1024;
+
+#[derive(Clone, PartialEq, Eq)]
+enum Container {
+    Array(Vec<u16>),
+    Bits(Box<[u64; WORDS]>, u32),
+}
+
+impl Container {
+    fn len(&self) -> usize {
+        match self {
+            Container::Array(values) => values.len(),
+            Container::Bits(_, len) => *len as usize,
+        }
+    }
+
+    fn contains(&self, low: u16) -> bool {
+        match self {
+            Container::Array(values) => values.binary_search(&low).is_ok(),
+            Container::Bits(words, _) => words[low as usize / 64] & (1 << (low % 64)) != 0,
+        }
+    }
+
+    fn insert(&mut self, low: u16) -> bool {
+        match self {
+            Container::Array(values) => {
+                let at = match values.binary_search(&low) {
+                    Ok(_) => return false,
+                    Err(at) => at,
+                };
+                values.insert(at, low);
+                if values.len() > ARRAY_MAX {
+                    *self = Container::bits_of(values);
+                }
+                true
+            }
+            Container::Bits(words, len) => {
+                let (word, bit) = (&mut words[low as usize / 64], 1u64 << (low % 64));
+                if *word & bit != 0 {
+                    return false;
+                }
+                *word |= bit;
+                *len += 1;
+                true
+            }
+        }
+    }
+
+    fn remove(&mut self, low: u16) -> bool {
+        match self {
+            Container::Array(values) => match values.binary_search(&low) {
+                Ok(at) => {
+                    values.remove(at);
+                    true
+                }
+                Err(_) => false,
+            },
+            Container::Bits(words, len) => {
+                let (word, bit) = (&mut words[low as usize / 64], 1u64 << (low % 64));
+                if *word & bit == 0 {
+                    return false;
+                }
+                *word &= !bit;
+                *len -= 1;
+                if *len as usize <= ARRAY_MAX {
+                    *self = Container::Array(Container::values_of(words));
+                }
+                true
+            }
+        }
+    }
+
+    fn bits_of(values: &[u16]) -> Container {
+        let mut words = Box::new([0u64; WORDS]);
+        for &v in values {
+            words[v as usize / 64] |= 1 << (v % 64);
+        }
+        Container::Bits(words, values.len() as u32)
+    }
+
+    fn values_of(words: &[u64; WORDS]) -> Vec<u16> {
+        let mut values = Vec::new();
+        for (i, &word) in words.iter().enumerate() {
+            let mut word = word;
+            while word != 0 {
+                values.push((i * 64) as u16 + word.trailing_zeros() as u16);
+                word &= word - 1;
+            }
+        }
+        values
+    }
+
+    // The container of words, None when empty, an array when sparse enough.
+    fn from_words(words: Box<[u64; WORDS]>) -> Option<Container> {
+        let len: u32 = words.iter().map(|w| w.count_ones()).sum();
+        match len as usize {
+            0 => None,
+            n if n <= ARRAY_MAX => Some(Container::Array(Container::values_of(&words))),
+            _ => Some(Container::Bits(words, len)),
+        }
+    }
+
+    fn from_values(values: Vec<u16>) -> Option<Container> {
+        match values.len() {
+            0 => None,
+            n if n <= ARRAY_MAX => Some(Container::Array(values)),
+            _ => Some(Container::bits_of(&values)),
+        }
+    }
+
+    fn and(&self, other: &Container) -> Option<Container> {
+        match (self, other) {
+            (Container::Array(a), Container::Array(b)) => {
+                let (mut i, mut j, mut values) = (0, 0, Vec::with_capacity(a.len().min(b.len())));
+                while i < a.len() && j < b.len() {
+                    match a[i].cmp(&b[j]) {
+                        std::cmp::Ordering::Less => i += 1,
+                        std::cmp::Ordering::Greater => j += 1,
+                        std::cmp::Ordering::Equal => {
+                            values.push(a[i]);
+                            i += 1;
+                            j += 1;
+                        }
+                    }
+                }
+                Container::from_values(values)
+            }
+            (Container::Array(a), bits @ Container::Bits(..)) | (bits @ Container::Bits(..), Container::Array(a)) => {
+                Container::from_values(a.iter().copied().filter(|&v| bits.contains(v)).collect())
+            }
+            (Container::Bits(a, _), Container::Bits(b, _)) => {
+                let mut words = a.clone();
+                words.iter_mut().zip(b.iter()).for_each(|(w, b)| *w &= b);
+                Container::from_words(words)
+            }
+        }
+    }
+
+    fn or(&self, other: &Container) -> Container {
+        match (self, other) {
+            (Container::Array(a), Container::Array(b)) => {
+                let (mut i, mut j, mut values) = (0, 0, Vec::with_capacity(a.len() + b.len()));
+                while i < a.len() || j < b.len() {
+                    if j == b.len() || (i < a.len() && a[i] < b[j]) {
+                        values.push(a[i]);
+                        i += 1;
+                    } else {
+                        if i < a.len() && a[i] == b[j] {
+                            i += 1;
+                        }
+                        values.push(b[j]);
+                        j += 1;
+                    }
+                }
+                Container::from_values(values).expect("union of non empty containers")
+            }
+            (Container::Array(a), Container::Bits(words, _)) | (Container::Bits(words, _), Container::Array(a)) => {
+                let mut words = words.clone();
+                for &v in a {
+                    words[v as usize / 64] |= 1 << (v % 64);
+                }
+                Container::from_words(words).expect("union of non empty containers")
+            }
+            (Container::Bits(a, _), Container::Bits(b, _)) => {
+                let mut words = a.clone();
+                words.iter_mut().zip(b.iter()).for_each(|(w, b)| *w |= b);
+                Container::from_words(words).expect("union of non empty containers")
+            }
+        }
+    }
+
+    fn and_not(&self, other: &Container) -> Option<Container> {
+        match (self, other) {
+            (Container::Array(a), _) => Container::from_values(a.iter().copied().filter(|&v| !other.contains(v)).collect()),
+            (Container::Bits(words, _), Container::Array(b)) => {
+                let mut words = words.clone();
+                for &v in b {
+                    words[v as usize / 64] &= !(1 << (v % 64));
+                }
+                Container::from_words(words)
+            }
+            (Container::Bits(a, _), Container::Bits(b, _)) => {
+                let mut words = a.clone();
+                words.iter_mut().zip(b.iter()).for_each(|(w, b)| *w &= !b);
+                Container::from_words(words)
+            }
+        }
+    }
+
+    fn bytes(&self) -> usize {
+        match self {
+            Container::Array(values) => values.capacity() * 2,
+            Container::Bits(..) => WORDS * 8,
+        }
+    }
+
+    fn for_each(&self, high: u32, f: &mut impl FnMut(u32)) {
+        match self {
+            Container::Array(values) => values.iter().for_each(|&v| f(high | v as u32)),
+            Container::Bits(words, _) => {
+                for (i, &word) in words.iter().enumerate() {
+                    let mut word = word;
+                    while word != 0 {
+                        f(high | (i * 64) as u32 | word.trailing_zeros());
+                        word &= word - 1;
+                    }
+                }
+            }
+        }
+    }
+}
+
+/// Bitmap : A compressed set of u32 ids, split in chunks of 65536 ids stored as sorted arrays while sparse
+///    and as plain bits once dense, in the manner of Roaring bitmaps.
+///    Set operations work chunk by chunk and skip the chunks only one side has.
+#[derive(Clone, Default, PartialEq, Eq)]
+pub struct Bitmap {
+    keys: Vec<u16>,
+    containers: Vec<Container>,
+}
+
+impl Bitmap {
+    pub fn new() -> Bitmap {
+        Bitmap::default()
+    }
+
+    /// Len : Returns the number of ids in the set, the sum of the cardinality each chunk keeps.
+    pub fn len(&self) -> u64 {
+        self.containers.iter().map(|c| c.len() as u64).sum()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.containers.is_empty()
+    }
+
+    pub fn contains(&self, id: u32) -> bool {
+        match self.keys.binary_search(&((id >> 16) as u16)) {
+            Ok(at) => self.containers[at].contains(id as u16),
+            Err(_) => false,
+        }
+    }
+
+    /// Insert : Adds id to the set, returns whether it was not already there.
+    ///    Ids inserted in increasing order only ever append.
+    pub fn insert(&mut self, id: u32) -> bool {
+        let high = (id >> 16) as u16;
+        match self.keys.binary_search(&high) {
+            Ok(at) => self.containers[at].insert(id as u16),
+            Err(at) => {
+                self.keys.insert(at, high);
+                self.containers.insert(at, Container::Array(vec![id as u16]));
+                true
+            }
+        }
+    }
+
+    /// Remove : Removes id from the set, returns whether it was there.
+    pub fn remove(&mut self, id: u32) -> bool {
+        let at = match self.keys.binary_search(&((id >> 16) as u16)) {
+            Ok(at) => at,
+            Err(_) => return false,
+        };
+        let removed = self.containers[at].remove(id as u16);
+        if self.containers[at].len() == 0 {
+            self.keys.remove(at);
+            self.containers.remove(at);
+        }
+        removed
+    }
+
+    /// And : Returns the ids in both sets.
+    pub fn and(&self, other: &Bitmap) -> Bitmap {
+        let mut result = Bitmap::new();
+        let (mut i, mut j) = (0, 0);
+        while i < self.keys.len() && j < other.keys.len() {
+            match self.keys[i].cmp(&other.keys[j]) {
+                std::cmp::Ordering::Less => i += 1,
+                std::cmp::Ordering::Greater => j += 1,
+                std::cmp::Ordering::Equal => {
+                    if let Some(c) = self.containers[i].and(&other.containers[j]) {
+                        result.keys.push(self.keys[i]);
+                        result.containers.push(c);
+                    }
+                    i += 1;
+                    j += 1;
+                }
+            }
+        }
+        result
+    }
+
+    /// Or : Returns the ids in either set.
+    pub fn or(&self, other: &Bitmap) -> Bitmap {
+        let mut result = Bitmap::new();
+        let (mut i, mut j) = (0, 0);
+        while i < self.keys.len() || j < other.keys.len() {
+            if j == other.keys.len() || (i < self.keys.len() && self.keys[i] < other.keys[j]) {
+                result.keys.push(self.keys[i]);
+                result.containers.push(self.containers[i].clone());
+                i += 1;
+            } else if i == self.keys.len() || other.keys[j] < self.keys[i] {
+                result.keys.push(other.keys[j]);
+                result.containers.push(other.containers[j].clone());
+                j += 1;
+            } else {
+                result.keys.push(self.keys[i]);
+                result.containers.push(self.containers[i].or(&other.containers[j]));
+                i += 1;
+                j += 1;
+            }
+        }
+        result
+    }
+
+    /// AndNot : Returns the ids in this set and not in other.
+    pub fn and_not(&self, other: &Bitmap) -> Bitmap {
+        let mut result = Bitmap::new();
+        let mut j = 0;
+        for (i, &key) in self.keys.iter().enumerate() {
+            while j < other.keys.len() && other.keys[j] < key {
+                j += 1;
+            }
+            let container = if j < other.keys.len() && other.keys[j] == key {
+                self.containers[i].and_not(&other.containers[j])
+            } else {
+                Some(self.containers[i].clone())
+            };
+            if let Some(c) = container {
+                result.keys.push(key);
+                result.containers.push(c);
+            }
+        }
+        result
+    }
+
+    /// Bytes : Returns the memory held by the ids, without the few bytes of the bitmap itself.
+    pub fn bytes(&self) -> usize {
+        self.keys.capacity() * 2 + self.containers.iter().map(|c| c.bytes()).sum::<usize>()
+    }
+
+    /// Iter : Returns the ids in increasing order.
+    pub fn iter(&self) -> impl Iterator<Item=u32> + '_ {
+        self.keys.iter().zip(self.containers.iter()).flat_map(|(&key, container)| {
+            let mut ids = Vec::with_capacity(container.len());
+            container.for_each((key as u32) << 16, &mut |id| ids.push(id));
+            ids
+        })
+    }
+}
+
+impl FromIterator<u32> for Bitmap {
+    fn from_iter<I: IntoIterator<Item=u32>>(ids: I) -> Bitmap {
+        let mut bitmap = Bitmap::new();
+        for id in ids {
+            bitmap.insert(id);
+        }
+        bitmap
+    }
+}
+
+impl fmt::Debug for Bitmap {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        f.debug_set().entries(self.iter()).finish()
+    }
+}
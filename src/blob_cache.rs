@@ -0,0 +1,427 @@
+use std::collections::hash_map::DefaultHasher;
+use std::collections::{BTreeMap, HashMap};
+use std::hash::{Hash, Hasher};
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::{Arc, Mutex};
+use std::time::{Duration, Instant, SystemTime, UNIX_EPOCH};
+
+use crate::error::ErrorType;
+use crate::handle::HandleType;
+use crate::qdb_time_t;
+
+/// BlobCacheConfig : Settings of a blob cache.
+///    shards : number of independently locked parts of the cache, aliases are spread over them by hash.
+///    max_bytes : upper bound of the cached content, split evenly between the shards.
+///    ttl : how long a blob is served from the cache before the cluster is asked again.
+///    track_expiry : reads the expiry time of every blob fetched, expired blobs are never served.
+///    revalidate : once ttl has elapsed, compares the modification time of the blob on the cluster
+///        with the cached one and keeps the cached content when it did not change,
+///        a metadata call instead of transferring the content again.
+#[derive(Debug, Clone, Copy)]
+pub struct BlobCacheConfig {
+    pub shards: usize,
+    pub max_bytes: usize,
+    pub ttl: Duration,
+    pub track_expiry: bool,
+    pub revalidate: bool,
+}
+
+impl Default for BlobCacheConfig {
+    fn default() -> Self {
+        BlobCacheConfig {
+            shards: 16,
+            max_bytes: 64 * 1024 * 1024,
+            ttl: Duration::from_secs(60),
+            track_expiry: true,
+            revalidate: false,
+        }
+    }
+}
+
+/// BlobCacheMetrics : A point in time copy of the cache counters.
+///    rejected : blobs fetched but not cached because they were requested less often than the blobs they would evict.
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct BlobCacheMetrics {
+    pub hits: u64,
+    pub misses: u64,
+    pub revalidated: u64,
+    pub rejected: u64,
+    pub evictions: u64,
+    pub expirations: u64,
+    pub invalidations: u64,
+    pub entries: u64,
+    pub bytes: u64,
+}
+
+// Depth of the frequency sketch, each row indexes the alias hash with its own multiplier.
+const SKETCH_ROWS: usize = 4;
+const SKETCH_MAX: u8 = 15;
+
+/// FrequencySketch : Approximate request counts of recently requested aliases, the TinyLFU filter.
+///    A count-min sketch of 4-bit counters, all halved once 10 x width requests were counted
+///    so that old popularity fades away.
+struct FrequencySketch {
+    counters: Vec<[u8; SKETCH_ROWS]>,
+    mask: usize,
+    additions: usize,
+    sample_size: usize,
+}
+
+impl FrequencySketch {
+    fn new(width: usize) -> FrequencySketch {
+        let width = width.max(16).next_power_of_two();
+        FrequencySketch { counters: vec![[0; SKETCH_ROWS]; width], mask: width - 1, additions: 0, sample_size: 10 * width }
+    }
+
+    fn index(&self, hash: u64, row: usize) -> usize {
+        // a different odd multiplier per row spreads the same hash over unrelated slots
+        const SEEDS: [u64; SKETCH_ROWS] = [0x9e37_79b9_7f4a_7c15, 0xc2b2_ae3d_27d4_eb4f, 0x1656_67b1_9e37_79f9, 0x27d4_eb2f_1656_67c5];
+        (hash.wrapping_mul(SEEDS[row]) >> 32) as usize & self.mask
+    }
+
+    fn increment(&mut self, hash: u64) {
+        for row in 0..SKETCH_ROWS {
+            let i = self.index(hash, row);
+            let c = &mut self.counters[i][row];
+            if *c < SKETCH_MAX {
+                *c += 1;
+            }
+        }
+
+        self.additions += 1;
+        if self.additions >= self.sample_size {
+            for slot in self.counters.iter_mut() {
+                for c in slot.iter_mut() {
+                    *c >>= 1;
+                }
+            }
+            self.additions /= 2;
+        }
+    }
+
+    fn estimate(&self, hash: u64) -> u8 {
+        (0..SKETCH_ROWS).map(|row| self.counters[self.index(hash, row)][row]).min().unwrap_or(0)
+    }
+}
+
+struct Cached {
+    content: Arc<[u8]>,
+    hash: u64,
+    // milliseconds since epoch, 0 if the blob does not expire or its expiry is not tracked
+    expiry: qdb_time_t,
+    // nanoseconds since epoch, 0 when unknown
+    modified: i64,
+    fetched: Instant,
+    tick: u64,
+}
+
+struct Shard {
+    entries: HashMap<String, Cached>,
+    // least recently used first
+    recency: BTreeMap<u64, String>,
+    sketch: FrequencySketch,
+    tick: u64,
+    bytes: usize,
+    // bumped by every invalidation, a fetch that saw another value does not cache its result
+    generation: u64,
+}
+
+impl Shard {
+    fn remove(&mut self, alias: &str) -> bool {
+        match self.entries.remove(alias) {
+            Some(entry) => {
+                self.recency.remove(&entry.tick);
+                self.bytes -= entry.content.len();
+                true
+            }
+            None => false,
+        }
+    }
+
+    fn touch(&mut self, alias: &str) -> Option<Arc<[u8]>> {
+        self.tick += 1;
+        let tick = self.tick;
+        let entry = self.entries.get_mut(alias)?;
+        let old_tick = std::mem::replace(&mut entry.tick, tick);
+        let content = entry.content.clone();
+        if let Some(key) = self.recency.remove(&old_tick) {
+            self.recency.insert(tick, key);
+        }
+        Some(content)
+    }
+}
+
+enum Lookup {
+    Hit(Arc<[u8]>),
+    // served for too long, may be kept if the blob was not modified since
+    Stale(i64),
+    Miss,
+}
+
+/// BlobCache : A sharded read-through cache of blob contents, for blobs read much more often than written.
+///    Each shard has its own lock, byte budget and least recently used order. A blob is only
+///    admitted in a full shard if it was requested more often than the blobs it would evict, as
+///    estimated by a frequency sketch of the recent requests (TinyLFU), so that a scan of cold
+///    blobs does not flush the hot ones.
+///    Blobs changed through the cache are invalidated, changes made by other clients are seen
+///    once ttl has elapsed or the blob has expired.
+pub struct BlobCache {
+    config: BlobCacheConfig,
+    shard_bytes: usize,
+    shards: Vec<Mutex<Shard>>,
+    hits: AtomicU64,
+    misses: AtomicU64,
+    revalidated: AtomicU64,
+    rejected: AtomicU64,
+    evictions: AtomicU64,
+    expirations: AtomicU64,
+    invalidations: AtomicU64,
+}
+
+impl BlobCache {
+    /// Creates a new, empty blob cache.
+    pub fn new(config: BlobCacheConfig) -> BlobCache {
+        let count = config.shards.max(1);
+        let shard_bytes = config.max_bytes / count;
+        // sized for blobs of about 1KiB, a larger sketch only lowers the collision rate
+        let sketch_width = (shard_bytes / 1024).clamp(64, 1 << 16);
+
+        let shards = (0..count)
+            .map(|_| Mutex::new(Shard {
+                entries: HashMap::new(),
+                recency: BTreeMap::new(),
+                sketch: FrequencySketch::new(sketch_width),
+                tick: 0,
+                bytes: 0,
+                generation: 0,
+            }))
+            .collect();
+
+        BlobCache {
+            config,
+            shard_bytes,
+            shards,
+            hits: AtomicU64::new(0),
+            misses: AtomicU64::new(0),
+            revalidated: AtomicU64::new(0),
+            rejected: AtomicU64::new(0),
+            evictions: AtomicU64::new(0),
+            expirations: AtomicU64::new(0),
+            invalidations: AtomicU64::new(0),
+        }
+    }
+
+    /// Get : Returns the content of the blob, from the cache when possible.
+    ///    Errors are returned as is and never cached.
+    pub fn get(&self, handle: &HandleType, alias: &str) -> Result<Arc<[u8]>, ErrorType> {
+        let hash = hash_alias(alias);
+        let shard = self.shard(hash);
+
+        let (lookup, generation) = {
+            let mut shard = shard.lock().unwrap();
+            shard.sketch.increment(hash);
+            (self.lookup(&mut shard, alias), shard.generation)
+        };
+
+        match lookup {
+            Lookup::Hit(content) => {
+                self.hits.fetch_add(1, Ordering::Relaxed);
+                return Ok(content);
+            }
+            Lookup::Stale(modified) => {
+                if let Ok(metadata) = handle.get_metadata(alias) {
+                    if metadata.modified == modified {
+                        let mut shard = shard.lock().unwrap();
+                        if shard.generation == generation {
+                            if let Some(entry) = shard.entries.get_mut(alias) {
+                                entry.fetched = Instant::now();
+                                entry.expiry = metadata.expiry;
+                            }
+                            if let Some(content) = shard.touch(alias) {
+                                self.revalidated.fetch_add(1, Ordering::Relaxed);
+                                return Ok(content);
+                            }
+                        }
+                    }
+                }
+            }
+            Lookup::Miss => {}
+        }
+
+        self.misses.fetch_add(1, Ordering::Relaxed);
+        let content: Arc<[u8]> = handle.blob_get(alias)?.into();
+
+        // best effort, a blob whose metadata cannot be read is cached without them
+        let (expiry, modified) = if self.config.revalidate {
+            handle.get_metadata(alias).map_or((0, 0), |m| (m.expiry, m.modified))
+        } else if self.config.track_expiry {
+            (handle.get_expiry_time(alias).unwrap_or(0), 0)
+        } else {
+            (0, 0)
+        };
+
+        let mut shard = shard.lock().unwrap();
+        if shard.generation == generation {
+            self.insert(&mut shard, alias, Cached { content: content.clone(), hash, expiry, modified, fetched: Instant::now(), tick: 0 });
+        }
+        Ok(content)
+    }
+
+    /// Put : Creates a blob and drops any cached content for its alias.
+    pub fn put(&self, handle: &HandleType, alias: &str, content: &[u8], expiry: qdb_time_t) -> Option<ErrorType> {
+        let err = handle.blob_put(alias, content, expiry);
+        self.invalidate(alias);
+        err
+    }
+
+    /// Update : Creates or replaces a blob and drops any cached content for its alias.
+    pub fn update(&self, handle: &HandleType, alias: &str, content: &[u8], expiry: qdb_time_t) -> Option<ErrorType> {
+        let err = handle.blob_update(alias, content, expiry);
+        self.invalidate(alias);
+        err
+    }
+
+    /// CompareAndSwap : Same as HandleType::blob_compare_and_swap, the cached content is dropped whatever the outcome.
+    pub fn compare_and_swap(&self, handle: &HandleType, alias: &str, content: &[u8], comparand: &[u8], expiry: qdb_time_t)
+                            -> Result<Option<Vec<u8>>, ErrorType> {
+        let result = handle.blob_compare_and_swap(alias, content, comparand, expiry);
+        self.invalidate(alias);
+        result
+    }
+
+    /// Remove : Removes an entry and drops any cached content for its alias.
+    pub fn remove(&self, handle: &HandleType, alias: &str) -> Option<ErrorType> {
+        let err = handle.remove(alias);
+        self.invalidate(alias);
+        err
+    }
+
+    /// Invalidate : Drops the cached content of the blob, if any.
+    ///    Fetches running at the same time do not cache their result.
+    pub fn invalidate(&self, alias: &str) {
+        let mut shard = self.shard(hash_alias(alias)).lock().unwrap();
+        shard.generation += 1;
+        if shard.remove(alias) {
+            self.invalidations.fetch_add(1, Ordering::Relaxed);
+        }
+    }
+
+    /// Clear : Drops every cached blob, request frequencies are kept.
+    pub fn clear(&self) {
+        for shard in &self.shards {
+            let mut shard = shard.lock().unwrap();
+            shard.generation += 1;
+            shard.entries.clear();
+            shard.recency.clear();
+            shard.bytes = 0;
+        }
+    }
+
+    /// Metrics : Returns the hit, miss and memory counters of the cache.
+    pub fn metrics(&self) -> BlobCacheMetrics {
+        let (mut entries, mut bytes) = (0, 0);
+        for shard in &self.shards {
+            let shard = shard.lock().unwrap();
+            entries += shard.entries.len() as u64;
+            bytes += shard.bytes as u64;
+        }
+
+        BlobCacheMetrics {
+            hits: self.hits.load(Ordering::Relaxed),
+            misses: self.misses.load(Ordering::Relaxed),
+            revalidated: self.revalidated.load(Ordering::Relaxed),
+            rejected: self.rejected.load(Ordering::Relaxed),
+            evictions: self.evictions.load(Ordering::Relaxed),
+            expirations: self.expirations.load(Ordering::Relaxed),
+            invalidations: self.invalidations.load(Ordering::Relaxed),
+            entries,
+            bytes,
+        }
+    }
+
+    fn shard(&self, hash: u64) -> &Mutex<Shard> {
+        // the top bits, the sketch rows mix the whole hash
+        &self.shards[((hash >> 48) as usize) % self.shards.len()]
+    }
+
+    fn lookup(&self, shard: &mut Shard, alias: &str) -> Lookup {
+        let (expired, stale, modified) = match shard.entries.get(alias) {
+            Some(e) => (e.expiry != 0 && e.expiry <= now_ms(), e.fetched.elapsed() >= self.config.ttl, e.modified),
+            None => return Lookup::Miss,
+        };
+
+        if expired {
+            shard.remove(alias);
+            self.expirations.fetch_add(1, Ordering::Relaxed);
+            return Lookup::Miss;
+        }
+        if stale {
+            if self.config.revalidate && modified != 0 {
+                return Lookup::Stale(modified);
+            }
+            shard.remove(alias);
+            return Lookup::Miss;
+        }
+
+        match shard.touch(alias) {
+            Some(content) => Lookup::Hit(content),
+            None => Lookup::Miss,
+        }
+    }
+
+    fn insert(&self, shard: &mut Shard, alias: &str, mut entry: Cached) {
+        let bytes = entry.content.len();
+        if bytes > self.shard_bytes {
+            self.rejected.fetch_add(1, Ordering::Relaxed);
+            return;
+        }
+
+        shard.remove(alias);
+
+        // admission: the least recently used blobs needed to make room are evicted only if every one of them
+        // is requested less than the candidate, otherwise none is and the candidate is rejected
+        let frequency = shard.sketch.estimate(entry.hash);
+        let mut victims = Vec::new();
+        let mut freed = 0;
+        for (tick, victim) in shard.recency.iter() {
+            if shard.bytes - freed + bytes <= self.shard_bytes {
+                break;
+            }
+            let victim = match shard.entries.get(victim) {
+                Some(v) => v,
+                None => continue,
+            };
+            if shard.sketch.estimate(victim.hash) >= frequency {
+                self.rejected.fetch_add(1, Ordering::Relaxed);
+                return;
+            }
+            freed += victim.content.len();
+            victims.push(*tick);
+        }
+
+        for tick in victims {
+            if let Some(victim) = shard.recency.remove(&tick) {
+                if let Some(evicted) = shard.entries.remove(&victim) {
+                    shard.bytes -= evicted.content.len();
+                }
+                self.evictions.fetch_add(1, Ordering::Relaxed);
+            }
+        }
+
+        shard.tick += 1;
+        entry.tick = shard.tick;
+        shard.bytes += bytes;
+        shard.recency.insert(entry.tick, alias.to_string());
+        shard.entries.insert(alias.to_string(), entry);
+    }
+}
+
+fn hash_alias(alias: &str) -> u64 {
+    let mut hasher = DefaultHasher::new();
+    alias.hash(&mut hasher);
+    hasher.finish()
+}
+
+fn now_ms() -> i64 {
+    SystemTime::now().duration_since(UNIX_EPOCH).map(|d| d.as_millis() as i64).unwrap_or(0)
+}
@@ -0,0 +1,379 @@
+use std::collections::VecDeque;
+use std::io;
+use std::sync::mpsc;
+use std::time::{SystemTime, UNIX_EPOCH};
+
+use crate::batch::Batch;
+use crate::error::ErrorType;
+use crate::handle::HandleType;
+use crate::qdb_time_t;
+
+const MANIFEST_MAGIC: &[u8; 8] = b"QDBCHNK1";
+const MANIFEST_SIZE: usize = 32;
+
+/// ChunkedConfig : Settings of a chunked blob writer.
+///    chunk_size : size of every chunk entry but the last one, large enough to amortize a round trip,
+///        small enough to stay well under the client and server buffer limits.
+///    batch_chunks : number of chunks sent together in one qdb_run_batch, the cluster writes them in parallel.
+///        The writer buffers chunk_size * batch_chunks bytes.
+///    expiry : absolute expiry time of the manifest and of the chunks, in milliseconds since epoch, 0 for never.
+#[derive(Debug, Clone, Copy)]
+pub struct ChunkedConfig {
+    pub chunk_size: usize,
+    pub batch_chunks: usize,
+    pub expiry: qdb_time_t,
+}
+
+impl Default for ChunkedConfig {
+    fn default() -> Self {
+        ChunkedConfig { chunk_size: 1024 * 1024, batch_chunks: 8, expiry: 0 }
+    }
+}
+
+/// Manifest : The blob stored at the alias of a chunked blob, describes its chunks.
+///    Chunks are stored at "<alias>.chunk.<generation>.<index>", every rewrite uses a new generation
+///    so that readers of the previous manifest never see a mix of old and new chunks.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct Manifest {
+    pub total: u64,
+    pub chunk_size: u32,
+    pub chunk_count: u32,
+    pub generation: u64,
+}
+
+impl Manifest {
+    fn encode(&self) -> [u8; MANIFEST_SIZE] {
+        let mut bytes = [0u8; MANIFEST_SIZE];
+        bytes[0..8].copy_from_slice(MANIFEST_MAGIC);
+        bytes[8..16].copy_from_slice(&self.total.to_le_bytes());
+        bytes[16..20].copy_from_slice(&self.chunk_size.to_le_bytes());
+        bytes[20..24].copy_from_slice(&self.chunk_count.to_le_bytes());
+        bytes[24..32].copy_from_slice(&self.generation.to_le_bytes());
+        bytes
+    }
+
+    fn decode(bytes: &[u8]) -> Result<Manifest, ErrorType> {
+        if bytes.len() != MANIFEST_SIZE || &bytes[0..8] != MANIFEST_MAGIC {
+            return Err(ErrorType::ErrIncompatibleType);
+        }
+        let u32_at = |i: usize| u32::from_le_bytes(bytes[i..i + 4].try_into().unwrap());
+        let u64_at = |i: usize| u64::from_le_bytes(bytes[i..i + 8].try_into().unwrap());
+        let manifest = Manifest { total: u64_at(8), chunk_size: u32_at(16), chunk_count: u32_at(20), generation: u64_at(24) };
+
+        if manifest.chunk_size == 0 || manifest.total.div_ceil(manifest.chunk_size as u64) != manifest.chunk_count as u64 {
+            return Err(ErrorType::ErrDataCorruption);
+        }
+        Ok(manifest)
+    }
+
+    fn chunk_alias(alias: &str, generation: u64, index: u32) -> String {
+        format!("{}.chunk.{:x}.{}", alias, generation, index)
+    }
+
+    // Size chunk index must have, anything else means the chunk was rewritten or damaged.
+    fn chunk_len(&self, index: u32) -> usize {
+        let start = index as u64 * self.chunk_size as u64;
+        (self.total - start).min(self.chunk_size as u64) as usize
+    }
+}
+
+fn to_io_error(err: ErrorType) -> io::Error {
+    io::Error::new(io::ErrorKind::Other, err.to_string())
+}
+
+/// BlobWriter : Writes a blob of any size as fixed size chunk entries, see HandleType::blob_stream_writer.
+///    Nothing is visible to readers until finish writes the manifest, dropping the writer without
+///    calling finish removes the chunks written so far.
+pub struct BlobWriter<'h> {
+    handle: &'h HandleType,
+    alias: String,
+    config: ChunkedConfig,
+    generation: u64,
+    previous: Option<Manifest>,
+    staging: Vec<u8>,
+    chunk_count: u32,
+    total: u64,
+    finished: bool,
+}
+
+impl<'h> BlobWriter<'h> {
+    /// Written : Returns the number of bytes written so far.
+    pub fn written(&self) -> u64 {
+        self.total
+    }
+
+    // Sends the first len staged bytes as chunks in one batch, len is a multiple of chunk_size except when finishing.
+    // When part of the batch fails, the chunks it wrote are removed and the bytes stay staged, nothing is counted.
+    fn flush_staging(&mut self, len: usize) -> Result<(), ErrorType> {
+        if len == 0 {
+            return Ok(());
+        }
+
+        let chunks = self.staging[..len].chunks(self.config.chunk_size);
+        let mut batch = Batch::with_capacity(chunks.len());
+        for (i, chunk) in chunks.enumerate() {
+            let alias = Manifest::chunk_alias(&self.alias, self.generation, self.chunk_count + i as u32);
+            batch.blob_update(&alias, chunk, self.config.expiry)?;
+        }
+
+        let count = batch.len();
+        let results = batch.run(self.handle);
+        if results.succeeded() != count {
+            if let Some(err) = (0..count).find_map(|i| results.error(i)) {
+                // a chunk that failed on an entry of another type is not ours to remove,
+                // any other failure may have come after the chunk was written
+                let written: Vec<u32> = (0..count)
+                    .filter(|i| results.error(*i) != Some(ErrorType::ErrIncompatibleType))
+                    .map(|i| self.chunk_count + i as u32)
+                    .collect();
+                drop(results);
+                remove_chunks(self.handle, &self.alias, self.generation, written);
+                return Err(err);
+            }
+        }
+        drop(results);
+
+        self.chunk_count += count as u32;
+        self.staging.drain(..len);
+        Ok(())
+    }
+
+    /// Finish : Writes the remaining chunks then the manifest, and removes the chunks of the previous content.
+    ///    Returns the size of the blob.
+    pub fn finish(mut self) -> Result<u64, ErrorType> {
+        self.flush_staging(self.staging.len())?;
+
+        let manifest = Manifest {
+            total: self.total,
+            chunk_size: self.config.chunk_size as u32,
+            chunk_count: self.chunk_count,
+            generation: self.generation,
+        };
+        if let Some(err) = self.handle.blob_update(&self.alias, &manifest.encode(), self.config.expiry) {
+            return Err(err);
+        }
+        self.finished = true;
+
+        if let Some(previous) = self.previous {
+            remove_chunks(self.handle, &self.alias, previous.generation, 0..previous.chunk_count);
+        }
+        Ok(self.total)
+    }
+}
+
+impl io::Write for BlobWriter<'_> {
+    fn write(&mut self, buf: &[u8]) -> io::Result<usize> {
+        let capacity = self.config.chunk_size * self.config.batch_chunks;
+        if self.staging.len() == capacity {
+            self.flush_staging(capacity).map_err(to_io_error)?;
+        }
+
+        let n = buf.len().min(capacity - self.staging.len());
+        self.staging.extend_from_slice(&buf[..n]);
+        self.total += n as u64;
+        Ok(n)
+    }
+
+    /// Flush : Sends the complete chunks staged so far, a partial chunk stays until more data or finish.
+    fn flush(&mut self) -> io::Result<()> {
+        let complete = self.staging.len() / self.config.chunk_size * self.config.chunk_size;
+        self.flush_staging(complete).map_err(to_io_error)
+    }
+}
+
+impl Drop for BlobWriter<'_> {
+    fn drop(&mut self) {
+        if !self.finished {
+            remove_chunks(self.handle, &self.alias, self.generation, 0..self.chunk_count);
+        }
+    }
+}
+
+fn remove_chunks(handle: &HandleType, alias: &str, generation: u64, indexes: impl IntoIterator<Item=u32>) {
+    // chunks already gone are not an error, a concurrent writer may have cleaned them
+    for i in indexes {
+        let _ = handle.remove(&Manifest::chunk_alias(alias, generation, i));
+    }
+}
+
+/// BlobReader : Reads a chunked blob as a stream, see HandleType::blob_stream_reader.
+///    Chunks are fetched read_ahead at a time in one batch, so at most read_ahead chunks are held in memory.
+pub struct BlobReader<'h> {
+    handle: &'h HandleType,
+    alias: String,
+    manifest: Manifest,
+    read_ahead: usize,
+    next_chunk: u32,
+    chunks: VecDeque<Vec<u8>>,
+    current: Vec<u8>,
+    position: usize,
+}
+
+impl BlobReader<'_> {
+    pub fn manifest(&self) -> &Manifest {
+        &self.manifest
+    }
+
+    /// Len : Returns the size of the blob.
+    pub fn len(&self) -> u64 {
+        self.manifest.total
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.manifest.total == 0
+    }
+
+    fn fetch(&mut self) -> Result<(), ErrorType> {
+        let end = self.manifest.chunk_count.min(self.next_chunk.saturating_add(self.read_ahead as u32));
+        fetch_chunks(self.handle, &self.alias, &self.manifest, self.next_chunk..end, |chunk| {
+            self.chunks.push_back(chunk.to_vec())
+        })?;
+        self.next_chunk = end;
+        Ok(())
+    }
+}
+
+impl io::Read for BlobReader<'_> {
+    fn read(&mut self, buf: &mut [u8]) -> io::Result<usize> {
+        if self.position == self.current.len() {
+            if self.chunks.is_empty() && self.next_chunk < self.manifest.chunk_count {
+                self.fetch().map_err(to_io_error)?;
+            }
+            match self.chunks.pop_front() {
+                Some(chunk) => {
+                    self.current = chunk;
+                    self.position = 0;
+                }
+                None => return Ok(0),
+            }
+        }
+
+        let n = buf.len().min(self.current.len() - self.position);
+        buf[..n].copy_from_slice(&self.current[self.position..self.position + n]);
+        self.position += n;
+        Ok(n)
+    }
+}
+
+// Reads the chunks of range in one batch and hands them to f in order, checking their size against the manifest.
+fn fetch_chunks(handle: &HandleType, alias: &str, manifest: &Manifest, range: std::ops::Range<u32>,
+                mut f: impl FnMut(&[u8])) -> Result<(), ErrorType> {
+    let mut batch = Batch::with_capacity(range.len());
+    for i in range.clone() {
+        batch.blob_get(&Manifest::chunk_alias(alias, manifest.generation, i))?;
+    }
+
+    let results = batch.run(handle);
+    for (op, i) in range.enumerate() {
+        let chunk = results.blob(op)?;
+        if chunk.len() != manifest.chunk_len(i) {
+            return Err(ErrorType::ErrDataCorruption);
+        }
+        f(chunk);
+    }
+    Ok(())
+}
+
+fn generation_after(previous: Option<&Manifest>) -> u64 {
+    let now = SystemTime::now().duration_since(UNIX_EPOCH).map(|d| d.as_nanos() as u64).unwrap_or(0);
+    match previous {
+        Some(previous) => now.max(previous.generation + 1),
+        None => now,
+    }
+}
+
+impl HandleType {
+    /// BlobStreamManifest : Returns the manifest of a chunked blob, ErrIncompatibleType if alias is a plain blob.
+    pub fn blob_stream_manifest(&self, alias: &str) -> Result<Manifest, ErrorType> {
+        self.blob_get_with(alias, Manifest::decode)?
+    }
+
+    /// BlobStreamWriter : Starts writing a chunked blob at alias, replacing its content once finished.
+    ///    The content never has to fit in memory nor in the client buffers, only chunk_size * batch_chunks does.
+    ///
+    ///    let mut writer = handle.blob_stream_writer("model", ChunkedConfig::default())?;
+    ///    io::copy(&mut file, &mut writer)?;
+    ///    writer.finish()?;
+    pub fn blob_stream_writer(&self, alias: &str, config: ChunkedConfig) -> Result<BlobWriter<'_>, ErrorType> {
+        if config.chunk_size == 0 || config.chunk_size > u32::MAX as usize || config.batch_chunks == 0 {
+            return Err(ErrorType::ErrInvalidArgument);
+        }
+        let previous = match self.blob_stream_manifest(alias) {
+            Ok(manifest) => Some(manifest),
+            Err(ErrorType::ErrAliasNotFound) => None,
+            Err(err) => return Err(err),
+        };
+
+        Ok(BlobWriter {
+            handle: self,
+            alias: alias.to_string(),
+            config,
+            generation: generation_after(previous.as_ref()),
+            previous,
+            staging: Vec::with_capacity(config.chunk_size * config.batch_chunks),
+            chunk_count: 0,
+            total: 0,
+            finished: false,
+        })
+    }
+
+    /// BlobStreamReader : Opens a chunked blob for reading, fetching read_ahead chunks per round trip.
+    pub fn blob_stream_reader(&self, alias: &str, read_ahead: usize) -> Result<BlobReader<'_>, ErrorType> {
+        Ok(BlobReader {
+            handle: self,
+            alias: alias.to_string(),
+            manifest: self.blob_stream_manifest(alias)?,
+            read_ahead: read_ahead.max(1),
+            next_chunk: 0,
+            chunks: VecDeque::new(),
+            current: Vec::new(),
+            position: 0,
+        })
+    }
+
+    /// BlobStreamForEach : Calls f with every chunk of a chunked blob in order, and returns the size of the blob.
+    ///    The next read_ahead chunks are fetched on another thread while f runs on the current ones.
+    pub fn blob_stream_for_each(&self, alias: &str, read_ahead: usize, mut f: impl FnMut(&[u8]))
+                                -> Result<u64, ErrorType> {
+        let manifest = self.blob_stream_manifest(alias)?;
+        let read_ahead = read_ahead.max(1) as u32;
+
+        std::thread::scope(|scope| {
+            // one batch in the channel and one being fetched, on top of the one f is reading
+            let (sender, receiver) = mpsc::sync_channel::<Result<Vec<Vec<u8>>, ErrorType>>(1);
+            scope.spawn(move || {
+                let mut start = 0;
+                while start < manifest.chunk_count {
+                    let end = manifest.chunk_count.min(start.saturating_add(read_ahead));
+                    let mut chunks = Vec::with_capacity((end - start) as usize);
+                    let fetched = fetch_chunks(self, alias, &manifest, start..end, |chunk| chunks.push(chunk.to_vec()));
+                    let failed = fetched.is_err();
+                    if sender.send(fetched.map(|_| chunks)).is_err() || failed {
+                        return;
+                    }
+                    start = end;
+                }
+            });
+
+            for chunks in receiver {
+                for chunk in chunks? {
+                    f(&chunk);
+                }
+            }
+            Ok(manifest.total)
+        })
+    }
+
+    /// BlobStreamRemove : Removes a chunked blob, its manifest first so that no reader starts on removed chunks.
+    pub fn blob_stream_remove(&self, alias: &str) -> Option<ErrorType> {
+        let manifest = match self.blob_stream_manifest(alias) {
+            Ok(manifest) => manifest,
+            Err(err) => return Some(err),
+        };
+        if let Some(err) = self.remove(alias) {
+            return Some(err);
+        }
+        remove_chunks(self, alias, manifest.generation, 0..manifest.chunk_count);
+        None
+    }
+}
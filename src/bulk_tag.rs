@@ -0,0 +1,216 @@
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::{mpsc, Mutex};
+use std::thread;
+use std::time::{Duration, Instant};
+
+use crate::error::ErrorType;
+use crate::handle::HandleType;
+use crate::handle_pool::HandlePool;
+use crate::random::{self, Rng};
+
+/// TagAction : Whether a bulk tagging adds or removes the tags.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum TagAction {
+    Attach,
+    Detach,
+}
+
+/// BulkTagConfig : Settings of a bulk tagging.
+///    workers : calls running at once, spread over the handles of the pool.
+///    max_in_flight : entries read from the input and not done yet, bounds the memory whatever the input size.
+///    max_attempts : calls tried for one entry while the cluster answers try_again or unstable_cluster.
+///    backoff_base / backoff_max : after the n-th retry of an entry, waits a random time in
+///        [0, min(backoff_max, backoff_base * 2^n)].
+#[derive(Debug, Clone, Copy)]
+pub struct BulkTagConfig {
+    pub workers: usize,
+    pub max_in_flight: usize,
+    pub max_attempts: u32,
+    pub backoff_base: Duration,
+    pub backoff_max: Duration,
+}
+
+impl Default for BulkTagConfig {
+    fn default() -> Self {
+        BulkTagConfig {
+            workers: 16,
+            max_in_flight: 4096,
+            max_attempts: 8,
+            backoff_base: Duration::from_millis(1),
+            backoff_max: Duration::from_millis(200),
+        }
+    }
+}
+
+/// BulkTagStats : Progress of a bulk tagger, readable while it runs.
+///    entries / tags : entries done and the tags they carried, failed ones included.
+///    retries : calls sent again after try_again or unstable_cluster.
+///    elapsed : time spent running, the base of the rates.
+#[derive(Debug, Default, Clone, Copy, PartialEq)]
+pub struct BulkTagStats {
+    pub entries: u64,
+    pub tags: u64,
+    pub failed: u64,
+    pub retries: u64,
+    pub elapsed: Duration,
+}
+
+impl BulkTagStats {
+    /// EntriesPerSecond : Returns the throughput in entries tagged per second.
+    pub fn entries_per_second(&self) -> f64 {
+        per_second(self.entries, self.elapsed)
+    }
+
+    /// TagsPerSecond : Returns the throughput in tags attached or detached per second.
+    pub fn tags_per_second(&self) -> f64 {
+        per_second(self.tags, self.elapsed)
+    }
+}
+
+fn per_second(count: u64, elapsed: Duration) -> f64 {
+    if elapsed.is_zero() {
+        return 0.0;
+    }
+    count as f64 / elapsed.as_secs_f64()
+}
+
+/// BulkTagReport : Outcome of a bulk tagging, the entries that failed with their error.
+#[derive(Debug, Default, Clone, PartialEq)]
+pub struct BulkTagReport {
+    pub stats: BulkTagStats,
+    pub failed: Vec<(String, ErrorType)>,
+}
+
+/// BulkTagger : Attaches or detaches tags to many entries, one attach_tags or detach_tags call per entry,
+///    with several calls running at once over a handle pool.
+///    The input is read as the calls complete, so it can be a stream larger than the memory.
+///    Tags the entry already has on attach, or does not have on detach, are not an error: running it again is safe.
+///
+///    let tagger = BulkTagger::new(pool, BulkTagConfig::default());
+///    let report = tagger.run(TagAction::Attach, aliases.map(|a| (a, vec!["schema.v2".to_string()])));
+///    println!("{:.0} entries/s", report.stats.entries_per_second());
+pub struct BulkTagger {
+    pool: HandlePool,
+    config: BulkTagConfig,
+    entries: AtomicU64,
+    tags: AtomicU64,
+    failed: AtomicU64,
+    retries: AtomicU64,
+    started: Mutex<Option<Instant>>,
+    // time spent by the runs over
+    elapsed_nanos: AtomicU64,
+}
+
+impl BulkTagger {
+    pub fn new(pool: HandlePool, config: BulkTagConfig) -> BulkTagger {
+        BulkTagger {
+            pool,
+            config,
+            entries: AtomicU64::new(0),
+            tags: AtomicU64::new(0),
+            failed: AtomicU64::new(0),
+            retries: AtomicU64::new(0),
+            started: Mutex::new(None),
+            elapsed_nanos: AtomicU64::new(0),
+        }
+    }
+
+    /// Run : Applies action to every (alias, tags) of the input and returns when all are done.
+    ///    The stats of the report are those of this run only, stats() sums every run.
+    ///    Runs are meant one after the other, the stats of runs made at once would mix.
+    pub fn run<I>(&self, action: TagAction, input: I) -> BulkTagReport
+        where I: IntoIterator<Item=(String, Vec<String>)> {
+        let before = self.stats();
+        let started = Instant::now();
+        *self.started.lock().unwrap() = Some(started);
+
+        let workers = self.config.workers.max(1);
+        // the channel holds what the workers have not taken yet, the workers one entry each
+        let (sender, receiver) = mpsc::sync_channel::<(String, Vec<String>)>(self.config.max_in_flight.saturating_sub(workers).max(1));
+        let receiver = Mutex::new(receiver);
+
+        let failed = thread::scope(|scope| {
+            let handles: Vec<_> = (0..workers)
+                .map(|w| {
+                    let receiver = &receiver;
+                    let handle = self.pool.handle(w % self.pool.size());
+                    scope.spawn(move || {
+                        let mut rng = Rng::new(random::seed(w as u64));
+                        let mut failed = Vec::new();
+                        loop {
+                            // the lock is only held while waiting for the next entry
+                            let next = receiver.lock().unwrap().recv();
+                            let (alias, tags) = match next {
+                                Ok(entry) => entry,
+                                Err(_) => return failed,
+                            };
+                            if let Some(err) = self.apply(handle, action, &alias, &tags, &mut rng) {
+                                self.failed.fetch_add(1, Ordering::Relaxed);
+                                failed.push((alias, err));
+                            }
+                            self.entries.fetch_add(1, Ordering::Relaxed);
+                            self.tags.fetch_add(tags.len() as u64, Ordering::Relaxed);
+                        }
+                    })
+                })
+                .collect();
+
+            for entry in input {
+                // every worker is gone, they only stop on panic
+                if sender.send(entry).is_err() {
+                    break;
+                }
+            }
+            drop(sender);
+
+            handles.into_iter()
+                .flat_map(|h| h.join().expect("bulk tagging worker panicked"))
+                .collect::<Vec<_>>()
+        });
+
+        self.elapsed_nanos.fetch_add(started.elapsed().as_nanos() as u64, Ordering::Relaxed);
+        *self.started.lock().unwrap() = None;
+
+        let after = self.stats();
+        BulkTagReport {
+            stats: BulkTagStats {
+                entries: after.entries - before.entries,
+                tags: after.tags - before.tags,
+                failed: after.failed - before.failed,
+                retries: after.retries - before.retries,
+                elapsed: after.elapsed - before.elapsed,
+            },
+            failed,
+        }
+    }
+
+    // One entry, retried while the cluster asks to.
+    fn apply(&self, handle: &HandleType, action: TagAction, alias: &str, tags: &[String], rng: &mut Rng) -> Option<ErrorType> {
+        let attempts = self.config.max_attempts.max(1);
+        for attempt in 0..attempts {
+            let err = match action {
+                TagAction::Attach => handle.attach_tags(alias, tags),
+                TagAction::Detach => handle.detach_tags(alias, tags),
+            };
+            match err {
+                Some(ErrorType::ErrTryAgain) | Some(ErrorType::ErrUnstableCluster) if attempt + 1 < attempts => {
+                    self.retries.fetch_add(1, Ordering::Relaxed);
+                    thread::sleep(random::backoff(self.config.backoff_base, self.config.backoff_max, attempt, rng));
+                }
+                err => return err,
+            }
+        }
+        unreachable!("the last attempt returns")
+    }
+
+    pub fn stats(&self) -> BulkTagStats {
+        let running = self.started.lock().unwrap().map_or(Duration::ZERO, |s| s.elapsed());
+        BulkTagStats {
+            entries: self.entries.load(Ordering::Relaxed),
+            tags: self.tags.load(Ordering::Relaxed),
+            failed: self.failed.load(Ordering::Relaxed),
+            retries: self.retries.load(Ordering::Relaxed),
+            elapsed: Duration::from_nanos(self.elapsed_nanos.load(Ordering::Relaxed)) + running,
+        }
+    }
+}
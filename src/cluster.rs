@@ -1,6 +1,6 @@
 use std::ptr;
 
-use crate::{qdb_cluster_endpoints, qdb_handle_t, qdb_purge_all, qdb_purge_cache, qdb_size_t, qdb_trim_all, qdb_wait_for_stabilization, utils_ptr};
+use crate::{qdb_cluster_endpoints, qdb_handle_t, qdb_purge_all, qdb_purge_cache, qdb_release, qdb_remote_node_t, qdb_size_t, qdb_trim_all, qdb_wait_for_stabilization, utils_ptr};
 use crate::cluster_endpoint::Endpoint;
 use crate::error::{Errorable, ErrorType, makeErrorNone};
 
@@ -74,51 +74,33 @@ impl Cluster {
     /// Returns Result type of either Vec<Endpoint> or an ErrorType.
     pub fn Endpoints(&self) -> Result<Vec<Endpoint>, ErrorType> {
         unsafe {
-            // create a new mutable raw pointer to pass to the underlying FFI function
-            let endpoints_raw_pointer = ptr::null_mut();
+            // the API allocates the array of endpoints, it is released below once converted
+            let mut endpoints_raw_pointer: *mut qdb_remote_node_t = ptr::null_mut();
 
             // create a new mutable counter to pass to the underlying FFI function
             let mut endpoints_count: qdb_size_t = 0;
 
             let err = qdb_cluster_endpoints(
                 self.handle,
-                endpoints_raw_pointer,
+                &mut endpoints_raw_pointer,
                 &mut endpoints_count,
             );
 
-            // no error
-            if err == 0 {
-                let endpoints = utils_ptr::raw_pointer_to_vector(
-                    endpoints_raw_pointer,
-                    endpoints_count,
-                );
-
-                return match endpoints {
-                    Ok(endpoints) => {
-                        // drop the raw pointer https://doc.rust-lang.org/stable/std/ptr/fn.drop_in_place.html
-                        ptr::drop_in_place(endpoints_raw_pointer);
-
-                        Ok(endpoints)
-                    }
-                    Err(err) => {
-                        // drop the raw pointer https://doc.rust-lang.org/stable/std/ptr/fn.drop_in_place.html
-                        ptr::drop_in_place(endpoints_raw_pointer);
+            if err != 0 {
+                // extract error code from response and return
+                return Err(ErrorType::from_qdb_error_origin_t(err));
+            }
 
-                        // Convert RawPointer Error to ErrorType. This will lead to a the following ErrorType
-                        // ErrSystemLocal / qdb_error_t_qdb_e_system_local =  qdb_error_t = -486539263
-                        // System error on local system (client-side).\n! Please check `errno` or `GetLastError()` for actual error.
+            let endpoints = utils_ptr::raw_pointer_to_vector(endpoints_raw_pointer, endpoints_count);
 
-                        // println!("Error: {}", err.error_message());
-                        Err(ErrorType::from_qdb_error_origin_t(err.error_code()))
-                    }
-                };
+            if !endpoints_raw_pointer.is_null() {
+                qdb_release(self.handle, endpoints_raw_pointer as *const _);
             }
 
-            // drop the raw pointer https://doc.rust-lang.org/stable/std/ptr/fn.drop_in_place.html
-            ptr::drop_in_place(endpoints_raw_pointer);
-
-            // extract error code from response and return
-            return Err(ErrorType::from_qdb_error_origin_t(err));
+            // Convert RawPointer Error to ErrorType. This will lead to a the following ErrorType
+            // ErrSystemLocal / qdb_error_t_qdb_e_system_local =  qdb_error_t = -486539263
+            // System error on local system (client-side).\n! Please check `errno` or `GetLastError()` for actual error.
+            endpoints.map_err(|err| ErrorType::from_qdb_error_origin_t(err.error_code()))
         }
     }
 }
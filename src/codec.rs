@@ -0,0 +1,402 @@
+use std::cell::RefCell;
+use std::sync::atomic::{AtomicU64, Ordering};
+
+use crate::error::ErrorType;
+use crate::handle::HandleType;
+use crate::qdb_time_t;
+
+// Tagged payloads start with a header: MAGIC, the codec id, the original size as u32 LE and the FNV-1a hash
+// of those 12 bytes as u32 LE. Blobs without a valid header, MAGIC and hash both, were written without
+// the codec layer and are returned as they are: a plain blob is only taken for a tagged one if its first
+// 16 bytes happen to be a valid header.
+const MAGIC: [u8; 7] = [0xD1, b'Q', b'Z', 0x0D, 0x0A, 0x1A, 0x0A];
+const CODEC_AT: usize = 7;
+const HEADER_SIZE: usize = 16;
+// A sequence of LZ77 output can not expand into more than this many bytes per input byte,
+// bounds what is reserved for a size read from the payload.
+const MAX_EXPANSION: usize = 255;
+
+const MIN_MATCH: usize = 4;
+const MAX_OFFSET: usize = 65_535;
+const MAX_HASH_BITS: u32 = 14;
+const WINDOW_MASK: usize = 65_535;
+
+/// Codec : How a blob is stored.
+///    Stored : as given, only tagged.
+///    Fast : LZ77 with a single candidate per position, skips ahead quickly on incompressible data.
+///    Best : LZ77 following hash chains of up to 32 candidates, slower but smaller, decompresses as fast as Fast.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum Codec {
+    Stored,
+    Fast,
+    Best,
+}
+
+impl Codec {
+    fn id(self) -> u8 {
+        match self {
+            Codec::Stored => 0,
+            Codec::Fast => 1,
+            Codec::Best => 2,
+        }
+    }
+
+    fn from_id(id: u8) -> Option<Codec> {
+        match id {
+            0 => Some(Codec::Stored),
+            1 => Some(Codec::Fast),
+            2 => Some(Codec::Best),
+            _ => None,
+        }
+    }
+}
+
+/// CodecConfig : Which codec compresses which blobs.
+///    prefixes : codec of the aliases starting with a prefix, the longest matching prefix wins.
+///    default : codec of the aliases no prefix matches.
+///    min_size : blobs smaller than this are stored as given, the header would eat the gain.
+#[derive(Debug, Clone)]
+pub struct CodecConfig {
+    pub prefixes: Vec<(String, Codec)>,
+    pub default: Codec,
+    pub min_size: usize,
+}
+
+impl Default for CodecConfig {
+    fn default() -> Self {
+        CodecConfig { prefixes: Vec::new(), default: Codec::Fast, min_size: 128 }
+    }
+}
+
+/// CodecStats : Counters of a blob codec since its creation.
+///    raw_bytes / stored_bytes : size of the blobs given to put and update, and once encoded.
+///    compressed : blobs stored compressed, stored : blobs stored as given because compression did not pay.
+#[derive(Debug, Default, Clone, Copy, PartialEq, Eq)]
+pub struct CodecStats {
+    pub raw_bytes: u64,
+    pub stored_bytes: u64,
+    pub compressed: u64,
+    pub stored: u64,
+}
+
+/// BlobCodec : Compresses blobs on the client before they are sent, and decompresses them when read.
+///    Payloads carry a small header naming their codec, so blobs written with any codec, or
+///    without this layer at all, are read back the same way.
+///
+///    let codec = BlobCodec::new(CodecConfig { prefixes: vec![("json.".into(), Codec::Best)], ..CodecConfig::default() });
+///    codec.blob_update(&handle, "json.user.1", document.as_bytes(), 0);
+///    let document = codec.blob_get(&handle, "json.user.1")?;
+pub struct BlobCodec {
+    config: CodecConfig,
+    raw_bytes: AtomicU64,
+    stored_bytes: AtomicU64,
+    compressed: AtomicU64,
+    stored: AtomicU64,
+}
+
+impl BlobCodec {
+    pub fn new(mut config: CodecConfig) -> BlobCodec {
+        // longest prefixes first, the first match is the longest one
+        config.prefixes.sort_by(|a, b| b.0.len().cmp(&a.0.len()));
+        BlobCodec {
+            config,
+            raw_bytes: AtomicU64::new(0),
+            stored_bytes: AtomicU64::new(0),
+            compressed: AtomicU64::new(0),
+            stored: AtomicU64::new(0),
+        }
+    }
+
+    /// CodecFor : Returns the codec used for alias.
+    pub fn codec_for(&self, alias: &str) -> Codec {
+        self.config.prefixes.iter()
+            .find(|(prefix, _)| alias.starts_with(prefix.as_str()))
+            .map_or(self.config.default, |(_, codec)| *codec)
+    }
+
+    /// Encode : Returns the payload stored for content at alias.
+    pub fn encode(&self, alias: &str, content: &[u8]) -> Result<Vec<u8>, ErrorType> {
+        let codec = if content.len() < self.config.min_size { Codec::Stored } else { self.codec_for(alias) };
+        let payload = encode(codec, content)?;
+
+        self.raw_bytes.fetch_add(content.len() as u64, Ordering::Relaxed);
+        self.stored_bytes.fetch_add(payload.len() as u64, Ordering::Relaxed);
+        if payload[CODEC_AT] == Codec::Stored.id() {
+            self.stored.fetch_add(1, Ordering::Relaxed);
+        } else {
+            self.compressed.fetch_add(1, Ordering::Relaxed);
+        }
+        Ok(payload)
+    }
+
+    pub fn blob_put(&self, handle: &HandleType, alias: &str, content: &[u8], expiry: qdb_time_t) -> Option<ErrorType> {
+        match self.encode(alias, content) {
+            Ok(payload) => handle.blob_put(alias, &payload, expiry),
+            Err(err) => Some(err),
+        }
+    }
+
+    pub fn blob_update(&self, handle: &HandleType, alias: &str, content: &[u8], expiry: qdb_time_t) -> Option<ErrorType> {
+        match self.encode(alias, content) {
+            Ok(payload) => handle.blob_update(alias, &payload, expiry),
+            Err(err) => Some(err),
+        }
+    }
+
+    /// BlobGet : Returns the content of a blob, decompressed straight from the API buffer.
+    pub fn blob_get(&self, handle: &HandleType, alias: &str) -> Result<Vec<u8>, ErrorType> {
+        handle.blob_get_with(alias, decode)?
+    }
+
+    pub fn stats(&self) -> CodecStats {
+        CodecStats {
+            raw_bytes: self.raw_bytes.load(Ordering::Relaxed),
+            stored_bytes: self.stored_bytes.load(Ordering::Relaxed),
+            compressed: self.compressed.load(Ordering::Relaxed),
+            stored: self.stored.load(Ordering::Relaxed),
+        }
+    }
+}
+
+// The match finder tables, kept per thread so that compressing does not allocate them every time.
+//    head : last position + 1 of every hash, 0 when none, cleared for every blob.
+//    chain : previous position + 1 with the same hash, by position in the window, never cleared:
+//        it is only reached from head and positions are checked to go strictly backwards.
+struct MatchFinder {
+    head: Vec<u32>,
+    chain: Vec<u32>,
+}
+
+thread_local! {
+    static MATCH_FINDER: RefCell<MatchFinder> = RefCell::new(MatchFinder { head: Vec::new(), chain: Vec::new() });
+}
+
+/// Encode : Returns content compressed with codec behind a header, or only tagged when compression does not pay.
+pub fn encode(codec: Codec, content: &[u8]) -> Result<Vec<u8>, ErrorType> {
+    if content.len() > u32::MAX as usize {
+        return Err(ErrorType::ErrEntryTooLarge);
+    }
+
+    let mut payload = Vec::with_capacity(HEADER_SIZE + content.len());
+    write_header(&mut payload, codec, content.len());
+
+    if codec != Codec::Stored {
+        MATCH_FINDER.with(|finder| compress(&mut finder.borrow_mut(), codec == Codec::Best, content, &mut payload));
+        if payload.len() < HEADER_SIZE + content.len() {
+            return Ok(payload);
+        }
+        payload.clear();
+        write_header(&mut payload, Codec::Stored, content.len());
+    }
+    payload.extend_from_slice(content);
+    Ok(payload)
+}
+
+/// Decode : Returns the content of a payload written by encode, or the payload itself when it has no valid header.
+pub fn decode(payload: &[u8]) -> Result<Vec<u8>, ErrorType> {
+    let (codec, size) = match read_header(payload) {
+        Some(header) => header,
+        None => return Ok(payload.to_vec()),
+    };
+    let codec = Codec::from_id(codec).ok_or(ErrorType::ErrDataCorruption)?;
+    let body = &payload[HEADER_SIZE..];
+
+    match codec {
+        Codec::Stored if body.len() == size => Ok(body.to_vec()),
+        Codec::Stored => Err(ErrorType::ErrDataCorruption),
+        Codec::Fast | Codec::Best => {
+            // the size is checked as the content is produced, only reserve what the body can expand to
+            let mut content = Vec::with_capacity(size.min(body.len().saturating_mul(MAX_EXPANSION)));
+            decompress(body, size, &mut content)?;
+            Ok(content)
+        }
+    }
+}
+
+fn header_hash(header: &[u8]) -> u32 {
+    header.iter().fold(0x811c_9dc5u32, |h, &b| (h ^ b as u32).wrapping_mul(0x0100_0193))
+}
+
+fn write_header(payload: &mut Vec<u8>, codec: Codec, size: usize) {
+    payload.extend_from_slice(&MAGIC);
+    payload.push(codec.id());
+    payload.extend_from_slice(&(size as u32).to_le_bytes());
+    let hash = header_hash(payload);
+    payload.extend_from_slice(&hash.to_le_bytes());
+}
+
+// The codec id and the original size, None when payload does not start with a valid header.
+fn read_header(payload: &[u8]) -> Option<(u8, usize)> {
+    if payload.len() < HEADER_SIZE || payload[..CODEC_AT] != MAGIC {
+        return None;
+    }
+    if header_hash(&payload[..12]) != read_u32(payload, 12) {
+        return None;
+    }
+    Some((payload[CODEC_AT], read_u32(payload, 8) as usize))
+}
+
+fn read_u32(input: &[u8], i: usize) -> u32 {
+    u32::from_le_bytes(input[i..i + 4].try_into().unwrap())
+}
+
+fn hash(v: u32, bits: u32) -> usize {
+    (v.wrapping_mul(2_654_435_761) >> (32 - bits)) as usize
+}
+
+fn match_length(input: &[u8], candidate: usize, i: usize) -> usize {
+    // candidate + k stays behind i + k, a match may run into the bytes it repeats
+    input[i..].iter().zip(&input[candidate..]).take_while(|(a, b)| a == b).count()
+}
+
+// Sequences as in LZ4 blocks: a token with the literal length in its high nibble and the match length - 4
+// in its low nibble, 15 meaning more length bytes follow, then the literals, then the match offset as u16 LE.
+// The last sequence has literals only.
+fn compress(finder: &mut MatchFinder, best: bool, input: &[u8], out: &mut Vec<u8>) {
+    let bits = (usize::BITS - input.len().leading_zeros()).clamp(8, MAX_HASH_BITS);
+    finder.head.clear();
+    finder.head.resize(1 << bits, 0);
+    if best && finder.chain.len() <= WINDOW_MASK {
+        finder.chain.resize(WINDOW_MASK + 1, 0);
+    }
+
+    let mut anchor = 0;
+    let mut i = 0;
+    while i + MIN_MATCH <= input.len() {
+        let h = hash(read_u32(input, i), bits);
+        let mut best_length = 0;
+        let mut best_candidate = 0;
+
+        let mut next = finder.head[h] as usize;
+        let mut tries = if best { 32 } else { 1 };
+        while next != 0 && tries > 0 {
+            let candidate = next - 1;
+            if i - candidate > MAX_OFFSET {
+                break;
+            }
+            if read_u32(input, candidate) == read_u32(input, i) {
+                let length = match_length(input, candidate, i);
+                if length > best_length {
+                    best_length = length;
+                    best_candidate = candidate;
+                }
+            }
+            tries -= 1;
+            if !best {
+                break;
+            }
+            let previous = finder.chain[candidate & WINDOW_MASK] as usize;
+            next = if previous != 0 && previous - 1 < candidate { previous } else { 0 };
+        }
+
+        if best {
+            finder.chain[i & WINDOW_MASK] = finder.head[h];
+        }
+        finder.head[h] = (i + 1) as u32;
+
+        if best_length < MIN_MATCH {
+            // skip faster and faster through data that does not compress
+            i += if best { 1 } else { 1 + ((i - anchor) >> 6) };
+            continue;
+        }
+
+        write_sequence(out, &input[anchor..i], Some((i - best_candidate, best_length)));
+        if best {
+            for p in i + 1..(i + best_length).min(input.len().saturating_sub(MIN_MATCH - 1)) {
+                let h = hash(read_u32(input, p), bits);
+                finder.chain[p & WINDOW_MASK] = finder.head[h];
+                finder.head[h] = (p + 1) as u32;
+            }
+        }
+        i += best_length;
+        anchor = i;
+    }
+    write_sequence(out, &input[anchor..], None);
+}
+
+fn write_length(out: &mut Vec<u8>, mut length: usize) {
+    while length >= 255 {
+        out.push(255);
+        length -= 255;
+    }
+    out.push(length as u8);
+}
+
+fn write_sequence(out: &mut Vec<u8>, literals: &[u8], found: Option<(usize, usize)>) {
+    let match_length = found.map_or(0, |(_, length)| length - MIN_MATCH);
+    out.push(((literals.len().min(15) as u8) << 4) | match_length.min(15) as u8);
+    if literals.len() >= 15 {
+        write_length(out, literals.len() - 15);
+    }
+    out.extend_from_slice(literals);
+
+    if let Some((offset, _)) = found {
+        out.extend_from_slice(&(offset as u16).to_le_bytes());
+        if match_length >= 15 {
+            write_length(out, match_length - 15);
+        }
+    }
+}
+
+fn read_length(input: &[u8], i: &mut usize, mut length: usize) -> Result<usize, ErrorType> {
+    loop {
+        let byte = *input.get(*i).ok_or(ErrorType::ErrDataCorruption)?;
+        *i += 1;
+        length += byte as usize;
+        if byte != 255 {
+            return Ok(length);
+        }
+    }
+}
+
+fn decompress(input: &[u8], size: usize, out: &mut Vec<u8>) -> Result<(), ErrorType> {
+    let mut i = 0;
+    loop {
+        let token = *input.get(i).ok_or(ErrorType::ErrDataCorruption)?;
+        i += 1;
+
+        let mut literals = (token >> 4) as usize;
+        if literals == 15 {
+            literals = read_length(input, &mut i, literals)?;
+        }
+        let end = i.checked_add(literals).filter(|&end| end <= input.len()).ok_or(ErrorType::ErrDataCorruption)?;
+        if out.len() + literals > size {
+            return Err(ErrorType::ErrDataCorruption);
+        }
+        out.extend_from_slice(&input[i..end]);
+        i = end;
+
+        if i == input.len() {
+            break;
+        }
+
+        if i + 2 > input.len() {
+            return Err(ErrorType::ErrDataCorruption);
+        }
+        let offset = u16::from_le_bytes([input[i], input[i + 1]]) as usize;
+        i += 2;
+        let mut length = (token & 15) as usize;
+        if length == 15 {
+            length = read_length(input, &mut i, length)?;
+        }
+        length += MIN_MATCH;
+
+        if offset == 0 || offset > out.len() || out.len() + length > size {
+            return Err(ErrorType::ErrDataCorruption);
+        }
+        let start = out.len() - offset;
+        if offset >= length {
+            out.extend_from_within(start..start + length);
+        } else {
+            // the match repeats bytes it is itself producing
+            for k in 0..length {
+                out.push(out[start + k]);
+            }
+        }
+    }
+
+    if out.len() != size {
+        return Err(ErrorType::ErrDataCorruption);
+    }
+    Ok(())
+}
@@ -0,0 +1,263 @@
+use std::ffi::CString;
+use std::os::raw;
+use std::ptr;
+use std::sync::Arc;
+use std::sync::atomic::{AtomicBool, AtomicU64, Ordering};
+use std::thread;
+use std::time::Duration;
+
+use crate::error::{ErrorType, makeErrorNone};
+use crate::handle::HandleType;
+use crate::query::{Column, ColumnValues, MIN_TIMESTAMP, nanos_to_timespec, result_columns};
+use crate::spsc_queue::{self, Producer};
+use crate::{qdb_dedup_handle_t, qdb_error_t, qdb_handle_t, qdb_init_query_dedup, qdb_query_cont_handle_t,
+            qdb_query_continuous, qdb_query_continuous_mode_type_t_qdb_query_continuous_new_values_only,
+            qdb_query_dedup, qdb_query_dedup_prune, qdb_query_result_t, qdb_release, qdb_ts_range_t};
+
+/// ContinuousQueryConfig : Settings of a continuous query consumer.
+///    refresh_rate : how often the server is asked for new rows.
+///    dedup_window : how far behind the newest $timestamp received rows are remembered to filter duplicates,
+///        older rows are pruned from the deduplication handle on every refresh.
+///    queue_capacity : how many deltas may wait for the consumer before new ones are dropped.
+#[derive(Debug, Clone, Copy)]
+pub struct ContinuousQueryConfig {
+    pub refresh_rate: Duration,
+    pub dedup_window: Duration,
+    pub queue_capacity: usize,
+}
+
+impl Default for ContinuousQueryConfig {
+    fn default() -> Self {
+        ContinuousQueryConfig {
+            refresh_rate: Duration::from_secs(1),
+            dedup_window: Duration::from_secs(60 * 60),
+            queue_capacity: 1024,
+        }
+    }
+}
+
+/// Delta : The rows received since the previous refresh, as typed columns.
+#[derive(Debug, Clone)]
+pub struct Delta {
+    pub columns: Vec<Column>,
+    pub row_count: usize,
+}
+
+// What the query and its consumer thread share.
+struct Shared {
+    stopped: AtomicBool,
+    delivered: AtomicU64,
+    dropped: AtomicU64,
+}
+
+// Owned by the refresh callback, only ever touched by the API thread running it.
+struct Refresh {
+    shared: Arc<Shared>,
+    handle: qdb_handle_t,
+    dedup: qdb_dedup_handle_t,
+    dedup_window: i64,
+    queue: Producer<Result<Delta, ErrorType>>,
+    consumer: thread::Thread,
+    // the latest $timestamp received, the deduplication window ends there
+    newest: Option<i64>,
+}
+
+// The raw handles stay valid until the query is released, the refresh moves to the API thread with them.
+unsafe impl Send for Refresh {}
+
+/// ContinuousQuery : Delivers only the new rows of a query as they arrive on the server.
+///    Each refresh is deduplicated with qdb_query_dedup, copied into typed columns on the API thread
+///    and handed to a consumer thread through a lock-free queue, so a slow consumer never stalls refreshes.
+///    When the queue is full the delta is dropped and counted instead.
+///    The query should select $timestamp: rows are forgotten by the deduplication once they are dedup_window
+///    older than the latest one received, without it every row is remembered for the life of the query.
+pub struct ContinuousQuery {
+    shared: Arc<Shared>,
+    handle: qdb_handle_t,
+    cont_handle: qdb_query_cont_handle_t,
+    // the context of the callback, reclaimed once the refreshes stopped
+    refresh: *mut Refresh,
+    consumer: Option<thread::JoinHandle<()>>,
+}
+
+unsafe impl Send for ContinuousQuery {}
+
+impl HandleType {
+    /// ContinuousQuery : Starts a continuous query in new values only mode.
+    ///    on_delta is invoked on a dedicated thread for every non empty delta and every error.
+    ///    Updates stop when the returned ContinuousQuery is dropped.
+    pub fn continuous_query<F>(&self, query: &str, config: ContinuousQueryConfig, mut on_delta: F)
+        -> Result<ContinuousQuery, ErrorType>
+        where F: FnMut(Result<Delta, ErrorType>) + Send + 'static
+    {
+        let query = match CString::new(query) {
+            Ok(q) => q,
+            Err(_) => return Err(ErrorType::ErrInvalidArgument),
+        };
+
+        let mut dedup: qdb_dedup_handle_t = ptr::null_mut();
+        let err = unsafe { qdb_init_query_dedup(self.handle, &mut dedup) };
+        if let Some(err) = makeErrorNone(err) {
+            return Err(err);
+        }
+
+        let shared = Arc::new(Shared { stopped: AtomicBool::new(false), delivered: AtomicU64::new(0), dropped: AtomicU64::new(0) });
+        let (producer, queue) = spsc_queue::channel(config.queue_capacity);
+
+        let consumer_shared = Arc::clone(&shared);
+        let consumer = thread::spawn(move || loop {
+            while let Some(delta) = queue.pop() {
+                on_delta(delta);
+            }
+            if consumer_shared.stopped.load(Ordering::Acquire) && queue.is_empty() {
+                return;
+            }
+            thread::park();
+        });
+
+        let refresh = Box::into_raw(Box::new(Refresh {
+            shared: Arc::clone(&shared),
+            handle: self.handle,
+            dedup,
+            dedup_window: i64::try_from(config.dedup_window.as_nanos()).unwrap_or(i64::MAX),
+            queue: producer,
+            consumer: consumer.thread().clone(),
+            newest: None,
+        }));
+
+        let mut cont_handle: qdb_query_cont_handle_t = ptr::null_mut();
+        let err = unsafe {
+            qdb_query_continuous(
+                self.handle,
+                query.as_ptr(),
+                qdb_query_continuous_mode_type_t_qdb_query_continuous_new_values_only,
+                config.refresh_rate.as_millis() as raw::c_uint,
+                Some(on_refresh),
+                refresh as *mut raw::c_void,
+                &mut cont_handle,
+            )
+        };
+
+        let query = ContinuousQuery { shared, handle: self.handle, cont_handle, refresh, consumer: Some(consumer) };
+
+        match makeErrorNone(err) {
+            None => Ok(query),
+            // dropping the query stops the consumer and releases the dedup handle
+            Some(err) => Err(err),
+        }
+    }
+}
+
+impl ContinuousQuery {
+    /// Delivered : Returns the number of deltas handed to the consumer thread.
+    pub fn delivered(&self) -> u64 {
+        self.shared.delivered.load(Ordering::Relaxed)
+    }
+
+    /// Dropped : Returns the number of deltas discarded because the consumer fell behind.
+    pub fn dropped(&self) -> u64 {
+        self.shared.dropped.load(Ordering::Relaxed)
+    }
+}
+
+impl Drop for ContinuousQuery {
+    fn drop(&mut self) {
+        unsafe {
+            // stops the refreshes, no callback runs once this returns
+            if !self.cont_handle.is_null() {
+                qdb_release(self.handle, self.cont_handle as *const _);
+            }
+        }
+
+        // the producer goes with the refresh, the consumer then sees every delta pushed
+        let refresh = unsafe { Box::from_raw(self.refresh) };
+        let dedup = refresh.dedup;
+        drop(refresh);
+
+        self.shared.stopped.store(true, Ordering::Release);
+        if let Some(consumer) = self.consumer.take() {
+            consumer.thread().unpark();
+            let _ = consumer.join();
+        }
+
+        unsafe { qdb_release(self.handle, dedup as *const _) };
+    }
+}
+
+unsafe extern "C" fn on_refresh(context: *mut raw::c_void, err: qdb_error_t, result: *const qdb_query_result_t) -> raw::c_int {
+    let refresh = &mut *(context as *mut Refresh);
+
+    let delta = match makeErrorNone(err) {
+        Some(err) => Some(Err(err)),
+        None => deduplicate(refresh, result),
+    };
+
+    if let Some(delta) = delta {
+        match refresh.queue.push(delta) {
+            Ok(()) => {
+                refresh.shared.delivered.fetch_add(1, Ordering::Relaxed);
+                refresh.consumer.unpark();
+            }
+            Err(_) => {
+                refresh.shared.dropped.fetch_add(1, Ordering::Relaxed);
+            }
+        }
+    }
+
+    prune(refresh);
+
+    // keep the continuous query running
+    0
+}
+
+unsafe fn deduplicate(refresh: &mut Refresh, result: *const qdb_query_result_t) -> Option<Result<Delta, ErrorType>> {
+    if result.is_null() {
+        return None;
+    }
+
+    let mut fresh: *mut qdb_query_result_t = ptr::null_mut();
+    let err = qdb_query_dedup(refresh.dedup, result, &mut fresh);
+    if let Some(err) = makeErrorNone(err) {
+        return Some(Err(err));
+    }
+
+    let columns = result_columns(fresh);
+    if !fresh.is_null() {
+        qdb_release(refresh.handle, fresh as *const _);
+    }
+
+    // rows already seen are older than the newest of them
+    let newest = columns.iter()
+        .find(|c| c.name == "$timestamp")
+        .and_then(|c| match &c.values {
+            ColumnValues::Timestamp(values) => values.iter().flatten().max().copied(),
+            _ => None,
+        });
+    if newest > refresh.newest {
+        refresh.newest = newest;
+    }
+
+    let row_count = columns.first().map(|c| c.values.len()).unwrap_or(0);
+    if row_count == 0 {
+        return None;
+    }
+
+    Some(Ok(Delta { columns, row_count }))
+}
+
+// Forgets the rows dedup_window older than the newest one received,
+// never without a $timestamp: the API would forget every row.
+unsafe fn prune(refresh: &Refresh) {
+    let newest = match refresh.newest {
+        Some(newest) => newest,
+        None => return,
+    };
+
+    let range = qdb_ts_range_t {
+        begin: nanos_to_timespec(MIN_TIMESTAMP),
+        end: nanos_to_timespec(newest.saturating_sub(refresh.dedup_window).max(MIN_TIMESTAMP)),
+    };
+
+    // a failed prune only delays memory reclamation to the next refresh
+    let _ = qdb_query_dedup_prune(refresh.dedup, &range);
+}
@@ -0,0 +1,378 @@
+use std::cell::RefCell;
+use std::collections::HashMap;
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::{Arc, Condvar, Mutex, Weak};
+use std::thread;
+use std::time::Duration;
+
+use crate::batch::Batch;
+use crate::error::ErrorType;
+use crate::handle_pool::HandlePool;
+use crate::qdb_int_t;
+
+/// CounterConfig : Settings of a counter aggregator.
+///    flush_interval : deltas are sent at least this often, the bound on how stale a counter on the cluster is.
+///    max_pending : a thread holding deltas for that many distinct counters asks for a flush right away.
+///    batch_size : maximum number of operations sent in one qdb_run_batch.
+///    create_missing : counters that do not exist yet are created with the delta as their value.
+#[derive(Debug, Clone, Copy)]
+pub struct CounterConfig {
+    pub flush_interval: Duration,
+    pub max_pending: usize,
+    pub batch_size: usize,
+    pub create_missing: bool,
+}
+
+impl Default for CounterConfig {
+    fn default() -> Self {
+        CounterConfig { flush_interval: Duration::from_millis(100), max_pending: 4096, batch_size: 4096, create_missing: true }
+    }
+}
+
+/// CounterStats : Counters of a counter aggregator since its creation.
+///    increments : calls to add.
+///    operations : int_add, int_put, double_add and double_put operations sent to the cluster, the round trips increments were combined into.
+///    flushes : batches run.
+///    created : counters created because they did not exist.
+///    failed : operations that failed. The deltas of those the cluster asked to try again are kept for the next flush,
+///        the others are dropped: they may have been applied before the error, sending them again could count them twice.
+///    threads : threads holding deltas, those that exited are forgotten by the next flush.
+#[derive(Debug, Default, Clone, Copy, PartialEq, Eq)]
+pub struct CounterStats {
+    pub increments: u64,
+    pub operations: u64,
+    pub flushes: u64,
+    pub created: u64,
+    pub failed: u64,
+    pub threads: u64,
+}
+
+// The sum of the increments of a counter, integer and double counters are entries of different types.
+#[derive(Debug, Clone, Copy)]
+enum Delta {
+    Int(qdb_int_t),
+    Double(f64),
+}
+
+// The pending deltas by counter.
+#[derive(Default)]
+struct Deltas {
+    ints: HashMap<String, qdb_int_t>,
+    doubles: HashMap<String, f64>,
+}
+
+impl Deltas {
+    fn len(&self) -> usize {
+        self.ints.len() + self.doubles.len()
+    }
+
+    fn add(&mut self, alias: &str, delta: Delta) {
+        match delta {
+            Delta::Int(d) => match self.ints.get_mut(alias) {
+                Some(sum) => *sum = sum.wrapping_add(d),
+                None => {
+                    self.ints.insert(alias.to_string(), d);
+                }
+            },
+            Delta::Double(d) => match self.doubles.get_mut(alias) {
+                Some(sum) => *sum += d,
+                None => {
+                    self.doubles.insert(alias.to_string(), d);
+                }
+            },
+        }
+    }
+
+    // Moves every delta to into, keeping the capacity of the maps for the next interval.
+    fn drain_into(&mut self, into: &mut Deltas) {
+        for (alias, d) in self.ints.drain() {
+            let sum = into.ints.entry(alias).or_insert(0);
+            *sum = sum.wrapping_add(d);
+        }
+        for (alias, d) in self.doubles.drain() {
+            *into.doubles.entry(alias).or_insert(0.0) += d;
+        }
+    }
+
+    fn into_vec(self) -> Vec<(String, Delta)> {
+        self.ints.into_iter().filter(|(_, d)| *d != 0).map(|(a, d)| (a, Delta::Int(d)))
+            .chain(self.doubles.into_iter().filter(|(_, d)| *d != 0.0).map(|(a, d)| (a, Delta::Double(d))))
+            .collect()
+    }
+}
+
+// The deltas of one thread, only ever locked by that thread and by the flush.
+struct Local {
+    deltas: Mutex<Deltas>,
+    increments: AtomicU64,
+}
+
+struct Shared {
+    pool: HandlePool,
+    config: CounterConfig,
+    locals: Mutex<Vec<Arc<Local>>>,
+    // increments of the threads that exited
+    retired_increments: AtomicU64,
+    // deltas whose operation failed, sent again with the next flush
+    retry: Mutex<Deltas>,
+    // one flush at a time, the periodic one or an explicit one
+    flushing: Mutex<()>,
+    wake: Mutex<Wake>,
+    wakeup: Condvar,
+    operations: AtomicU64,
+    flushes: AtomicU64,
+    created: AtomicU64,
+    failed: AtomicU64,
+}
+
+#[derive(Default)]
+struct Wake {
+    requested: bool,
+    stopped: bool,
+}
+
+thread_local! {
+    // the deltas of the current thread, for every aggregator it added to
+    static LOCALS: RefCell<Vec<(Weak<Shared>, Arc<Local>)>> = const { RefCell::new(Vec::new()) };
+}
+
+/// CounterAggregator : Combines increments of integer and double counters on the client and sends them
+///    as int_add and double_add batches.
+///    Every thread adds to a map of its own, so hot counters cost a hash map update instead of a round trip.
+///    A background thread flushes every flush_interval, or sooner when a thread holds max_pending counters;
+///    the deltas left are flushed when the aggregator is dropped.
+///
+///    let counters = CounterAggregator::new(pool, CounterConfig::default());
+///    counters.add("metrics.requests", 1);
+pub struct CounterAggregator {
+    shared: Arc<Shared>,
+    flusher: Option<thread::JoinHandle<()>>,
+}
+
+impl CounterAggregator {
+    pub fn new(pool: HandlePool, config: CounterConfig) -> CounterAggregator {
+        let shared = Arc::new(Shared {
+            pool,
+            config,
+            locals: Mutex::new(Vec::new()),
+            retired_increments: AtomicU64::new(0),
+            retry: Mutex::new(Deltas::default()),
+            flushing: Mutex::new(()),
+            wake: Mutex::new(Wake::default()),
+            wakeup: Condvar::new(),
+            operations: AtomicU64::new(0),
+            flushes: AtomicU64::new(0),
+            created: AtomicU64::new(0),
+            failed: AtomicU64::new(0),
+        });
+
+        let flusher_shared = Arc::clone(&shared);
+        let flusher = thread::Builder::new()
+            .name("qdb-counters".to_string())
+            .spawn(move || flusher_shared.run())
+            .expect("failed to spawn the counter flusher");
+
+        CounterAggregator { shared, flusher: Some(flusher) }
+    }
+
+    /// Add : Adds delta to the integer counter at alias, sent to the cluster with the next flush.
+    pub fn add(&self, alias: &str, delta: qdb_int_t) {
+        self.add_delta(alias, Delta::Int(delta));
+    }
+
+    /// AddDouble : Adds delta to the double counter at alias, sent to the cluster with the next flush.
+    pub fn add_double(&self, alias: &str, delta: f64) {
+        self.add_delta(alias, Delta::Double(delta));
+    }
+
+    fn add_delta(&self, alias: &str, delta: Delta) {
+        let pending = self.with_local(|local| {
+            local.increments.fetch_add(1, Ordering::Relaxed);
+            let mut deltas = local.deltas.lock().unwrap();
+            deltas.add(alias, delta);
+            deltas.len()
+        });
+
+        // asked once, the flusher takes every delta of the thread
+        if pending == self.shared.config.max_pending {
+            let mut wake = self.shared.wake.lock().unwrap();
+            wake.requested = true;
+            self.shared.wakeup.notify_one();
+        }
+    }
+
+    /// Flush : Sends every pending delta now, returns the first error met.
+    ///    Deltas the cluster asked to try again stay pending and are sent again by the next flush,
+    ///    see CounterStats::failed for the others.
+    pub fn flush(&self) -> Option<ErrorType> {
+        self.shared.flush()
+    }
+
+    pub fn stats(&self) -> CounterStats {
+        let locals = self.shared.locals.lock().unwrap();
+        CounterStats {
+            increments: self.shared.retired_increments.load(Ordering::Relaxed)
+                + locals.iter().map(|l| l.increments.load(Ordering::Relaxed)).sum::<u64>(),
+            operations: self.shared.operations.load(Ordering::Relaxed),
+            flushes: self.shared.flushes.load(Ordering::Relaxed),
+            created: self.shared.created.load(Ordering::Relaxed),
+            failed: self.shared.failed.load(Ordering::Relaxed),
+            threads: locals.len() as u64,
+        }
+    }
+
+    // Calls f with the deltas of the current thread, registering them on first use.
+    fn with_local<R>(&self, f: impl FnOnce(&Local) -> R) -> R {
+        LOCALS.with(|locals| {
+            let mut locals = locals.borrow_mut();
+            if let Some((_, local)) = locals.iter().find(|(shared, _)| shared.as_ptr() == Arc::as_ptr(&self.shared)) {
+                return f(local);
+            }
+
+            // the entries of dropped aggregators go with the first new one
+            locals.retain(|(shared, _)| shared.strong_count() > 0);
+            let local = Arc::new(Local { deltas: Mutex::new(Deltas::default()), increments: AtomicU64::new(0) });
+            self.shared.locals.lock().unwrap().push(Arc::clone(&local));
+            let result = f(&local);
+            locals.push((Arc::downgrade(&self.shared), local));
+            result
+        })
+    }
+}
+
+impl Drop for CounterAggregator {
+    fn drop(&mut self) {
+        {
+            let mut wake = self.shared.wake.lock().unwrap();
+            wake.stopped = true;
+            self.shared.wakeup.notify_one();
+        }
+        if let Some(flusher) = self.flusher.take() {
+            let _ = flusher.join();
+        }
+        // deltas added while the flusher was stopping
+        self.shared.flush();
+    }
+}
+
+impl Shared {
+    fn run(&self) {
+        loop {
+            {
+                let wake = self.wake.lock().unwrap();
+                let (mut wake, _) = self.wakeup
+                    .wait_timeout_while(wake, self.config.flush_interval, |w| !w.requested && !w.stopped)
+                    .unwrap();
+                if wake.stopped {
+                    return;
+                }
+                wake.requested = false;
+            }
+            self.flush();
+        }
+    }
+
+    fn flush(&self) -> Option<ErrorType> {
+        let _flushing = self.flushing.lock().unwrap();
+
+        let mut deltas = std::mem::take(&mut *self.retry.lock().unwrap());
+        self.locals.lock().unwrap().retain(|local| {
+            // only held here once the thread local of an exited thread is gone, nothing is added to it anymore
+            let exited = Arc::strong_count(local) == 1;
+            local.deltas.lock().unwrap().drain_into(&mut deltas);
+            if exited {
+                self.retired_increments.fetch_add(local.increments.load(Ordering::Relaxed), Ordering::Relaxed);
+            }
+            !exited
+        });
+
+        let deltas = deltas.into_vec();
+        let mut first_error = None;
+        for part in deltas.chunks(self.config.batch_size.max(1)) {
+            if let Some(err) = self.send(part) {
+                first_error.get_or_insert(err);
+            }
+        }
+        first_error
+    }
+
+    // Sends one batch of int_add and double_add, then creates the counters that did not exist.
+    fn send(&self, deltas: &[(String, Delta)]) -> Option<ErrorType> {
+        let handle = self.pool.get();
+        let mut first_error = None;
+        let mut missing = Vec::new();
+
+        let mut batch = Batch::with_capacity(deltas.len());
+        let mut added = Vec::with_capacity(deltas.len());
+        for (alias, delta) in deltas {
+            let add = match *delta {
+                Delta::Int(d) => batch.int_add(alias, d),
+                Delta::Double(d) => batch.double_add(alias, d),
+            };
+            match add {
+                Ok(_) => added.push((alias, *delta)),
+                // an alias the API can never accept, its delta is dropped
+                Err(err) => {
+                    self.failed.fetch_add(1, Ordering::Relaxed);
+                    first_error.get_or_insert(err);
+                }
+            }
+        }
+
+        let results = batch.run(handle);
+        self.flushes.fetch_add(1, Ordering::Relaxed);
+        self.operations.fetch_add(added.len() as u64, Ordering::Relaxed);
+        for (i, (alias, delta)) in added.into_iter().enumerate() {
+            match results.error(i) {
+                None => {}
+                Some(ErrorType::ErrAliasNotFound) if self.config.create_missing => missing.push((alias, delta)),
+                Some(err) => {
+                    self.failed.fetch_add(1, Ordering::Relaxed);
+                    self.keep_if_not_applied(alias, delta, err);
+                    first_error.get_or_insert(err);
+                }
+            }
+        }
+        drop(results);
+
+        if missing.is_empty() {
+            return first_error;
+        }
+        let mut batch = Batch::with_capacity(missing.len());
+        for (alias, delta) in &missing {
+            match *delta {
+                Delta::Int(d) => batch.int_put(alias, d, 0),
+                Delta::Double(d) => batch.double_put(alias, d, 0),
+            }.expect("alias accepted by the first batch");
+        }
+        let results = batch.run(handle);
+        self.flushes.fetch_add(1, Ordering::Relaxed);
+        self.operations.fetch_add(missing.len() as u64, Ordering::Relaxed);
+        for (i, (alias, delta)) in missing.into_iter().enumerate() {
+            match results.error(i) {
+                None => {
+                    self.created.fetch_add(1, Ordering::Relaxed);
+                }
+                // created by someone else in between, added with the next flush
+                Some(ErrorType::ErrAliasAlreadyExists) => self.keep(alias, delta),
+                Some(err) => {
+                    self.failed.fetch_add(1, Ordering::Relaxed);
+                    self.keep_if_not_applied(alias, delta, err);
+                    first_error.get_or_insert(err);
+                }
+            }
+        }
+        first_error
+    }
+
+    // Keeps the delta only when the error says the operation was not applied, at most once delivery otherwise.
+    fn keep_if_not_applied(&self, alias: &str, delta: Delta, err: ErrorType) {
+        if matches!(err, ErrorType::ErrTryAgain | ErrorType::ErrUnstableCluster) {
+            self.keep(alias, delta);
+        }
+    }
+
+    fn keep(&self, alias: &str, delta: Delta) {
+        self.retry.lock().unwrap().add(alias, delta);
+    }
+}
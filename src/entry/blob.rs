@@ -0,0 +1,85 @@
+use std::os::raw;
+use std::ptr;
+
+use crate::error::{ErrorType, makeErrorNone};
+use crate::ffi_str::with_c_str;
+use crate::handle::HandleType;
+use crate::{qdb_blob_compare_and_swap, qdb_blob_get, qdb_blob_put, qdb_blob_update, qdb_error_t_qdb_e_unmatched_content,
+            qdb_release, qdb_time_t};
+
+impl HandleType {
+    /// BlobPut : Creates a blob, returns ErrAliasAlreadyExists when the alias is taken.
+    ///    expiry is an absolute time in milliseconds since epoch, or qdb_never_expires.
+    pub fn blob_put(&self, alias: &str, content: &[u8], expiry: qdb_time_t) -> Option<ErrorType> {
+        match with_c_str(alias, |alias| unsafe {
+            qdb_blob_put(self.handle, alias, content.as_ptr() as *const raw::c_void, content.len(), expiry)
+        }) {
+            Ok(err) => makeErrorNone(err),
+            Err(e) => Some(e),
+        }
+    }
+
+    /// BlobUpdate : Creates or replaces a blob.
+    ///    expiry is an absolute time in milliseconds since epoch, qdb_never_expires or qdb_preserve_expiration.
+    pub fn blob_update(&self, alias: &str, content: &[u8], expiry: qdb_time_t) -> Option<ErrorType> {
+        match with_c_str(alias, |alias| unsafe {
+            qdb_blob_update(self.handle, alias, content.as_ptr() as *const raw::c_void, content.len(), expiry)
+        }) {
+            Ok(err) => makeErrorNone(err),
+            Err(e) => Some(e),
+        }
+    }
+
+    /// BlobGet : Returns a copy of the content of a blob.
+    pub fn blob_get(&self, alias: &str) -> Result<Vec<u8>, ErrorType> {
+        self.blob_get_with(alias, |content| content.to_vec())
+    }
+
+    /// BlobGetWith : Lets read look at the content of a blob in the API buffer, released on return.
+    pub fn blob_get_with<R>(&self, alias: &str, read: impl FnOnce(&[u8]) -> R) -> Result<R, ErrorType> {
+        let mut content: *const raw::c_void = ptr::null();
+        let mut length: usize = 0;
+
+        let err = with_c_str(alias, |alias| unsafe { qdb_blob_get(self.handle, alias, &mut content, &mut length) })?;
+        if let Some(err) = makeErrorNone(err) {
+            return Err(err);
+        }
+        if content.is_null() {
+            return Ok(read(&[]));
+        }
+
+        let result = read(unsafe { std::slice::from_raw_parts(content as *const u8, length) });
+        unsafe { qdb_release(self.handle, content) };
+        Ok(result)
+    }
+
+    /// BlobCompareAndSwap : Replaces the content of a blob with content if it currently equals comparand.
+    ///    Returns None when the blob was swapped, and a copy of its current content when it did not match.
+    pub fn blob_compare_and_swap(&self, alias: &str, content: &[u8], comparand: &[u8], expiry: qdb_time_t)
+                                 -> Result<Option<Vec<u8>>, ErrorType> {
+        let mut original: *const raw::c_void = ptr::null();
+        let mut length: usize = 0;
+
+        let err = with_c_str(alias, |alias| unsafe {
+            qdb_blob_compare_and_swap(self.handle, alias, content.as_ptr() as *const raw::c_void, content.len(),
+                                      comparand.as_ptr() as *const raw::c_void, comparand.len(), expiry,
+                                      &mut original, &mut length)
+        })?;
+
+        let current = if original.is_null() {
+            Vec::new()
+        } else {
+            let current = unsafe { std::slice::from_raw_parts(original as *const u8, length).to_vec() };
+            unsafe { qdb_release(self.handle, original) };
+            current
+        };
+
+        if err == qdb_error_t_qdb_e_unmatched_content {
+            return Ok(Some(current));
+        }
+        match makeErrorNone(err) {
+            None => Ok(None),
+            Some(err) => Err(err),
+        }
+    }
+}
@@ -0,0 +1,74 @@
+use std::mem::MaybeUninit;
+
+use crate::error::{ErrorType, makeErrorNone};
+use crate::ffi_str::with_c_str;
+use crate::handle::HandleType;
+use crate::query::timespec_to_nanos;
+use crate::{qdb_entry_metadata_t, qdb_entry_type_t, qdb_expires_at, qdb_expires_from_now, qdb_get_expiry_time, qdb_get_metadata, qdb_remove,
+            qdb_time_t};
+
+/// EntryMetadata : What the cluster knows about an entry besides its content.
+///    size : content size of blobs and integers, 0 for other types.
+///    modified : last modification time, in nanoseconds since epoch.
+///    expiry : absolute expiry time in milliseconds since epoch, 0 when the entry never expires.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct EntryMetadata {
+    pub entry_type: qdb_entry_type_t,
+    pub size: u64,
+    pub modified: i64,
+    pub expiry: qdb_time_t,
+}
+
+impl HandleType {
+    /// Remove : Removes an entry of any type.
+    pub fn remove(&self, alias: &str) -> Option<ErrorType> {
+        match with_c_str(alias, |alias| unsafe { qdb_remove(self.handle, alias) }) {
+            Ok(err) => makeErrorNone(err),
+            Err(e) => Some(e),
+        }
+    }
+
+    /// ExpiresAt : Sets the absolute expiry time of a blob or an integer, in milliseconds since epoch.
+    ///    qdb_never_expires (0) removes the expiry.
+    pub fn expires_at(&self, alias: &str, expiry: qdb_time_t) -> Option<ErrorType> {
+        match with_c_str(alias, |alias| unsafe { qdb_expires_at(self.handle, alias, expiry) }) {
+            Ok(err) => makeErrorNone(err),
+            Err(e) => Some(e),
+        }
+    }
+
+    /// ExpiresFromNow : Sets the expiry time of a blob or an integer relative to now, in milliseconds.
+    pub fn expires_from_now(&self, alias: &str, delta: qdb_time_t) -> Option<ErrorType> {
+        match with_c_str(alias, |alias| unsafe { qdb_expires_from_now(self.handle, alias, delta) }) {
+            Ok(err) => makeErrorNone(err),
+            Err(e) => Some(e),
+        }
+    }
+
+    /// GetExpiryTime : Returns the absolute expiry time of an entry in milliseconds since epoch, 0 if it never expires.
+    pub fn get_expiry_time(&self, alias: &str) -> Result<qdb_time_t, ErrorType> {
+        let mut expiry: qdb_time_t = 0;
+        let err = with_c_str(alias, |alias| unsafe { qdb_get_expiry_time(self.handle, alias, &mut expiry) })?;
+
+        match makeErrorNone(err) {
+            None => Ok(expiry),
+            Some(err) => Err(err),
+        }
+    }
+
+    pub fn get_metadata(&self, alias: &str) -> Result<EntryMetadata, ErrorType> {
+        let mut metadata = MaybeUninit::<qdb_entry_metadata_t>::zeroed();
+        let err = with_c_str(alias, |alias| unsafe { qdb_get_metadata(self.handle, alias, metadata.as_mut_ptr()) })?;
+
+        if let Some(err) = makeErrorNone(err) {
+            return Err(err);
+        }
+        let metadata = unsafe { metadata.assume_init() };
+        Ok(EntryMetadata {
+            entry_type: metadata.type_,
+            size: metadata.size,
+            modified: timespec_to_nanos(&metadata.modification_time),
+            expiry: timespec_to_nanos(&metadata.expiry_time) / 1_000_000,
+        })
+    }
+}
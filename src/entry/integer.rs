@@ -0,0 +1,45 @@
+use crate::error::{ErrorType, makeErrorNone};
+use crate::ffi_str::with_c_str;
+use crate::handle::HandleType;
+use crate::{qdb_int_add, qdb_int_get, qdb_int_put, qdb_int_t, qdb_int_update, qdb_time_t};
+
+impl HandleType {
+    /// IntPut : Creates a signed 64-bit integer, returns ErrAliasAlreadyExists when the alias is taken.
+    ///    expiry is an absolute time in milliseconds since epoch, or qdb_never_expires.
+    pub fn int_put(&self, alias: &str, value: qdb_int_t, expiry: qdb_time_t) -> Option<ErrorType> {
+        match with_c_str(alias, |alias| unsafe { qdb_int_put(self.handle, alias, value, expiry) }) {
+            Ok(err) => makeErrorNone(err),
+            Err(e) => Some(e),
+        }
+    }
+
+    /// IntUpdate : Creates or replaces a signed 64-bit integer.
+    ///    expiry is an absolute time in milliseconds since epoch, qdb_never_expires or qdb_preserve_expiration.
+    pub fn int_update(&self, alias: &str, value: qdb_int_t, expiry: qdb_time_t) -> Option<ErrorType> {
+        match with_c_str(alias, |alias| unsafe { qdb_int_update(self.handle, alias, value, expiry) }) {
+            Ok(err) => makeErrorNone(err),
+            Err(e) => Some(e),
+        }
+    }
+
+    pub fn int_get(&self, alias: &str) -> Result<qdb_int_t, ErrorType> {
+        let mut value: qdb_int_t = 0;
+        let err = with_c_str(alias, |alias| unsafe { qdb_int_get(self.handle, alias, &mut value) })?;
+
+        match makeErrorNone(err) {
+            None => Ok(value),
+            Some(err) => Err(err),
+        }
+    }
+
+    /// IntAdd : Atomically adds addend to an existing integer and returns the new value.
+    pub fn int_add(&self, alias: &str, addend: qdb_int_t) -> Result<qdb_int_t, ErrorType> {
+        let mut value: qdb_int_t = 0;
+        let err = with_c_str(alias, |alias| unsafe { qdb_int_add(self.handle, alias, addend, &mut value) })?;
+
+        match makeErrorNone(err) {
+            None => Ok(value),
+            Some(err) => Err(err),
+        }
+    }
+}
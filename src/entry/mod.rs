@@ -0,0 +1,7 @@
+pub mod timeseries;
+pub mod ts_batch;
+pub mod ts_view;
+pub mod blob;
+pub mod integer;
+pub mod common;
+pub mod multi_get;
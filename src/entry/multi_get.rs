@@ -0,0 +1,121 @@
+use crate::batch::{Batch, EntryValue};
+use crate::error::ErrorType;
+use crate::handle::HandleType;
+use crate::{qdb_entry_type_t, qdb_entry_type_t_qdb_entry_blob, qdb_entry_type_t_qdb_entry_double,
+            qdb_entry_type_t_qdb_entry_integer, qdb_entry_type_t_qdb_entry_timestamp,
+            qdb_entry_type_t_qdb_entry_uninitialized, qdb_error_t, qdb_int_t};
+
+/// MULTI_GET_BATCH : Number of aliases sent in one value_get batch, bounds the API buffers held at once.
+pub const MULTI_GET_BATCH: usize = 1024;
+
+// One entry of the table: its type, or the error met, and where its content is in the arena or its value:
+// an integer, the bits of a double or a timestamp in nanoseconds.
+#[derive(Debug, Clone, Copy)]
+struct Slot {
+    error: qdb_error_t,
+    entry_type: qdb_entry_type_t,
+    value: i64,
+    size: usize,
+}
+
+/// MultiGet : The entries read by multi_get, by the index of their alias.
+///    A slot of 24 bytes per entry and one arena holding the content of every blob, the API buffers are
+///    released once copied, so the table owns everything and can be sent to another thread.
+#[derive(Debug, Clone, Default)]
+pub struct MultiGet {
+    slots: Vec<Slot>,
+    arena: Vec<u8>,
+}
+
+impl MultiGet {
+    pub fn len(&self) -> usize {
+        self.slots.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.slots.is_empty()
+    }
+
+    /// Found : Returns the number of entries read without error.
+    pub fn found(&self) -> usize {
+        self.slots.iter().filter(|s| s.error == 0).count()
+    }
+
+    /// EntryType : Returns the type of entry i, qdb_entry_uninitialized when it could not be read.
+    pub fn entry_type(&self, i: usize) -> qdb_entry_type_t {
+        self.slots[i].entry_type
+    }
+
+    /// Get : Returns the value of entry i, or the error its read met, ErrAliasNotFound for instance.
+    pub fn get(&self, i: usize) -> Result<EntryValue<'_>, ErrorType> {
+        let slot = &self.slots[i];
+        if slot.error != 0 {
+            return Err(ErrorType::from_qdb_error_origin_t(slot.error));
+        }
+        Ok(match slot.entry_type {
+            t if t == qdb_entry_type_t_qdb_entry_blob => {
+                EntryValue::Blob(&self.arena[slot.value as usize..slot.value as usize + slot.size])
+            }
+            t if t == qdb_entry_type_t_qdb_entry_integer => EntryValue::Integer(slot.value as qdb_int_t),
+            t if t == qdb_entry_type_t_qdb_entry_double => EntryValue::Double(f64::from_bits(slot.value as u64)),
+            t if t == qdb_entry_type_t_qdb_entry_timestamp => EntryValue::Timestamp(slot.value),
+            t => EntryValue::Other(t),
+        })
+    }
+
+    pub fn iter(&self) -> impl ExactSizeIterator<Item=Result<EntryValue<'_>, ErrorType>> + '_ {
+        (0..self.slots.len()).map(|i| self.get(i))
+    }
+
+    fn push(&mut self, value: Result<EntryValue<'_>, ErrorType>) {
+        let slot = match value {
+            Ok(EntryValue::Blob(content)) => {
+                let offset = self.arena.len();
+                self.arena.extend_from_slice(content);
+                Slot { error: 0, entry_type: qdb_entry_type_t_qdb_entry_blob, value: offset as i64, size: content.len() }
+            }
+            Ok(EntryValue::Integer(v)) => Slot { error: 0, entry_type: qdb_entry_type_t_qdb_entry_integer, value: v, size: 0 },
+            Ok(EntryValue::Double(v)) => {
+                Slot { error: 0, entry_type: qdb_entry_type_t_qdb_entry_double, value: v.to_bits() as i64, size: 0 }
+            }
+            Ok(EntryValue::Timestamp(v)) => Slot { error: 0, entry_type: qdb_entry_type_t_qdb_entry_timestamp, value: v, size: 0 },
+            Ok(EntryValue::Other(t)) => Slot { error: 0, entry_type: t, value: 0, size: 0 },
+            Err(err) => Slot { error: err as qdb_error_t, entry_type: qdb_entry_type_t_qdb_entry_uninitialized, value: 0, size: 0 },
+        };
+        self.slots.push(slot);
+    }
+}
+
+impl HandleType {
+    /// MultiGet : Reads entries of any type with value_get batches of MULTI_GET_BATCH aliases,
+    ///    instead of a get_type call followed by a typed get for every entry.
+    ///    An entry that cannot be read only fails its own slot, the error of the call is for the whole request.
+    pub fn multi_get<S: AsRef<str>>(&self, aliases: &[S]) -> Result<MultiGet, ErrorType> {
+        let mut table = MultiGet { slots: Vec::with_capacity(aliases.len()), arena: Vec::new() };
+        let mut batch = Batch::with_capacity(aliases.len().min(MULTI_GET_BATCH));
+
+        for part in aliases.chunks(MULTI_GET_BATCH) {
+            batch.clear();
+            for alias in part {
+                batch.value_get(alias.as_ref())?;
+            }
+
+            let results = batch.run(self);
+            if results.succeeded() == 0 {
+                // the whole request failed, not the entries one by one
+                if let Some(err) = results.error(0).filter(|e| !is_entry_error(*e)) {
+                    return Err(err);
+                }
+            }
+            for i in 0..part.len() {
+                table.push(results.value(i));
+            }
+        }
+        Ok(table)
+    }
+}
+
+fn is_entry_error(err: ErrorType) -> bool {
+    matches!(err, ErrorType::ErrAliasNotFound | ErrorType::ErrIncompatibleType | ErrorType::ErrReservedAlias
+                  | ErrorType::ErrInvalidArgument | ErrorType::ErrAliasTooLong)
+}
@@ -0,0 +1,60 @@
+use std::ffi::CString;
+use std::ptr;
+
+use crate::entry::ts_view::raw_ranges;
+use crate::error::{ErrorType, makeErrorNone};
+use crate::ffi_str::with_c_str;
+use crate::handle::HandleType;
+use crate::{qdb_release, qdb_ts_erase_ranges, qdb_ts_expire_by_size, qdb_ts_get_metadata, qdb_ts_metadata_t, qdb_uint_t};
+
+impl HandleType {
+    /// TsShardSize : Returns the shard size of a time series, in milliseconds.
+    ///    Rows of a time series are stored in buckets of this duration.
+    pub fn ts_shard_size(&self, alias: &str) -> Result<u64, ErrorType> {
+        let alias = match CString::new(alias) {
+            Ok(a) => a,
+            Err(_) => return Err(ErrorType::ErrInvalidArgument),
+        };
+
+        unsafe {
+            let mut metadata: *mut qdb_ts_metadata_t = ptr::null_mut();
+            let err = qdb_ts_get_metadata(self.handle, alias.as_ptr(), &mut metadata);
+
+            if let Some(err) = makeErrorNone(err) {
+                return Err(err);
+            }
+
+            let shard_size = match metadata.as_ref() {
+                Some(m) => m.shard_size,
+                None => return Err(ErrorType::ErrInvalidReply),
+            };
+
+            qdb_release(self.handle, metadata as *const _);
+
+            Ok(shard_size)
+        }
+    }
+
+    /// TsEraseRanges : Erases the points of a column in the given [begin, end) ranges, in nanoseconds since epoch.
+    ///    Returns the number of points erased.
+    pub fn ts_erase_ranges(&self, alias: &str, column: &str, ranges: &[(i64, i64)]) -> Result<u64, ErrorType> {
+        let ranges = raw_ranges(ranges);
+        let mut erased: qdb_uint_t = 0;
+        let err = with_c_str(alias, |alias| with_c_str(column, |column| unsafe {
+            qdb_ts_erase_ranges(self.handle, alias, column, ranges.as_ptr(), ranges.len(), &mut erased)
+        }))??;
+
+        match makeErrorNone(err) {
+            None => Ok(erased),
+            Some(err) => Err(err),
+        }
+    }
+
+    /// TsExpireBySize : Erases the oldest shards of a time series until it uses about size bytes on disk.
+    pub fn ts_expire_by_size(&self, alias: &str, size: u64) -> Option<ErrorType> {
+        match with_c_str(alias, |alias| unsafe { qdb_ts_expire_by_size(self.handle, alias, size) }) {
+            Ok(err) => makeErrorNone(err),
+            Err(e) => Some(e),
+        }
+    }
+}
@@ -0,0 +1,272 @@
+use std::borrow::Cow;
+use std::marker::PhantomData;
+use std::os::raw;
+use std::ptr;
+
+use crate::error::{ErrorType, makeErrorNone};
+use crate::handle::HandleType;
+use crate::query::nanos_to_timespec;
+use crate::{qdb_blob_t, qdb_exp_batch_push, qdb_exp_batch_push_column_t, qdb_exp_batch_push_column_t__bindgen_ty_1,
+            qdb_exp_batch_push_mode_t, qdb_exp_batch_push_mode_t_qdb_exp_batch_push_async,
+            qdb_exp_batch_push_mode_t_qdb_exp_batch_push_fast, qdb_exp_batch_push_mode_t_qdb_exp_batch_push_transactional,
+            qdb_exp_batch_push_mode_t_qdb_exp_batch_push_truncate, qdb_exp_batch_push_options_t,
+            qdb_exp_batch_push_options_t_qdb_exp_batch_option_standard, qdb_exp_batch_push_options_t_qdb_exp_batch_option_unique,
+            qdb_exp_batch_push_options_t_qdb_exp_batch_option_unique_upsert, qdb_exp_batch_push_table_data_t,
+            qdb_exp_batch_push_table_t, qdb_string_t, qdb_timespec_t, qdb_ts_column_type_t,
+            qdb_ts_column_type_t_qdb_ts_column_blob, qdb_ts_column_type_t_qdb_ts_column_double,
+            qdb_ts_column_type_t_qdb_ts_column_int64, qdb_ts_column_type_t_qdb_ts_column_string,
+            qdb_ts_column_type_t_qdb_ts_column_timestamp, qdb_ts_range_t};
+
+/// PushMode : How qdb_exp_batch_push writes the tables.
+///    Transactional : all tables are written in a single transaction.
+///    Truncate : like Transactional, the truncate ranges of every table are erased first.
+///    Fast : buckets are updated in place, faster for small incremental writes but not rolled back on failure.
+///    Async : like Fast, applied by the server after the call returns.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum PushMode {
+    Transactional,
+    Truncate,
+    Fast,
+    Async,
+}
+
+impl PushMode {
+    fn raw(&self) -> qdb_exp_batch_push_mode_t {
+        match self {
+            PushMode::Transactional => qdb_exp_batch_push_mode_t_qdb_exp_batch_push_transactional,
+            PushMode::Truncate => qdb_exp_batch_push_mode_t_qdb_exp_batch_push_truncate,
+            PushMode::Fast => qdb_exp_batch_push_mode_t_qdb_exp_batch_push_fast,
+            PushMode::Async => qdb_exp_batch_push_mode_t_qdb_exp_batch_push_async,
+        }
+    }
+}
+
+/// Deduplicate : What the server does with rows already present in the table.
+///    The columns compared are those named, or all of them when the list is empty.
+///    Ignored in Truncate mode.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub enum Deduplicate<'a> {
+    Keep,
+    Drop(Vec<&'a str>),
+    Upsert(Vec<&'a str>),
+}
+
+/// ColumnData : The values of a column, borrowed from the caller and handed to the API as they are.
+///    String and blob columns are added with string_column and blob_column.
+#[derive(Debug, Clone)]
+pub enum ColumnData<'a> {
+    Double(&'a [f64]),
+    Int64(&'a [i64]),
+    Timestamp(&'a [qdb_timespec_t]),
+}
+
+impl ColumnData<'_> {
+    pub fn len(&self) -> usize {
+        match self {
+            ColumnData::Double(v) => v.len(),
+            ColumnData::Int64(v) => v.len(),
+            ColumnData::Timestamp(v) => v.len(),
+        }
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+}
+
+// A column as the API reads it. Strings and blobs are pointer and length pairs, one per value,
+// pointing into values borrowed for 'a: only string_column and blob_column build them.
+#[derive(Debug, Clone)]
+enum RawColumn<'a> {
+    Data(ColumnData<'a>),
+    String(Vec<qdb_string_t>, PhantomData<&'a str>),
+    Blob(Vec<qdb_blob_t>, PhantomData<&'a [u8]>),
+}
+
+impl RawColumn<'_> {
+    fn len(&self) -> usize {
+        match self {
+            RawColumn::Data(d) => d.len(),
+            RawColumn::String(v, _) => v.len(),
+            RawColumn::Blob(v, _) => v.len(),
+        }
+    }
+
+    fn column_type(&self) -> qdb_ts_column_type_t {
+        match self {
+            RawColumn::Data(ColumnData::Double(_)) => qdb_ts_column_type_t_qdb_ts_column_double,
+            RawColumn::Data(ColumnData::Int64(_)) => qdb_ts_column_type_t_qdb_ts_column_int64,
+            RawColumn::Data(ColumnData::Timestamp(_)) => qdb_ts_column_type_t_qdb_ts_column_timestamp,
+            RawColumn::String(..) => qdb_ts_column_type_t_qdb_ts_column_string,
+            RawColumn::Blob(..) => qdb_ts_column_type_t_qdb_ts_column_blob,
+        }
+    }
+
+    fn raw(&self) -> qdb_exp_batch_push_column_t__bindgen_ty_1 {
+        match self {
+            RawColumn::Data(ColumnData::Double(v)) => qdb_exp_batch_push_column_t__bindgen_ty_1 { doubles: v.as_ptr() },
+            RawColumn::Data(ColumnData::Int64(v)) => qdb_exp_batch_push_column_t__bindgen_ty_1 { ints: v.as_ptr() },
+            RawColumn::Data(ColumnData::Timestamp(v)) => qdb_exp_batch_push_column_t__bindgen_ty_1 { timestamps: v.as_ptr() },
+            RawColumn::String(v, _) => qdb_exp_batch_push_column_t__bindgen_ty_1 { strings: v.as_ptr() },
+            RawColumn::Blob(v, _) => qdb_exp_batch_push_column_t__bindgen_ty_1 { blobs: v.as_ptr() },
+        }
+    }
+}
+
+fn string_ref(s: &str) -> qdb_string_t {
+    qdb_string_t { data: s.as_ptr() as *const raw::c_char, length: s.len() }
+}
+
+/// TsBatchTable : The rows of one table for HandleType::ts_batch_push, column by column.
+///    Every column has one value per timestamp. Names and values are borrowed and handed
+///    to the API as they are, only the column descriptors are built at push time.
+///    Missing values are written as NaN for doubles and qdb_int64_undefined for integers.
+///
+///    let table = TsBatchTable::new("btc", &timestamps)
+///        .double_column("price", &prices)?
+///        .int64_column("volume", &volumes)?;
+///    handle.ts_batch_push(PushMode::Fast, &[table]);
+#[derive(Debug, Clone)]
+pub struct TsBatchTable<'a> {
+    name: &'a str,
+    timestamps: Cow<'a, [qdb_timespec_t]>,
+    columns: Vec<(&'a str, RawColumn<'a>)>,
+    truncate_ranges: Vec<qdb_ts_range_t>,
+    deduplicate: Deduplicate<'a>,
+}
+
+impl<'a> TsBatchTable<'a> {
+    /// New : A table whose rows have the given timestamps, borrowed as is.
+    pub fn new(name: &'a str, timestamps: &'a [qdb_timespec_t]) -> TsBatchTable<'a> {
+        TsBatchTable {
+            name,
+            timestamps: Cow::Borrowed(timestamps),
+            columns: Vec::new(),
+            truncate_ranges: Vec::new(),
+            deduplicate: Deduplicate::Keep,
+        }
+    }
+
+    /// FromNanos : A table whose rows have the given timestamps in nanoseconds since epoch.
+    ///    The API reads timestamps as timespecs, they are converted once here.
+    pub fn from_nanos(name: &'a str, timestamps: &[i64]) -> TsBatchTable<'a> {
+        let mut table = TsBatchTable::new(name, &[]);
+        table.timestamps = Cow::Owned(timestamps.iter().map(|t| nanos_to_timespec(*t)).collect());
+        table
+    }
+
+    pub fn name(&self) -> &str {
+        self.name
+    }
+
+    pub fn row_count(&self) -> usize {
+        self.timestamps.len()
+    }
+
+    pub fn column_count(&self) -> usize {
+        self.columns.len()
+    }
+
+    /// Column : Adds a column, returns ErrInvalidArgument when it does not have one value per row.
+    pub fn column(self, name: &'a str, data: ColumnData<'a>) -> Result<TsBatchTable<'a>, ErrorType> {
+        self.push_column(name, RawColumn::Data(data))
+    }
+
+    fn push_column(mut self, name: &'a str, column: RawColumn<'a>) -> Result<TsBatchTable<'a>, ErrorType> {
+        if column.len() != self.timestamps.len() {
+            return Err(ErrorType::ErrInvalidArgument);
+        }
+        self.columns.push((name, column));
+        Ok(self)
+    }
+
+    pub fn double_column(self, name: &'a str, values: &'a [f64]) -> Result<TsBatchTable<'a>, ErrorType> {
+        self.column(name, ColumnData::Double(values))
+    }
+
+    pub fn int64_column(self, name: &'a str, values: &'a [i64]) -> Result<TsBatchTable<'a>, ErrorType> {
+        self.column(name, ColumnData::Int64(values))
+    }
+
+    pub fn timestamp_column(self, name: &'a str, values: &'a [qdb_timespec_t]) -> Result<TsBatchTable<'a>, ErrorType> {
+        self.column(name, ColumnData::Timestamp(values))
+    }
+
+    /// StringColumn : Adds a column of strings, their contents are read in place by the API at push time.
+    pub fn string_column<S: AsRef<str>>(self, name: &'a str, values: &'a [S]) -> Result<TsBatchTable<'a>, ErrorType> {
+        let strings = values.iter().map(|s| string_ref(s.as_ref())).collect();
+        self.push_column(name, RawColumn::String(strings, PhantomData))
+    }
+
+    /// BlobColumn : Adds a column of blobs, their contents are read in place by the API at push time.
+    pub fn blob_column<B: AsRef<[u8]>>(self, name: &'a str, values: &'a [B]) -> Result<TsBatchTable<'a>, ErrorType> {
+        let blobs = values.iter()
+            .map(|b| qdb_blob_t { content: b.as_ref().as_ptr() as *const raw::c_void, content_length: b.as_ref().len() })
+            .collect();
+        self.push_column(name, RawColumn::Blob(blobs, PhantomData))
+    }
+
+    /// Truncate : Erases [begin, end), in nanoseconds since epoch, before writing the rows.
+    ///    Only used in Truncate mode.
+    pub fn truncate(mut self, begin: i64, end: i64) -> TsBatchTable<'a> {
+        self.truncate_ranges.push(qdb_ts_range_t { begin: nanos_to_timespec(begin), end: nanos_to_timespec(end) });
+        self
+    }
+
+    pub fn deduplicate(mut self, deduplicate: Deduplicate<'a>) -> TsBatchTable<'a> {
+        self.deduplicate = deduplicate;
+        self
+    }
+
+    fn options(&self) -> (qdb_exp_batch_push_options_t, &[&'a str]) {
+        match &self.deduplicate {
+            Deduplicate::Keep => (qdb_exp_batch_push_options_t_qdb_exp_batch_option_standard, &[]),
+            Deduplicate::Drop(columns) => (qdb_exp_batch_push_options_t_qdb_exp_batch_option_unique, columns),
+            Deduplicate::Upsert(columns) => (qdb_exp_batch_push_options_t_qdb_exp_batch_option_unique_upsert, columns),
+        }
+    }
+}
+
+impl HandleType {
+    /// TsBatchPush : Writes the rows of every table in a single call, see PushMode for the ways it can be done.
+    ///    The tables and their columns must exist. Waits first while a memory governor on the handle holds its gate closed.
+    pub fn ts_batch_push(&self, mode: PushMode, tables: &[TsBatchTable]) -> Option<ErrorType> {
+        if tables.is_empty() {
+            return None;
+        }
+
+        // descriptors only, the API reads names and values from the caller's buffers
+        let columns: Vec<Vec<qdb_exp_batch_push_column_t>> = tables.iter()
+            .map(|t| t.columns.iter()
+                .map(|(name, data)| qdb_exp_batch_push_column_t { name: string_ref(name), data_type: data.column_type(), data: data.raw() })
+                .collect())
+            .collect();
+        let mut where_duplicate: Vec<Vec<qdb_string_t>> = tables.iter()
+            .map(|t| t.options().1.iter().map(|c| string_ref(c)).collect())
+            .collect();
+
+        let raw_tables: Vec<qdb_exp_batch_push_table_t> = tables.iter().zip(columns.iter()).zip(where_duplicate.iter_mut())
+            .map(|((t, c), w)| qdb_exp_batch_push_table_t {
+                name: string_ref(t.name),
+                data: qdb_exp_batch_push_table_data_t {
+                    row_count: t.row_count(),
+                    column_count: c.len(),
+                    timestamps: t.timestamps.as_ptr(),
+                    columns: c.as_ptr(),
+                },
+                truncate_ranges: if t.truncate_ranges.is_empty() { ptr::null() } else { t.truncate_ranges.as_ptr() },
+                truncate_range_count: t.truncate_ranges.len(),
+                options: t.options().0,
+                where_duplicate: if w.is_empty() { ptr::null_mut() } else { w.as_mut_ptr() },
+                where_duplicate_count: w.len(),
+            })
+            .collect();
+
+        self.admit_memory();
+        unsafe {
+            // no schemas, the server looks the tables up
+            let err = qdb_exp_batch_push(self.handle, mode.raw(), raw_tables.as_ptr(), ptr::null_mut(), raw_tables.len());
+            makeErrorNone(err)
+        }
+    }
+}
@@ -0,0 +1,214 @@
+use std::fmt;
+use std::ops::Deref;
+use std::os::raw::c_char;
+use std::ptr;
+
+use crate::error::{ErrorType, makeErrorNone};
+use crate::ffi_str::with_c_str;
+use crate::handle::HandleType;
+use crate::query::{nanos_to_timespec, timespec_to_nanos};
+use crate::{qdb_error_t, qdb_error_t_qdb_e_buffer_too_small, qdb_handle_t, qdb_int_t, qdb_release, qdb_size_t, qdb_timespec_t,
+            qdb_ts_double_get_ranges, qdb_ts_double_get_ranges_no_copy, qdb_ts_double_point, qdb_ts_int64_get_ranges,
+            qdb_ts_int64_get_ranges_no_copy, qdb_ts_int64_point, qdb_ts_range_t};
+
+/// TsPoint : A point type of a time series column, and the API calls that read it.
+pub trait TsPoint: Copy {
+    type Value: Copy;
+
+    fn timespec(&self) -> &qdb_timespec_t;
+
+    fn value(&self) -> Self::Value;
+
+    /// GetRanges : Reads the points into a buffer allocated by the API.
+    ///
+    /// # Safety
+    ///    The pointers must be valid for the call, as for qdb_ts_double_get_ranges.
+    unsafe fn get_ranges(handle: qdb_handle_t, alias: *const c_char, column: *const c_char,
+                         ranges: *const qdb_ts_range_t, range_count: qdb_size_t,
+                         points: *mut *mut Self, point_count: *mut qdb_size_t) -> qdb_error_t;
+
+    /// GetRangesNoCopy : Reads the points into a buffer of *point_count points allocated by the caller.
+    ///
+    /// # Safety
+    ///    The pointers must be valid for the call, as for qdb_ts_double_get_ranges_no_copy.
+    unsafe fn get_ranges_no_copy(handle: qdb_handle_t, alias: *const c_char, column: *const c_char,
+                                 ranges: *const qdb_ts_range_t, range_count: qdb_size_t,
+                                 points: *mut Self, point_count: *mut qdb_size_t) -> qdb_error_t;
+}
+
+impl TsPoint for qdb_ts_double_point {
+    type Value = f64;
+
+    fn timespec(&self) -> &qdb_timespec_t {
+        &self.timestamp
+    }
+
+    fn value(&self) -> f64 {
+        self.value
+    }
+
+    unsafe fn get_ranges(handle: qdb_handle_t, alias: *const c_char, column: *const c_char,
+                         ranges: *const qdb_ts_range_t, range_count: qdb_size_t,
+                         points: *mut *mut Self, point_count: *mut qdb_size_t) -> qdb_error_t {
+        qdb_ts_double_get_ranges(handle, alias, column, ranges, range_count, points, point_count)
+    }
+
+    unsafe fn get_ranges_no_copy(handle: qdb_handle_t, alias: *const c_char, column: *const c_char,
+                                 ranges: *const qdb_ts_range_t, range_count: qdb_size_t,
+                                 points: *mut Self, point_count: *mut qdb_size_t) -> qdb_error_t {
+        qdb_ts_double_get_ranges_no_copy(handle, alias, column, ranges, range_count, points, point_count)
+    }
+}
+
+impl TsPoint for qdb_ts_int64_point {
+    type Value = qdb_int_t;
+
+    fn timespec(&self) -> &qdb_timespec_t {
+        &self.timestamp
+    }
+
+    fn value(&self) -> qdb_int_t {
+        self.value
+    }
+
+    unsafe fn get_ranges(handle: qdb_handle_t, alias: *const c_char, column: *const c_char,
+                         ranges: *const qdb_ts_range_t, range_count: qdb_size_t,
+                         points: *mut *mut Self, point_count: *mut qdb_size_t) -> qdb_error_t {
+        qdb_ts_int64_get_ranges(handle, alias, column, ranges, range_count, points, point_count)
+    }
+
+    unsafe fn get_ranges_no_copy(handle: qdb_handle_t, alias: *const c_char, column: *const c_char,
+                                 ranges: *const qdb_ts_range_t, range_count: qdb_size_t,
+                                 points: *mut Self, point_count: *mut qdb_size_t) -> qdb_error_t {
+        qdb_ts_int64_get_ranges_no_copy(handle, alias, column, ranges, range_count, points, point_count)
+    }
+}
+
+/// TsView : Points of a time series column returned by the API, read in place.
+///    Derefs to a slice of points, the API buffer is released when the view is dropped.
+///    Use to_vec to keep the points beyond the view.
+///
+///    let view = handle.ts_double_get_ranges("btc", "price", &[(begin, end)])?;
+///    let mean = view.values().sum::<f64>() / view.len() as f64;
+pub struct TsView<'h, P: TsPoint> {
+    handle: &'h HandleType,
+    points: *mut P,
+    count: usize,
+}
+
+// The API buffer is owned by the view and only read.
+unsafe impl<P: TsPoint + Send> Send for TsView<'_, P> {}
+unsafe impl<P: TsPoint + Sync> Sync for TsView<'_, P> {}
+
+impl<'h, P: TsPoint> TsView<'h, P> {
+    /// FromApi : Takes ownership of an API buffer of count points.
+    ///
+    /// # Safety
+    ///    points must be null or an array of count points allocated by the API for handle.
+    pub unsafe fn from_api(handle: &'h HandleType, points: *mut P, count: usize) -> TsView<'h, P> {
+        TsView { handle, points, count: if points.is_null() { 0 } else { count } }
+    }
+
+    /// Timestamps : The timestamp of every point, in nanoseconds since epoch.
+    pub fn timestamps(&self) -> impl ExactSizeIterator<Item=i64> + '_ {
+        self.iter().map(|p| timespec_to_nanos(p.timespec()))
+    }
+
+    pub fn timespecs(&self) -> impl ExactSizeIterator<Item=&qdb_timespec_t> + '_ {
+        self.iter().map(|p| p.timespec())
+    }
+
+    pub fn values(&self) -> impl ExactSizeIterator<Item=P::Value> + '_ {
+        self.iter().map(|p| p.value())
+    }
+}
+
+impl<P: TsPoint> Deref for TsView<'_, P> {
+    type Target = [P];
+
+    fn deref(&self) -> &[P] {
+        if self.points.is_null() {
+            return &[];
+        }
+        unsafe { std::slice::from_raw_parts(self.points, self.count) }
+    }
+}
+
+impl<P: TsPoint> fmt::Debug for TsView<'_, P> where P::Value: fmt::Debug {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        f.debug_list().entries(self.timestamps().zip(self.values())).finish()
+    }
+}
+
+impl<P: TsPoint> Drop for TsView<'_, P> {
+    fn drop(&mut self) {
+        if !self.points.is_null() {
+            unsafe { qdb_release(self.handle.handle, self.points as *const _) };
+            self.points = ptr::null_mut();
+        }
+    }
+}
+
+pub(crate) fn raw_ranges(ranges: &[(i64, i64)]) -> Vec<qdb_ts_range_t> {
+    ranges.iter().map(|(b, e)| qdb_ts_range_t { begin: nanos_to_timespec(*b), end: nanos_to_timespec(*e) }).collect()
+}
+
+impl HandleType {
+    /// TsGetRanges : Returns the points of a column in the given [begin, end) ranges, in nanoseconds since epoch.
+    ///    The points are not copied out of the API buffer, see TsView.
+    ///    Waits first while a memory governor on the handle holds its gate closed.
+    pub fn ts_get_ranges<P: TsPoint>(&self, alias: &str, column: &str, ranges: &[(i64, i64)]) -> Result<TsView<'_, P>, ErrorType> {
+        self.admit_memory();
+        let ranges = raw_ranges(ranges);
+        let mut points: *mut P = ptr::null_mut();
+        let mut count: qdb_size_t = 0;
+
+        let err = with_c_str(alias, |alias| with_c_str(column, |column| unsafe {
+            P::get_ranges(self.handle, alias, column, ranges.as_ptr(), ranges.len(), &mut points, &mut count)
+        }))??;
+
+        match makeErrorNone(err) {
+            Some(err) => Err(err),
+            None => Ok(unsafe { TsView::from_api(self, points, count) }),
+        }
+    }
+
+    pub fn ts_double_get_ranges(&self, alias: &str, column: &str, ranges: &[(i64, i64)]) -> Result<TsView<'_, qdb_ts_double_point>, ErrorType> {
+        self.ts_get_ranges(alias, column, ranges)
+    }
+
+    pub fn ts_int64_get_ranges(&self, alias: &str, column: &str, ranges: &[(i64, i64)]) -> Result<TsView<'_, qdb_ts_int64_point>, ErrorType> {
+        self.ts_get_ranges(alias, column, ranges)
+    }
+
+    /// TsGetRangesInto : Like ts_get_ranges, but the API writes the points to the given vector.
+    ///    The vector is cleared and grown when it is too small, keep it across calls to read
+    ///    many ranges without allocating.
+    pub fn ts_get_ranges_into<P: TsPoint>(&self, alias: &str, column: &str, ranges: &[(i64, i64)], points: &mut Vec<P>) -> Option<ErrorType> {
+        self.admit_memory();
+        let ranges = raw_ranges(ranges);
+        points.clear();
+
+        let read = with_c_str(alias, |alias| with_c_str(column, |column| loop {
+            let mut count: qdb_size_t = points.capacity();
+            let err = unsafe {
+                P::get_ranges_no_copy(self.handle, alias, column, ranges.as_ptr(), ranges.len(), points.as_mut_ptr(), &mut count)
+            };
+            if err == qdb_error_t_qdb_e_buffer_too_small {
+                // count is the size needed, the column may still grow before the next call
+                points.reserve(count);
+                continue;
+            }
+            let err = makeErrorNone(err);
+            if err.is_none() {
+                unsafe { points.set_len(count) };
+            }
+            return err;
+        }));
+
+        match read {
+            Ok(Ok(err)) => err,
+            Ok(Err(err)) | Err(err) => Some(err),
+        }
+    }
+}
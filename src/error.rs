@@ -117,7 +117,7 @@ impl fmt::Display for ErrorType {
 
 
 #[repr(i32)]
-#[derive(Debug)]
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
 pub enum ErrorType {
     // We need this as a catch-all for (future) error codes that we don't know how to handle.
     #[doc = "! Catch-all for (future) error codes."]
@@ -0,0 +1,337 @@
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::{Arc, Condvar, Mutex};
+use std::thread;
+use std::time::{Duration, Instant, SystemTime, UNIX_EPOCH};
+
+use crate::error::ErrorType;
+use crate::handle::HandleType;
+use crate::handle_pool::HandlePool;
+use crate::query::MIN_TIMESTAMP;
+use crate::qdb_time_t;
+
+/// Expiry : When entries expire.
+///    At : absolute time in milliseconds since epoch.
+///    FromNow : relative to the time the cluster receives the request, immune to the skew of the client clock.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum Expiry {
+    Never,
+    At(qdb_time_t),
+    FromNow(Duration),
+}
+
+impl Expiry {
+    fn apply(&self, handle: &HandleType, alias: &str) -> Option<ErrorType> {
+        match *self {
+            Expiry::Never => handle.expires_at(alias, 0),
+            Expiry::At(at) => handle.expires_at(alias, at),
+            Expiry::FromNow(delta) => handle.expires_from_now(alias, delta.as_millis() as qdb_time_t),
+        }
+    }
+}
+
+/// BulkExpiry : Outcome of a bulk expiry, the failures by index of their alias.
+#[derive(Debug, Clone, Default, PartialEq, Eq)]
+pub struct BulkExpiry {
+    pub updated: usize,
+    pub failed: Vec<(usize, ErrorType)>,
+}
+
+/// BulkExpire : Sets the expiry of every alias, spread over the handles of the pool which work in parallel.
+///    The API has no batch operation for expiry, every alias is still one call, but the calls of different
+///    handles overlap instead of queueing one after the other.
+pub fn bulk_expire<S: AsRef<str> + Sync>(pool: &HandlePool, aliases: &[S], expiry: Expiry) -> BulkExpiry {
+    if aliases.is_empty() {
+        return BulkExpiry::default();
+    }
+    let per_handle = aliases.len().div_ceil(pool.size());
+
+    let mut result = BulkExpiry::default();
+    thread::scope(|scope| {
+        let workers: Vec<_> = aliases.chunks(per_handle).enumerate()
+            .map(|(h, part)| {
+                let handle = pool.handle(h);
+                scope.spawn(move || {
+                    let mut failed = Vec::new();
+                    for (i, alias) in part.iter().enumerate() {
+                        if let Some(err) = expiry.apply(handle, alias.as_ref()) {
+                            failed.push((h * per_handle + i, err));
+                        }
+                    }
+                    (part.len() - failed.len(), failed)
+                })
+            })
+            .collect();
+
+        for worker in workers {
+            let (updated, failed) = worker.join().expect("bulk expiry worker panicked");
+            result.updated += updated;
+            result.failed.extend(failed);
+        }
+    });
+    result
+}
+
+/// BulkExpirePrefix : Sets the expiry of up to max_count entries whose alias starts with prefix, see bulk_expire.
+pub fn bulk_expire_prefix(pool: &HandlePool, prefix: &str, max_count: i64, expiry: Expiry) -> Result<BulkExpiry, ErrorType> {
+    let aliases = pool.get().prefix_get_list(prefix, max_count)?.to_vec();
+    Ok(bulk_expire(pool, &aliases, expiry))
+}
+
+/// SweepRule : What the sweeper enforces on one time series.
+///    Retention : erases the points of columns older than keep, in slices of SweepConfig::slice from a watermark
+///        per column, so no call asks the cluster for an unbounded erase. Points written behind the watermark
+///        are erased by a second cursor walking [cutoff - horizon, watermark) again, one slice per sweep.
+///    Size : trims the oldest shards until the time series uses about bytes on disk.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub enum SweepRule {
+    Retention { table: String, columns: Vec<String>, keep: Duration },
+    Size { table: String, bytes: u64 },
+}
+
+/// SweepConfig : Settings of an expiry sweeper.
+///    interval : time between the start of two sweeps.
+///    ops_per_second : upper bound of the erase calls sent, spreads a sweep over time instead of a burst.
+///    slice : most time one erase call covers, bounds the work of a call on the cluster.
+///    horizon : how far behind the cutoff retention looks, the first sweep starts there and points older
+///        than cutoff - horizon are left alone. A pass over the horizon takes horizon / slice calls per column.
+#[derive(Debug, Clone, Copy)]
+pub struct SweepConfig {
+    pub interval: Duration,
+    pub ops_per_second: f64,
+    pub slice: Duration,
+    pub horizon: Duration,
+}
+
+impl Default for SweepConfig {
+    fn default() -> Self {
+        SweepConfig {
+            interval: Duration::from_secs(60),
+            ops_per_second: 10.0,
+            slice: Duration::from_secs(86_400),
+            horizon: Duration::from_secs(365 * 86_400),
+        }
+    }
+}
+
+/// SweepStats : Counters of an expiry sweeper since its start.
+///    erased : points erased by retention rules.
+///    throttled : time operations waited for the rate limit.
+#[derive(Debug, Default, Clone, Copy, PartialEq, Eq)]
+pub struct SweepStats {
+    pub sweeps: u64,
+    pub operations: u64,
+    pub erased: u64,
+    pub errors: u64,
+    pub throttled: Duration,
+}
+
+// Where a retention rule stands on one column, in nanoseconds since epoch.
+struct Cursor {
+    // everything expired before it was erased, the next expirations are erased from there
+    watermark: i64,
+    // walks [cutoff - horizon, watermark) again for the points written behind the watermark
+    rescan: i64,
+}
+
+struct Schedule {
+    stopped: bool,
+    requested: bool,
+    next_slot: Instant,
+}
+
+struct Shared {
+    pool: HandlePool,
+    config: SweepConfig,
+    schedule: Mutex<Schedule>,
+    wakeup: Condvar,
+    sweeps: AtomicU64,
+    operations: AtomicU64,
+    erased: AtomicU64,
+    errors: AtomicU64,
+    throttled_nanos: AtomicU64,
+}
+
+/// ExpirySweeper : Enforces the retention of time series from the client, on a schedule and at a bounded rate.
+///    The first sweep starts right away, the sweeper stops when dropped.
+///
+///    let rules = vec![SweepRule::Retention { table: "ticks".into(), columns: vec!["price".into()], keep: Duration::from_secs(86_400) }];
+///    let sweeper = ExpirySweeper::start(pool, rules, SweepConfig::default());
+pub struct ExpirySweeper {
+    shared: Arc<Shared>,
+    thread: Option<thread::JoinHandle<()>>,
+}
+
+impl ExpirySweeper {
+    pub fn start(pool: HandlePool, rules: Vec<SweepRule>, config: SweepConfig) -> ExpirySweeper {
+        let shared = Arc::new(Shared {
+            pool,
+            config,
+            schedule: Mutex::new(Schedule { stopped: false, requested: false, next_slot: Instant::now() }),
+            wakeup: Condvar::new(),
+            sweeps: AtomicU64::new(0),
+            operations: AtomicU64::new(0),
+            erased: AtomicU64::new(0),
+            errors: AtomicU64::new(0),
+            throttled_nanos: AtomicU64::new(0),
+        });
+
+        let sweeper_shared = Arc::clone(&shared);
+        let thread = thread::Builder::new()
+            .name("qdb-expiry-sweeper".to_string())
+            .spawn(move || sweeper_shared.run(rules))
+            .expect("failed to spawn the expiry sweeper");
+
+        ExpirySweeper { shared, thread: Some(thread) }
+    }
+
+    /// SweepNow : Starts a sweep without waiting for the interval to elapse.
+    pub fn sweep_now(&self) {
+        self.shared.schedule.lock().unwrap().requested = true;
+        self.shared.wakeup.notify_all();
+    }
+
+    pub fn stats(&self) -> SweepStats {
+        SweepStats {
+            sweeps: self.shared.sweeps.load(Ordering::Relaxed),
+            operations: self.shared.operations.load(Ordering::Relaxed),
+            erased: self.shared.erased.load(Ordering::Relaxed),
+            errors: self.shared.errors.load(Ordering::Relaxed),
+            throttled: Duration::from_nanos(self.shared.throttled_nanos.load(Ordering::Relaxed)),
+        }
+    }
+}
+
+impl Drop for ExpirySweeper {
+    fn drop(&mut self) {
+        self.shared.schedule.lock().unwrap().stopped = true;
+        self.shared.wakeup.notify_all();
+        if let Some(thread) = self.thread.take() {
+            let _ = thread.join();
+        }
+    }
+}
+
+impl Shared {
+    fn run(&self, rules: Vec<SweepRule>) {
+        // per retention rule and column, none until the first sweep sets the cutoff
+        let mut cursors: Vec<Vec<Option<Cursor>>> = rules.iter()
+            .map(|r| match r {
+                SweepRule::Retention { columns, .. } => columns.iter().map(|_| None).collect(),
+                SweepRule::Size { .. } => Vec::new(),
+            })
+            .collect();
+
+        loop {
+            let started = Instant::now();
+            if !self.sweep(&rules, &mut cursors) {
+                return;
+            }
+            self.sweeps.fetch_add(1, Ordering::Relaxed);
+
+            let schedule = self.schedule.lock().unwrap();
+            let wait = self.config.interval.saturating_sub(started.elapsed());
+            let (mut schedule, _) = self.wakeup
+                .wait_timeout_while(schedule, wait, |s| !s.stopped && !s.requested)
+                .unwrap();
+            if schedule.stopped {
+                return;
+            }
+            schedule.requested = false;
+        }
+    }
+
+    // One pass over the rules, returns false when the sweeper was stopped meanwhile.
+    fn sweep(&self, rules: &[SweepRule], cursors: &mut [Vec<Option<Cursor>>]) -> bool {
+        let now = SystemTime::now().duration_since(UNIX_EPOCH).map(|d| d.as_nanos() as i64).unwrap_or(0);
+        let slice = nanos(self.config.slice).max(1);
+
+        for (rule, cursors) in rules.iter().zip(cursors.iter_mut()) {
+            match rule {
+                SweepRule::Retention { table, columns, keep } => {
+                    let cutoff = now.saturating_sub(nanos(*keep)).max(MIN_TIMESTAMP);
+                    let floor = cutoff.saturating_sub(nanos(self.config.horizon)).max(MIN_TIMESTAMP);
+
+                    for (column, cursor) in columns.iter().zip(cursors.iter_mut()) {
+                        let cursor = cursor.get_or_insert(Cursor { watermark: floor, rescan: floor });
+
+                        while cursor.watermark < cutoff {
+                            let end = cursor.watermark.saturating_add(slice).min(cutoff);
+                            match self.erase(table, column, cursor.watermark, end) {
+                                None => return false,
+                                Some(true) => cursor.watermark = end,
+                                // erased again by the next sweep
+                                Some(false) => break,
+                            }
+                        }
+
+                        if cursor.rescan < floor || cursor.rescan >= cursor.watermark {
+                            cursor.rescan = floor;
+                        }
+                        if cursor.rescan < cursor.watermark {
+                            let end = cursor.rescan.saturating_add(slice).min(cursor.watermark);
+                            match self.erase(table, column, cursor.rescan, end) {
+                                None => return false,
+                                Some(true) => cursor.rescan = end,
+                                Some(false) => {}
+                            }
+                        }
+                    }
+                }
+                SweepRule::Size { table, bytes } => {
+                    if !self.pace() {
+                        return false;
+                    }
+                    if self.pool.get().ts_expire_by_size(table, *bytes).is_some() {
+                        self.errors.fetch_add(1, Ordering::Relaxed);
+                    }
+                }
+            }
+        }
+        true
+    }
+
+    // Erases [begin, end) of a column once the rate limit allows it.
+    // Returns None when the sweeper was stopped meanwhile, whether the erase succeeded otherwise.
+    fn erase(&self, table: &str, column: &str, begin: i64, end: i64) -> Option<bool> {
+        if !self.pace() {
+            return None;
+        }
+        match self.pool.get().ts_erase_ranges(table, column, &[(begin, end)]) {
+            Ok(erased) => {
+                self.erased.fetch_add(erased, Ordering::Relaxed);
+                Some(true)
+            }
+            Err(_) => {
+                self.errors.fetch_add(1, Ordering::Relaxed);
+                Some(false)
+            }
+        }
+    }
+
+    // Waits for the next slot of the rate limit, returns false when the sweeper was stopped meanwhile.
+    fn pace(&self) -> bool {
+        let period = Duration::from_secs_f64(1.0 / self.config.ops_per_second.max(1e-3));
+        let mut schedule = self.schedule.lock().unwrap();
+        let now = Instant::now();
+        // no credit for the time the sweeper was idle, a sweep never starts with a burst
+        let slot = schedule.next_slot.max(now);
+        schedule.next_slot = slot + period;
+
+        if slot > now {
+            self.throttled_nanos.fetch_add((slot - now).as_nanos() as u64, Ordering::Relaxed);
+            while !schedule.stopped && Instant::now() < slot {
+                schedule = self.wakeup.wait_timeout(schedule, slot.saturating_duration_since(Instant::now())).unwrap().0;
+            }
+        }
+        if schedule.stopped {
+            return false;
+        }
+        self.operations.fetch_add(1, Ordering::Relaxed);
+        true
+    }
+}
+
+// A duration in nanoseconds, saturated: a retention of Duration::MAX keeps everything.
+fn nanos(duration: Duration) -> i64 {
+    i64::try_from(duration.as_nanos()).unwrap_or(i64::MAX)
+}
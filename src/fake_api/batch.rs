@@ -0,0 +1,204 @@
+use std::ffi::CStr;
+use std::os::raw;
+use std::ptr;
+
+use crate::{qdb_error_t, qdb_error_t_qdb_e_invalid_argument, qdb_error_t_qdb_e_not_implemented,
+            qdb_error_t_qdb_e_tag_not_set, qdb_error_t_qdb_e_unmatched_content, qdb_handle_t, qdb_operation_t,
+            qdb_operation_type_t_qdb_op_blob_cas, qdb_operation_type_t_qdb_op_blob_get,
+            qdb_operation_type_t_qdb_op_blob_get_and_update, qdb_operation_type_t_qdb_op_blob_put,
+            qdb_operation_type_t_qdb_op_blob_update, qdb_operation_type_t_qdb_op_double_add,
+            qdb_operation_type_t_qdb_op_double_get, qdb_operation_type_t_qdb_op_double_put,
+            qdb_operation_type_t_qdb_op_double_update, qdb_operation_type_t_qdb_op_get_entry_type,
+            qdb_operation_type_t_qdb_op_has_tag, qdb_operation_type_t_qdb_op_int_add,
+            qdb_operation_type_t_qdb_op_int_get, qdb_operation_type_t_qdb_op_int_put,
+            qdb_operation_type_t_qdb_op_int_update, qdb_operation_type_t_qdb_op_uninitialized,
+            qdb_operation_type_t_qdb_op_value_get};
+
+use super::store::{cluster, CasOutcome, Cluster, Value};
+use super::{adopt, bytes_arg, hand_out_bytes, receive, remote};
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_init_operations(operations: *mut qdb_operation_t, operation_count: usize) -> qdb_error_t {
+    if operations.is_null() && operation_count > 0 {
+        return qdb_error_t_qdb_e_invalid_argument;
+    }
+    for i in 0..operation_count {
+        let op = operations.add(i);
+        ptr::write_bytes(op, 0, 1);
+        (*op).type_ = qdb_operation_type_t_qdb_op_uninitialized;
+    }
+    0
+}
+
+// Bytes a batch sends to the cluster.
+unsafe fn request_size(op: &qdb_operation_t) -> usize {
+    let alias = if op.alias.is_null() { 0 } else { CStr::from_ptr(op.alias).to_bytes().len() };
+    let u = &op.__bindgen_anon_1;
+    alias + match op.type_ {
+        t if t == qdb_operation_type_t_qdb_op_blob_put => u.blob_put.content_size,
+        t if t == qdb_operation_type_t_qdb_op_blob_update => u.blob_update.content_size,
+        t if t == qdb_operation_type_t_qdb_op_blob_cas => u.blob_cas.new_content_size + u.blob_cas.comparand_size,
+        t if t == qdb_operation_type_t_qdb_op_blob_get_and_update => u.blob_get_and_update.new_content_size,
+        _ => std::mem::size_of::<i64>(),
+    }
+}
+
+/// RunBatch : Runs every operation as one request, each operation gets its own error code.
+///    Returns the number of successful operations.
+#[no_mangle]
+pub unsafe extern "C" fn qdb_run_batch(handle: qdb_handle_t, operations: *mut qdb_operation_t, operation_count: usize) -> usize {
+    if operations.is_null() || operation_count == 0 {
+        return 0;
+    }
+    let ops = std::slice::from_raw_parts_mut(operations, operation_count);
+
+    let sent: usize = ops.iter().map(|op| request_size(op)).sum();
+    if let Err(e) = remote(handle, sent) {
+        for op in ops.iter_mut() {
+            op.error = e;
+        }
+        return 0;
+    }
+
+    let mut succeeded = 0;
+    let mut cluster = cluster();
+    for op in ops.iter_mut() {
+        op.error = match run_operation(&mut cluster, op) {
+            Ok(()) => {
+                succeeded += 1;
+                0
+            }
+            Err(e) => e,
+        };
+    }
+    drop(cluster);
+
+    let results: Vec<*const raw::c_void> = ops.iter().filter_map(|op| result_buffer(op)).collect();
+    adopt(operations as *const raw::c_void, &results);
+    succeeded
+}
+
+// The API allocated buffer of an operation that ran, if any.
+unsafe fn result_buffer(op: &qdb_operation_t) -> Option<*const raw::c_void> {
+    let u = &op.__bindgen_anon_1;
+    let buffer = match op.type_ {
+        t if t == qdb_operation_type_t_qdb_op_blob_get => u.blob_get.content,
+        t if t == qdb_operation_type_t_qdb_op_blob_cas => u.blob_cas.original_content,
+        t if t == qdb_operation_type_t_qdb_op_blob_get_and_update => u.blob_get_and_update.original_content,
+        t if t == qdb_operation_type_t_qdb_op_value_get => u.value_get.blob_content,
+        _ => ptr::null(),
+    };
+    if buffer.is_null() { None } else { Some(buffer) }
+}
+
+unsafe fn hand_out_content(content: &[u8]) -> (*const raw::c_void, usize) {
+    receive(content.len());
+    hand_out_bytes(content)
+}
+
+unsafe fn run_operation(cluster: &mut Cluster, op: &mut qdb_operation_t) -> Result<(), qdb_error_t> {
+    if op.alias.is_null() {
+        return Err(qdb_error_t_qdb_e_invalid_argument);
+    }
+    let alias = match CStr::from_ptr(op.alias).to_str() {
+        Ok(a) if !a.is_empty() => a,
+        _ => return Err(qdb_error_t_qdb_e_invalid_argument),
+    };
+    let u = &mut op.__bindgen_anon_1;
+
+    match op.type_ {
+        t if t == qdb_operation_type_t_qdb_op_blob_get => {
+            let content = cluster.blob(alias)?;
+            let offset = u.blob_get.content_offset.min(content.len());
+            let (address, length) = hand_out_content(&content[offset..]);
+            u.blob_get.content = address;
+            u.blob_get.content_size = length;
+            Ok(())
+        }
+        t if t == qdb_operation_type_t_qdb_op_blob_put => {
+            let p = u.blob_put;
+            cluster.blob_put(alias, bytes_arg(p.content, p.content_size), p.expiry_time)
+        }
+        t if t == qdb_operation_type_t_qdb_op_blob_update => {
+            let p = u.blob_update;
+            cluster.blob_update(alias, bytes_arg(p.content, p.content_size), p.expiry_time)
+        }
+        t if t == qdb_operation_type_t_qdb_op_blob_cas => {
+            let c = u.blob_cas;
+            let outcome = cluster.blob_cas(alias, bytes_arg(c.new_content, c.new_content_size),
+                                           bytes_arg(c.comparand, c.comparand_size), c.comparand_offset, c.expiry_time)?;
+            match outcome {
+                CasOutcome::Swapped => {
+                    u.blob_cas.original_content = ptr::null();
+                    u.blob_cas.original_content_size = 0;
+                    Ok(())
+                }
+                CasOutcome::Unmatched(current) => {
+                    let (address, length) = hand_out_content(&current);
+                    u.blob_cas.original_content = address;
+                    u.blob_cas.original_content_size = length;
+                    Err(qdb_error_t_qdb_e_unmatched_content)
+                }
+            }
+        }
+        t if t == qdb_operation_type_t_qdb_op_blob_get_and_update => {
+            let g = u.blob_get_and_update;
+            let previous = cluster.blob_get_and_update(alias, bytes_arg(g.new_content, g.new_content_size), g.expiry_time)?;
+            let (address, length) = hand_out_content(&previous);
+            u.blob_get_and_update.original_content = address;
+            u.blob_get_and_update.original_content_size = length;
+            Ok(())
+        }
+        t if t == qdb_operation_type_t_qdb_op_has_tag => {
+            let tag = match u.has_tag.tag.as_ref() {
+                Some(_) => CStr::from_ptr(u.has_tag.tag).to_string_lossy(),
+                None => return Err(qdb_error_t_qdb_e_invalid_argument),
+            };
+            if cluster.has_tag(alias, &tag)? { Ok(()) } else { Err(qdb_error_t_qdb_e_tag_not_set) }
+        }
+        t if t == qdb_operation_type_t_qdb_op_int_put => cluster.int_put(alias, u.int_put.value, u.int_put.expiry_time),
+        t if t == qdb_operation_type_t_qdb_op_int_update => cluster.int_update(alias, u.int_update.value, u.int_update.expiry_time),
+        t if t == qdb_operation_type_t_qdb_op_int_get => {
+            u.int_get.result = cluster.int(alias)?;
+            Ok(())
+        }
+        t if t == qdb_operation_type_t_qdb_op_int_add => {
+            u.int_add.result = cluster.int_add(alias, u.int_add.addend)?;
+            Ok(())
+        }
+        t if t == qdb_operation_type_t_qdb_op_double_put => cluster.double_put(alias, u.double_put.value, u.double_put.expiry_time),
+        t if t == qdb_operation_type_t_qdb_op_double_update => {
+            cluster.double_update(alias, u.double_update.value, u.double_update.expiry_time)
+        }
+        t if t == qdb_operation_type_t_qdb_op_double_get => {
+            u.double_get.result = cluster.double(alias)?;
+            Ok(())
+        }
+        t if t == qdb_operation_type_t_qdb_op_double_add => {
+            u.double_add.result = cluster.double_add(alias, u.double_add.addend)?;
+            Ok(())
+        }
+        t if t == qdb_operation_type_t_qdb_op_get_entry_type => {
+            u.get_entry_type.type_ = cluster.get(alias)?.entry_type();
+            Ok(())
+        }
+        t if t == qdb_operation_type_t_qdb_op_value_get => {
+            let entry = cluster.get(alias)?;
+            u.value_get.type_ = entry.entry_type();
+            match &entry.value {
+                Value::Blob(content) => {
+                    let content = content.clone();
+                    let (address, length) = hand_out_content(&content);
+                    u.value_get.blob_content = address;
+                    u.value_get.blob_content_size = length;
+                }
+                Value::Integer(v) => u.value_get.int_result = *v,
+                Value::Double(v) => u.value_get.double_result = *v,
+                _ => {}
+            }
+            Ok(())
+        }
+        t if t == qdb_operation_type_t_qdb_op_uninitialized => Err(qdb_error_t_qdb_e_invalid_argument),
+        _ => Err(qdb_error_t_qdb_e_not_implemented),
+    }
+}
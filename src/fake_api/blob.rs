@@ -0,0 +1,167 @@
+use std::os::raw;
+
+use crate::{qdb_error_t, qdb_error_t_qdb_e_invalid_argument, qdb_error_t_qdb_e_unmatched_content, qdb_handle_t,
+            qdb_size_t, qdb_time_t};
+
+use super::store::{cluster, CasOutcome};
+use super::{alias_arg, bytes_arg, hand_out_bytes, receive, remote, status};
+
+unsafe fn hand_out_content(content: &[u8], out: *mut *const raw::c_void, out_length: *mut qdb_size_t) {
+    receive(content.len());
+    let (address, length) = hand_out_bytes(content);
+    *out = address;
+    *out_length = length;
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_blob_put(handle: qdb_handle_t, alias: *const raw::c_char, content: *const raw::c_void,
+                                      content_length: qdb_size_t, expiry_time: qdb_time_t) -> qdb_error_t {
+    let alias = match alias_arg(alias) {
+        Ok(a) => a,
+        Err(e) => return e,
+    };
+    if let Err(e) = remote(handle, alias.len() + content_length) {
+        return e;
+    }
+    status(cluster().blob_put(alias, bytes_arg(content, content_length), expiry_time))
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_blob_update(handle: qdb_handle_t, alias: *const raw::c_char, content: *const raw::c_void,
+                                         content_length: qdb_size_t, expiry_time: qdb_time_t) -> qdb_error_t {
+    let alias = match alias_arg(alias) {
+        Ok(a) => a,
+        Err(e) => return e,
+    };
+    if let Err(e) = remote(handle, alias.len() + content_length) {
+        return e;
+    }
+    status(cluster().blob_update(alias, bytes_arg(content, content_length), expiry_time))
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_blob_get(handle: qdb_handle_t, alias: *const raw::c_char, content: *mut *const raw::c_void,
+                                      content_length: *mut qdb_size_t) -> qdb_error_t {
+    let alias = match alias_arg(alias) {
+        Ok(a) => a,
+        Err(e) => return e,
+    };
+    if content.is_null() || content_length.is_null() {
+        return qdb_error_t_qdb_e_invalid_argument;
+    }
+    if let Err(e) = remote(handle, alias.len()) {
+        return e;
+    }
+
+    let blob = match cluster().blob(alias) {
+        Ok(b) => b.to_vec(),
+        Err(e) => return e,
+    };
+    hand_out_content(&blob, content, content_length);
+    0
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_blob_get_and_remove(handle: qdb_handle_t, alias: *const raw::c_char,
+                                                 content: *mut *const raw::c_void, content_length: *mut qdb_size_t) -> qdb_error_t {
+    let alias = match alias_arg(alias) {
+        Ok(a) => a,
+        Err(e) => return e,
+    };
+    if content.is_null() || content_length.is_null() {
+        return qdb_error_t_qdb_e_invalid_argument;
+    }
+    if let Err(e) = remote(handle, alias.len()) {
+        return e;
+    }
+
+    let blob = {
+        let mut cluster = cluster();
+        let blob = match cluster.blob(alias) {
+            Ok(b) => b.to_vec(),
+            Err(e) => return e,
+        };
+        let _ = cluster.remove(alias);
+        blob
+    };
+    hand_out_content(&blob, content, content_length);
+    0
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_blob_get_and_update(handle: qdb_handle_t, alias: *const raw::c_char,
+                                                 update_content: *const raw::c_void, update_content_length: qdb_size_t,
+                                                 expiry_time: qdb_time_t, get_content: *mut *const raw::c_void,
+                                                 get_content_length: *mut qdb_size_t) -> qdb_error_t {
+    let alias = match alias_arg(alias) {
+        Ok(a) => a,
+        Err(e) => return e,
+    };
+    if get_content.is_null() || get_content_length.is_null() {
+        return qdb_error_t_qdb_e_invalid_argument;
+    }
+    if let Err(e) = remote(handle, alias.len() + update_content_length) {
+        return e;
+    }
+
+    let update = bytes_arg(update_content, update_content_length);
+    match cluster().blob_get_and_update(alias, update, expiry_time) {
+        Ok(previous) => {
+            hand_out_content(&previous, get_content, get_content_length);
+            0
+        }
+        Err(e) => e,
+    }
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_blob_compare_and_swap(handle: qdb_handle_t, alias: *const raw::c_char,
+                                                   new_value: *const raw::c_void, new_value_length: qdb_size_t,
+                                                   comparand: *const raw::c_void, comparand_length: qdb_size_t,
+                                                   expiry_time: qdb_time_t, original_value: *mut *const raw::c_void,
+                                                   original_value_length: *mut qdb_size_t) -> qdb_error_t {
+    let alias = match alias_arg(alias) {
+        Ok(a) => a,
+        Err(e) => return e,
+    };
+    if original_value.is_null() || original_value_length.is_null() {
+        return qdb_error_t_qdb_e_invalid_argument;
+    }
+    if let Err(e) = remote(handle, alias.len() + new_value_length + comparand_length) {
+        return e;
+    }
+
+    let outcome = cluster().blob_cas(alias, bytes_arg(new_value, new_value_length),
+                                     bytes_arg(comparand, comparand_length), 0, expiry_time);
+    match outcome {
+        Ok(CasOutcome::Swapped) => {
+            *original_value = std::ptr::null();
+            *original_value_length = 0;
+            0
+        }
+        Ok(CasOutcome::Unmatched(current)) => {
+            hand_out_content(&current, original_value, original_value_length);
+            qdb_error_t_qdb_e_unmatched_content
+        }
+        Err(e) => e,
+    }
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_blob_remove_if(handle: qdb_handle_t, alias: *const raw::c_char, comparand: *const raw::c_void,
+                                            comparand_length: qdb_size_t) -> qdb_error_t {
+    let alias = match alias_arg(alias) {
+        Ok(a) => a,
+        Err(e) => return e,
+    };
+    if let Err(e) = remote(handle, alias.len() + comparand_length) {
+        return e;
+    }
+
+    let mut cluster = cluster();
+    match cluster.blob(alias) {
+        Ok(current) if current == bytes_arg(comparand, comparand_length) => status(cluster.remove(alias).map(|_| ())),
+        Ok(_) => qdb_error_t_qdb_e_unmatched_content,
+        Err(e) => e,
+    }
+}
@@ -0,0 +1,495 @@
+use std::ffi::CStr;
+use std::os::raw;
+use std::ptr;
+use std::sync::atomic::Ordering;
+
+use crate::query::nanos_to_timespec;
+use crate::{qdb_compression_t, qdb_encryption_t, qdb_entry_metadata_t, qdb_entry_type_t, qdb_error_t, qdb_error_t_qdb_e_invalid_argument,
+            qdb_error_t_qdb_e_invalid_protocol, qdb_error_t_qdb_e_not_implemented, qdb_handle_t, qdb_int_t,
+            qdb_log_callback, qdb_log_callback_id, qdb_perf_profile_t, qdb_protocol_t, qdb_remote_node_t,
+            qdb_size_t, qdb_time_t, qdb_uint_t};
+
+use super::store::{cluster, Value};
+use super::{add_log_callback, alias_arg, fake_handle, hand_out_bytes, hand_out_strings, now_ms, receive, release, remote, remove_log_callback, stats,
+            status, FakeHandle};
+
+static VERSION: &[u8] = b"fake\0";
+
+#[no_mangle]
+pub extern "C" fn qdb_version() -> *const raw::c_char {
+    VERSION.as_ptr() as *const raw::c_char
+}
+
+#[no_mangle]
+pub extern "C" fn qdb_build() -> *const raw::c_char {
+    VERSION.as_ptr() as *const raw::c_char
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_open(handle: *mut qdb_handle_t, _proto: qdb_protocol_t) -> qdb_error_t {
+    if handle.is_null() {
+        return qdb_error_t_qdb_e_invalid_argument;
+    }
+    *handle = qdb_open_tcp();
+    0
+}
+
+#[no_mangle]
+pub extern "C" fn qdb_open_tcp() -> qdb_handle_t {
+    Box::into_raw(Box::new(FakeHandle::new())) as qdb_handle_t
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_connect(handle: qdb_handle_t, uri: *const raw::c_char) -> qdb_error_t {
+    let h = match fake_handle(handle) {
+        Ok(h) => h,
+        Err(e) => return e,
+    };
+    if uri.is_null() {
+        return qdb_error_t_qdb_e_invalid_argument;
+    }
+    if !CStr::from_ptr(uri).to_bytes().starts_with(b"qdb://") {
+        return qdb_error_t_qdb_e_invalid_protocol;
+    }
+
+    h.connected.store(true, Ordering::Release);
+    status(remote(handle, 0))
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_close(handle: qdb_handle_t) -> qdb_error_t {
+    if let Err(e) = fake_handle(handle) {
+        return e;
+    }
+    drop(Box::from_raw(handle as *mut FakeHandle));
+    0
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_release(_handle: qdb_handle_t, buffer: *const raw::c_void) {
+    if !buffer.is_null() {
+        release(buffer);
+    }
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_option_set_timeout(handle: qdb_handle_t, timeout_ms: raw::c_int) -> qdb_error_t {
+    match fake_handle(handle) {
+        Ok(h) if timeout_ms > 0 => {
+            h.timeout_ms.store(timeout_ms, Ordering::Relaxed);
+            0
+        }
+        Ok(_) => qdb_error_t_qdb_e_invalid_argument,
+        Err(e) => e,
+    }
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_option_set_client_max_parallelism(handle: qdb_handle_t, thread_count: qdb_size_t) -> qdb_error_t {
+    match fake_handle(handle) {
+        Ok(h) => {
+            // 0 is all the cores, reported back as set like the API does
+            h.parallelism.store(thread_count, Ordering::Relaxed);
+            0
+        }
+        Err(e) => e,
+    }
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_option_get_client_max_parallelism(handle: qdb_handle_t, thread_count: *mut qdb_size_t) -> qdb_error_t {
+    match fake_handle(handle) {
+        Ok(h) if !thread_count.is_null() => {
+            *thread_count = h.parallelism.load(Ordering::Relaxed);
+            0
+        }
+        Ok(_) => qdb_error_t_qdb_e_invalid_argument,
+        Err(e) => e,
+    }
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_option_set_client_max_in_buf_size(handle: qdb_handle_t, max_size: usize) -> qdb_error_t {
+    match fake_handle(handle) {
+        Ok(h) => {
+            h.in_buf_size.store(max_size, Ordering::Relaxed);
+            0
+        }
+        Err(e) => e,
+    }
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_option_get_client_max_in_buf_size(handle: qdb_handle_t, max_size: *mut usize) -> qdb_error_t {
+    match fake_handle(handle) {
+        Ok(h) if !max_size.is_null() => {
+            *max_size = h.in_buf_size.load(Ordering::Relaxed);
+            0
+        }
+        Ok(_) => qdb_error_t_qdb_e_invalid_argument,
+        Err(e) => e,
+    }
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_option_get_cluster_max_in_buf_size(handle: qdb_handle_t, max_size: *mut usize) -> qdb_error_t {
+    if let Err(e) = remote(handle, 0) {
+        return e;
+    }
+    if max_size.is_null() {
+        return qdb_error_t_qdb_e_invalid_argument;
+    }
+    *max_size = 1024 * 1024 * 1024;
+    0
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_option_set_client_soft_memory_limit(handle: qdb_handle_t, limit: qdb_uint_t) -> qdb_error_t {
+    match fake_handle(handle) {
+        Ok(h) => {
+            h.soft_memory_limit.store(limit, Ordering::Relaxed);
+            0
+        }
+        Err(e) => e,
+    }
+}
+
+// Reports the buffers handed out and not released yet.
+#[no_mangle]
+pub unsafe extern "C" fn qdb_option_client_get_memory_info(handle: qdb_handle_t, content: *mut *const raw::c_char,
+                                                           content_length: *mut qdb_size_t) -> qdb_error_t {
+    if let Err(e) = fake_handle(handle) {
+        return e;
+    }
+    if content.is_null() || content_length.is_null() {
+        return qdb_error_t_qdb_e_invalid_argument;
+    }
+
+    let s = stats();
+    let info = format!("{{\"allocated\":{},\"allocations\":{}}}", s.allocated_bytes, s.live_allocations);
+    let (address, length) = hand_out_bytes(info.as_bytes());
+    *content = address as *const raw::c_char;
+    *content_length = length;
+    0
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_option_client_tidy_memory(handle: qdb_handle_t) -> qdb_error_t {
+    match fake_handle(handle) {
+        Ok(_) => 0,
+        Err(e) => e,
+    }
+}
+
+// Settings that have no effect on the fake.
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_option_set_compression(handle: qdb_handle_t, _comp_level: qdb_compression_t) -> qdb_error_t {
+    status(fake_handle(handle).map(|_| ()))
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_option_set_encryption(handle: qdb_handle_t, _encryption: qdb_encryption_t) -> qdb_error_t {
+    status(fake_handle(handle).map(|_| ()))
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_option_set_max_cardinality(handle: qdb_handle_t, _max_cardinality: qdb_uint_t) -> qdb_error_t {
+    status(fake_handle(handle).map(|_| ()))
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_option_set_cluster_public_key(handle: qdb_handle_t, _public_key: *const raw::c_char) -> qdb_error_t {
+    status(fake_handle(handle).map(|_| ()))
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_option_set_user_credentials(handle: qdb_handle_t, _user_name: *const raw::c_char,
+                                                         _private_key: *const raw::c_char) -> qdb_error_t {
+    status(fake_handle(handle).map(|_| ()))
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_cluster_endpoints(handle: qdb_handle_t, _endpoints: *mut *mut qdb_remote_node_t,
+                                               _endpoints_count: *mut qdb_size_t) -> qdb_error_t {
+    match fake_handle(handle) {
+        Ok(_) => qdb_error_t_qdb_e_not_implemented,
+        Err(e) => e,
+    }
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_purge_all(handle: qdb_handle_t, _timeout_ms: raw::c_int) -> qdb_error_t {
+    if let Err(e) = remote(handle, 0) {
+        return e;
+    }
+    cluster().clear();
+    0
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_purge_cache(handle: qdb_handle_t, _timeout_ms: raw::c_int) -> qdb_error_t {
+    status(remote(handle, 0))
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_trim_all(handle: qdb_handle_t, _timeout_ms: raw::c_int) -> qdb_error_t {
+    status(remote(handle, 0))
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_wait_for_stabilization(handle: qdb_handle_t, _timeout_ms: raw::c_int) -> qdb_error_t {
+    status(remote(handle, 0))
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_remove(handle: qdb_handle_t, alias: *const raw::c_char) -> qdb_error_t {
+    let alias = match alias_arg(alias) {
+        Ok(a) => a,
+        Err(e) => return e,
+    };
+    if let Err(e) = remote(handle, alias.len()) {
+        return e;
+    }
+    status(cluster().remove(alias).map(|_| ()))
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_expires_at(handle: qdb_handle_t, alias: *const raw::c_char, expiry_time: qdb_time_t) -> qdb_error_t {
+    let alias = match alias_arg(alias) {
+        Ok(a) => a,
+        Err(e) => return e,
+    };
+    if let Err(e) = remote(handle, alias.len()) {
+        return e;
+    }
+    status(cluster().expires_at(alias, expiry_time))
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_expires_from_now(handle: qdb_handle_t, alias: *const raw::c_char, expiry_delta: qdb_time_t) -> qdb_error_t {
+    let alias = match alias_arg(alias) {
+        Ok(a) => a,
+        Err(e) => return e,
+    };
+    if let Err(e) = remote(handle, alias.len()) {
+        return e;
+    }
+    status(cluster().expires_at(alias, now_ms() + expiry_delta))
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_get_expiry_time(handle: qdb_handle_t, alias: *const raw::c_char,
+                                             expiry_time: *mut qdb_time_t) -> qdb_error_t {
+    let alias = match alias_arg(alias) {
+        Ok(a) => a,
+        Err(e) => return e,
+    };
+    if expiry_time.is_null() {
+        return qdb_error_t_qdb_e_invalid_argument;
+    }
+    if let Err(e) = remote(handle, alias.len()) {
+        return e;
+    }
+    match cluster().get(alias) {
+        Ok(entry) => {
+            *expiry_time = entry.expiry;
+            0
+        }
+        Err(e) => e,
+    }
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_get_type(handle: qdb_handle_t, alias: *const raw::c_char,
+                                      entry_type: *mut qdb_entry_type_t) -> qdb_error_t {
+    let alias = match alias_arg(alias) {
+        Ok(a) => a,
+        Err(e) => return e,
+    };
+    if entry_type.is_null() {
+        return qdb_error_t_qdb_e_invalid_argument;
+    }
+    if let Err(e) = remote(handle, alias.len()) {
+        return e;
+    }
+    match cluster().get(alias) {
+        Ok(entry) => {
+            *entry_type = entry.entry_type();
+            0
+        }
+        Err(e) => e,
+    }
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_get_metadata(handle: qdb_handle_t, alias: *const raw::c_char,
+                                          entry_metadata: *mut qdb_entry_metadata_t) -> qdb_error_t {
+    let alias = match alias_arg(alias) {
+        Ok(a) => a,
+        Err(e) => return e,
+    };
+    if entry_metadata.is_null() {
+        return qdb_error_t_qdb_e_invalid_argument;
+    }
+    if let Err(e) = remote(handle, alias.len()) {
+        return e;
+    }
+    match cluster().get(alias) {
+        Ok(entry) => {
+            // the alias and reference are left empty, the fake has no entry ids
+            let mut metadata: qdb_entry_metadata_t = std::mem::zeroed();
+            metadata.type_ = entry.entry_type();
+            metadata.size = match &entry.value {
+                Value::Blob(content) => content.len() as qdb_uint_t,
+                Value::Integer(_) => std::mem::size_of::<i64>() as qdb_uint_t,
+                Value::Double(_) => std::mem::size_of::<f64>() as qdb_uint_t,
+                _ => 0,
+            };
+            metadata.modification_time = nanos_to_timespec(entry.modified);
+            metadata.expiry_time = nanos_to_timespec(entry.expiry.saturating_mul(1_000_000));
+            *entry_metadata = metadata;
+            0
+        }
+        Err(e) => e,
+    }
+}
+
+unsafe fn hand_out_aliases(aliases: Vec<String>, results: *mut *mut *const raw::c_char, count: *mut usize) {
+    receive(aliases.iter().map(|a| a.len() + 1).sum());
+    let (address, n) = hand_out_strings(aliases);
+    *results = address;
+    *count = n;
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_prefix_get(handle: qdb_handle_t, prefix: *const raw::c_char, max_count: qdb_int_t,
+                                        results: *mut *mut *const raw::c_char, result_count: *mut usize) -> qdb_error_t {
+    let prefix = match alias_arg(prefix) {
+        Ok(p) => p,
+        Err(e) => return e,
+    };
+    if results.is_null() || result_count.is_null() || max_count <= 0 {
+        return qdb_error_t_qdb_e_invalid_argument;
+    }
+    if let Err(e) = remote(handle, prefix.len()) {
+        return e;
+    }
+
+    let aliases = cluster().with_prefix(prefix, max_count as usize);
+    hand_out_aliases(aliases, results, result_count);
+    0
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_prefix_count(handle: qdb_handle_t, prefix: *const raw::c_char,
+                                          result_count: *mut qdb_uint_t) -> qdb_error_t {
+    let prefix = match alias_arg(prefix) {
+        Ok(p) => p,
+        Err(e) => return e,
+    };
+    if result_count.is_null() {
+        return qdb_error_t_qdb_e_invalid_argument;
+    }
+    if let Err(e) = remote(handle, prefix.len()) {
+        return e;
+    }
+
+    *result_count = cluster().with_prefix(prefix, usize::MAX).len() as qdb_uint_t;
+    0
+}
+
+// The fake has a single node, hence the approximation is exact.
+#[no_mangle]
+pub unsafe extern "C" fn qdb_prefix_approximate_count(handle: qdb_handle_t, prefix: *const raw::c_char,
+                                                      result_count: *mut qdb_uint_t) -> qdb_error_t {
+    qdb_prefix_count(handle, prefix, result_count)
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_suffix_get(handle: qdb_handle_t, suffix: *const raw::c_char, max_count: qdb_int_t,
+                                        results: *mut *mut *const raw::c_char, result_count: *mut usize) -> qdb_error_t {
+    let suffix = match alias_arg(suffix) {
+        Ok(s) => s,
+        Err(e) => return e,
+    };
+    if results.is_null() || result_count.is_null() || max_count <= 0 {
+        return qdb_error_t_qdb_e_invalid_argument;
+    }
+    if let Err(e) = remote(handle, suffix.len()) {
+        return e;
+    }
+
+    let aliases = cluster().with_suffix(suffix, max_count as usize);
+    hand_out_aliases(aliases, results, result_count);
+    0
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_suffix_count(handle: qdb_handle_t, suffix: *const raw::c_char,
+                                          result_count: *mut qdb_uint_t) -> qdb_error_t {
+    let suffix = match alias_arg(suffix) {
+        Ok(s) => s,
+        Err(e) => return e,
+    };
+    if result_count.is_null() {
+        return qdb_error_t_qdb_e_invalid_argument;
+    }
+    if let Err(e) = remote(handle, suffix.len()) {
+        return e;
+    }
+
+    *result_count = cluster().with_suffix(suffix, usize::MAX).len() as qdb_uint_t;
+    0
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_suffix_approximate_count(handle: qdb_handle_t, suffix: *const raw::c_char,
+                                                      result_count: *mut qdb_uint_t) -> qdb_error_t {
+    qdb_suffix_count(handle, suffix, result_count)
+}
+
+// The fake only logs what fake_api::log is given, and does not profile.
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_log_add_callback(cb: qdb_log_callback, callback_id: *mut qdb_log_callback_id) -> qdb_error_t {
+    if cb.is_none() || callback_id.is_null() {
+        return qdb_error_t_qdb_e_invalid_argument;
+    }
+    *callback_id = add_log_callback(cb);
+    0
+}
+
+#[no_mangle]
+pub extern "C" fn qdb_log_remove_callback(callback_id: qdb_log_callback_id) -> qdb_error_t {
+    if remove_log_callback(callback_id) { 0 } else { qdb_error_t_qdb_e_invalid_argument }
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_perf_enable_client_tracking(handle: qdb_handle_t) -> qdb_error_t {
+    status(fake_handle(handle).map(|_| ()))
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_perf_disable_client_tracking(handle: qdb_handle_t) -> qdb_error_t {
+    status(fake_handle(handle).map(|_| ()))
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_perf_clear_all_profiles(handle: qdb_handle_t) -> qdb_error_t {
+    status(fake_handle(handle).map(|_| ()))
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_perf_get_profiles(handle: qdb_handle_t, profiles: *mut *mut qdb_perf_profile_t,
+                                               count: *mut qdb_size_t) -> qdb_error_t {
+    if let Err(e) = fake_handle(handle) {
+        return e;
+    }
+    if profiles.is_null() || count.is_null() {
+        return qdb_error_t_qdb_e_invalid_argument;
+    }
+    *profiles = ptr::null_mut();
+    *count = 0;
+    0
+}
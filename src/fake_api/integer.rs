@@ -0,0 +1,80 @@
+use std::os::raw;
+
+use crate::{qdb_error_t, qdb_error_t_qdb_e_invalid_argument, qdb_handle_t, qdb_int_t, qdb_time_t};
+
+use super::store::cluster;
+use super::{alias_arg, receive, remote, status};
+
+const INT_SIZE: usize = std::mem::size_of::<qdb_int_t>();
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_int_put(handle: qdb_handle_t, alias: *const raw::c_char, integer: qdb_int_t,
+                                     expiry_time: qdb_time_t) -> qdb_error_t {
+    let alias = match alias_arg(alias) {
+        Ok(a) => a,
+        Err(e) => return e,
+    };
+    if let Err(e) = remote(handle, alias.len() + INT_SIZE) {
+        return e;
+    }
+    status(cluster().int_put(alias, integer, expiry_time))
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_int_update(handle: qdb_handle_t, alias: *const raw::c_char, integer: qdb_int_t,
+                                        expiry_time: qdb_time_t) -> qdb_error_t {
+    let alias = match alias_arg(alias) {
+        Ok(a) => a,
+        Err(e) => return e,
+    };
+    if let Err(e) = remote(handle, alias.len() + INT_SIZE) {
+        return e;
+    }
+    status(cluster().int_update(alias, integer, expiry_time))
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_int_get(handle: qdb_handle_t, alias: *const raw::c_char, integer: *mut qdb_int_t) -> qdb_error_t {
+    let alias = match alias_arg(alias) {
+        Ok(a) => a,
+        Err(e) => return e,
+    };
+    if integer.is_null() {
+        return qdb_error_t_qdb_e_invalid_argument;
+    }
+    if let Err(e) = remote(handle, alias.len()) {
+        return e;
+    }
+
+    match cluster().int(alias) {
+        Ok(v) => {
+            receive(INT_SIZE);
+            *integer = v;
+            0
+        }
+        Err(e) => e,
+    }
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_int_add(handle: qdb_handle_t, alias: *const raw::c_char, addend: qdb_int_t,
+                                     result: *mut qdb_int_t) -> qdb_error_t {
+    let alias = match alias_arg(alias) {
+        Ok(a) => a,
+        Err(e) => return e,
+    };
+    if let Err(e) = remote(handle, alias.len() + INT_SIZE) {
+        return e;
+    }
+
+    match cluster().int_add(alias, addend) {
+        Ok(v) => {
+            receive(INT_SIZE);
+            if !result.is_null() {
+                *result = v;
+            }
+            0
+        }
+        Err(e) => e,
+    }
+}
@@ -0,0 +1,382 @@
+use std::any::Any;
+use std::collections::HashMap;
+use std::ffi::{CStr, CString};
+use std::os::raw;
+use std::sync::{Mutex, MutexGuard, OnceLock};
+use std::sync::atomic::{AtomicBool, AtomicI32, AtomicU64, AtomicUsize, Ordering};
+use std::thread;
+use std::time::Duration;
+
+use crate::{qdb_error_t, qdb_error_t_qdb_e_invalid_argument, qdb_error_t_qdb_e_invalid_handle,
+            qdb_error_t_qdb_e_not_connected, qdb_error_t_qdb_e_try_again, qdb_handle_t, qdb_log_callback,
+            qdb_log_callback_id, qdb_log_level_t};
+
+mod store;
+mod client;
+mod blob;
+mod integer;
+mod tag;
+mod ts;
+mod batch;
+mod query;
+
+/// FakeConfig : Behaviour of the in-process cluster.
+///    latency : added to every call that would reach the cluster, plus a uniformly random share of jitter.
+///    bandwidth : bytes per second moved to and from the cluster, 0 for unlimited.
+///    error_rate : probability, between 0 and 1, that a call fails with error before being applied.
+///    seed : seed of the random generator, the same seed injects the same sequence of errors and jitter.
+#[derive(Debug, Clone, Copy)]
+pub struct FakeConfig {
+    pub latency: Duration,
+    pub jitter: Duration,
+    pub bandwidth: u64,
+    pub error_rate: f64,
+    pub error: qdb_error_t,
+    pub seed: u64,
+}
+
+impl Default for FakeConfig {
+    fn default() -> Self {
+        FakeConfig {
+            latency: Duration::ZERO,
+            jitter: Duration::ZERO,
+            bandwidth: 0,
+            error_rate: 0.0,
+            error: qdb_error_t_qdb_e_try_again,
+            seed: 0x9e37_79b9_7f4a_7c15,
+        }
+    }
+}
+
+/// FakeStats : Counters of the in-process cluster since the last reset.
+///    live_allocations and allocated_bytes are the buffers handed out and not released yet.
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct FakeStats {
+    pub calls: u64,
+    pub injected_errors: u64,
+    pub bytes_sent: u64,
+    pub bytes_received: u64,
+    pub live_allocations: usize,
+    pub allocated_bytes: usize,
+}
+
+struct Injection {
+    config: FakeConfig,
+    rng: u64,
+}
+
+static INJECTION: OnceLock<Mutex<Injection>> = OnceLock::new();
+static CALLS: AtomicU64 = AtomicU64::new(0);
+static INJECTED_ERRORS: AtomicU64 = AtomicU64::new(0);
+static BYTES_SENT: AtomicU64 = AtomicU64::new(0);
+static BYTES_RECEIVED: AtomicU64 = AtomicU64::new(0);
+
+fn injection() -> MutexGuard<'static, Injection> {
+    INJECTION
+        .get_or_init(|| {
+            let config = FakeConfig::default();
+            Mutex::new(Injection { config, rng: config.seed })
+        })
+        .lock()
+        .unwrap()
+}
+
+/// Configure : Replaces the latency, bandwidth and error injection settings and reseeds the random generator.
+pub fn configure(config: FakeConfig) {
+    let mut injection = injection();
+    injection.config = config;
+    injection.rng = config.seed.max(1);
+}
+
+/// Reset : Removes every entry of the in-process cluster and zeroes the counters.
+///    Buffers already handed out stay valid until released.
+pub fn reset() {
+    store::cluster().clear();
+    CALLS.store(0, Ordering::Relaxed);
+    INJECTED_ERRORS.store(0, Ordering::Relaxed);
+    BYTES_SENT.store(0, Ordering::Relaxed);
+    BYTES_RECEIVED.store(0, Ordering::Relaxed);
+}
+
+/// Stats : Returns the call, injection, traffic and allocation counters.
+pub fn stats() -> FakeStats {
+    let allocations = allocations();
+    FakeStats {
+        calls: CALLS.load(Ordering::Relaxed),
+        injected_errors: INJECTED_ERRORS.load(Ordering::Relaxed),
+        bytes_sent: BYTES_SENT.load(Ordering::Relaxed),
+        bytes_received: BYTES_RECEIVED.load(Ordering::Relaxed),
+        live_allocations: allocations.len(),
+        allocated_bytes: allocations.values().map(|a| a.bytes).sum(),
+    }
+}
+
+// Callbacks registered with qdb_log_add_callback, by id.
+static LOG_CALLBACKS: Mutex<Vec<(qdb_log_callback_id, qdb_log_callback)>> = Mutex::new(Vec::new());
+static NEXT_LOG_CALLBACK: AtomicUsize = AtomicUsize::new(1);
+
+fn add_log_callback(cb: qdb_log_callback) -> qdb_log_callback_id {
+    let id = NEXT_LOG_CALLBACK.fetch_add(1, Ordering::Relaxed);
+    LOG_CALLBACKS.lock().unwrap().push((id, cb));
+    id
+}
+
+fn remove_log_callback(id: qdb_log_callback_id) -> bool {
+    let mut callbacks = LOG_CALLBACKS.lock().unwrap();
+    let before = callbacks.len();
+    callbacks.retain(|(i, _)| *i != id);
+    callbacks.len() != before
+}
+
+/// Log : Emits message as the API would, to every callback registered with qdb_log_add_callback.
+///    No callback runs once qdb_log_remove_callback returns.
+pub fn log(level: qdb_log_level_t, message: &str) {
+    let now = std::time::SystemTime::now().duration_since(std::time::UNIX_EPOCH).map(|d| d.as_secs() as i64).unwrap_or(0);
+    let (year, month, day) = civil_from_days(now.div_euclid(86_400));
+    let seconds = now.rem_euclid(86_400);
+    let date = [year, month, day, seconds / 3600, seconds / 60 % 60, seconds % 60].map(|v| v as raw::c_ulong);
+    let tid = thread_number();
+
+    // called under the lock, so that removing a callback waits for it
+    for (_, cb) in LOG_CALLBACKS.lock().unwrap().iter() {
+        if let Some(cb) = cb {
+            unsafe {
+                cb(level, date.as_ptr(), std::process::id() as raw::c_ulong, tid as raw::c_ulong,
+                   message.as_ptr() as *const raw::c_char, message.len())
+            };
+        }
+    }
+}
+
+// year, month and day of a number of days since epoch, http://howardhinnant.github.io/date_algorithms.html
+fn civil_from_days(days: i64) -> (i64, i64, i64) {
+    let z = days + 719_468;
+    let era = z.div_euclid(146_097);
+    let doe = z - era * 146_097;
+    let yoe = (doe - doe / 1460 + doe / 36_524 - doe / 146_096) / 365;
+    let doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    let mp = (5 * doy + 2) / 153;
+    let day = doy - (153 * mp + 2) / 5 + 1;
+    let month = if mp < 10 { mp + 3 } else { mp - 9 };
+    (yoe + era * 400 + (month <= 2) as i64, month, day)
+}
+
+// A small number for the calling thread, in the order threads first ask for one.
+fn thread_number() -> u64 {
+    static NEXT: AtomicU64 = AtomicU64::new(1);
+    thread_local!(static NUMBER: u64 = NEXT.fetch_add(1, Ordering::Relaxed));
+    NUMBER.with(|n| *n)
+}
+
+// xorshift64*, good enough to draw injected errors and jitter
+fn next_random(state: &mut u64) -> u64 {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    state.wrapping_mul(0x2545_f491_4f6c_dd1d)
+}
+
+fn transfer_time(bytes: usize, bandwidth: u64) -> Duration {
+    if bandwidth == 0 || bytes == 0 {
+        return Duration::ZERO;
+    }
+    Duration::from_secs_f64(bytes as f64 / bandwidth as f64)
+}
+
+// Simulates sending a request of sent bytes to the cluster: waits for the latency and
+// the transfer, then either lets the call through or fails it with the injected error.
+fn round_trip(sent: usize) -> Result<(), qdb_error_t> {
+    CALLS.fetch_add(1, Ordering::Relaxed);
+    BYTES_SENT.fetch_add(sent as u64, Ordering::Relaxed);
+
+    let (delay, error) = {
+        let mut injection = injection();
+        let config = injection.config;
+
+        let mut delay = config.latency + transfer_time(sent, config.bandwidth);
+        if !config.jitter.is_zero() {
+            let share = (next_random(&mut injection.rng) >> 11) as f64 / (1u64 << 53) as f64;
+            delay += config.jitter.mul_f64(share);
+        }
+
+        let mut error = None;
+        if config.error_rate > 0.0 {
+            let draw = (next_random(&mut injection.rng) >> 11) as f64 / (1u64 << 53) as f64;
+            if draw < config.error_rate {
+                error = Some(config.error);
+            }
+        }
+        (delay, error)
+    };
+
+    if !delay.is_zero() {
+        thread::sleep(delay);
+    }
+
+    match error {
+        Some(e) => {
+            INJECTED_ERRORS.fetch_add(1, Ordering::Relaxed);
+            Err(e)
+        }
+        None => Ok(()),
+    }
+}
+
+// Simulates receiving the reply of received bytes.
+fn receive(received: usize) {
+    BYTES_RECEIVED.fetch_add(received as u64, Ordering::Relaxed);
+
+    let bandwidth = injection().config.bandwidth;
+    let delay = transfer_time(received, bandwidth);
+    if !delay.is_zero() {
+        thread::sleep(delay);
+    }
+}
+
+// What a qdb_handle_t points to when the fake is linked.
+struct FakeHandle {
+    connected: AtomicBool,
+    timeout_ms: AtomicI32,
+    parallelism: AtomicUsize,
+    in_buf_size: AtomicUsize,
+    soft_memory_limit: AtomicU64,
+}
+
+impl FakeHandle {
+    fn new() -> FakeHandle {
+        FakeHandle {
+            connected: AtomicBool::new(false),
+            timeout_ms: AtomicI32::new(60_000),
+            parallelism: AtomicUsize::new(thread::available_parallelism().map(|n| n.get()).unwrap_or(1)),
+            in_buf_size: AtomicUsize::new(64 * 1024 * 1024),
+            soft_memory_limit: AtomicU64::new(0),
+        }
+    }
+}
+
+unsafe fn fake_handle<'a>(handle: qdb_handle_t) -> Result<&'a FakeHandle, qdb_error_t> {
+    match (handle as *const FakeHandle).as_ref() {
+        Some(h) => Ok(h),
+        None => Err(qdb_error_t_qdb_e_invalid_handle),
+    }
+}
+
+// Checks the handle is connected then simulates the request.
+unsafe fn remote(handle: qdb_handle_t, sent: usize) -> Result<(), qdb_error_t> {
+    let h = fake_handle(handle)?;
+    if !h.connected.load(Ordering::Acquire) {
+        return Err(qdb_error_t_qdb_e_not_connected);
+    }
+    round_trip(sent)
+}
+
+unsafe fn alias_arg<'a>(alias: *const raw::c_char) -> Result<&'a str, qdb_error_t> {
+    if alias.is_null() {
+        return Err(qdb_error_t_qdb_e_invalid_argument);
+    }
+    match CStr::from_ptr(alias).to_str() {
+        Ok(a) if !a.is_empty() => Ok(a),
+        _ => Err(qdb_error_t_qdb_e_invalid_argument),
+    }
+}
+
+unsafe fn bytes_arg<'a>(content: *const raw::c_void, length: usize) -> &'a [u8] {
+    if content.is_null() || length == 0 {
+        return &[];
+    }
+    std::slice::from_raw_parts(content as *const u8, length)
+}
+
+fn status(result: Result<(), qdb_error_t>) -> qdb_error_t {
+    match result {
+        Ok(()) => 0,
+        Err(e) => e,
+    }
+}
+
+// Buffers handed out to the caller, keyed by the address the caller will pass to qdb_release.
+struct Allocation {
+    _owner: Box<dyn Any + Send>,
+    bytes: usize,
+}
+
+static ALLOCATIONS: OnceLock<Mutex<HashMap<usize, Allocation>>> = OnceLock::new();
+
+fn allocations() -> MutexGuard<'static, HashMap<usize, Allocation>> {
+    ALLOCATIONS.get_or_init(|| Mutex::new(HashMap::new())).lock().unwrap()
+}
+
+fn hand_out(owner: Box<dyn Any + Send>, address: *const raw::c_void, bytes: usize) {
+    allocations().insert(address as usize, Allocation { _owner: owner, bytes });
+}
+
+// Returns true if the address was handed out by the fake.
+fn release(address: *const raw::c_void) -> bool {
+    // dropped once the lock is released, the owner may wait for a thread handing out buffers
+    let released = allocations().remove(&(address as usize));
+    released.is_some()
+}
+
+// Moves the buffers handed out at addresses under the address of the batch that produced them,
+// so that releasing the operations array releases them all, as with the real API.
+fn adopt(batch: *const raw::c_void, addresses: &[*const raw::c_void]) {
+    let mut allocations = allocations();
+    let mut parts: Vec<Allocation> = addresses.iter().filter_map(|a| allocations.remove(&(*a as usize))).collect();
+    if parts.is_empty() {
+        return;
+    }
+    // a batch run again before being released keeps the buffers of the previous run
+    if let Some(previous) = allocations.remove(&(batch as usize)) {
+        parts.push(previous);
+    }
+    let bytes = parts.iter().map(|p| p.bytes).sum();
+    allocations.insert(batch as usize, Allocation { _owner: Box::new(parts), bytes });
+}
+
+fn hand_out_bytes(content: &[u8]) -> (*const raw::c_void, usize) {
+    // never empty, so that every buffer has an address of its own
+    let mut buffer: Vec<u8> = Vec::with_capacity(content.len().max(1));
+    buffer.extend_from_slice(content);
+    let address = buffer.as_ptr() as *const raw::c_void;
+    hand_out(Box::new(buffer), address, content.len());
+    (address, content.len())
+}
+
+// The raw pointers only point into the strings owned by the same value.
+struct StringArray {
+    _strings: Vec<CString>,
+    pointers: Vec<*const raw::c_char>,
+}
+
+unsafe impl Send for StringArray {}
+
+fn hand_out_strings(strings: Vec<String>) -> (*mut *const raw::c_char, usize) {
+    let strings: Vec<CString> = strings.into_iter().filter_map(|s| CString::new(s).ok()).collect();
+    let mut pointers: Vec<*const raw::c_char> = Vec::with_capacity(strings.len().max(1));
+    pointers.extend(strings.iter().map(|s| s.as_ptr()));
+
+    let count = strings.len();
+    let bytes = strings.iter().map(|s| s.as_bytes_with_nul().len()).sum::<usize>()
+        + count * std::mem::size_of::<*const raw::c_char>();
+    let mut array = Box::new(StringArray { _strings: strings, pointers });
+    let address = array.pointers.as_mut_ptr();
+    hand_out(array, address as *const raw::c_void, bytes);
+    (address, count)
+}
+
+// The raw pointers of T only point into memory owned by T.
+struct Owned<T>(T);
+
+unsafe impl<T> Send for Owned<T> {}
+
+// Hands out a value whose address is the one of its first field, T must be repr(C).
+fn hand_out_value<T: 'static>(value: T, bytes: usize) -> *mut T {
+    let mut owned = Box::new(Owned(value));
+    let address = &mut owned.0 as *mut T;
+    hand_out(owned, address as *const raw::c_void, bytes);
+    address
+}
+
+fn now_ms() -> i64 {
+    std::time::SystemTime::now().duration_since(std::time::UNIX_EPOCH).map(|d| d.as_millis() as i64).unwrap_or(0)
+}
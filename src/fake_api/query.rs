@@ -0,0 +1,506 @@
+use std::collections::{BTreeMap, HashMap};
+use std::ffi::{CStr, CString};
+use std::os::raw;
+use std::ptr;
+use std::sync::{Arc, Condvar, Mutex};
+use std::thread;
+use std::time::Duration;
+
+use crate::query::{nanos_to_timespec, timespec_to_nanos};
+use crate::{qdb_dedup_handle_t, qdb_error_t, qdb_error_t_qdb_e_invalid_argument, qdb_error_t_qdb_e_invalid_query,
+            qdb_error_t_qdb_e_invalid_handle, qdb_handle_t, qdb_point_result_t, qdb_point_result_t__bindgen_ty_1,
+            qdb_query_cont_callback_t, qdb_query_cont_handle_t, qdb_query_continuous_mode_type_t, qdb_query_result_t,
+            qdb_query_result_value_type_t, qdb_query_result_value_type_t_qdb_query_result_blob, qdb_query_result_value_type_t_qdb_query_result_double,
+            qdb_query_result_value_type_t_qdb_query_result_int64, qdb_query_result_value_type_t_qdb_query_result_none,
+            qdb_query_result_value_type_t_qdb_query_result_string,
+            qdb_query_result_value_type_t_qdb_query_result_timestamp, qdb_string_t, qdb_ts_range_t};
+
+use super::store::cluster;
+use super::ts::ColumnData;
+use super::{fake_handle, hand_out_value, receive, release, remote};
+
+/// The subset of the query language understood by the fake:
+///    select <*|column, ...> from <table|"table"> [in range(<begin>, <end>)]
+/// where begin is a date, a date and time, or a year, and end is either one of those or
+/// a duration relative to begin such as +1d, +2h, +30min, +10s or +500ms.
+struct RangeQuery {
+    columns: Option<Vec<String>>,
+    table: String,
+    begin: i64,
+    end: i64,
+}
+
+fn parse_query(query: &str) -> Option<RangeQuery> {
+    let query = query.trim().trim_end_matches(';').trim();
+    let lower = query.to_ascii_lowercase();
+    if !lower.starts_with("select ") {
+        return None;
+    }
+
+    let from = lower.find(" from ")?;
+    let list = query[7..from].trim();
+    let columns = if list == "*" {
+        None
+    } else {
+        Some(list.split(',').map(|c| c.trim().to_string()).filter(|c| !c.is_empty()).collect())
+    };
+
+    let rest = query[from + 6..].trim();
+    let (table, clause) = match rest.find(char::is_whitespace) {
+        Some(i) => (&rest[..i], rest[i..].trim()),
+        None => (rest, ""),
+    };
+
+    let (begin, end) = if clause.is_empty() {
+        (i64::MIN, i64::MAX)
+    } else {
+        let clause_lower = clause.to_ascii_lowercase();
+        let inner = clause_lower.strip_prefix("in")?.trim_start().strip_prefix("range")?.trim_start()
+            .strip_prefix('(')?.strip_suffix(')')?;
+        let (b, e) = inner.split_once(',')?;
+        let begin = parse_time(b.trim())?;
+        let e = e.trim();
+        let end = match e.strip_prefix('+') {
+            Some(duration) => begin.checked_add(parse_duration(duration)?)?,
+            None => parse_time(e)?,
+        };
+        (begin, end)
+    };
+
+    let table = table.strip_prefix('"').and_then(|t| t.strip_suffix('"')).unwrap_or(table);
+    Some(RangeQuery { columns, table: table.to_string(), begin, end })
+}
+
+// days since epoch of a civil date, http://howardhinnant.github.io/date_algorithms.html
+fn days_from_civil(year: i64, month: i64, day: i64) -> i64 {
+    let y = if month <= 2 { year - 1 } else { year };
+    let era = y.div_euclid(400);
+    let yoe = y - era * 400;
+    let mp = (month + 9) % 12;
+    let doy = (153 * mp + 2) / 5 + day - 1;
+    let doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    era * 146_097 + doe - 719_468
+}
+
+// 2021, 2021-01-01, 2021-01-01T10:00:00 and 2021-01-01T10:00:00.123456789
+fn parse_time(s: &str) -> Option<i64> {
+    let (date, time) = match s.split_once('t') {
+        Some((d, t)) => (d, Some(t)),
+        None => (s, None),
+    };
+
+    let mut parts = date.split('-');
+    let year: i64 = parts.next()?.parse().ok()?;
+    let month: i64 = parts.next().map_or(Some(1), |m| m.parse().ok())?;
+    let day: i64 = parts.next().map_or(Some(1), |d| d.parse().ok())?;
+    if !(1..=12).contains(&month) || !(1..=31).contains(&day) {
+        return None;
+    }
+
+    let mut nanos = days_from_civil(year, month, day) * 86_400 * 1_000_000_000;
+
+    if let Some(time) = time {
+        let (hms, fraction) = match time.split_once('.') {
+            Some((h, f)) => (h, Some(f)),
+            None => (time, None),
+        };
+        let mut fields = hms.split(':');
+        let h: i64 = fields.next()?.parse().ok()?;
+        let m: i64 = fields.next().map_or(Some(0), |m| m.parse().ok())?;
+        let sec: i64 = fields.next().map_or(Some(0), |s| s.parse().ok())?;
+        nanos += ((h * 60 + m) * 60 + sec) * 1_000_000_000;
+
+        if let Some(f) = fraction {
+            if f.is_empty() || f.len() > 9 || !f.bytes().all(|b| b.is_ascii_digit()) {
+                return None;
+            }
+            nanos += f.parse::<i64>().ok()? * 10i64.pow(9 - f.len() as u32);
+        }
+    }
+
+    Some(nanos)
+}
+
+fn parse_duration(s: &str) -> Option<i64> {
+    let split = s.find(|c: char| !c.is_ascii_digit())?;
+    let count: i64 = s[..split].parse().ok()?;
+    let unit: i64 = match &s[split..] {
+        "ns" => 1,
+        "us" => 1_000,
+        "ms" => 1_000_000,
+        "s" => 1_000_000_000,
+        "min" => 60 * 1_000_000_000,
+        "h" => 3_600 * 1_000_000_000,
+        "d" => 86_400 * 1_000_000_000,
+        _ => return None,
+    };
+    count.checked_mul(unit)
+}
+
+// Everything the result points to lives in the same allocation.
+#[repr(C)]
+struct ResultOwner {
+    result: qdb_query_result_t,
+    _names: Vec<CString>,
+    _name_refs: Vec<qdb_string_t>,
+    _rows: Vec<*mut qdb_point_result_t>,
+    _points: Vec<qdb_point_result_t>,
+    _contents: Vec<Vec<u8>>,
+}
+
+fn point(type_: qdb_query_result_value_type_t, fill: impl FnOnce(&mut qdb_point_result_t__bindgen_ty_1)) -> qdb_point_result_t {
+    let mut payload: qdb_point_result_t__bindgen_ty_1 = unsafe { std::mem::zeroed() };
+    fill(&mut payload);
+    qdb_point_result_t { type_, payload }
+}
+
+fn null_point() -> qdb_point_result_t {
+    point(qdb_query_result_value_type_t_qdb_query_result_none, |_| {})
+}
+
+// Hands out a result of rows of names.len() points, blob and string points referring into contents.
+fn hand_out_result(names: Vec<String>, mut points: Vec<qdb_point_result_t>, contents: Vec<Vec<u8>>,
+                   scanned_point_count: usize) -> *mut qdb_query_result_t {
+    let column_count = names.len();
+    let row_count = if column_count == 0 { 0 } else { points.len() / column_count };
+
+    let names: Vec<CString> = names.into_iter().filter_map(|n| CString::new(n).ok()).collect();
+    let mut name_refs: Vec<qdb_string_t> = names.iter()
+        .map(|n| qdb_string_t { data: n.as_ptr(), length: n.as_bytes().len() })
+        .collect();
+    let mut rows: Vec<*mut qdb_point_result_t> = (0..row_count)
+        .map(|i| unsafe { points.as_mut_ptr().add(i * column_count) })
+        .collect();
+
+    let bytes = std::mem::size_of::<qdb_query_result_t>()
+        + row_count * std::mem::size_of::<*mut qdb_point_result_t>()
+        + points.len() * std::mem::size_of::<qdb_point_result_t>()
+        + contents.iter().map(|c| c.len()).sum::<usize>();
+    receive(bytes);
+
+    let owner = ResultOwner {
+        result: qdb_query_result_t {
+            column_names: name_refs.as_mut_ptr(),
+            column_count,
+            rows: if row_count == 0 { ptr::null_mut() } else { rows.as_mut_ptr() },
+            row_count,
+            scanned_point_count,
+            error_message: qdb_string_t { data: ptr::null(), length: 0 },
+        },
+        _names: names,
+        _name_refs: name_refs,
+        _rows: rows,
+        _points: points,
+        _contents: contents,
+    };
+    hand_out_value(owner, bytes) as *mut qdb_query_result_t
+}
+
+fn run_query(query: &RangeQuery) -> Result<*mut qdb_query_result_t, qdb_error_t> {
+    let mut cluster = cluster();
+    let table = cluster.table(&query.table).map_err(|_| qdb_error_t_qdb_e_invalid_query)?;
+
+    let selected: Vec<usize> = match &query.columns {
+        None => (0..table.columns.len()).collect(),
+        Some(names) => {
+            let mut indices = Vec::with_capacity(names.len());
+            for name in names {
+                match table.columns.iter().position(|c| &c.name == name) {
+                    Some(i) => indices.push(i),
+                    None => return Err(qdb_error_t_qdb_e_invalid_query),
+                }
+            }
+            indices
+        }
+    };
+
+    // copy the ranges out so that the rows are built without holding the cluster
+    let mut names = Vec::with_capacity(selected.len() + 1);
+    names.push("$timestamp".to_string());
+    let mut ranges: Vec<Vec<(i64, qdb_point_result_t)>> = Vec::with_capacity(selected.len());
+    for index in &selected {
+        let column = &table.columns[*index];
+        names.push(column.name.clone());
+        ranges.push(match &column.data {
+            ColumnData::Double(s) => s.range(query.begin, query.end)
+                .map(|(t, v)| (t, point(qdb_query_result_value_type_t_qdb_query_result_double, |p| p.double_.value = v)))
+                .collect(),
+            ColumnData::Int64(s) => s.range(query.begin, query.end)
+                .map(|(t, v)| (t, point(qdb_query_result_value_type_t_qdb_query_result_int64, |p| p.int64_.value = v)))
+                .collect(),
+            ColumnData::Other => Vec::new(),
+        });
+    }
+    drop(cluster);
+
+    // one row per timestamp, or several when a column has several points at the same timestamp
+    let mut rows: BTreeMap<(i64, usize), Vec<qdb_point_result_t>> = BTreeMap::new();
+    let scanned = ranges.iter().map(|r| r.len()).sum();
+    let width = selected.len();
+
+    for (position, range) in ranges.into_iter().enumerate() {
+        let mut previous: Option<(i64, usize)> = None;
+        for (t, p) in range {
+            let occurrence = match previous {
+                Some((pt, n)) if pt == t => n + 1,
+                _ => 0,
+            };
+            previous = Some((t, occurrence));
+            rows.entry((t, occurrence)).or_insert_with(|| vec![null_point(); width])[position] = p;
+        }
+    }
+
+    let mut points = Vec::with_capacity(rows.len() * (width + 1));
+    for ((t, _), row) in rows {
+        points.push(point(qdb_query_result_value_type_t_qdb_query_result_timestamp, |p| p.timestamp.value = nanos_to_timespec(t)));
+        points.extend(row);
+    }
+
+    Ok(hand_out_result(names, points, Vec::new(), scanned))
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_query(handle: qdb_handle_t, query: *const raw::c_char,
+                                   result: *mut *mut qdb_query_result_t) -> qdb_error_t {
+    if query.is_null() || result.is_null() {
+        return qdb_error_t_qdb_e_invalid_argument;
+    }
+    *result = ptr::null_mut();
+
+    let text = CStr::from_ptr(query).to_string_lossy();
+    if let Err(e) = remote(handle, text.len()) {
+        return e;
+    }
+
+    let parsed = match parse_query(&text) {
+        Some(q) => q,
+        None => return qdb_error_t_qdb_e_invalid_query,
+    };
+    match run_query(&parsed) {
+        Ok(r) => {
+            *result = r;
+            0
+        }
+        Err(e) => e,
+    }
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_query_copy_results(handle: qdb_handle_t, result: *const qdb_query_result_t,
+                                                result_copy: *mut *mut qdb_query_result_t) -> qdb_error_t {
+    if let Err(e) = fake_handle(handle) {
+        return e;
+    }
+    if result_copy.is_null() {
+        return qdb_error_t_qdb_e_invalid_argument;
+    }
+    let source = match result.as_ref() {
+        Some(r) => r,
+        None => return qdb_error_t_qdb_e_invalid_argument,
+    };
+
+    *result_copy = copy_rows(source, |_| true);
+    0
+}
+
+// Hands out a copy of the rows of source that keep accepts, blobs and strings included.
+unsafe fn copy_rows(source: &qdb_query_result_t, mut keep: impl FnMut(&[qdb_point_result_t]) -> bool) -> *mut qdb_query_result_t {
+    let names: Vec<String> = (0..source.column_count)
+        .map(|i| {
+            let n = &*source.column_names.add(i);
+            String::from_utf8_lossy(std::slice::from_raw_parts(n.data as *const u8, n.length)).into_owned()
+        })
+        .collect();
+
+    let mut points = Vec::with_capacity(source.row_count * source.column_count);
+    let mut contents: Vec<Vec<u8>> = Vec::new();
+    for r in 0..source.row_count {
+        let row = std::slice::from_raw_parts(*source.rows.add(r), source.column_count);
+        if !keep(row) {
+            continue;
+        }
+        for &p in row {
+            let mut p = p;
+            if p.type_ == qdb_query_result_value_type_t_qdb_query_result_blob {
+                let copy = std::slice::from_raw_parts(p.payload.blob.content as *const u8, p.payload.blob.content_length).to_vec();
+                p.payload.blob.content = copy.as_ptr() as *const raw::c_void;
+                contents.push(copy);
+            } else if p.type_ == qdb_query_result_value_type_t_qdb_query_result_string {
+                let copy = std::slice::from_raw_parts(p.payload.string.content as *const u8, p.payload.string.content_length).to_vec();
+                p.payload.string.content = copy.as_ptr() as *const raw::c_char;
+                contents.push(copy);
+            }
+            points.push(p);
+        }
+    }
+
+    hand_out_result(names, points, contents, source.scanned_point_count)
+}
+
+// A continuous query is a thread running the query every refresh_rate_ms, stopped and joined on release.
+// The fake reports the whole result on every refresh whatever the mode, deduplication keeps the new rows.
+struct Continuous {
+    stop: Arc<(Mutex<bool>, Condvar)>,
+    refresh: Option<thread::JoinHandle<()>>,
+}
+
+impl Drop for Continuous {
+    fn drop(&mut self) {
+        let (stopped, wake) = &*self.stop;
+        *stopped.lock().unwrap() = true;
+        wake.notify_all();
+        if let Some(refresh) = self.refresh.take() {
+            // released from its own callback, the loop ends after it returns
+            if refresh.thread().id() != thread::current().id() {
+                let _ = refresh.join();
+            }
+        }
+    }
+}
+
+// The handle and the context belong to the caller, who keeps them valid until the query is released.
+struct Refresh {
+    handle: qdb_handle_t,
+    context: *mut raw::c_void,
+}
+
+unsafe impl Send for Refresh {}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_query_continuous(handle: qdb_handle_t, query: *const raw::c_char,
+                                              _mode: qdb_query_continuous_mode_type_t, refresh_rate_ms: raw::c_uint,
+                                              cb: qdb_query_cont_callback_t, cb_context: *mut raw::c_void,
+                                              cont_handle: *mut qdb_query_cont_handle_t) -> qdb_error_t {
+    if query.is_null() || cont_handle.is_null() || refresh_rate_ms == 0 {
+        return qdb_error_t_qdb_e_invalid_argument;
+    }
+    let cb = match cb {
+        Some(cb) => cb,
+        None => return qdb_error_t_qdb_e_invalid_argument,
+    };
+    *cont_handle = ptr::null_mut();
+
+    let text = CStr::from_ptr(query).to_string_lossy().into_owned();
+    if let Err(e) = remote(handle, text.len()) {
+        return e;
+    }
+    let parsed = match parse_query(&text) {
+        Some(q) => q,
+        None => return qdb_error_t_qdb_e_invalid_query,
+    };
+
+    let stop = Arc::new((Mutex::new(false), Condvar::new()));
+    let refresh = Refresh { handle, context: cb_context };
+    let rate = Duration::from_millis(refresh_rate_ms as u64);
+
+    let signal = stop.clone();
+    let thread = thread::spawn(move || {
+        let refresh = refresh;
+        let (stopped, wake) = &*signal;
+        loop {
+            let guard = wake.wait_timeout_while(stopped.lock().unwrap(), rate, |s| !*s).unwrap().0;
+            if *guard {
+                return;
+            }
+            drop(guard);
+
+            let (err, result) = match remote(refresh.handle, text.len()).and_then(|()| run_query(&parsed)) {
+                Ok(r) => (0, r),
+                Err(e) => (e, ptr::null_mut()),
+            };
+            let carry_on = cb(refresh.context, err, result) == 0;
+            if !result.is_null() {
+                release(result as *const raw::c_void);
+            }
+            if !carry_on {
+                return;
+            }
+        }
+    });
+
+    let continuous = Continuous { stop, refresh: Some(thread) };
+    *cont_handle = hand_out_value(continuous, std::mem::size_of::<Continuous>()) as qdb_query_cont_handle_t;
+    0
+}
+
+// The rows already seen by a deduplication handle, with their timestamp to prune them.
+struct Dedup {
+    seen: Mutex<HashMap<Vec<u8>, i64>>,
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_init_query_dedup(handle: qdb_handle_t, dedup_handle: *mut qdb_dedup_handle_t) -> qdb_error_t {
+    if let Err(e) = fake_handle(handle) {
+        return e;
+    }
+    if dedup_handle.is_null() {
+        return qdb_error_t_qdb_e_invalid_argument;
+    }
+    let dedup = Dedup { seen: Mutex::new(HashMap::new()) };
+    *dedup_handle = hand_out_value(dedup, std::mem::size_of::<Dedup>()) as qdb_dedup_handle_t;
+    0
+}
+
+// The bytes identifying a row, and its timestamp, the first timestamp point of the row.
+unsafe fn row_key(row: &[qdb_point_result_t]) -> (Vec<u8>, i64) {
+    let mut key = Vec::new();
+    let mut timestamp = None;
+    for p in row {
+        key.extend_from_slice(&(p.type_ as i64).to_le_bytes());
+        match p.type_ {
+            t if t == qdb_query_result_value_type_t_qdb_query_result_double => key.extend_from_slice(&p.payload.double_.value.to_bits().to_le_bytes()),
+            t if t == qdb_query_result_value_type_t_qdb_query_result_int64 => key.extend_from_slice(&p.payload.int64_.value.to_le_bytes()),
+            t if t == qdb_query_result_value_type_t_qdb_query_result_timestamp => {
+                let nanos = timespec_to_nanos(&p.payload.timestamp.value);
+                timestamp.get_or_insert(nanos);
+                key.extend_from_slice(&nanos.to_le_bytes());
+            }
+            t if t == qdb_query_result_value_type_t_qdb_query_result_blob => {
+                key.extend_from_slice(&p.payload.blob.content_length.to_le_bytes());
+                key.extend_from_slice(std::slice::from_raw_parts(p.payload.blob.content as *const u8, p.payload.blob.content_length));
+            }
+            t if t == qdb_query_result_value_type_t_qdb_query_result_string => {
+                key.extend_from_slice(&p.payload.string.content_length.to_le_bytes());
+                key.extend_from_slice(std::slice::from_raw_parts(p.payload.string.content as *const u8, p.payload.string.content_length));
+            }
+            _ => {}
+        }
+    }
+    (key, timestamp.unwrap_or(i64::MIN))
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_query_dedup(dedup_handle: qdb_dedup_handle_t, result: *const qdb_query_result_t,
+                                         dedup_result: *mut *mut qdb_query_result_t) -> qdb_error_t {
+    let dedup = match (dedup_handle as *const Dedup).as_ref() {
+        Some(d) => d,
+        None => return qdb_error_t_qdb_e_invalid_handle,
+    };
+    let source = match result.as_ref() {
+        Some(r) if !dedup_result.is_null() => r,
+        _ => return qdb_error_t_qdb_e_invalid_argument,
+    };
+
+    let mut seen = dedup.seen.lock().unwrap();
+    *dedup_result = copy_rows(source, |row| {
+        let (key, timestamp) = row_key(row);
+        seen.insert(key, timestamp).is_none()
+    });
+    0
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_query_dedup_prune(dedup_handle: qdb_dedup_handle_t, range: *const qdb_ts_range_t) -> qdb_error_t {
+    let dedup = match (dedup_handle as *const Dedup).as_ref() {
+        Some(d) => d,
+        None => return qdb_error_t_qdb_e_invalid_handle,
+    };
+    let range = match range.as_ref() {
+        Some(r) => r,
+        None => return qdb_error_t_qdb_e_invalid_argument,
+    };
+
+    let (begin, end) = (timespec_to_nanos(&range.begin), timespec_to_nanos(&range.end));
+    dedup.seen.lock().unwrap().retain(|_, t| *t < begin || *t >= end);
+    0
+}
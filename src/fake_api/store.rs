@@ -0,0 +1,377 @@
+use std::collections::{BTreeMap, BTreeSet};
+use std::sync::atomic::{AtomicI64, Ordering};
+use std::sync::{Mutex, MutexGuard, OnceLock};
+use std::time::{SystemTime, UNIX_EPOCH};
+
+use crate::{qdb_entry_type_t, qdb_entry_type_t_qdb_entry_blob, qdb_entry_type_t_qdb_entry_double, qdb_entry_type_t_qdb_entry_integer,
+            qdb_entry_type_t_qdb_entry_tag, qdb_entry_type_t_qdb_entry_ts, qdb_error_t,
+            qdb_error_t_qdb_e_alias_already_exists, qdb_error_t_qdb_e_alias_not_found,
+            qdb_error_t_qdb_e_incompatible_type, qdb_error_t_qdb_e_tag_already_set, qdb_error_t_qdb_e_tag_not_set};
+
+use super::now_ms;
+use super::ts::Table;
+
+// qdb_never_expires and qdb_preserve_expiration of client.h
+pub(super) const NEVER_EXPIRES: i64 = 0;
+pub(super) const PRESERVE_EXPIRATION: i64 = -1;
+
+pub(super) enum Value {
+    Blob(Vec<u8>),
+    Integer(i64),
+    Double(f64),
+    // the aliases carrying the tag
+    Tag(BTreeSet<String>),
+    Table(Table),
+}
+
+pub(super) struct Entry {
+    pub value: Value,
+    // milliseconds since epoch, NEVER_EXPIRES if the entry does not expire
+    pub expiry: i64,
+    pub tags: BTreeSet<String>,
+    // nanoseconds since epoch of the last change of the value, see modified_now
+    pub modified: i64,
+}
+
+impl Entry {
+    pub fn entry_type(&self) -> qdb_entry_type_t {
+        match self.value {
+            Value::Blob(_) => qdb_entry_type_t_qdb_entry_blob,
+            Value::Integer(_) => qdb_entry_type_t_qdb_entry_integer,
+            Value::Double(_) => qdb_entry_type_t_qdb_entry_double,
+            Value::Tag(_) => qdb_entry_type_t_qdb_entry_tag,
+            Value::Table(_) => qdb_entry_type_t_qdb_entry_ts,
+        }
+    }
+
+    fn expired(&self, now: i64) -> bool {
+        self.expiry != NEVER_EXPIRES && self.expiry <= now
+    }
+}
+
+/// CasOutcome : Result of a compare and swap that reached the entry.
+pub(super) enum CasOutcome {
+    Swapped,
+    // the comparand did not match, carries the current content
+    Unmatched(Vec<u8>),
+}
+
+/// Cluster : Every entry of the in-process cluster, sorted by alias so that prefix scans are ranges.
+pub(super) struct Cluster {
+    entries: BTreeMap<String, Entry>,
+}
+
+static CLUSTER: OnceLock<Mutex<Cluster>> = OnceLock::new();
+
+pub(super) fn cluster() -> MutexGuard<'static, Cluster> {
+    CLUSTER.get_or_init(|| Mutex::new(Cluster { entries: BTreeMap::new() })).lock().unwrap()
+}
+
+static LAST_MODIFIED: AtomicI64 = AtomicI64::new(0);
+
+// Wall clock nanoseconds, strictly increasing so that two changes never share a modification time.
+pub(super) fn modified_now() -> i64 {
+    let now = SystemTime::now().duration_since(UNIX_EPOCH).map(|d| d.as_nanos() as i64).unwrap_or(0);
+    let mut last = LAST_MODIFIED.load(Ordering::Relaxed);
+    loop {
+        let next = now.max(last + 1);
+        match LAST_MODIFIED.compare_exchange_weak(last, next, Ordering::Relaxed, Ordering::Relaxed) {
+            Ok(_) => return next,
+            Err(current) => last = current,
+        }
+    }
+}
+
+fn new_expiry(current: Option<i64>, expiry: i64) -> i64 {
+    if expiry == PRESERVE_EXPIRATION {
+        current.unwrap_or(NEVER_EXPIRES)
+    } else {
+        expiry
+    }
+}
+
+impl Cluster {
+    pub fn clear(&mut self) {
+        self.entries.clear();
+    }
+
+    /// Get : Returns the entry, removing it first if it has expired.
+    pub fn get(&mut self, alias: &str) -> Result<&mut Entry, qdb_error_t> {
+        let expired = match self.entries.get(alias) {
+            Some(e) => e.expired(now_ms()),
+            None => return Err(qdb_error_t_qdb_e_alias_not_found),
+        };
+        if expired {
+            let _ = self.remove(alias);
+            return Err(qdb_error_t_qdb_e_alias_not_found);
+        }
+        Ok(self.entries.get_mut(alias).unwrap())
+    }
+
+    /// Create : Adds a new entry, fails if the alias is taken.
+    pub fn create(&mut self, alias: &str, value: Value, expiry: i64) -> Result<&mut Entry, qdb_error_t> {
+        if self.get(alias).is_ok() {
+            return Err(qdb_error_t_qdb_e_alias_already_exists);
+        }
+        let expiry = new_expiry(None, expiry);
+        Ok(self.entries.entry(alias.to_string()).or_insert(Entry { value, expiry, tags: BTreeSet::new(), modified: modified_now() }))
+    }
+
+    /// Remove : Removes the entry and every tag association it is part of.
+    pub fn remove(&mut self, alias: &str) -> Result<Entry, qdb_error_t> {
+        let entry = match self.entries.remove(alias) {
+            Some(e) => e,
+            None => return Err(qdb_error_t_qdb_e_alias_not_found),
+        };
+
+        for tag in &entry.tags {
+            let emptied = match self.entries.get_mut(tag) {
+                Some(Entry { value: Value::Tag(aliases), .. }) => {
+                    aliases.remove(alias);
+                    aliases.is_empty()
+                }
+                _ => false,
+            };
+            if emptied {
+                self.entries.remove(tag);
+            }
+        }
+
+        if let Value::Tag(aliases) = &entry.value {
+            for tagged in aliases {
+                if let Some(e) = self.entries.get_mut(tagged) {
+                    e.tags.remove(alias);
+                }
+            }
+        }
+
+        Ok(entry)
+    }
+
+    pub fn expires_at(&mut self, alias: &str, expiry: i64) -> Result<(), qdb_error_t> {
+        let entry = self.get(alias)?;
+        match entry.value {
+            Value::Blob(_) | Value::Integer(_) | Value::Double(_) => {
+                entry.expiry = new_expiry(Some(entry.expiry), expiry);
+                Ok(())
+            }
+            _ => Err(qdb_error_t_qdb_e_incompatible_type),
+        }
+    }
+
+    /// WithPrefix : Returns up to max aliases starting with prefix, in alias order.
+    pub fn with_prefix(&mut self, prefix: &str, max: usize) -> Vec<String> {
+        let now = now_ms();
+        self.entries
+            .range(prefix.to_string()..)
+            .take_while(|(alias, _)| alias.starts_with(prefix))
+            .filter(|(_, e)| !e.expired(now))
+            .map(|(alias, _)| alias.clone())
+            .take(max)
+            .collect()
+    }
+
+    /// WithSuffix : Returns up to max aliases ending with suffix, in alias order.
+    pub fn with_suffix(&mut self, suffix: &str, max: usize) -> Vec<String> {
+        let now = now_ms();
+        self.entries
+            .iter()
+            .filter(|(alias, e)| alias.ends_with(suffix) && !e.expired(now))
+            .map(|(alias, _)| alias.clone())
+            .take(max)
+            .collect()
+    }
+
+    pub fn attach_tag(&mut self, alias: &str, tag: &str) -> Result<(), qdb_error_t> {
+        if !self.get(alias)?.tags.insert(tag.to_string()) {
+            return Err(qdb_error_t_qdb_e_tag_already_set);
+        }
+
+        let entry = self.entries.entry(tag.to_string()).or_insert(Entry {
+            value: Value::Tag(BTreeSet::new()),
+            expiry: NEVER_EXPIRES,
+            tags: BTreeSet::new(),
+            modified: modified_now(),
+        });
+        match &mut entry.value {
+            Value::Tag(aliases) => {
+                aliases.insert(alias.to_string());
+                Ok(())
+            }
+            _ => {
+                self.entries.get_mut(alias).unwrap().tags.remove(tag);
+                Err(qdb_error_t_qdb_e_incompatible_type)
+            }
+        }
+    }
+
+    pub fn detach_tag(&mut self, alias: &str, tag: &str) -> Result<(), qdb_error_t> {
+        if !self.get(alias)?.tags.remove(tag) {
+            return Err(qdb_error_t_qdb_e_tag_not_set);
+        }
+
+        let emptied = match self.entries.get_mut(tag) {
+            Some(Entry { value: Value::Tag(aliases), .. }) => {
+                aliases.remove(alias);
+                aliases.is_empty()
+            }
+            _ => false,
+        };
+        if emptied {
+            self.entries.remove(tag);
+        }
+        Ok(())
+    }
+
+    pub fn has_tag(&mut self, alias: &str, tag: &str) -> Result<bool, qdb_error_t> {
+        Ok(self.get(alias)?.tags.contains(tag))
+    }
+
+    pub fn tags(&mut self, alias: &str) -> Result<Vec<String>, qdb_error_t> {
+        Ok(self.get(alias)?.tags.iter().cloned().collect())
+    }
+
+    pub fn tagged(&mut self, tag: &str) -> Result<Vec<String>, qdb_error_t> {
+        match &self.get(tag)?.value {
+            Value::Tag(aliases) => Ok(aliases.iter().cloned().collect()),
+            _ => Err(qdb_error_t_qdb_e_incompatible_type),
+        }
+    }
+
+    pub fn blob(&mut self, alias: &str) -> Result<&[u8], qdb_error_t> {
+        match &self.get(alias)?.value {
+            Value::Blob(content) => Ok(content),
+            _ => Err(qdb_error_t_qdb_e_incompatible_type),
+        }
+    }
+
+    pub fn blob_put(&mut self, alias: &str, content: &[u8], expiry: i64) -> Result<(), qdb_error_t> {
+        self.create(alias, Value::Blob(content.to_vec()), expiry).map(|_| ())
+    }
+
+    pub fn blob_update(&mut self, alias: &str, content: &[u8], expiry: i64) -> Result<(), qdb_error_t> {
+        match self.blob_get_and_update(alias, content, expiry) {
+            Ok(_) => Ok(()),
+            Err(e) if e == qdb_error_t_qdb_e_alias_not_found => self.blob_put(alias, content, expiry),
+            Err(e) => Err(e),
+        }
+    }
+
+    /// BlobGetAndUpdate : Replaces the content of an existing blob and returns the previous one.
+    pub fn blob_get_and_update(&mut self, alias: &str, content: &[u8], expiry: i64) -> Result<Vec<u8>, qdb_error_t> {
+        let entry = self.get(alias)?;
+        match &mut entry.value {
+            Value::Blob(current) => {
+                let previous = std::mem::replace(current, content.to_vec());
+                entry.expiry = new_expiry(Some(entry.expiry), expiry);
+                entry.modified = modified_now();
+                Ok(previous)
+            }
+            _ => Err(qdb_error_t_qdb_e_incompatible_type),
+        }
+    }
+
+    /// BlobCas : Replaces the content if the part of it starting at offset equals the comparand.
+    pub fn blob_cas(&mut self, alias: &str, content: &[u8], comparand: &[u8], offset: usize, expiry: i64)
+                    -> Result<CasOutcome, qdb_error_t> {
+        let entry = self.get(alias)?;
+        match &mut entry.value {
+            Value::Blob(current) => {
+                let matched = current.get(offset..offset + comparand.len()).map_or(false, |c| c == comparand);
+                if !matched {
+                    return Ok(CasOutcome::Unmatched(current.clone()));
+                }
+                *current = content.to_vec();
+                entry.expiry = new_expiry(Some(entry.expiry), expiry);
+                entry.modified = modified_now();
+                Ok(CasOutcome::Swapped)
+            }
+            _ => Err(qdb_error_t_qdb_e_incompatible_type),
+        }
+    }
+
+    pub fn int(&mut self, alias: &str) -> Result<i64, qdb_error_t> {
+        match self.get(alias)?.value {
+            Value::Integer(v) => Ok(v),
+            _ => Err(qdb_error_t_qdb_e_incompatible_type),
+        }
+    }
+
+    pub fn int_put(&mut self, alias: &str, value: i64, expiry: i64) -> Result<(), qdb_error_t> {
+        self.create(alias, Value::Integer(value), expiry).map(|_| ())
+    }
+
+    pub fn int_update(&mut self, alias: &str, value: i64, expiry: i64) -> Result<(), qdb_error_t> {
+        match self.get(alias) {
+            Ok(entry) => match &mut entry.value {
+                Value::Integer(current) => {
+                    *current = value;
+                    entry.expiry = new_expiry(Some(entry.expiry), expiry);
+                    entry.modified = modified_now();
+                    Ok(())
+                }
+                _ => Err(qdb_error_t_qdb_e_incompatible_type),
+            },
+            Err(_) => self.int_put(alias, value, expiry),
+        }
+    }
+
+    /// IntAdd : Adds addend to an existing integer and returns the new value, wrapping on overflow.
+    pub fn int_add(&mut self, alias: &str, addend: i64) -> Result<i64, qdb_error_t> {
+        let entry = self.get(alias)?;
+        match &mut entry.value {
+            Value::Integer(current) => {
+                *current = current.wrapping_add(addend);
+                entry.modified = modified_now();
+                Ok(*current)
+            }
+            _ => Err(qdb_error_t_qdb_e_incompatible_type),
+        }
+    }
+
+    pub fn double(&mut self, alias: &str) -> Result<f64, qdb_error_t> {
+        match self.get(alias)?.value {
+            Value::Double(v) => Ok(v),
+            _ => Err(qdb_error_t_qdb_e_incompatible_type),
+        }
+    }
+
+    pub fn double_put(&mut self, alias: &str, value: f64, expiry: i64) -> Result<(), qdb_error_t> {
+        self.create(alias, Value::Double(value), expiry).map(|_| ())
+    }
+
+    pub fn double_update(&mut self, alias: &str, value: f64, expiry: i64) -> Result<(), qdb_error_t> {
+        match self.get(alias) {
+            Ok(entry) => match &mut entry.value {
+                Value::Double(current) => {
+                    *current = value;
+                    entry.expiry = new_expiry(Some(entry.expiry), expiry);
+                    entry.modified = modified_now();
+                    Ok(())
+                }
+                _ => Err(qdb_error_t_qdb_e_incompatible_type),
+            },
+            Err(_) => self.double_put(alias, value, expiry),
+        }
+    }
+
+    /// DoubleAdd : Adds addend to an existing double and returns the new value.
+    pub fn double_add(&mut self, alias: &str, addend: f64) -> Result<f64, qdb_error_t> {
+        let entry = self.get(alias)?;
+        match &mut entry.value {
+            Value::Double(current) => {
+                *current += addend;
+                entry.modified = modified_now();
+                Ok(*current)
+            }
+            _ => Err(qdb_error_t_qdb_e_incompatible_type),
+        }
+    }
+
+    pub fn table(&mut self, alias: &str) -> Result<&mut Table, qdb_error_t> {
+        match &mut self.get(alias)?.value {
+            Value::Table(t) => Ok(t),
+            _ => Err(qdb_error_t_qdb_e_incompatible_type),
+        }
+    }
+}
@@ -0,0 +1,191 @@
+use std::os::raw;
+
+use crate::{qdb_error_t, qdb_error_t_qdb_e_invalid_argument, qdb_error_t_qdb_e_tag_already_set, qdb_error_t_qdb_e_tag_not_set, qdb_handle_t, qdb_uint_t};
+
+use super::store::cluster;
+use super::{alias_arg, hand_out_strings, receive, remote, status};
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_attach_tag(handle: qdb_handle_t, alias: *const raw::c_char, tag: *const raw::c_char) -> qdb_error_t {
+    let (alias, tag) = match (alias_arg(alias), alias_arg(tag)) {
+        (Ok(a), Ok(t)) => (a, t),
+        (Err(e), _) | (_, Err(e)) => return e,
+    };
+    if let Err(e) = remote(handle, alias.len() + tag.len()) {
+        return e;
+    }
+    status(cluster().attach_tag(alias, tag))
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_attach_tags(handle: qdb_handle_t, alias: *const raw::c_char, tags: *const *const raw::c_char,
+                                         tag_count: usize) -> qdb_error_t {
+    let alias = match alias_arg(alias) {
+        Ok(a) => a,
+        Err(e) => return e,
+    };
+    if tags.is_null() && tag_count > 0 {
+        return qdb_error_t_qdb_e_invalid_argument;
+    }
+    let mut names = Vec::with_capacity(tag_count);
+    for i in 0..tag_count {
+        match alias_arg(*tags.add(i)) {
+            Ok(t) => names.push(t),
+            Err(e) => return e,
+        }
+    }
+    if let Err(e) = remote(handle, alias.len() + names.iter().map(|t| t.len()).sum::<usize>()) {
+        return e;
+    }
+
+    // tags already set are not an error when attaching several
+    let mut cluster = cluster();
+    for tag in names {
+        if let Err(e) = cluster.attach_tag(alias, tag) {
+            if e != qdb_error_t_qdb_e_tag_already_set {
+                return e;
+            }
+        }
+    }
+    0
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_detach_tag(handle: qdb_handle_t, alias: *const raw::c_char, tag: *const raw::c_char) -> qdb_error_t {
+    let (alias, tag) = match (alias_arg(alias), alias_arg(tag)) {
+        (Ok(a), Ok(t)) => (a, t),
+        (Err(e), _) | (_, Err(e)) => return e,
+    };
+    if let Err(e) = remote(handle, alias.len() + tag.len()) {
+        return e;
+    }
+    status(cluster().detach_tag(alias, tag))
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_detach_tags(handle: qdb_handle_t, alias: *const raw::c_char, tags: *const *const raw::c_char,
+                                         tag_count: usize) -> qdb_error_t {
+    let alias = match alias_arg(alias) {
+        Ok(a) => a,
+        Err(e) => return e,
+    };
+    if tags.is_null() && tag_count > 0 {
+        return qdb_error_t_qdb_e_invalid_argument;
+    }
+    let mut names = Vec::with_capacity(tag_count);
+    for i in 0..tag_count {
+        match alias_arg(*tags.add(i)) {
+            Ok(t) => names.push(t),
+            Err(e) => return e,
+        }
+    }
+    if let Err(e) = remote(handle, alias.len() + names.iter().map(|t| t.len()).sum::<usize>()) {
+        return e;
+    }
+
+    let mut cluster = cluster();
+    for tag in names {
+        if let Err(e) = cluster.detach_tag(alias, tag) {
+            if e != qdb_error_t_qdb_e_tag_not_set {
+                return e;
+            }
+        }
+    }
+    0
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_has_tag(handle: qdb_handle_t, alias: *const raw::c_char, tag: *const raw::c_char) -> qdb_error_t {
+    let (alias, tag) = match (alias_arg(alias), alias_arg(tag)) {
+        (Ok(a), Ok(t)) => (a, t),
+        (Err(e), _) | (_, Err(e)) => return e,
+    };
+    if let Err(e) = remote(handle, alias.len() + tag.len()) {
+        return e;
+    }
+    match cluster().has_tag(alias, tag) {
+        Ok(true) => 0,
+        Ok(false) => qdb_error_t_qdb_e_tag_not_set,
+        Err(e) => e,
+    }
+}
+
+unsafe fn hand_out_list(list: Vec<String>, results: *mut *mut *const raw::c_char, count: *mut usize) {
+    receive(list.iter().map(|a| a.len() + 1).sum());
+    let (address, n) = hand_out_strings(list);
+    *results = address;
+    *count = n;
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_get_tags(handle: qdb_handle_t, alias: *const raw::c_char, tags: *mut *mut *const raw::c_char,
+                                      tag_count: *mut usize) -> qdb_error_t {
+    let alias = match alias_arg(alias) {
+        Ok(a) => a,
+        Err(e) => return e,
+    };
+    if tags.is_null() || tag_count.is_null() {
+        return qdb_error_t_qdb_e_invalid_argument;
+    }
+    if let Err(e) = remote(handle, alias.len()) {
+        return e;
+    }
+
+    let list = match cluster().tags(alias) {
+        Ok(l) => l,
+        Err(e) => return e,
+    };
+    hand_out_list(list, tags, tag_count);
+    0
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_get_tagged(handle: qdb_handle_t, tag: *const raw::c_char, aliases: *mut *mut *const raw::c_char,
+                                        alias_count: *mut usize) -> qdb_error_t {
+    let tag = match alias_arg(tag) {
+        Ok(t) => t,
+        Err(e) => return e,
+    };
+    if aliases.is_null() || alias_count.is_null() {
+        return qdb_error_t_qdb_e_invalid_argument;
+    }
+    if let Err(e) = remote(handle, tag.len()) {
+        return e;
+    }
+
+    let list = match cluster().tagged(tag) {
+        Ok(l) => l,
+        Err(e) => return e,
+    };
+    hand_out_list(list, aliases, alias_count);
+    0
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_get_tagged_count(handle: qdb_handle_t, tag: *const raw::c_char, count: *mut qdb_uint_t) -> qdb_error_t {
+    let tag = match alias_arg(tag) {
+        Ok(t) => t,
+        Err(e) => return e,
+    };
+    if count.is_null() {
+        return qdb_error_t_qdb_e_invalid_argument;
+    }
+    if let Err(e) = remote(handle, tag.len()) {
+        return e;
+    }
+
+    match cluster().tagged(tag) {
+        Ok(l) => {
+            *count = l.len() as qdb_uint_t;
+            0
+        }
+        Err(e) => e,
+    }
+}
+
+// The fake has a single node, hence the approximation is exact.
+#[no_mangle]
+pub unsafe extern "C" fn qdb_get_tagged_approximate_count(handle: qdb_handle_t, tag: *const raw::c_char,
+                                                          count: *mut qdb_uint_t) -> qdb_error_t {
+    qdb_get_tagged_count(handle, tag, count)
+}
@@ -0,0 +1,609 @@
+use std::ffi::CString;
+use std::os::raw;
+use std::ptr;
+
+use crate::query::nanos_to_timespec;
+use crate::{qdb_error_t, qdb_error_t_qdb_e_buffer_too_small, qdb_error_t_qdb_e_column_not_found, qdb_error_t_qdb_e_incompatible_type,
+            qdb_error_t_qdb_e_invalid_argument, qdb_exp_batch_push_mode_t, qdb_exp_batch_push_mode_t_qdb_exp_batch_push_truncate,
+            qdb_exp_batch_push_options_t, qdb_exp_batch_push_options_t_qdb_exp_batch_option_standard,
+            qdb_exp_batch_push_options_t_qdb_exp_batch_option_unique,
+            qdb_exp_batch_push_options_t_qdb_exp_batch_option_unique_upsert, qdb_exp_batch_push_table_schema_t,
+            qdb_exp_batch_push_table_t, qdb_handle_t, qdb_size_t, qdb_string_t, qdb_timespec_t, qdb_ts_column_info_ex_t,
+            qdb_ts_column_info_t, qdb_ts_column_type_t, qdb_ts_column_type_t_qdb_ts_column_double,
+            qdb_ts_column_type_t_qdb_ts_column_int64, qdb_ts_double_point, qdb_ts_int64_point, qdb_ts_metadata_t,
+            qdb_ts_range_t, qdb_uint_t};
+
+use super::store::{cluster, Value, NEVER_EXPIRES};
+use super::{alias_arg, hand_out, hand_out_value, receive, remote, status};
+
+/// Series : Points of one column in timestamp order, timestamps and values stored side by side.
+pub(super) struct Series<T> {
+    pub timestamps: Vec<i64>,
+    pub values: Vec<T>,
+}
+
+impl<T: Copy> Series<T> {
+    fn new() -> Series<T> {
+        Series { timestamps: Vec::new(), values: Vec::new() }
+    }
+
+    fn insert(&mut self, points: &[(i64, T)]) {
+        let in_order = points.windows(2).all(|w| w[0].0 <= w[1].0)
+            && points.first().map_or(true, |p| self.timestamps.last().map_or(true, |last| *last <= p.0));
+
+        if in_order {
+            // the common case, appending after the last point
+            self.timestamps.extend(points.iter().map(|p| p.0));
+            self.values.extend(points.iter().map(|p| p.1));
+            return;
+        }
+
+        let mut points = points.to_vec();
+        // stable, points sharing a timestamp keep their insertion order
+        points.sort_by_key(|p| p.0);
+
+        // only the points after the first inserted timestamp move, writers stay close to the end
+        let split = self.timestamps.partition_point(|t| *t <= points[0].0);
+        let tail_timestamps = self.timestamps.split_off(split);
+        let tail_values = self.values.split_off(split);
+
+        let mut tail = tail_timestamps.into_iter().zip(tail_values).peekable();
+        let mut inserted = points.into_iter().peekable();
+        loop {
+            let next = match (tail.peek(), inserted.peek()) {
+                (Some(a), Some(b)) => if a.0 <= b.0 { tail.next() } else { inserted.next() },
+                (Some(_), None) => tail.next(),
+                (None, Some(_)) => inserted.next(),
+                (None, None) => break,
+            };
+            let (t, v) = next.unwrap();
+            self.timestamps.push(t);
+            self.values.push(v);
+        }
+    }
+
+    // [begin, end) as indices
+    fn bounds(&self, begin: i64, end: i64) -> (usize, usize) {
+        let first = self.timestamps.partition_point(|t| *t < begin);
+        let last = self.timestamps.partition_point(|t| *t < end).max(first);
+        (first, last)
+    }
+
+    pub fn range(&self, begin: i64, end: i64) -> impl Iterator<Item=(i64, T)> + '_ {
+        let (first, last) = self.bounds(begin, end);
+        (first..last).map(move |i| (self.timestamps[i], self.values[i]))
+    }
+
+    fn erase(&mut self, begin: i64, end: i64) -> usize {
+        let (first, last) = self.bounds(begin, end);
+        self.timestamps.drain(first..last);
+        self.values.drain(first..last);
+        last - first
+    }
+}
+
+pub(super) enum ColumnData {
+    Double(Series<f64>),
+    Int64(Series<i64>),
+    // blob, string and timestamp columns can be declared but hold no data in the fake
+    Other,
+}
+
+pub(super) struct TsColumn {
+    pub name: String,
+    pub type_: qdb_ts_column_type_t,
+    pub data: ColumnData,
+}
+
+/// Table : A time series of the in-process cluster.
+pub(super) struct Table {
+    pub shard_size_ms: u64,
+    pub columns: Vec<TsColumn>,
+}
+
+impl Table {
+    pub fn column(&mut self, name: &str) -> Result<&mut TsColumn, qdb_error_t> {
+        match self.columns.iter_mut().find(|c| c.name == name) {
+            Some(c) => Ok(c),
+            None => Err(qdb_error_t_qdb_e_column_not_found),
+        }
+    }
+}
+
+// The API bounds go up to the maximum timespec, saturate instead of overflowing.
+fn nanos(ts: &qdb_timespec_t) -> i64 {
+    (ts.tv_sec as i64).saturating_mul(1_000_000_000).saturating_add(ts.tv_nsec as i64)
+}
+
+unsafe fn ranges_arg(ranges: *const qdb_ts_range_t, range_count: qdb_size_t) -> Result<Vec<(i64, i64)>, qdb_error_t> {
+    if ranges.is_null() || range_count == 0 {
+        return Err(qdb_error_t_qdb_e_invalid_argument);
+    }
+    Ok(std::slice::from_raw_parts(ranges, range_count).iter().map(|r| (nanos(&r.begin), nanos(&r.end))).collect())
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_ts_create(handle: qdb_handle_t, alias: *const raw::c_char, shard_size_ms: qdb_uint_t,
+                                       columns: *const qdb_ts_column_info_t, column_count: qdb_size_t) -> qdb_error_t {
+    let alias = match alias_arg(alias) {
+        Ok(a) => a,
+        Err(e) => return e,
+    };
+    if shard_size_ms == 0 || (columns.is_null() && column_count > 0) {
+        return qdb_error_t_qdb_e_invalid_argument;
+    }
+
+    let mut table = Table { shard_size_ms, columns: Vec::with_capacity(column_count) };
+    for info in std::slice::from_raw_parts(columns, column_count) {
+        let name = match alias_arg(info.name) {
+            Ok(n) => n.to_string(),
+            Err(e) => return e,
+        };
+        let data = match info.type_ {
+            t if t == qdb_ts_column_type_t_qdb_ts_column_double => ColumnData::Double(Series::new()),
+            t if t == qdb_ts_column_type_t_qdb_ts_column_int64 => ColumnData::Int64(Series::new()),
+            _ => ColumnData::Other,
+        };
+        table.columns.push(TsColumn { name, type_: info.type_, data });
+    }
+
+    if let Err(e) = remote(handle, alias.len() + table.columns.iter().map(|c| c.name.len()).sum::<usize>()) {
+        return e;
+    }
+    status(cluster().create(alias, Value::Table(table), NEVER_EXPIRES).map(|_| ()))
+}
+
+// The column names are owned by the metadata.
+#[repr(C)]
+struct Metadata {
+    metadata: qdb_ts_metadata_t,
+    _names: Vec<CString>,
+    _columns: Vec<qdb_ts_column_info_ex_t>,
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_ts_get_metadata(handle: qdb_handle_t, alias: *const raw::c_char,
+                                             metadata: *mut *mut qdb_ts_metadata_t) -> qdb_error_t {
+    let alias = match alias_arg(alias) {
+        Ok(a) => a,
+        Err(e) => return e,
+    };
+    if metadata.is_null() {
+        return qdb_error_t_qdb_e_invalid_argument;
+    }
+    if let Err(e) = remote(handle, alias.len()) {
+        return e;
+    }
+
+    let (shard_size, names, types) = {
+        let mut cluster = cluster();
+        let table = match cluster.table(alias) {
+            Ok(t) => t,
+            Err(e) => return e,
+        };
+        let names: Vec<CString> = table.columns.iter().filter_map(|c| CString::new(c.name.clone()).ok()).collect();
+        let types: Vec<qdb_ts_column_type_t> = table.columns.iter().map(|c| c.type_).collect();
+        (table.shard_size_ms, names, types)
+    };
+
+    let mut columns: Vec<qdb_ts_column_info_ex_t> = names.iter().zip(types.iter())
+        .map(|(n, t)| qdb_ts_column_info_ex_t { name: n.as_ptr(), type_: *t, symtable: ptr::null() })
+        .collect();
+    let bytes = std::mem::size_of::<qdb_ts_metadata_t>() + columns.len() * std::mem::size_of::<qdb_ts_column_info_ex_t>();
+    receive(bytes);
+
+    let value = Metadata {
+        metadata: qdb_ts_metadata_t {
+            columns: columns.as_mut_ptr(),
+            column_count: columns.len(),
+            shard_size,
+            ttl: 0,
+            aggregated: ptr::null_mut(),
+        },
+        _names: names,
+        _columns: columns,
+    };
+    // metadata is the first field, its address is the one handed out
+    *metadata = hand_out_value(value, bytes) as *mut qdb_ts_metadata_t;
+    0
+}
+
+unsafe fn insert<T: Copy, P>(handle: qdb_handle_t, alias: *const raw::c_char, column: *const raw::c_char,
+                             values: *const P, value_count: qdb_size_t, point: impl Fn(&P) -> (i64, T),
+                             series: impl Fn(&mut ColumnData) -> Option<&mut Series<T>>) -> qdb_error_t {
+    let (alias, column) = match (alias_arg(alias), alias_arg(column)) {
+        (Ok(a), Ok(c)) => (a, c),
+        (Err(e), _) | (_, Err(e)) => return e,
+    };
+    if values.is_null() && value_count > 0 {
+        return qdb_error_t_qdb_e_invalid_argument;
+    }
+    if let Err(e) = remote(handle, alias.len() + column.len() + value_count * std::mem::size_of::<P>()) {
+        return e;
+    }
+
+    let points: Vec<(i64, T)> = std::slice::from_raw_parts(values, value_count).iter().map(point).collect();
+
+    let mut cluster = cluster();
+    let data = match cluster.table(alias).and_then(|t| t.column(column)) {
+        Ok(c) => &mut c.data,
+        Err(e) => return e,
+    };
+    match series(data) {
+        Some(s) => {
+            s.insert(&points);
+            0
+        }
+        None => qdb_error_t_qdb_e_incompatible_type,
+    }
+}
+
+// Reads the points of every range of a column, in range order.
+unsafe fn read_ranges<T: Copy, P>(handle: qdb_handle_t, alias: *const raw::c_char, column: *const raw::c_char,
+                                  ranges: *const qdb_ts_range_t, range_count: qdb_size_t,
+                                  point: impl Fn(i64, T) -> P,
+                                  series: impl Fn(&ColumnData) -> Option<&Series<T>>) -> Result<Vec<P>, qdb_error_t> {
+    let (alias, column) = (alias_arg(alias)?, alias_arg(column)?);
+    let ranges = ranges_arg(ranges, range_count)?;
+    remote(handle, alias.len() + column.len() + ranges.len() * std::mem::size_of::<qdb_ts_range_t>())?;
+
+    let mut cluster = cluster();
+    let data = &cluster.table(alias).and_then(|t| t.column(column))?.data;
+    let s = series(data).ok_or(qdb_error_t_qdb_e_incompatible_type)?;
+    Ok(ranges.iter().flat_map(|(b, e)| s.range(*b, *e)).map(|(t, v)| point(t, v)).collect())
+}
+
+unsafe fn get_ranges<T: Copy + 'static, P: 'static>(handle: qdb_handle_t, alias: *const raw::c_char, column: *const raw::c_char,
+                                                    ranges: *const qdb_ts_range_t, range_count: qdb_size_t,
+                                                    points: *mut *mut P, point_count: *mut qdb_size_t,
+                                                    point: impl Fn(i64, T) -> P,
+                                                    series: impl Fn(&ColumnData) -> Option<&Series<T>>) -> qdb_error_t {
+    if points.is_null() || point_count.is_null() {
+        return qdb_error_t_qdb_e_invalid_argument;
+    }
+    let mut result = match read_ranges(handle, alias, column, ranges, range_count, point, series) {
+        Ok(r) => r,
+        Err(e) => return e,
+    };
+
+    let bytes = result.len() * std::mem::size_of::<P>();
+    receive(bytes);
+
+    if result.capacity() == 0 {
+        result.reserve(1);
+    }
+    *point_count = result.len();
+    *points = result.as_mut_ptr();
+    hand_out(Box::new(super::Owned(result)), *points as *const raw::c_void, bytes);
+    0
+}
+
+// Copies the points to the caller's array, or only reports how many there are when it is too small.
+unsafe fn get_ranges_no_copy<T: Copy, P>(handle: qdb_handle_t, alias: *const raw::c_char, column: *const raw::c_char,
+                                         ranges: *const qdb_ts_range_t, range_count: qdb_size_t,
+                                         points: *mut P, point_count: *mut qdb_size_t,
+                                         point: impl Fn(i64, T) -> P,
+                                         series: impl Fn(&ColumnData) -> Option<&Series<T>>) -> qdb_error_t {
+    if point_count.is_null() || (points.is_null() && *point_count > 0) {
+        return qdb_error_t_qdb_e_invalid_argument;
+    }
+    let result = match read_ranges(handle, alias, column, ranges, range_count, point, series) {
+        Ok(r) => r,
+        Err(e) => return e,
+    };
+
+    let capacity = *point_count;
+    *point_count = result.len();
+    if result.len() > capacity {
+        return qdb_error_t_qdb_e_buffer_too_small;
+    }
+    receive(result.len() * std::mem::size_of::<P>());
+    ptr::copy_nonoverlapping(result.as_ptr(), points, result.len());
+    0
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_ts_double_insert(handle: qdb_handle_t, alias: *const raw::c_char, column: *const raw::c_char,
+                                              values: *const qdb_ts_double_point, value_count: qdb_size_t) -> qdb_error_t {
+    insert(handle, alias, column, values, value_count,
+           |p| (nanos(&p.timestamp), p.value),
+           |d| match d { ColumnData::Double(s) => Some(s), _ => None })
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_ts_int64_insert(handle: qdb_handle_t, alias: *const raw::c_char, column: *const raw::c_char,
+                                             values: *const qdb_ts_int64_point, value_count: qdb_size_t) -> qdb_error_t {
+    insert(handle, alias, column, values, value_count,
+           |p| (nanos(&p.timestamp), p.value),
+           |d| match d { ColumnData::Int64(s) => Some(s), _ => None })
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_ts_double_get_ranges(handle: qdb_handle_t, alias: *const raw::c_char, column: *const raw::c_char,
+                                                  ranges: *const qdb_ts_range_t, range_count: qdb_size_t,
+                                                  points: *mut *mut qdb_ts_double_point, point_count: *mut qdb_size_t) -> qdb_error_t {
+    get_ranges(handle, alias, column, ranges, range_count, points, point_count,
+               |t, v| qdb_ts_double_point { timestamp: nanos_to_timespec(t), value: v },
+               |d| match d { ColumnData::Double(s) => Some(s), _ => None })
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_ts_int64_get_ranges(handle: qdb_handle_t, alias: *const raw::c_char, column: *const raw::c_char,
+                                                 ranges: *const qdb_ts_range_t, range_count: qdb_size_t,
+                                                 points: *mut *mut qdb_ts_int64_point, point_count: *mut qdb_size_t) -> qdb_error_t {
+    get_ranges(handle, alias, column, ranges, range_count, points, point_count,
+               |t, v| qdb_ts_int64_point { timestamp: nanos_to_timespec(t), value: v },
+               |d| match d { ColumnData::Int64(s) => Some(s), _ => None })
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_ts_double_get_ranges_no_copy(handle: qdb_handle_t, alias: *const raw::c_char, column: *const raw::c_char,
+                                                          ranges: *const qdb_ts_range_t, range_count: qdb_size_t,
+                                                          points: *mut qdb_ts_double_point, point_count: *mut qdb_size_t) -> qdb_error_t {
+    get_ranges_no_copy(handle, alias, column, ranges, range_count, points, point_count,
+                       |t, v| qdb_ts_double_point { timestamp: nanos_to_timespec(t), value: v },
+                       |d| match d { ColumnData::Double(s) => Some(s), _ => None })
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_ts_int64_get_ranges_no_copy(handle: qdb_handle_t, alias: *const raw::c_char, column: *const raw::c_char,
+                                                         ranges: *const qdb_ts_range_t, range_count: qdb_size_t,
+                                                         points: *mut qdb_ts_int64_point, point_count: *mut qdb_size_t) -> qdb_error_t {
+    get_ranges_no_copy(handle, alias, column, ranges, range_count, points, point_count,
+                       |t, v| qdb_ts_int64_point { timestamp: nanos_to_timespec(t), value: v },
+                       |d| match d { ColumnData::Int64(s) => Some(s), _ => None })
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn qdb_ts_erase_ranges(handle: qdb_handle_t, alias: *const raw::c_char, column: *const raw::c_char,
+                                             ranges: *const qdb_ts_range_t, range_count: qdb_size_t,
+                                             erased_count: *mut qdb_uint_t) -> qdb_error_t {
+    let (alias, column) = match (alias_arg(alias), alias_arg(column)) {
+        (Ok(a), Ok(c)) => (a, c),
+        (Err(e), _) | (_, Err(e)) => return e,
+    };
+    let ranges = match ranges_arg(ranges, range_count) {
+        Ok(r) => r,
+        Err(e) => return e,
+    };
+    if let Err(e) = remote(handle, alias.len() + column.len() + ranges.len() * std::mem::size_of::<qdb_ts_range_t>()) {
+        return e;
+    }
+
+    let mut cluster = cluster();
+    let data = match cluster.table(alias).and_then(|t| t.column(column)) {
+        Ok(c) => &mut c.data,
+        Err(e) => return e,
+    };
+    let erased: usize = match data {
+        ColumnData::Double(s) => ranges.iter().map(|(b, e)| s.erase(*b, *e)).sum(),
+        ColumnData::Int64(s) => ranges.iter().map(|(b, e)| s.erase(*b, *e)).sum(),
+        ColumnData::Other => 0,
+    };
+    if !erased_count.is_null() {
+        *erased_count = erased as qdb_uint_t;
+    }
+    0
+}
+
+// Disk usage of a point, a timestamp and a value.
+const POINT_SIZE: usize = 16;
+
+/// ExpireBySize : Erases the oldest points of every column until the table holds about size bytes.
+#[no_mangle]
+pub unsafe extern "C" fn qdb_ts_expire_by_size(handle: qdb_handle_t, alias: *const raw::c_char, size: qdb_uint_t) -> qdb_error_t {
+    let alias = match alias_arg(alias) {
+        Ok(a) => a,
+        Err(e) => return e,
+    };
+    if let Err(e) = remote(handle, alias.len()) {
+        return e;
+    }
+
+    let mut cluster = cluster();
+    let table = match cluster.table(alias) {
+        Ok(t) => t,
+        Err(e) => return e,
+    };
+    let mut timestamps: Vec<i64> = Vec::new();
+    for column in &table.columns {
+        match &column.data {
+            ColumnData::Double(s) => timestamps.extend_from_slice(&s.timestamps),
+            ColumnData::Int64(s) => timestamps.extend_from_slice(&s.timestamps),
+            ColumnData::Other => {}
+        }
+    }
+    let keep = size as usize / POINT_SIZE;
+    if timestamps.len() <= keep {
+        return 0;
+    }
+
+    // everything older than the oldest point kept goes
+    timestamps.sort_unstable();
+    let cutoff = if keep == 0 { i64::MAX } else { timestamps[timestamps.len() - keep] };
+    for column in &mut table.columns {
+        match &mut column.data {
+            ColumnData::Double(s) => { s.erase(i64::MIN, cutoff); }
+            ColumnData::Int64(s) => { s.erase(i64::MIN, cutoff); }
+            ColumnData::Other => {}
+        }
+    }
+    0
+}
+
+impl<T: Copy + PartialEq> Series<T> {
+    fn contains(&self, t: i64, value: T) -> bool {
+        let (first, last) = self.bounds(t, t.saturating_add(1));
+        self.values[first..last].contains(&value)
+    }
+}
+
+unsafe fn string_arg<'a>(s: &qdb_string_t) -> Result<&'a str, qdb_error_t> {
+    if s.data.is_null() || s.length == 0 {
+        return Err(qdb_error_t_qdb_e_invalid_argument);
+    }
+    std::str::from_utf8(std::slice::from_raw_parts(s.data as *const u8, s.length))
+        .map_err(|_| qdb_error_t_qdb_e_invalid_argument)
+}
+
+// The values of a pushed column, the fake only keeps double and int64 ones.
+enum Pushed<'a> {
+    Double(&'a [f64]),
+    Int64(&'a [i64]),
+    Ignored,
+}
+
+struct PushedTable<'a> {
+    alias: &'a str,
+    timestamps: Vec<i64>,
+    columns: Vec<(&'a str, Pushed<'a>)>,
+    truncate: Vec<(i64, i64)>,
+    options: qdb_exp_batch_push_options_t,
+    where_duplicate: Vec<&'a str>,
+}
+
+unsafe fn pushed_table<'a>(t: &'a qdb_exp_batch_push_table_t) -> Result<PushedTable<'a>, qdb_error_t> {
+    let rows = t.data.row_count;
+    if (rows > 0 && t.data.timestamps.is_null()) || (t.data.column_count > 0 && t.data.columns.is_null()) {
+        return Err(qdb_error_t_qdb_e_invalid_argument);
+    }
+
+    let timestamps = if rows == 0 { Vec::new() } else { std::slice::from_raw_parts(t.data.timestamps, rows).iter().map(nanos).collect() };
+    let mut columns = Vec::with_capacity(t.data.column_count);
+    for c in std::slice::from_raw_parts(t.data.columns, t.data.column_count) {
+        let values = match c.data_type {
+            d if d == qdb_ts_column_type_t_qdb_ts_column_double => Pushed::Double(std::slice::from_raw_parts(c.data.doubles, rows)),
+            d if d == qdb_ts_column_type_t_qdb_ts_column_int64 => Pushed::Int64(std::slice::from_raw_parts(c.data.ints, rows)),
+            _ => Pushed::Ignored,
+        };
+        columns.push((string_arg(&c.name)?, values));
+    }
+
+    let truncate = if t.truncate_range_count == 0 { Vec::new() } else { ranges_arg(t.truncate_ranges, t.truncate_range_count)? };
+    let where_duplicate = if t.where_duplicate.is_null() {
+        Vec::new()
+    } else {
+        std::slice::from_raw_parts(t.where_duplicate, t.where_duplicate_count).iter()
+            .map(|s| string_arg(s))
+            .collect::<Result<Vec<_>, _>>()?
+    };
+
+    Ok(PushedTable { alias: string_arg(&t.name)?, timestamps, columns, truncate, options: t.options, where_duplicate })
+}
+
+/// ExpBatchPush : Writes the double and int64 columns of every table, the other column types are accepted and dropped.
+///    The mode is only looked at for truncation, every push is applied at once.
+///    Duplicates are rows whose values at the same timestamp are all equal in the compared columns:
+///    unique drops them, unique upsert replaces the points of the table at their timestamps.
+#[no_mangle]
+pub unsafe extern "C" fn qdb_exp_batch_push(handle: qdb_handle_t, mode: qdb_exp_batch_push_mode_t,
+                                            tables: *const qdb_exp_batch_push_table_t,
+                                            _table_schemas: *mut *const qdb_exp_batch_push_table_schema_t,
+                                            table_count: qdb_size_t) -> qdb_error_t {
+    if tables.is_null() || table_count == 0 {
+        return qdb_error_t_qdb_e_invalid_argument;
+    }
+
+    let mut pushed = Vec::with_capacity(table_count);
+    for t in std::slice::from_raw_parts(tables, table_count) {
+        match pushed_table(t) {
+            Ok(p) => pushed.push(p),
+            Err(e) => return e,
+        }
+    }
+
+    let sent: usize = pushed.iter().map(|t| t.alias.len() + t.timestamps.len() * 8 * (t.columns.len() + 1)).sum();
+    if let Err(e) = remote(handle, sent) {
+        return e;
+    }
+
+    let mut cluster = cluster();
+
+    // checked before anything is written, a push is all or nothing
+    for t in &pushed {
+        let table = match cluster.table(t.alias) {
+            Ok(table) => table,
+            Err(e) => return e,
+        };
+        for (name, values) in &t.columns {
+            let column = match table.column(name) {
+                Ok(c) => c,
+                Err(e) => return e,
+            };
+            let compatible = match (values, &column.data) {
+                (Pushed::Double(_), ColumnData::Double(_)) | (Pushed::Int64(_), ColumnData::Int64(_)) => true,
+                (Pushed::Ignored, ColumnData::Other) => true,
+                _ => false,
+            };
+            if !compatible {
+                return qdb_error_t_qdb_e_incompatible_type;
+            }
+        }
+        if t.where_duplicate.iter().any(|w| !t.columns.iter().any(|(n, _)| n == w)) {
+            return qdb_error_t_qdb_e_column_not_found;
+        }
+    }
+
+    for t in &pushed {
+        let table = cluster.table(t.alias).unwrap();
+
+        if mode == qdb_exp_batch_push_mode_t_qdb_exp_batch_push_truncate {
+            for column in table.columns.iter_mut() {
+                for (b, e) in &t.truncate {
+                    match &mut column.data {
+                        ColumnData::Double(s) => { s.erase(*b, *e); }
+                        ColumnData::Int64(s) => { s.erase(*b, *e); }
+                        ColumnData::Other => {}
+                    }
+                }
+            }
+        }
+
+        let compared = |name: &str| t.where_duplicate.is_empty() || t.where_duplicate.contains(&name);
+        let deduplicate = mode != qdb_exp_batch_push_mode_t_qdb_exp_batch_push_truncate
+            && t.options != qdb_exp_batch_push_options_t_qdb_exp_batch_option_standard;
+
+        // rows to write, with the duplicates dropped when asked to
+        let mut keep = vec![true; t.timestamps.len()];
+        if deduplicate {
+            for (row, ts) in t.timestamps.iter().enumerate() {
+                let duplicate = t.columns.iter().filter(|(n, _)| compared(n)).all(|(name, values)| {
+                    match (values, &table.column(name).unwrap().data) {
+                        (Pushed::Double(v), ColumnData::Double(s)) => s.contains(*ts, v[row]),
+                        (Pushed::Int64(v), ColumnData::Int64(s)) => s.contains(*ts, v[row]),
+                        _ => true,
+                    }
+                });
+                if duplicate && t.options == qdb_exp_batch_push_options_t_qdb_exp_batch_option_unique {
+                    keep[row] = false;
+                }
+                if duplicate && t.options == qdb_exp_batch_push_options_t_qdb_exp_batch_option_unique_upsert {
+                    for column in table.columns.iter_mut() {
+                        match &mut column.data {
+                            ColumnData::Double(s) => { s.erase(*ts, ts.saturating_add(1)); }
+                            ColumnData::Int64(s) => { s.erase(*ts, ts.saturating_add(1)); }
+                            ColumnData::Other => {}
+                        }
+                    }
+                }
+            }
+        }
+
+        for (name, values) in &t.columns {
+            let column = table.column(name).unwrap();
+            match (values, &mut column.data) {
+                (Pushed::Double(v), ColumnData::Double(s)) => s.insert(&rows(&t.timestamps, v, &keep)),
+                (Pushed::Int64(v), ColumnData::Int64(s)) => s.insert(&rows(&t.timestamps, v, &keep)),
+                _ => {}
+            }
+        }
+    }
+    0
+}
+
+fn rows<T: Copy>(timestamps: &[i64], values: &[T], keep: &[bool]) -> Vec<(i64, T)> {
+    timestamps.iter().zip(values.iter()).zip(keep.iter())
+        .filter(|(_, k)| **k)
+        .map(|((t, v), _)| (*t, *v))
+        .collect()
+}
@@ -0,0 +1,180 @@
+use std::ffi::{CStr, CString};
+use std::fmt;
+use std::os::raw::c_char;
+use std::ptr;
+
+use crate::error::ErrorType;
+use crate::handle::HandleType;
+use crate::qdb_release;
+
+// Aliases and options shorter than this are converted on the stack.
+const STACK_CSTR_LEN: usize = 256;
+
+/// WithCStr : Calls f with a null-terminated copy of s, the pointer is only valid during the call.
+///    Short strings are copied to a stack buffer, longer ones to a CString freed on return.
+///    Returns ErrInvalidArgument when s contains a null byte.
+pub fn with_c_str<R>(s: &str, f: impl FnOnce(*const c_char) -> R) -> Result<R, ErrorType> {
+    let bytes = s.as_bytes();
+    if bytes.contains(&0) {
+        return Err(ErrorType::ErrInvalidArgument);
+    }
+
+    if bytes.len() < STACK_CSTR_LEN {
+        let mut buffer = [0u8; STACK_CSTR_LEN];
+        buffer[..bytes.len()].copy_from_slice(bytes);
+        return Ok(f(buffer.as_ptr() as *const c_char));
+    }
+
+    let owned = CString::new(bytes).map_err(|_| ErrorType::ErrInvalidArgument)?;
+    Ok(f(owned.as_ptr()))
+}
+
+/// CStrArena : Null-terminated copies of many strings in a single buffer,
+///    to pass a list of aliases to the API with two allocations instead of one per alias.
+#[derive(Debug, Default, Clone)]
+pub struct CStrArena {
+    bytes: Vec<u8>,
+    offsets: Vec<usize>,
+}
+
+impl CStrArena {
+    pub fn new() -> CStrArena {
+        CStrArena::default()
+    }
+
+    /// WithCapacity : Reserves room for count strings totalling bytes bytes, terminators excluded.
+    pub fn with_capacity(count: usize, bytes: usize) -> CStrArena {
+        CStrArena { bytes: Vec::with_capacity(bytes + count), offsets: Vec::with_capacity(count) }
+    }
+
+    /// Push : Appends a copy of s and returns its index, ErrInvalidArgument when s contains a null byte.
+    pub fn push(&mut self, s: &str) -> Result<usize, ErrorType> {
+        if s.as_bytes().contains(&0) {
+            return Err(ErrorType::ErrInvalidArgument);
+        }
+        self.offsets.push(self.bytes.len());
+        self.bytes.extend_from_slice(s.as_bytes());
+        self.bytes.push(0);
+        Ok(self.offsets.len() - 1)
+    }
+
+    pub fn len(&self) -> usize {
+        self.offsets.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.offsets.is_empty()
+    }
+
+    /// Clear : Forgets every string but keeps the buffers for reuse.
+    pub fn clear(&mut self) {
+        self.bytes.clear();
+        self.offsets.clear();
+    }
+
+    /// Ptr : Returns the null-terminated string i, valid until the arena is modified.
+    pub fn ptr(&self, i: usize) -> *const c_char {
+        self.bytes[self.offsets[i]..].as_ptr() as *const c_char
+    }
+
+    /// Ptrs : Returns a pointer to every string in push order, valid until the arena is modified.
+    pub fn ptrs(&self) -> Vec<*const c_char> {
+        self.offsets.iter().map(|o| self.bytes[*o..].as_ptr() as *const c_char).collect()
+    }
+
+    pub fn get(&self, i: usize) -> &str {
+        let start = self.offsets[i];
+        let end = self.offsets.get(i + 1).map_or(self.bytes.len(), |o| *o) - 1;
+        // only whole &str are pushed
+        unsafe { std::str::from_utf8_unchecked(&self.bytes[start..end]) }
+    }
+}
+
+/// AliasList : A list of aliases returned by the API, read in place.
+///    The strings are borrowed from the API buffer, which is released when the list is dropped.
+///    Use to_vec to keep the aliases beyond the list.
+pub struct AliasList<'h> {
+    handle: &'h HandleType,
+    aliases: *const *const c_char,
+    // byte length of every alias, computed once when the list is checked
+    lengths: Vec<usize>,
+}
+
+// The API buffer is owned by the list and only read.
+unsafe impl Send for AliasList<'_> {}
+unsafe impl Sync for AliasList<'_> {}
+
+impl<'h> AliasList<'h> {
+    /// FromApi : Takes ownership of an API buffer of count aliases.
+    ///    Every alias is checked to be UTF-8, otherwise the buffer is released and ErrInvalidReply returned.
+    ///
+    /// # Safety
+    ///    aliases must be null or an array of count null-terminated strings allocated by the API for handle.
+    pub unsafe fn from_api(handle: &'h HandleType, aliases: *const *const c_char, count: usize) -> Result<AliasList<'h>, ErrorType> {
+        let mut list = AliasList { handle, aliases, lengths: Vec::new() };
+        if aliases.is_null() || count == 0 {
+            return Ok(list);
+        }
+
+        let mut lengths = Vec::with_capacity(count);
+        for p in std::slice::from_raw_parts(aliases, count) {
+            if p.is_null() {
+                return Err(ErrorType::ErrInvalidReply);
+            }
+            let bytes = CStr::from_ptr(*p).to_bytes();
+            if std::str::from_utf8(bytes).is_err() {
+                return Err(ErrorType::ErrInvalidReply);
+            }
+            lengths.push(bytes.len());
+        }
+
+        list.lengths = lengths;
+        Ok(list)
+    }
+
+    pub fn len(&self) -> usize {
+        self.lengths.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.lengths.is_empty()
+    }
+
+    pub fn get(&self, i: usize) -> Option<&str> {
+        let length = *self.lengths.get(i)?;
+        unsafe {
+            let bytes = std::slice::from_raw_parts(*self.aliases.add(i) as *const u8, length);
+            // checked in from_api
+            Some(std::str::from_utf8_unchecked(bytes))
+        }
+    }
+
+    pub fn iter(&self) -> impl ExactSizeIterator<Item=&str> + '_ {
+        (0..self.len()).map(move |i| self.get(i).unwrap())
+    }
+
+    /// Contains : Returns whether alias is part of the list, a linear scan.
+    pub fn contains(&self, alias: &str) -> bool {
+        self.iter().any(|a| a == alias)
+    }
+
+    /// ToVec : Copies the aliases out of the API buffer.
+    pub fn to_vec(&self) -> Vec<String> {
+        self.iter().map(|a| a.to_string()).collect()
+    }
+}
+
+impl fmt::Debug for AliasList<'_> {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        f.debug_list().entries(self.iter()).finish()
+    }
+}
+
+impl Drop for AliasList<'_> {
+    fn drop(&mut self) {
+        if !self.aliases.is_null() {
+            unsafe { qdb_release(self.handle.handle, self.aliases as *const _) };
+            self.aliases = ptr::null();
+        }
+    }
+}
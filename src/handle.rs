@@ -1,18 +1,27 @@
 use std::{ffi, ptr};
 use std::os::raw;
 use std::str::Utf8Error;
+use std::sync::{RwLock, Weak};
 
-use crate::{handler_credentials, qdb_build, qdb_close, qdb_connect, qdb_get_tagged, qdb_get_tags, qdb_handle_t, qdb_open, qdb_option_get_client_max_in_buf_size, qdb_option_get_client_max_parallelism, qdb_option_get_cluster_max_in_buf_size, qdb_option_set_client_max_in_buf_size, qdb_option_set_client_max_parallelism, qdb_option_set_cluster_public_key, qdb_option_set_compression, qdb_option_set_encryption, qdb_option_set_max_cardinality, qdb_option_set_timeout, qdb_option_set_user_credentials, qdb_prefix_count, qdb_prefix_get, qdb_release, qdb_size_t, qdb_version, utils_ptr};
-use crate::error::{Errorable, ErrorType, makeErrorNone};
+use crate::{handler_credentials, qdb_build, qdb_attach_tag, qdb_attach_tags, qdb_close, qdb_connect, qdb_detach_tag, qdb_detach_tags, qdb_get_tagged, qdb_get_tagged_approximate_count, qdb_get_tagged_count, qdb_get_tags, qdb_handle_t, qdb_has_tag, qdb_open, qdb_option_get_client_max_in_buf_size, qdb_option_get_client_max_parallelism, qdb_option_client_get_memory_info, qdb_option_client_tidy_memory, qdb_option_get_cluster_max_in_buf_size, qdb_option_set_client_max_in_buf_size, qdb_option_set_client_soft_memory_limit, qdb_option_set_client_max_parallelism, qdb_option_set_cluster_public_key, qdb_option_set_compression, qdb_option_set_encryption, qdb_option_set_max_cardinality, qdb_option_set_timeout, qdb_option_set_user_credentials, qdb_error_t, qdb_prefix_approximate_count, qdb_prefix_count, qdb_prefix_get, qdb_release, qdb_size_t, qdb_suffix_approximate_count, qdb_suffix_count, qdb_suffix_get, qdb_version};
+use crate::error::{ErrorType, makeErrorNone};
+use crate::ffi_str::{AliasList, CStrArena, with_c_str};
 use crate::handle_const::{Compression, Encryption, Protocol, PROTOCOL_DEFAULT};
 use crate::handler_credentials::{ClusterKey, JSONCredentialsConfig};
-use crate::utils;
+use crate::memory_governor::Governor;
 
 /// HandleType : An opaque handle to internal API-allocated structures needed for maintaining connection to a cluster.
 pub struct HandleType {
-    handle: qdb_handle_t,
+    pub(crate) handle: qdb_handle_t,
+    // the governor started on this handle, batches and readers wait at its gate
+    pub(crate) memory_gate: RwLock<Weak<Governor>>,
 }
 
+// The quasardb C API allows a handle to be shared by several threads at once,
+// the raw pointer is only there to keep the internal structures opaque.
+unsafe impl Send for HandleType {}
+unsafe impl Sync for HandleType {}
+
 // Handles constructors
 
 /// NewHandle : Create a new handle, return error if needed
@@ -25,7 +34,7 @@ pub fn new_handle() -> Result<HandleType, ErrorType> {
         let err = qdb_open(&mut handle, PROTOCOL_DEFAULT);
 
         return match makeErrorNone(err) {
-            None => Ok(HandleType { handle }),
+            None => Ok(HandleType { handle, memory_gate: RwLock::new(Weak::new()) }),
             Some(e) => Err(e)
         };
     }
@@ -158,10 +167,9 @@ impl HandleType {
     ///    	qdb://myserver1.org:2836,myserver2.org:2836 - Connects to myserver1.org or myserver2.org on the port 2836
     //		qdb://[::1]:2836 - Connects to the local IPv6 loopback on the port 2836
     pub fn connect(&self, cluster_uri: &str) -> Option<ErrorType> {
-        unsafe {
-            let uri = utils::str_to_cstr(cluster_uri);
-            let err = qdb_connect(self.handle, uri);
-            makeErrorNone(err)
+        match with_c_str(cluster_uri, |uri| unsafe { qdb_connect(self.handle, uri) }) {
+            Ok(err) => makeErrorNone(err),
+            Err(e) => Some(e),
         }
     }
 
@@ -178,6 +186,7 @@ impl HandleType {
     /// Close : Closes the handle previously opened.
     ///    This results in terminating all connections and releasing all internal buffers,
     ///    including buffers which may have been allocated as or a result of batch operations or get operations.
+    ///    Results borrowing the handle, query results or TsView for instance, must be dropped before.
     pub fn close(&self) -> Option<ErrorType> {
         unsafe {
             let err = qdb_close(self.handle);
@@ -238,20 +247,24 @@ impl HandleType {
 
     /// AddUserCredentials : add a username and key from a user name and secret.
     pub fn add_user_credentials(&self, credentials: JSONCredentialsConfig) -> Option<ErrorType> {
-        unsafe {
-            let user_name = utils::str_to_cstr(credentials.username());
-            let private_key = utils::str_to_cstr(credentials.secret());
-            let err = qdb_option_set_user_credentials(self.handle, user_name, private_key);
-            makeErrorNone(err)
+        let set = with_c_str(credentials.username(), |user_name| {
+            with_c_str(credentials.secret(), |private_key| unsafe {
+                qdb_option_set_user_credentials(self.handle, user_name, private_key)
+            })
+        });
+        match set {
+            Ok(Ok(err)) => makeErrorNone(err),
+            Ok(Err(e)) | Err(e) => Some(e),
         }
     }
 
     /// AddClusterPublicKey : add the cluster public key from a cluster config file.
     pub fn set_cluster_public_key(&self, cluster_public_key: ClusterKey) -> Option<ErrorType> {
-        unsafe {
-            let public_key = utils::str_to_cstr(cluster_public_key.cluster_key());
-            let err = qdb_option_set_cluster_public_key(self.handle, public_key);
-            makeErrorNone(err)
+        match with_c_str(cluster_public_key.cluster_key(), |public_key| unsafe {
+            qdb_option_set_cluster_public_key(self.handle, public_key)
+        }) {
+            Ok(err) => makeErrorNone(err),
+            Err(e) => Some(e),
         }
     }
 
@@ -335,63 +348,144 @@ impl HandleType {
         }
     }
 
-    /// GetTags : Retrieves all the tags of an entry.
-    ///    Tagging an entry enables you to search for entries based on their tags. Tags scale across nodes.
-    ///    The entry must exist.
-    pub fn get_tags(&self, entry_alias: &str) -> Result<Vec<String>, ErrorType> {
+    /// SetClientSoftMemoryLimit : Sets the amount of memory, in bytes, above which the API starts releasing cached memory.
+    ///    EXPERIMENTAL.
+    pub fn set_client_soft_memory_limit(&self, limit: u64) -> Option<ErrorType> {
         unsafe {
-            let mut result: Vec<String> = Vec::new();
-            let alias = utils::str_to_cstr(entry_alias);
-            let mut tag_count: qdb_size_t = 0;
-            let tags_raw_ptr = ptr::null_mut();
-
-            let err = qdb_get_tags(self.handle, alias, tags_raw_ptr, &mut tag_count);
-
-            if err == 0 && tag_count > 0 {
-                result = match utils_ptr::raw_pointer_to_string_vector(tags_raw_ptr, tag_count) {
-                    Ok(v) => v,
-                    Err(e) => return Err(ErrorType::from_qdb_error_origin_t(e.error_code())),
-                };
+            let err = qdb_option_set_client_soft_memory_limit(self.handle, limit);
+            makeErrorNone(err)
+        }
+    }
+
+    /// GetClientMemoryInfo : Returns a description of the memory allocated by the API on the client.
+    ///    EXPERIMENTAL.
+    pub fn get_client_memory_info(&self) -> Result<String, ErrorType> {
+        unsafe {
+            let mut content: *const raw::c_char = ptr::null();
+            let mut content_length: qdb_size_t = 0;
+
+            let err = qdb_option_client_get_memory_info(self.handle, &mut content, &mut content_length);
+
+            if let Some(err) = makeErrorNone(err) {
+                return Err(err);
+            }
+
+            if content.is_null() {
+                return Ok(String::new());
             }
 
-            ptr::drop_in_place(alias);
-            ptr::drop_in_place(tags_raw_ptr);
+            let bytes = std::slice::from_raw_parts(content as *const u8, content_length);
+            let info = String::from_utf8_lossy(bytes).into_owned();
+            qdb_release(self.handle, content as *const raw::c_void);
 
-            return match makeErrorNone(err) {
-                None => Ok(result),
-                Some(err) => Err(err),
-            };
+            Ok(info)
+        }
+    }
+
+    /// ClientTidyMemory : Asks the API to return unused memory to the system.
+    ///    EXPERIMENTAL.
+    pub fn client_tidy_memory(&self) -> Option<ErrorType> {
+        unsafe {
+            let err = qdb_option_client_tidy_memory(self.handle);
+            makeErrorNone(err)
+        }
+    }
+
+    // Waits at the gate of the memory governor started on this handle, if any, before allocating.
+    pub(crate) fn admit_memory(&self) {
+        let governor = self.memory_gate.read().unwrap().upgrade();
+        if let Some(governor) = governor {
+            governor.wait(None);
+        }
+    }
+
+    /// AttachTag : Adds a tag to an entry, ErrTagAlreadySet when the entry already has it.
+    ///    The tag is created if it does not exist. The entry must exist.
+    pub fn attach_tag(&self, entry_alias: &str, tag: &str) -> Option<ErrorType> {
+        self.tag_call(entry_alias, tag, |alias, tag| unsafe { qdb_attach_tag(self.handle, alias, tag) })
+    }
+
+    /// AttachTags : Adds several tags to an entry in one call, the tags it already has are not an error.
+    pub fn attach_tags<S: AsRef<str>>(&self, entry_alias: &str, tags: &[S]) -> Option<ErrorType> {
+        self.tags_call(entry_alias, tags, |alias, tags, count| unsafe { qdb_attach_tags(self.handle, alias, tags, count) })
+    }
+
+    /// DetachTag : Removes a tag from an entry, ErrTagNotSet when the entry does not have it.
+    pub fn detach_tag(&self, entry_alias: &str, tag: &str) -> Option<ErrorType> {
+        self.tag_call(entry_alias, tag, |alias, tag| unsafe { qdb_detach_tag(self.handle, alias, tag) })
+    }
+
+    /// DetachTags : Removes several tags from an entry in one call, the tags it does not have are not an error.
+    pub fn detach_tags<S: AsRef<str>>(&self, entry_alias: &str, tags: &[S]) -> Option<ErrorType> {
+        self.tags_call(entry_alias, tags, |alias, tags, count| unsafe { qdb_detach_tags(self.handle, alias, tags, count) })
+    }
+
+    /// HasTag : Returns whether an entry has the tag.
+    pub fn has_tag(&self, entry_alias: &str, tag: &str) -> Result<bool, ErrorType> {
+        match self.tag_call(entry_alias, tag, |alias, tag| unsafe { qdb_has_tag(self.handle, alias, tag) }) {
+            None => Ok(true),
+            Some(ErrorType::ErrTagNotSet) => Ok(false),
+            Some(err) => Err(err),
+        }
+    }
+
+    fn tag_call<F>(&self, alias: &str, tag: &str, call: F) -> Option<ErrorType>
+        where F: FnOnce(*const raw::c_char, *const raw::c_char) -> qdb_error_t {
+        let err = with_c_str(alias, |alias| with_c_str(tag, |tag| call(alias, tag)));
+        match err {
+            Ok(Ok(err)) => makeErrorNone(err),
+            Ok(Err(err)) | Err(err) => Some(err),
+        }
+    }
+
+    fn tags_call<S, F>(&self, alias: &str, tags: &[S], call: F) -> Option<ErrorType>
+        where S: AsRef<str>, F: FnOnce(*const raw::c_char, *const *const raw::c_char, usize) -> qdb_error_t {
+        let mut arena = CStrArena::with_capacity(tags.len(), tags.iter().map(|t| t.as_ref().len()).sum());
+        for tag in tags {
+            if let Err(err) = arena.push(tag.as_ref()) {
+                return Some(err);
+            }
+        }
+        let ptrs = arena.ptrs();
+        match with_c_str(alias, |alias| call(alias, ptrs.as_ptr(), ptrs.len())) {
+            Ok(err) => makeErrorNone(err),
+            Err(err) => Some(err),
         }
     }
 
+    /// GetTags : Retrieves all the tags of an entry.
+    ///    Tagging an entry enables you to search for entries based on their tags. Tags scale across nodes.
+    ///    The entry must exist.
+    pub fn get_tags(&self, entry_alias: &str) -> Result<Vec<String>, ErrorType> {
+        self.get_tags_list(entry_alias).map(|l| l.to_vec())
+    }
+
+    /// GetTagsList : Same as GetTags, the tags are read in place from the API buffer instead of being copied.
+    pub fn get_tags_list(&self, entry_alias: &str) -> Result<AliasList<'_>, ErrorType> {
+        self.alias_list(entry_alias, |alias, tags, count| unsafe { qdb_get_tags(self.handle, alias, tags, count) })
+    }
+
     /// GetTagged : Retrieves all entries that have the specified tag.
     ///    Tagging an entry enables you to search for entries based on their tags. Tags scale across nodes.
     ///    The tag must exist.
     ///    The complexity of this function is constant.
     pub fn get_tagged(&self, tag: &str) -> Result<Vec<String>, ErrorType> {
-        unsafe {
-            let mut result: Vec<String> = Vec::new();
-            let alias = utils::str_to_cstr(tag);
-            let mut count: qdb_size_t = 0;
-            let raw_ptr = ptr::null_mut();
-
-            let err = qdb_get_tagged(self.handle, alias, raw_ptr, &mut count);
-
-            if err == 0 && count > 0 {
-                result = match utils_ptr::raw_pointer_to_string_vector(raw_ptr, count) {
-                    Ok(v) => v,
-                    Err(e) => return Err(ErrorType::from_qdb_error_origin_t(e.error_code())),
-                };
-            }
+        self.get_tagged_list(tag).map(|l| l.to_vec())
+    }
 
-            ptr::drop_in_place(alias);
-            ptr::drop_in_place(raw_ptr);
+    /// GetTaggedList : Same as GetTagged, the aliases are read in place from the API buffer instead of being copied.
+    pub fn get_tagged_list(&self, tag: &str) -> Result<AliasList<'_>, ErrorType> {
+        self.alias_list(tag, |tag, aliases, count| unsafe { qdb_get_tagged(self.handle, tag, aliases, count) })
+    }
 
-            return match makeErrorNone(err) {
-                None => Ok(result),
-                Some(err) => Err(err),
-            };
-        }
+    /// GetTaggedCount : Retrieves the count of all entries that have the specified tag.
+    pub fn get_tagged_count(&self, tag: &str) -> Result<u64, ErrorType> {
+        self.count(tag, |tag, result| unsafe { qdb_get_tagged_count(self.handle, tag, result) })
+    }
+
+    /// GetTaggedApproximateCount : Retrieves an estimate of the count of entries that have the specified tag.
+    pub fn get_tagged_approximate_count(&self, tag: &str) -> Result<u64, ErrorType> {
+        self.count(tag, |tag, result| unsafe { qdb_get_tagged_approximate_count(self.handle, tag, result) })
     }
 
     /// PrefixGet : Retrieves the list of all entries matching the provided prefix.
@@ -399,52 +493,78 @@ impl HandleType {
     /// This function returns the list of aliases.
     /// It’s up to the user to query the content associated with every entry, if needed.
     pub fn prefix_get(&self, prefix: &str, limit: i64) -> Result<Vec<String>, ErrorType> {
-        unsafe {
-            let prefix = utils::str_to_cstr(prefix);
-            let raw_ptr = ptr::null_mut();
-            let mut result_count: usize = 0;
-            let mut result: Vec<String> = Vec::new();
-
-            let err = qdb_prefix_get(
-                self.handle,
-                prefix,
-                limit,
-                raw_ptr,
-                &mut result_count,
-            );
-
-            if err == 0 && result_count > 0 {
-                result = match utils_ptr::raw_pointer_to_string_vector(raw_ptr, result_count) {
-                    Ok(v) => v,
-                    Err(e) => return Err(ErrorType::from_qdb_error_origin_t(e.error_code())),
-                };
-            }
-
-            ptr::drop_in_place(prefix);
-            ptr::drop_in_place(raw_ptr);
+        self.prefix_get_list(prefix, limit).map(|l| l.to_vec())
+    }
 
-            return match makeErrorNone(err) {
-                None => Ok(result),
-                Some(err) => Err(err),
-            };
-        }
+    /// PrefixGetList : Same as PrefixGet, the aliases are read in place from the API buffer instead of being copied.
+    pub fn prefix_get_list(&self, prefix: &str, limit: i64) -> Result<AliasList<'_>, ErrorType> {
+        self.alias_list(prefix, |prefix, aliases, count| unsafe { qdb_prefix_get(self.handle, prefix, limit, aliases, count) })
     }
 
     /// PrefixCount : Retrieves the count of all entries matching the provided prefix.
     /// A prefix-based count counts all entries matching a provided prefix.
     pub fn prefix_count(&self, prefix: &str) -> Result<u64, ErrorType> {
-        unsafe {
-            let prefix = utils::str_to_cstr(prefix);
-            let mut result: u64 = 0;
+        let mut result: u64 = 0;
+        let err = with_c_str(prefix, |prefix| unsafe { qdb_prefix_count(self.handle, prefix, &mut result) })?;
+
+        match makeErrorNone(err) {
+            None => Ok(result),
+            Some(err) => Err(err),
+        }
+    }
 
-            let err = qdb_prefix_count(self.handle, prefix, &mut result);
+    /// PrefixApproximateCount : Retrieves an estimate of the count of entries matching the provided prefix.
+    ///    Cheaper than PrefixCount, the nodes answer from their own statistics instead of walking the entries.
+    pub fn prefix_approximate_count(&self, prefix: &str) -> Result<u64, ErrorType> {
+        self.count(prefix, |prefix, result| unsafe { qdb_prefix_approximate_count(self.handle, prefix, result) })
+    }
 
-            ptr::drop_in_place(prefix);
+    /// SuffixGet : Retrieves the list of all entries matching the provided suffix.
+    ///    Same as PrefixGet, for the aliases ending with suffix.
+    pub fn suffix_get(&self, suffix: &str, limit: i64) -> Result<Vec<String>, ErrorType> {
+        self.suffix_get_list(suffix, limit).map(|l| l.to_vec())
+    }
 
-            return match makeErrorNone(err) {
-                None => Ok(result),
-                Some(err) => Err(err),
-            };
+    /// SuffixGetList : Same as SuffixGet, the aliases are read in place from the API buffer instead of being copied.
+    pub fn suffix_get_list(&self, suffix: &str, limit: i64) -> Result<AliasList<'_>, ErrorType> {
+        self.alias_list(suffix, |suffix, aliases, count| unsafe { qdb_suffix_get(self.handle, suffix, limit, aliases, count) })
+    }
+
+    /// SuffixCount : Retrieves the count of all entries matching the provided suffix.
+    pub fn suffix_count(&self, suffix: &str) -> Result<u64, ErrorType> {
+        self.count(suffix, |suffix, result| unsafe { qdb_suffix_count(self.handle, suffix, result) })
+    }
+
+    /// SuffixApproximateCount : Retrieves an estimate of the count of entries matching the provided suffix.
+    pub fn suffix_approximate_count(&self, suffix: &str) -> Result<u64, ErrorType> {
+        self.count(suffix, |suffix, result| unsafe { qdb_suffix_approximate_count(self.handle, suffix, result) })
+    }
+
+    // Runs a call counting entries, with arg converted to a C string.
+    fn count<F>(&self, arg: &str, call: F) -> Result<u64, ErrorType>
+        where F: FnOnce(*const raw::c_char, *mut u64) -> qdb_error_t {
+        let mut result: u64 = 0;
+        let err = with_c_str(arg, |arg| call(arg, &mut result))?;
+
+        match makeErrorNone(err) {
+            None => Ok(result),
+            Some(err) => Err(err),
+        }
+    }
+
+    // Runs a call returning an API allocated array of aliases, with arg converted to a C string.
+    pub(crate) fn alias_list<F>(&self, arg: &str, call: F) -> Result<AliasList<'_>, ErrorType>
+        where F: FnOnce(*const raw::c_char, *mut *mut *const raw::c_char, *mut usize) -> qdb_error_t {
+        let mut aliases: *mut *const raw::c_char = ptr::null_mut();
+        let mut count: usize = 0;
+
+        let err = with_c_str(arg, |arg| call(arg, &mut aliases, &mut count))?;
+
+        // the list releases the buffer whatever the outcome
+        let list = unsafe { AliasList::from_api(self, aliases, count) };
+        match makeErrorNone(err) {
+            None => list,
+            Some(err) => Err(err),
         }
     }
 }
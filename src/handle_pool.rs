@@ -0,0 +1,65 @@
+use std::sync::atomic::{AtomicUsize, Ordering};
+
+use crate::error::ErrorType;
+use crate::handle::{HandleType, setup_handle};
+
+/// HandlePool : A fixed set of handles connected to the same cluster.
+///    Each handle owns its own connections, spreading work over the pool lets independent
+///    requests run concurrently instead of queueing on a single handle.
+///    The handles are closed when the pool is dropped.
+pub struct HandlePool {
+    handles: Vec<HandleType>,
+    next: AtomicUsize,
+}
+
+/// NewHandlePool : Setup size handles connected to the cluster, return error if needed
+///    Every handle is opened with tcp protocol, has the given timeout and is connected with the clusterURI string
+pub fn new_handle_pool(cluster_uri: &str, timeout: i32, size: usize) -> Result<HandlePool, ErrorType> {
+    let mut handles = Vec::with_capacity(size.max(1));
+
+    for _ in 0..size.max(1) {
+        match setup_handle(cluster_uri, timeout) {
+            Ok(h) => handles.push(h),
+            Err(e) => {
+                for h in handles {
+                    h.close();
+                }
+                return Err(e);
+            }
+        }
+    }
+
+    Ok(HandlePool { handles, next: AtomicUsize::new(0) })
+}
+
+impl HandlePool {
+    /// FromHandles : Builds a pool out of already connected handles.
+    pub fn from_handles(handles: Vec<HandleType>) -> HandlePool {
+        assert!(!handles.is_empty(), "a handle pool needs at least one handle");
+        HandlePool { handles, next: AtomicUsize::new(0) }
+    }
+
+    /// Size : Returns the number of handles of the pool.
+    pub fn size(&self) -> usize {
+        self.handles.len()
+    }
+
+    /// Get : Returns the next handle, in round robin order.
+    pub fn get(&self) -> &HandleType {
+        let i = self.next.fetch_add(1, Ordering::Relaxed);
+        &self.handles[i % self.handles.len()]
+    }
+
+    /// Handle : Returns the handle at index i modulo the pool size.
+    pub fn handle(&self, i: usize) -> &HandleType {
+        &self.handles[i % self.handles.len()]
+    }
+}
+
+impl Drop for HandlePool {
+    fn drop(&mut self) {
+        for h in &self.handles {
+            h.close();
+        }
+    }
+}
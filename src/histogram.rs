@@ -0,0 +1,141 @@
+// Number of significant bits kept for every recorded value,
+// 7 bits bound the relative error of a bucket to 1 / 64.
+const SUB_BUCKET_BITS: u32 = 7;
+const SUB_BUCKET_COUNT: usize = 1 << SUB_BUCKET_BITS;
+const SUB_BUCKET_HALF: usize = SUB_BUCKET_COUNT / 2;
+const BUCKET_COUNT: usize = SUB_BUCKET_COUNT + (64 - SUB_BUCKET_BITS as usize) * SUB_BUCKET_HALF;
+
+/// LatencyHistogram : A log-linear histogram in the style of HdrHistogram.
+///    Values up to 2^7 are counted exactly, larger values in buckets whose width
+///    is at most 1/64 of their lower bound, covering the whole u64 range in constant memory.
+#[derive(Clone)]
+pub struct LatencyHistogram {
+    counts: Box<[u64]>,
+    total: u64,
+    sum: u128,
+    min: u64,
+    max: u64,
+}
+
+impl Default for LatencyHistogram {
+    fn default() -> Self {
+        LatencyHistogram::new()
+    }
+}
+
+impl std::fmt::Debug for LatencyHistogram {
+    fn fmt(&self, f: &mut std::fmt::Formatter) -> std::fmt::Result {
+        f.debug_struct("LatencyHistogram")
+            .field("count", &self.total)
+            .field("min", &self.min())
+            .field("p50", &self.percentile(50.0))
+            .field("p99", &self.percentile(99.0))
+            .field("max", &self.max)
+            .finish()
+    }
+}
+
+impl LatencyHistogram {
+    /// Creates an empty histogram.
+    pub fn new() -> LatencyHistogram {
+        LatencyHistogram {
+            counts: vec![0; BUCKET_COUNT].into_boxed_slice(),
+            total: 0,
+            sum: 0,
+            min: u64::MAX,
+            max: 0,
+        }
+    }
+
+    /// Record : Adds one occurrence of value.
+    pub fn record(&mut self, value: u64) {
+        self.record_n(value, 1);
+    }
+
+    /// RecordN : Adds count occurrences of value.
+    pub fn record_n(&mut self, value: u64, count: u64) {
+        if count == 0 {
+            return;
+        }
+        self.counts[bucket_index(value)] += count;
+        self.total += count;
+        self.sum += value as u128 * count as u128;
+        self.min = self.min.min(value);
+        self.max = self.max.max(value);
+    }
+
+    /// Merge : Adds every value recorded by other.
+    pub fn merge(&mut self, other: &LatencyHistogram) {
+        for (a, b) in self.counts.iter_mut().zip(other.counts.iter()) {
+            *a += *b;
+        }
+        self.total += other.total;
+        self.sum += other.sum;
+        self.min = self.min.min(other.min);
+        self.max = self.max.max(other.max);
+    }
+
+    /// Reset : Forgets every recorded value.
+    pub fn reset(&mut self) {
+        *self = LatencyHistogram::new();
+    }
+
+    pub fn count(&self) -> u64 {
+        self.total
+    }
+
+    pub fn min(&self) -> u64 {
+        if self.total == 0 { 0 } else { self.min }
+    }
+
+    pub fn max(&self) -> u64 {
+        self.max
+    }
+
+    pub fn mean(&self) -> f64 {
+        if self.total == 0 { 0.0 } else { self.sum as f64 / self.total as f64 }
+    }
+
+    /// Percentile : Returns the value below which percentile percent of the recorded values fall,
+    ///    e.g. percentile(99.9) for the p999. Returns 0 for an empty histogram.
+    pub fn percentile(&self, percentile: f64) -> u64 {
+        if self.total == 0 {
+            return 0;
+        }
+
+        let rank = ((percentile.clamp(0.0, 100.0) / 100.0) * self.total as f64).ceil().max(1.0) as u64;
+
+        let mut seen = 0u64;
+        for (i, count) in self.counts.iter().enumerate() {
+            seen += count;
+            if seen >= rank {
+                return bucket_value(i).clamp(self.min, self.max);
+            }
+        }
+
+        self.max
+    }
+}
+
+fn bucket_index(value: u64) -> usize {
+    let bits = 64 - value.leading_zeros();
+    if bits <= SUB_BUCKET_BITS {
+        return value as usize;
+    }
+
+    let shift = bits - SUB_BUCKET_BITS;
+    let top = (value >> shift) as usize;
+    SUB_BUCKET_COUNT + (shift as usize - 1) * SUB_BUCKET_HALF + (top - SUB_BUCKET_HALF)
+}
+
+// middle of the range of values counted in bucket i
+fn bucket_value(i: usize) -> u64 {
+    if i < SUB_BUCKET_COUNT {
+        return i as u64;
+    }
+
+    let j = i - SUB_BUCKET_COUNT;
+    let shift = (j / SUB_BUCKET_HALF + 1) as u32;
+    let top = (j % SUB_BUCKET_HALF + SUB_BUCKET_HALF) as u64;
+    (top << shift) + ((1u64 << shift) >> 1)
+}
@@ -12,5 +12,36 @@ pub mod handle;
 pub mod handle_const;
 mod utils;
 pub mod handler_credentials;
-mod utils_ptr;
+#[doc(hidden)]
+pub mod utils_ptr;
+pub mod ffi_str;
 pub mod entry;
+pub mod batch;
+pub mod query;
+pub mod query_cache;
+pub mod blob_cache;
+pub mod blob_stream;
+pub mod codec;
+pub mod continuous_query;
+pub mod spsc_queue;
+pub mod handle_pool;
+pub mod query_splitter;
+pub mod histogram;
+pub mod perf;
+pub mod perf_trace;
+pub mod mpsc_ring;
+pub mod log_sink;
+pub mod memory_governor;
+pub mod auto_tuner;
+pub mod random;
+pub mod loadgen;
+pub mod async_client;
+pub mod counter_aggregator;
+pub mod atomic_update;
+pub mod expiry;
+pub mod alias_scan;
+pub mod bitmap;
+pub mod tag_index;
+pub mod bulk_tag;
+#[cfg(feature = "fake-api")]
+pub mod fake_api;
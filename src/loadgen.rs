@@ -0,0 +1,674 @@
+use std::ffi::CString;
+use std::fmt;
+use std::fmt::Write;
+use std::thread;
+use std::time::{Duration, Instant, SystemTime, UNIX_EPOCH};
+
+use serde::Deserialize;
+
+use crate::error::{ErrorType, makeErrorNone};
+use crate::handle::HandleType;
+use crate::handle_pool::HandlePool;
+use crate::histogram::LatencyHistogram;
+use crate::query::nanos_to_timespec;
+use crate::query_splitter::format_timestamp;
+pub use crate::random::Rng;
+use crate::{qdb_error_t_qdb_e_alias_already_exists, qdb_ts_column_info_t, qdb_ts_column_type_t_qdb_ts_column_double,
+            qdb_ts_create, qdb_ts_double_insert, qdb_ts_double_point};
+
+/// WorkloadSpec : Declarative description of a load test, usually read from a JSON file:
+///    {
+///      "rate": 2000, "duration_ms": 30000, "warmup_ms": 2000, "workers": 16,
+///      "keys": { "count": 100000, "distribution": { "zipfian": 0.99 } },
+///      "value_size": { "uniform": [512, 4096] },
+///      "mix": { "blob_get": 0.8, "blob_put": 0.15, "ts_insert": 0.04, "query": 0.01 },
+///      "ts": { "table": "loadgen.ts", "columns": 8, "rows_per_insert": 100 },
+///      "queries": ["select * from \"{table}\" in range({now-1min}, {now})"],
+///      "burst": { "period_ms": 10000, "on_ms": 1000, "multiplier": 5,
+///                 "mix": { "ts_insert": 1 } }
+///    }
+///    rate : operations started per second, over all workers.
+///    Requests are issued on a fixed schedule whatever the latency of the previous ones (open loop),
+///    and latencies are measured from the time an operation was due, not the time it started,
+///    so that a stalled client or cluster is not hidden by the requests it delayed.
+#[derive(Debug, Clone, Deserialize)]
+#[serde(deny_unknown_fields)]
+pub struct WorkloadSpec {
+    pub rate: f64,
+    pub duration_ms: u64,
+    #[serde(default)]
+    pub warmup_ms: u64,
+    #[serde(default = "default_workers")]
+    pub workers: usize,
+    #[serde(default = "default_seed")]
+    pub seed: u64,
+    #[serde(default)]
+    pub keys: KeySpec,
+    #[serde(default)]
+    pub value_size: SizeDistribution,
+    pub mix: Mix,
+    #[serde(default)]
+    pub ts: TsSpec,
+    #[serde(default)]
+    pub queries: Vec<String>,
+    #[serde(default)]
+    pub burst: Option<Burst>,
+    // writes every key once and creates the table before the measurement starts
+    #[serde(default = "default_true")]
+    pub preload: bool,
+}
+
+fn default_workers() -> usize { 8 }
+fn default_seed() -> u64 { 0x2545f4914f6cdd1d }
+fn default_true() -> bool { true }
+
+/// KeySpec : The blob aliases are prefix followed by the key number, in [0, count).
+#[derive(Debug, Clone, Deserialize)]
+#[serde(deny_unknown_fields)]
+pub struct KeySpec {
+    pub count: u64,
+    #[serde(default = "default_prefix")]
+    pub prefix: String,
+    #[serde(default)]
+    pub distribution: KeyDistribution,
+}
+
+fn default_prefix() -> String { "loadgen.blob.".to_string() }
+
+impl Default for KeySpec {
+    fn default() -> Self {
+        KeySpec { count: 10_000, prefix: default_prefix(), distribution: KeyDistribution::default() }
+    }
+}
+
+/// KeyDistribution : How keys are picked.
+///    zipfian takes the skew theta in (0, 1), 0.99 being the usual value for hot key workloads.
+#[derive(Debug, Clone, Copy, Default, Deserialize)]
+#[serde(rename_all = "snake_case")]
+pub enum KeyDistribution {
+    #[default]
+    Uniform,
+    Zipfian(f64),
+    // the most recently written keys are the most likely, theta as for zipfian
+    Latest(f64),
+}
+
+/// SizeDistribution : Size of the written blobs, in bytes.
+#[derive(Debug, Clone, Copy, Deserialize)]
+#[serde(rename_all = "snake_case")]
+pub enum SizeDistribution {
+    Fixed(usize),
+    Uniform(usize, usize),
+    // sizes whose logarithm is normally distributed, given by the median and the sigma of the logarithm
+    LogNormal(usize, f64),
+}
+
+impl Default for SizeDistribution {
+    fn default() -> Self {
+        SizeDistribution::Fixed(1024)
+    }
+}
+
+/// Mix : Relative weight of every operation, they need not add up to one.
+#[derive(Debug, Clone, Copy, Default, Deserialize)]
+#[serde(deny_unknown_fields)]
+pub struct Mix {
+    #[serde(default)]
+    pub blob_get: f64,
+    #[serde(default)]
+    pub blob_put: f64,
+    #[serde(default)]
+    pub ts_insert: f64,
+    #[serde(default)]
+    pub query: f64,
+}
+
+/// TsSpec : The table ts_insert writes to and query templates read from, it has columns double columns.
+#[derive(Debug, Clone, Deserialize)]
+#[serde(deny_unknown_fields)]
+pub struct TsSpec {
+    #[serde(default = "default_table")]
+    pub table: String,
+    #[serde(default = "default_columns")]
+    pub columns: usize,
+    #[serde(default = "default_rows")]
+    pub rows_per_insert: usize,
+    #[serde(default = "default_shard_size")]
+    pub shard_size_ms: u64,
+}
+
+fn default_table() -> String { "loadgen.ts".to_string() }
+fn default_columns() -> usize { 4 }
+fn default_rows() -> usize { 100 }
+fn default_shard_size() -> u64 { 24 * 60 * 60 * 1000 }
+
+impl Default for TsSpec {
+    fn default() -> Self {
+        TsSpec { table: default_table(), columns: default_columns(), rows_per_insert: default_rows(), shard_size_ms: default_shard_size() }
+    }
+}
+
+/// Burst : For on_ms out of every period_ms the rate is multiplied by multiplier,
+///    and operations are drawn from mix instead of the workload mix when one is given.
+#[derive(Debug, Clone, Copy, Deserialize)]
+#[serde(deny_unknown_fields)]
+pub struct Burst {
+    pub period_ms: u64,
+    pub on_ms: u64,
+    pub multiplier: f64,
+    #[serde(default)]
+    pub mix: Option<Mix>,
+}
+
+/// ParseWorkload : Reads and checks a JSON workload spec.
+pub fn parse_workload(json: &str) -> Result<WorkloadSpec, String> {
+    let spec: WorkloadSpec = serde_json::from_str(json).map_err(|e| e.to_string())?;
+    spec.validate()?;
+    Ok(spec)
+}
+
+impl WorkloadSpec {
+    pub fn validate(&self) -> Result<(), String> {
+        if !(self.rate > 0.0) {
+            return Err("rate must be positive".to_string());
+        }
+        if self.workers == 0 {
+            return Err("workers must be positive".to_string());
+        }
+        if self.keys.count == 0 {
+            return Err("keys.count must be positive".to_string());
+        }
+        match self.keys.distribution {
+            KeyDistribution::Zipfian(theta) | KeyDistribution::Latest(theta) if !(theta > 0.0 && theta < 1.0) => {
+                return Err("the zipfian theta must be in (0, 1)".to_string());
+            }
+            _ => {}
+        }
+        match self.value_size {
+            SizeDistribution::Uniform(min, max) if min > max => return Err("value_size min exceeds max".to_string()),
+            SizeDistribution::LogNormal(median, sigma) if median == 0 || !(sigma >= 0.0) => {
+                return Err("value_size log_normal needs a positive median and sigma".to_string());
+            }
+            _ => {}
+        }
+        check_mix(&self.mix)?;
+        if self.mix.query > 0.0 && self.queries.is_empty() {
+            return Err("the mix has queries but no query template is given".to_string());
+        }
+        if self.ts.columns == 0 || self.ts.rows_per_insert == 0 {
+            return Err("ts.columns and ts.rows_per_insert must be positive".to_string());
+        }
+        if let Some(b) = &self.burst {
+            if b.period_ms == 0 || b.on_ms > b.period_ms || !(b.multiplier > 0.0) {
+                return Err("burst needs on_ms <= period_ms and a positive multiplier".to_string());
+            }
+            if let Some(m) = &b.mix {
+                check_mix(m)?;
+                if m.query > 0.0 && self.queries.is_empty() {
+                    return Err("the burst mix has queries but no query template is given".to_string());
+                }
+            }
+        }
+        Ok(())
+    }
+}
+
+fn check_mix(mix: &Mix) -> Result<(), String> {
+    let weights = [mix.blob_get, mix.blob_put, mix.ts_insert, mix.query];
+    if weights.iter().any(|w| !(*w >= 0.0)) || weights.iter().sum::<f64>() <= 0.0 {
+        return Err("the mix weights must be non negative and not all zero".to_string());
+    }
+    Ok(())
+}
+
+/// Op : The operations a workload is made of.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum Op {
+    BlobGet,
+    BlobPut,
+    TsInsert,
+    Query,
+}
+
+const OPS: [Op; 4] = [Op::BlobGet, Op::BlobPut, Op::TsInsert, Op::Query];
+
+impl Op {
+    pub fn name(&self) -> &'static str {
+        match self {
+            Op::BlobGet => "blob_get",
+            Op::BlobPut => "blob_put",
+            Op::TsInsert => "ts_insert",
+            Op::Query => "query",
+        }
+    }
+}
+
+impl Mix {
+    fn pick(&self, u: f64) -> Op {
+        let weights = [self.blob_get, self.blob_put, self.ts_insert, self.query];
+        let mut target = u * weights.iter().sum::<f64>();
+        for (op, w) in OPS.iter().zip(weights.iter()) {
+            if target < *w {
+                return *op;
+            }
+            target -= w;
+        }
+        // rounding, fall back on the last operation with a weight
+        *OPS.iter().zip(weights.iter()).rev().find(|(_, w)| **w > 0.0).unwrap().0
+    }
+}
+
+/// Schedule : When every operation is due, relative to the start of the run.
+///    Operation i is due at i / rate, or on the equivalent piecewise schedule when there are bursts.
+#[derive(Debug, Clone, Copy)]
+pub struct Schedule {
+    rate: f64,
+    burst: Option<Burst>,
+}
+
+impl Schedule {
+    pub fn new(rate: f64, burst: Option<Burst>) -> Schedule {
+        Schedule { rate, burst }
+    }
+
+    /// Arrival : Returns when operation i is due and whether it falls within a burst.
+    pub fn arrival(&self, i: u64) -> (Duration, bool) {
+        let i = i as f64;
+        let b = match &self.burst {
+            Some(b) => b,
+            None => return (Duration::from_secs_f64(i / self.rate), false),
+        };
+
+        let period = b.period_ms as f64 / 1000.0;
+        let on = b.on_ms as f64 / 1000.0;
+        let burst_rate = self.rate * b.multiplier;
+        let on_ops = burst_rate * on;
+        let period_ops = on_ops + self.rate * (period - on);
+
+        let periods = (i / period_ops).floor();
+        let within = i - periods * period_ops;
+        let (offset, bursting) = if within < on_ops {
+            (within / burst_rate, true)
+        } else {
+            (on + (within - on_ops) / self.rate, false)
+        };
+        (Duration::from_secs_f64(periods * period + offset), bursting)
+    }
+}
+
+/// Zipfian : Draws ranks in [0, n) where rank k has a probability proportional to 1 / (k + 1)^theta,
+///    with the method of Gray et al., "Quickly generating billion-record synthetic databases".
+///    Setup is linear in n, every draw is constant time.
+#[derive(Debug, Clone)]
+pub struct Zipfian {
+    n: u64,
+    theta: f64,
+    alpha: f64,
+    zetan: f64,
+    eta: f64,
+}
+
+impl Zipfian {
+    pub fn new(n: u64, theta: f64) -> Zipfian {
+        let zeta = |count: u64| (1..=count).map(|i| 1.0 / (i as f64).powf(theta)).sum::<f64>();
+        let zetan = zeta(n);
+        let zeta2 = zeta(2.min(n));
+        let eta = if n > 1 { (1.0 - (2.0 / n as f64).powf(1.0 - theta)) / (1.0 - zeta2 / zetan) } else { 0.0 };
+        Zipfian { n, theta, alpha: 1.0 / (1.0 - theta), zetan, eta }
+    }
+
+    /// Next : Returns a rank, 0 being the most frequent.
+    pub fn next(&self, rng: &mut Rng) -> u64 {
+        let u = rng.next_f64();
+        let uz = u * self.zetan;
+        if uz < 1.0 {
+            return 0;
+        }
+        if uz < 1.0 + 0.5f64.powf(self.theta) {
+            return 1.min(self.n - 1);
+        }
+        ((self.n as f64 * (self.eta * u - self.eta + 1.0).powf(self.alpha)) as u64).min(self.n - 1)
+    }
+}
+
+// Spreads the zipfian ranks over the key space, so that hot keys are not neighbours.
+fn scramble(rank: u64, n: u64) -> u64 {
+    let mut h: u64 = 0xcbf29ce484222325;
+    for b in rank.to_le_bytes() {
+        h ^= b as u64;
+        h = h.wrapping_mul(0x100000001b3);
+    }
+    h % n
+}
+
+/// KeyChooser : Draws key numbers according to a KeyDistribution.
+#[derive(Debug, Clone)]
+pub struct KeyChooser {
+    count: u64,
+    distribution: KeyDistribution,
+    zipfian: Option<Zipfian>,
+}
+
+impl KeyChooser {
+    pub fn new(spec: &KeySpec) -> KeyChooser {
+        let zipfian = match spec.distribution {
+            KeyDistribution::Zipfian(theta) | KeyDistribution::Latest(theta) => Some(Zipfian::new(spec.count, theta)),
+            KeyDistribution::Uniform => None,
+        };
+        KeyChooser { count: spec.count, distribution: spec.distribution, zipfian }
+    }
+
+    /// Next : Returns a key number, latest is the number of the last written key for the Latest distribution.
+    pub fn next(&self, rng: &mut Rng, latest: u64) -> u64 {
+        match (&self.distribution, &self.zipfian) {
+            (KeyDistribution::Zipfian(_), Some(z)) => scramble(z.next(rng), self.count),
+            (KeyDistribution::Latest(_), Some(z)) => (latest + self.count - z.next(rng) % self.count) % self.count,
+            _ => rng.next_u64() % self.count,
+        }
+    }
+}
+
+impl SizeDistribution {
+    pub fn sample(&self, rng: &mut Rng) -> usize {
+        match *self {
+            SizeDistribution::Fixed(size) => size,
+            SizeDistribution::Uniform(min, max) => min + (rng.next_u64() % (max - min + 1) as u64) as usize,
+            SizeDistribution::LogNormal(median, sigma) => ((median as f64).ln() + sigma * rng.next_gaussian()).exp().round() as usize,
+        }
+    }
+
+    fn max(&self) -> usize {
+        match *self {
+            SizeDistribution::Fixed(size) => size,
+            SizeDistribution::Uniform(_, max) => max,
+            // sizes beyond 6 sigmas are clamped
+            SizeDistribution::LogNormal(median, sigma) => ((median as f64).ln() + 6.0 * sigma).exp().ceil() as usize,
+        }
+    }
+}
+
+/// RenderQuery : Substitutes {table}, {now} and {now-<duration>} in a query template,
+///    durations being written as in queries, e.g. {now-5min} or {now-1h}.
+pub fn render_query(template: &str, table: &str, now_nanos: i64) -> String {
+    let mut out = String::with_capacity(template.len() + 32);
+    let mut rest = template;
+    while let Some(open) = rest.find('{') {
+        out.push_str(&rest[..open]);
+        let close = match rest[open..].find('}') {
+            Some(c) => open + c,
+            None => break,
+        };
+        let name = &rest[open + 1..close];
+        match name {
+            "table" => out.push_str(table),
+            "now" => out.push_str(&format_timestamp(now_nanos)),
+            _ => match name.strip_prefix("now-").and_then(parse_duration) {
+                Some(d) => out.push_str(&format_timestamp(now_nanos - d)),
+                None => out.push_str(&rest[open..=close]),
+            },
+        }
+        rest = &rest[close + 1..];
+    }
+    out.push_str(rest);
+    out
+}
+
+fn parse_duration(s: &str) -> Option<i64> {
+    let split = s.find(|c: char| !c.is_ascii_digit())?;
+    let count: i64 = s[..split].parse().ok()?;
+    let unit: i64 = match &s[split..] {
+        "ns" => 1,
+        "us" => 1_000,
+        "ms" => 1_000_000,
+        "s" => 1_000_000_000,
+        "min" => 60 * 1_000_000_000,
+        "h" => 3_600 * 1_000_000_000,
+        "d" => 86_400 * 1_000_000_000,
+        _ => return None,
+    };
+    count.checked_mul(unit)
+}
+
+/// OpReport : What was measured for one operation, latencies are in microseconds.
+///    latency : from the time the operation was due to its completion, it includes the time
+///        spent waiting behind earlier operations (corrected for coordinated omission).
+///    service : from the time the operation actually started to its completion.
+#[derive(Debug, Clone)]
+pub struct OpReport {
+    pub op: Op,
+    pub count: u64,
+    pub errors: u64,
+    pub latency: LatencyHistogram,
+    pub service: LatencyHistogram,
+}
+
+impl OpReport {
+    fn new(op: Op) -> OpReport {
+        OpReport { op, count: 0, errors: 0, latency: LatencyHistogram::new(), service: LatencyHistogram::new() }
+    }
+
+    fn merge(&mut self, other: &OpReport) {
+        self.count += other.count;
+        self.errors += other.errors;
+        self.latency.merge(&other.latency);
+        self.service.merge(&other.service);
+    }
+}
+
+/// LoadReport : The outcome of a run, only the operations due after the warmup are counted.
+#[derive(Debug, Clone)]
+pub struct LoadReport {
+    pub elapsed: Duration,
+    // operations that were due but started more than one second late
+    pub late: u64,
+    pub ops: Vec<OpReport>,
+}
+
+impl LoadReport {
+    /// Throughput : Completed operations per second, errors included.
+    pub fn throughput(&self, op: Op) -> f64 {
+        let secs = self.elapsed.as_secs_f64();
+        match self.ops.iter().find(|r| r.op == op) {
+            Some(r) if secs > 0.0 => r.count as f64 / secs,
+            _ => 0.0,
+        }
+    }
+}
+
+impl fmt::Display for LoadReport {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        writeln!(f, "{:<10} {:>9} {:>7} {:>10} {:>9} {:>9} {:>9} {:>9} {:>9} {:>11}",
+                 "op", "count", "errors", "ops/s", "p50 us", "p90 us", "p99 us", "p999 us", "max us", "svc p99 us")?;
+        for r in self.ops.iter().filter(|r| r.count > 0) {
+            writeln!(f, "{:<10} {:>9} {:>7} {:>10.1} {:>9} {:>9} {:>9} {:>9} {:>9} {:>11}",
+                     r.op.name(), r.count, r.errors, self.throughput(r.op),
+                     r.latency.percentile(50.0), r.latency.percentile(90.0), r.latency.percentile(99.0),
+                     r.latency.percentile(99.9), r.latency.max(), r.service.percentile(99.0))?;
+        }
+        write!(f, "{:.1}s measured, {} operation(s) started more than 1s late", self.elapsed.as_secs_f64(), self.late)
+    }
+}
+
+fn now_nanos() -> i64 {
+    SystemTime::now().duration_since(UNIX_EPOCH).map_or(0, |d| d.as_nanos() as i64)
+}
+
+/// Preload : Writes every key of the spec once and creates its table when it does not exist yet.
+pub fn preload(pool: &HandlePool, spec: &WorkloadSpec) -> Result<(), ErrorType> {
+    if spec.mix.ts_insert > 0.0 || spec.mix.query > 0.0 || spec.burst.map_or(false, |b| b.mix.is_some()) {
+        create_table(pool.get(), &spec.ts)?;
+    }
+
+    let mut rng = Rng::new(spec.seed);
+    let value = random_bytes(&mut rng, spec.value_size.max());
+    let workers = pool.size() as u64;
+
+    thread::scope(|s| {
+        let workers: Vec<_> = (0..workers)
+            .map(|w| {
+                let (handle, value, spec) = (pool.handle(w as usize), &value, spec);
+                s.spawn(move || {
+                    let mut rng = Rng::new(spec.seed ^ w);
+                    let mut alias = String::new();
+                    for key in (w..spec.keys.count).step_by(workers as usize) {
+                        let size = spec.value_size.sample(&mut rng).min(value.len());
+                        if let Some(e) = handle.blob_update(key_alias(&mut alias, &spec.keys.prefix, key), &value[..size], 0) {
+                            return Err(e);
+                        }
+                    }
+                    Ok(())
+                })
+            })
+            .collect();
+        workers.into_iter().try_for_each(|w| w.join().unwrap())
+    })
+}
+
+fn create_table(handle: &HandleType, ts: &TsSpec) -> Result<(), ErrorType> {
+    let alias = CString::new(ts.table.as_str()).map_err(|_| ErrorType::ErrInvalidArgument)?;
+    let names: Vec<CString> = (0..ts.columns).map(|i| CString::new(format!("c{}", i)).unwrap()).collect();
+    let columns: Vec<qdb_ts_column_info_t> = names.iter()
+        .map(|n| qdb_ts_column_info_t { name: n.as_ptr(), type_: qdb_ts_column_type_t_qdb_ts_column_double })
+        .collect();
+
+    let err = unsafe { qdb_ts_create(handle.handle, alias.as_ptr(), ts.shard_size_ms, columns.as_ptr(), columns.len()) };
+    if err == qdb_error_t_qdb_e_alias_already_exists {
+        return Ok(());
+    }
+    match makeErrorNone(err) {
+        Some(e) => Err(e),
+        None => Ok(()),
+    }
+}
+
+fn random_bytes(rng: &mut Rng, len: usize) -> Vec<u8> {
+    let mut bytes = Vec::with_capacity(len + 8);
+    while bytes.len() < len {
+        bytes.extend_from_slice(&rng.next_u64().to_le_bytes());
+    }
+    bytes.truncate(len);
+    bytes
+}
+
+// Writes the alias of key to a buffer reused by the worker, converted on the stack by the blob calls.
+fn key_alias<'a>(alias: &'a mut String, prefix: &str, key: u64) -> &'a str {
+    alias.clear();
+    let _ = write!(alias, "{}{}", prefix, key);
+    alias
+}
+
+// Inserts rows_per_insert rows, a nanosecond apart, into every column, a call per column.
+fn ts_insert(handle: &HandleType, table: &CString, columns: &[CString], points: &mut [qdb_ts_double_point],
+             first: i64, rng: &mut Rng) -> Option<ErrorType> {
+    for column in columns {
+        for (i, p) in points.iter_mut().enumerate() {
+            p.timestamp = nanos_to_timespec(first + i as i64);
+            p.value = rng.next_f64();
+        }
+        let err = unsafe { qdb_ts_double_insert(handle.handle, table.as_ptr(), column.as_ptr(), points.as_ptr(), points.len()) };
+        if let Some(e) = makeErrorNone(err) {
+            return Some(e);
+        }
+    }
+    None
+}
+
+/// RunWorkload : Runs the workload against the pool, one worker thread per spec.workers,
+///    worker w handling the operations due at w, w + workers, w + 2 * workers...
+///    and using the handle w of the pool. Blocks until the run is over.
+pub fn run_workload(pool: &HandlePool, spec: &WorkloadSpec) -> LoadReport {
+    let schedule = Schedule::new(spec.rate, spec.burst);
+    let chooser = KeyChooser::new(&spec.keys);
+    let value = random_bytes(&mut Rng::new(spec.seed), spec.value_size.max());
+    let table = CString::new(spec.ts.table.as_str()).unwrap_or_default();
+    let columns: Vec<CString> = (0..spec.ts.columns).map(|i| CString::new(format!("c{}", i)).unwrap()).collect();
+
+    let warmup = Duration::from_millis(spec.warmup_ms);
+    let end = warmup + Duration::from_millis(spec.duration_ms);
+    let workers = spec.workers as u64;
+    let start = Instant::now();
+
+    let reports: Vec<(Vec<OpReport>, u64)> = thread::scope(|s| {
+        let handles: Vec<_> = (0..workers)
+            .map(|w| {
+                let (schedule, chooser, value, table, columns) = (&schedule, &chooser, &value, &table, &columns);
+                s.spawn(move || {
+                    let handle = pool.handle(w as usize);
+                    let mut rng = Rng::new(spec.seed.wrapping_add(w + 1));
+                    let mut ops: Vec<OpReport> = OPS.iter().map(|op| OpReport::new(*op)).collect();
+                    let mut points = vec![qdb_ts_double_point { timestamp: nanos_to_timespec(0), value: 0.0 }; spec.ts.rows_per_insert];
+                    let mut late = 0u64;
+                    let mut latest = 0u64;
+                    let mut alias = String::new();
+
+                    for i in (w..).step_by(workers as usize) {
+                        let (due, bursting) = schedule.arrival(i);
+                        if due >= end {
+                            break;
+                        }
+                        let now = start.elapsed();
+                        if due > now {
+                            thread::sleep(due - now);
+                        }
+
+                        let mix = match (bursting, spec.burst.and_then(|b| b.mix)) {
+                            (true, Some(m)) => m,
+                            _ => spec.mix,
+                        };
+                        let op = mix.pick(rng.next_f64());
+
+                        let started = Instant::now();
+                        let error = match op {
+                            Op::BlobGet => {
+                                let key = chooser.next(&mut rng, latest);
+                                handle.blob_get_with(key_alias(&mut alias, &spec.keys.prefix, key), |_| ()).err()
+                            }
+                            Op::BlobPut => {
+                                latest = chooser.next(&mut rng, latest);
+                                let size = spec.value_size.sample(&mut rng).min(value.len());
+                                handle.blob_update(key_alias(&mut alias, &spec.keys.prefix, latest), &value[..size], 0)
+                            }
+                            Op::TsInsert => {
+                                ts_insert(handle, table, columns, &mut points, now_nanos(), &mut rng)
+                            }
+                            Op::Query => {
+                                let template = &spec.queries[(rng.next_u64() % spec.queries.len() as u64) as usize];
+                                handle.query(&render_query(template, &spec.ts.table, now_nanos())).err()
+                            }
+                        };
+                        let done = Instant::now();
+
+                        if due < warmup {
+                            continue;
+                        }
+                        let started_at = started.duration_since(start);
+                        if started_at > due + Duration::from_secs(1) {
+                            late += 1;
+                        }
+                        let r = &mut ops[OPS.iter().position(|o| *o == op).unwrap()];
+                        r.count += 1;
+                        if error.is_some() {
+                            r.errors += 1;
+                        }
+                        r.latency.record((done.duration_since(start).saturating_sub(due)).as_micros() as u64);
+                        r.service.record(done.duration_since(started).as_micros() as u64);
+                    }
+                    (ops, late)
+                })
+            })
+            .collect();
+        handles.into_iter().map(|h| h.join().unwrap()).collect()
+    });
+
+    let elapsed = start.elapsed().saturating_sub(warmup);
+    let mut ops: Vec<OpReport> = OPS.iter().map(|op| OpReport::new(*op)).collect();
+    let mut late = 0;
+    for (worker_ops, worker_late) in &reports {
+        for (total, r) in ops.iter_mut().zip(worker_ops.iter()) {
+            total.merge(r);
+        }
+        late += worker_late;
+    }
+
+    LoadReport { elapsed, late, ops }
+}
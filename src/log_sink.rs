@@ -0,0 +1,234 @@
+use std::io::Write;
+use std::os::raw;
+use std::slice;
+use std::sync::OnceLock;
+use std::sync::atomic::{AtomicBool, AtomicU32, AtomicU64, Ordering};
+use std::thread;
+use std::time::Duration;
+
+use crate::error::{ErrorType, makeErrorNone};
+use crate::mpsc_ring::MpscRing;
+use crate::{qdb_log_add_callback, qdb_log_callback_id, qdb_log_level_t, qdb_log_remove_callback};
+
+/// Longest message kept by the sink, longer messages are truncated.
+pub const LOG_MESSAGE_CAPACITY: usize = 480;
+
+/// LogSinkConfig : Settings of the asynchronous log sink.
+///    min_level : messages below this qdb_log_level_t are discarded before being copied.
+///    capacity : number of preallocated message slots, rounded up to a power of two.
+///        The ring is allocated by the first sink installed in the process and reused afterwards.
+///    flush_interval : how often the writer thread drains the ring.
+#[derive(Debug, Clone, Copy)]
+pub struct LogSinkConfig {
+    pub min_level: qdb_log_level_t,
+    pub capacity: usize,
+    pub flush_interval: Duration,
+}
+
+impl Default for LogSinkConfig {
+    fn default() -> Self {
+        LogSinkConfig {
+            min_level: crate::qdb_log_level_t_qdb_log_info,
+            capacity: 4096,
+            flush_interval: Duration::from_millis(10),
+        }
+    }
+}
+
+struct LogRecord {
+    level: qdb_log_level_t,
+    // year, month, day, hours, minutes, seconds
+    date: [u32; 6],
+    pid: u64,
+    tid: u64,
+    length: usize,
+    truncated: bool,
+    message: [u8; LOG_MESSAGE_CAPACITY],
+}
+
+impl Default for LogRecord {
+    fn default() -> Self {
+        LogRecord { level: 0, date: [0; 6], pid: 0, tid: 0, length: 0, truncated: false, message: [0; LOG_MESSAGE_CAPACITY] }
+    }
+}
+
+// The API callback carries no context, hence the sink state is process wide.
+static RING: OnceLock<MpscRing<LogRecord>> = OnceLock::new();
+static INSTALLED: AtomicBool = AtomicBool::new(false);
+static MIN_LEVEL: AtomicU32 = AtomicU32::new(u32::MAX);
+static ACCEPTED: AtomicU64 = AtomicU64::new(0);
+static DROPPED: AtomicU64 = AtomicU64::new(0);
+static FILTERED: AtomicU64 = AtomicU64::new(0);
+
+/// LogSinkMetrics : Counters of the log sink since the process started.
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct LogSinkMetrics {
+    pub accepted: u64,
+    pub dropped: u64,
+    pub filtered: u64,
+}
+
+/// LogSink : Receives the API logs through a single qdb_log_callback and writes them from a background thread.
+///    The callback only filters by level and copies the message into a preallocated lock-free ring,
+///    when the ring is full the message is counted as dropped instead of blocking the API thread.
+///    Only one sink may be installed at a time, dropping it unregisters the callback and flushes the ring.
+pub struct LogSink {
+    callback_id: qdb_log_callback_id,
+    stopped: std::sync::Arc<AtomicBool>,
+    writer: Option<thread::JoinHandle<()>>,
+}
+
+/// InstallLogSink : Registers the log callback and starts writing the logs to writer.
+///    Returns ErrResourceLocked when a sink is already installed.
+pub fn install_log_sink<W>(config: LogSinkConfig, mut writer: W) -> Result<LogSink, ErrorType>
+    where W: Write + Send + 'static
+{
+    if INSTALLED.swap(true, Ordering::AcqRel) {
+        return Err(ErrorType::ErrResourceLocked);
+    }
+
+    let ring = RING.get_or_init(|| MpscRing::with_capacity(config.capacity));
+    // the previous sink joined its writer before letting another be installed
+    let consumer = match ring.consumer() {
+        Some(c) => c,
+        None => {
+            INSTALLED.store(false, Ordering::Release);
+            return Err(ErrorType::ErrResourceLocked);
+        }
+    };
+    MIN_LEVEL.store(config.min_level, Ordering::Release);
+
+    let stopped = std::sync::Arc::new(AtomicBool::new(false));
+    let stop = stopped.clone();
+    let interval = config.flush_interval;
+
+    let worker = thread::spawn(move || {
+        let mut consumer = consumer;
+        loop {
+            let stopping = stop.load(Ordering::Acquire);
+            let mut wrote = false;
+            while consumer.pop_with(|record| { write_record(&mut writer, record); }) {
+                wrote = true;
+            }
+            if wrote {
+                let _ = writer.flush();
+            }
+            if stopping {
+                return;
+            }
+            thread::park_timeout(interval);
+        }
+    });
+
+    let mut callback_id: qdb_log_callback_id = 0;
+    let err = unsafe { qdb_log_add_callback(Some(on_log), &mut callback_id) };
+
+    let sink = LogSink { callback_id, stopped, writer: Some(worker) };
+
+    match makeErrorNone(err) {
+        None => Ok(sink),
+        Some(e) => {
+            // nothing was registered, do not remove anything on drop
+            let mut sink = sink;
+            sink.callback_id = 0;
+            drop(sink);
+            Err(e)
+        }
+    }
+}
+
+impl LogSink {
+    /// Metrics : Returns the accepted, dropped and filtered message counters.
+    pub fn metrics(&self) -> LogSinkMetrics {
+        log_sink_metrics()
+    }
+
+    /// SetMinLevel : Changes the level below which messages are discarded.
+    pub fn set_min_level(&self, level: qdb_log_level_t) {
+        MIN_LEVEL.store(level, Ordering::Release);
+    }
+}
+
+/// LogSinkMetrics : Returns the counters of the log sink.
+pub fn log_sink_metrics() -> LogSinkMetrics {
+    LogSinkMetrics {
+        accepted: ACCEPTED.load(Ordering::Relaxed),
+        dropped: DROPPED.load(Ordering::Relaxed),
+        filtered: FILTERED.load(Ordering::Relaxed),
+    }
+}
+
+impl Drop for LogSink {
+    fn drop(&mut self) {
+        if self.callback_id != 0 {
+            unsafe { qdb_log_remove_callback(self.callback_id) };
+        }
+        // stop accepting messages from callbacks that may still be running
+        MIN_LEVEL.store(u32::MAX, Ordering::Release);
+
+        self.stopped.store(true, Ordering::Release);
+        if let Some(writer) = self.writer.take() {
+            writer.thread().unpark();
+            let _ = writer.join();
+        }
+
+        INSTALLED.store(false, Ordering::Release);
+    }
+}
+
+/// LevelName : Returns the short name of a log level.
+pub fn level_name(level: qdb_log_level_t) -> &'static str {
+    match level {
+        0..=100 => "detailed",
+        101..=200 => "debug",
+        201..=300 => "info",
+        301..=400 => "warning",
+        401..=500 => "error",
+        _ => "panic",
+    }
+}
+
+unsafe extern "C" fn on_log(level: qdb_log_level_t, date: *const raw::c_ulong, pid: raw::c_ulong, tid: raw::c_ulong,
+                            message: *const raw::c_char, length: usize) {
+    if level < MIN_LEVEL.load(Ordering::Relaxed) {
+        FILTERED.fetch_add(1, Ordering::Relaxed);
+        return;
+    }
+
+    let ring = match RING.get() {
+        Some(r) => r,
+        None => return,
+    };
+
+    let pushed = ring.push_with(|record| {
+        record.level = level;
+        if !date.is_null() {
+            for (i, v) in slice::from_raw_parts(date, 6).iter().enumerate() {
+                record.date[i] = *v as u32;
+            }
+        }
+        record.pid = pid as u64;
+        record.tid = tid as u64;
+
+        let copied = if message.is_null() { 0 } else { length.min(LOG_MESSAGE_CAPACITY) };
+        if copied > 0 {
+            record.message[..copied].copy_from_slice(slice::from_raw_parts(message as *const u8, copied));
+        }
+        record.length = copied;
+        record.truncated = copied < length;
+    });
+
+    if pushed {
+        ACCEPTED.fetch_add(1, Ordering::Relaxed);
+    } else {
+        DROPPED.fetch_add(1, Ordering::Relaxed);
+    }
+}
+
+fn write_record<W: Write>(writer: &mut W, record: &LogRecord) {
+    let d = record.date;
+    let message = String::from_utf8_lossy(&record.message[..record.length]);
+    let _ = writeln!(writer, "{:04}-{:02}-{:02}T{:02}:{:02}:{:02} {:<8} pid={} tid={} {}{}",
+                     d[0], d[1], d[2], d[3], d[4], d[5], level_name(record.level), record.pid, record.tid,
+                     message.trim_end(), if record.truncated { "..." } else { "" });
+}
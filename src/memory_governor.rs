@@ -0,0 +1,284 @@
+use std::borrow::Cow;
+use std::sync::{Arc, Condvar, Mutex, Weak};
+use std::sync::atomic::{AtomicBool, AtomicU64, Ordering};
+use std::thread;
+use std::time::{Duration, Instant};
+
+use serde_json::Value;
+
+use crate::error::ErrorType;
+use crate::handle::HandleType;
+
+/// MemoryGovernorConfig : Watermarks of the memory governor, in bytes.
+///    soft_limit : above it the API is asked to tidy its memory, it is also handed to the API
+///        as its own soft limit.
+///    hard_limit : above it callers of MemoryGate::admit wait until usage drops back below.
+///    sample_interval : how often the client memory is sampled.
+///    tidy_interval : the least time between two tidies, tidying is not free and usage
+///        may stay above the soft limit for many samples.
+///    usage_pointer : JSON pointer to the bytes in use in the document of qdb_option_client_get_memory_info,
+///        such as "/allocated", or "" when the document is a plain number. The content of the document is
+///        experimental and undocumented, it is not guessed.
+#[derive(Debug, Clone)]
+pub struct MemoryGovernorConfig {
+    pub soft_limit: u64,
+    pub hard_limit: u64,
+    pub sample_interval: Duration,
+    pub tidy_interval: Duration,
+    pub usage_pointer: Cow<'static, str>,
+}
+
+/// MemoryMetrics : A point in time copy of the governor counters.
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct MemoryMetrics {
+    pub usage: u64,
+    pub peak: u64,
+    pub samples: u64,
+    pub tidies: u64,
+    pub throttled_waits: u64,
+    pub throttled_nanos: u64,
+    pub sample_errors: u64,
+}
+
+pub(crate) struct Governor {
+    handle: Arc<HandleType>,
+    config: MemoryGovernorConfig,
+    usage: AtomicU64,
+    peak: AtomicU64,
+    samples: AtomicU64,
+    tidies: AtomicU64,
+    throttled_waits: AtomicU64,
+    throttled_nanos: AtomicU64,
+    sample_errors: AtomicU64,
+    last_tidy: Mutex<Option<Instant>>,
+    // true while usage is above the hard limit, closed mirrors it for the callers that find the gate open
+    throttled: Mutex<bool>,
+    closed: AtomicBool,
+    released: Condvar,
+    stopped: AtomicBool,
+}
+
+/// MemoryGovernor : Keeps the memory allocated by the API on the client under a budget.
+///    A background thread samples the client memory, tidies it once the soft limit is crossed
+///    and closes the gate while the hard limit is exceeded. Batches, time series batch pushes
+///    and range reads on the handle wait at the gate before sending, other callers can share it.
+///    A failed sample opens the gate, an unknown usage does not hold callers back.
+///    Dropping the governor stops sampling and opens the gate for good.
+pub struct MemoryGovernor {
+    governor: Arc<Governor>,
+    sampler: Option<thread::JoinHandle<()>>,
+}
+
+/// MemoryGate : A cheap, cloneable view of the governor to call before allocating.
+#[derive(Clone)]
+pub struct MemoryGate {
+    governor: Arc<Governor>,
+}
+
+impl MemoryGovernor {
+    /// Start : Sets the API soft memory limit and starts sampling the handle.
+    pub fn start(handle: Arc<HandleType>, config: MemoryGovernorConfig) -> Result<MemoryGovernor, ErrorType> {
+        if config.soft_limit > config.hard_limit {
+            return Err(ErrorType::ErrInvalidArgument);
+        }
+
+        if let Some(e) = handle.set_client_soft_memory_limit(config.soft_limit) {
+            return Err(e);
+        }
+
+        let governor = Arc::new(Governor {
+            handle,
+            config,
+            usage: AtomicU64::new(0),
+            peak: AtomicU64::new(0),
+            samples: AtomicU64::new(0),
+            tidies: AtomicU64::new(0),
+            throttled_waits: AtomicU64::new(0),
+            throttled_nanos: AtomicU64::new(0),
+            sample_errors: AtomicU64::new(0),
+            last_tidy: Mutex::new(None),
+            throttled: Mutex::new(false),
+            closed: AtomicBool::new(false),
+            released: Condvar::new(),
+            stopped: AtomicBool::new(false),
+        });
+
+        *governor.handle.memory_gate.write().unwrap() = Arc::downgrade(&governor);
+
+        let g = governor.clone();
+        let sampler = thread::spawn(move || {
+            while !g.stopped.load(Ordering::Acquire) {
+                let _ = g.sample();
+                thread::park_timeout(g.config.sample_interval);
+            }
+        });
+
+        Ok(MemoryGovernor { governor, sampler: Some(sampler) })
+    }
+
+    /// Gate : Returns the gate to share with batch builders and readers.
+    pub fn gate(&self) -> MemoryGate {
+        MemoryGate { governor: self.governor.clone() }
+    }
+
+    /// Sample : Samples the client memory right away instead of waiting for the next interval.
+    pub fn sample(&self) -> Result<u64, ErrorType> {
+        self.governor.sample()
+    }
+
+    /// Metrics : Returns the usage, tidy and throttling counters.
+    pub fn metrics(&self) -> MemoryMetrics {
+        self.governor.metrics()
+    }
+}
+
+impl Drop for MemoryGovernor {
+    fn drop(&mut self) {
+        self.governor.stopped.store(true, Ordering::Release);
+        {
+            let mut gate = self.governor.handle.memory_gate.write().unwrap();
+            if std::ptr::eq(gate.as_ptr(), Arc::as_ptr(&self.governor)) {
+                *gate = Weak::new();
+            }
+        }
+        if let Some(sampler) = self.sampler.take() {
+            sampler.thread().unpark();
+            let _ = sampler.join();
+        }
+        self.governor.set_throttled(false);
+    }
+}
+
+impl MemoryGate {
+    /// Admit : Returns at once below the hard limit, otherwise waits until usage drops back below it.
+    pub fn admit(&self) {
+        self.governor.wait(None);
+    }
+
+    /// AdmitTimeout : Same as Admit but gives up after timeout, returns false if it did.
+    pub fn admit_timeout(&self, timeout: Duration) -> bool {
+        self.governor.wait(Some(timeout))
+    }
+
+    /// IsThrottled : Returns true while the hard limit is exceeded.
+    pub fn is_throttled(&self) -> bool {
+        self.governor.closed.load(Ordering::Acquire)
+    }
+
+    /// Metrics : Returns the usage, tidy and throttling counters.
+    pub fn metrics(&self) -> MemoryMetrics {
+        self.governor.metrics()
+    }
+}
+
+impl Governor {
+    fn sample(&self) -> Result<u64, ErrorType> {
+        let usage = match self.read_usage() {
+            Ok(u) => u,
+            Err(e) => {
+                self.sample_errors.fetch_add(1, Ordering::Relaxed);
+                // a gate closed on a usage that can no longer be read would never reopen
+                self.set_throttled(false);
+                return Err(e);
+            }
+        };
+
+        self.samples.fetch_add(1, Ordering::Relaxed);
+        self.peak.fetch_max(usage, Ordering::Relaxed);
+
+        let mut usage = usage;
+        if usage >= self.config.soft_limit && self.tidy_due() {
+            if self.handle.client_tidy_memory().is_none() {
+                self.tidies.fetch_add(1, Ordering::Relaxed);
+                // tidying may have freed enough to reopen the gate
+                usage = self.read_usage().unwrap_or(usage);
+            }
+        }
+
+        self.usage.store(usage, Ordering::Relaxed);
+        self.set_throttled(usage >= self.config.hard_limit);
+
+        Ok(usage)
+    }
+
+    // Returns true and starts a new tidy interval when the last tidy is old enough.
+    fn tidy_due(&self) -> bool {
+        let mut last = self.last_tidy.lock().unwrap();
+        let now = Instant::now();
+        if last.map_or(false, |t| now.duration_since(t) < self.config.tidy_interval) {
+            return false;
+        }
+        *last = Some(now);
+        true
+    }
+
+    fn read_usage(&self) -> Result<u64, ErrorType> {
+        let info = self.handle.get_client_memory_info()?;
+        match parse_memory_info(&info, &self.config.usage_pointer) {
+            Some(bytes) => Ok(bytes),
+            None => Err(ErrorType::ErrInvalidReply),
+        }
+    }
+
+    fn set_throttled(&self, throttled: bool) {
+        let mut state = self.throttled.lock().unwrap();
+        if *state != throttled {
+            *state = throttled;
+            self.closed.store(throttled, Ordering::Release);
+            if !throttled {
+                self.released.notify_all();
+            }
+        }
+    }
+
+    pub(crate) fn wait(&self, timeout: Option<Duration>) -> bool {
+        if !self.closed.load(Ordering::Acquire) {
+            return true;
+        }
+
+        let mut throttled = self.throttled.lock().unwrap();
+        if !*throttled {
+            return true;
+        }
+
+        self.throttled_waits.fetch_add(1, Ordering::Relaxed);
+        let started = Instant::now();
+
+        while *throttled {
+            throttled = match timeout {
+                None => self.released.wait(throttled).unwrap(),
+                Some(t) => {
+                    let left = match t.checked_sub(started.elapsed()) {
+                        Some(l) => l,
+                        None => break,
+                    };
+                    self.released.wait_timeout(throttled, left).unwrap().0
+                }
+            };
+        }
+
+        self.throttled_nanos.fetch_add(started.elapsed().as_nanos() as u64, Ordering::Relaxed);
+        !*throttled
+    }
+
+    fn metrics(&self) -> MemoryMetrics {
+        MemoryMetrics {
+            usage: self.usage.load(Ordering::Relaxed),
+            peak: self.peak.load(Ordering::Relaxed),
+            samples: self.samples.load(Ordering::Relaxed),
+            tidies: self.tidies.load(Ordering::Relaxed),
+            throttled_waits: self.throttled_waits.load(Ordering::Relaxed),
+            throttled_nanos: self.throttled_nanos.load(Ordering::Relaxed),
+            sample_errors: self.sample_errors.load(Ordering::Relaxed),
+        }
+    }
+}
+
+/// ParseMemoryInfo : Extracts the number of bytes in use from the output of qdb_option_client_get_memory_info,
+///    the number found at the JSON pointer usage_pointer. None when the document is not JSON
+///    or has no non negative number there.
+pub fn parse_memory_info(info: &str, usage_pointer: &str) -> Option<u64> {
+    let value: Value = serde_json::from_str(info.trim()).ok()?;
+    let usage = value.pointer(usage_pointer)?;
+    usage.as_u64().or_else(|| usage.as_f64().filter(|f| *f >= 0.0).map(|f| f as u64))
+}
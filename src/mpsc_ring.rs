@@ -0,0 +1,120 @@
+use std::cell::UnsafeCell;
+use std::sync::atomic::{AtomicBool, AtomicUsize, Ordering};
+
+struct Slot<T> {
+    // lap counter of the slot, tells producers and the consumer whose turn it is
+    sequence: AtomicUsize,
+    value: UnsafeCell<T>,
+}
+
+/// MpscRing : A bounded, lock-free, multiple producer single consumer ring of preallocated slots.
+///    Values are written and read in place, so pushing never allocates,
+///    and a full ring rejects the value instead of blocking the producer.
+///    Values are popped through the one RingConsumer the ring hands out at a time.
+///    Based on the bounded queue by Dmitry Vyukov.
+pub struct MpscRing<T> {
+    slots: Box<[Slot<T>]>,
+    mask: usize,
+    tail: AtomicUsize,
+    head: AtomicUsize,
+    // a RingConsumer is alive
+    consumed: AtomicBool,
+}
+
+unsafe impl<T: Send> Send for MpscRing<T> {}
+unsafe impl<T: Send> Sync for MpscRing<T> {}
+
+impl<T: Default> MpscRing<T> {
+    /// Creates a ring of capacity slots, rounded up to a power of two.
+    pub fn with_capacity(capacity: usize) -> MpscRing<T> {
+        let capacity = capacity.max(2).next_power_of_two();
+        let slots = (0..capacity)
+            .map(|i| Slot { sequence: AtomicUsize::new(i), value: UnsafeCell::new(T::default()) })
+            .collect();
+
+        MpscRing { slots, mask: capacity - 1, tail: AtomicUsize::new(0), head: AtomicUsize::new(0), consumed: AtomicBool::new(false) }
+    }
+}
+
+impl<T> MpscRing<T> {
+    pub fn capacity(&self) -> usize {
+        self.slots.len()
+    }
+
+    /// PushWith : Claims a slot and lets fill overwrite it in place.
+    ///    Returns false when the ring is full. Safe to call from any number of threads.
+    pub fn push_with<F: FnOnce(&mut T)>(&self, fill: F) -> bool {
+        let mut pos = self.tail.load(Ordering::Relaxed);
+
+        loop {
+            let slot = &self.slots[pos & self.mask];
+            let sequence = slot.sequence.load(Ordering::Acquire);
+            let lap = sequence as isize - pos as isize;
+
+            if lap == 0 {
+                match self.tail.compare_exchange_weak(pos, pos + 1, Ordering::Relaxed, Ordering::Relaxed) {
+                    Ok(_) => {
+                        unsafe { fill(&mut *slot.value.get()) };
+                        slot.sequence.store(pos + 1, Ordering::Release);
+                        return true;
+                    }
+                    Err(current) => pos = current,
+                }
+            } else if lap < 0 {
+                return false;
+            } else {
+                pos = self.tail.load(Ordering::Relaxed);
+            }
+        }
+    }
+
+    /// Consumer : Returns the consumer of the ring, None while another one is alive.
+    pub fn consumer(&self) -> Option<RingConsumer<'_, T>> {
+        if self.consumed.swap(true, Ordering::Acquire) {
+            return None;
+        }
+        Some(RingConsumer { ring: self })
+    }
+}
+
+/// RingConsumer : The one thread popping from an MpscRing, the ring can hand out another once it is dropped.
+pub struct RingConsumer<'r, T> {
+    ring: &'r MpscRing<T>,
+}
+
+// Frees the slot once read is done with it, even when read panics.
+struct FreeSlot<'a> {
+    sequence: &'a AtomicUsize,
+    next: usize,
+}
+
+impl Drop for FreeSlot<'_> {
+    fn drop(&mut self) {
+        self.sequence.store(self.next, Ordering::Release);
+    }
+}
+
+impl<T> RingConsumer<'_, T> {
+    /// PopWith : Lets read look at the oldest value in place, then frees its slot.
+    ///    Returns false when the ring is empty.
+    pub fn pop_with<F: FnOnce(&T)>(&mut self, read: F) -> bool {
+        let ring = self.ring;
+        let pos = ring.head.load(Ordering::Relaxed);
+        let slot = &ring.slots[pos & ring.mask];
+
+        if slot.sequence.load(Ordering::Acquire) != pos + 1 {
+            return false;
+        }
+
+        ring.head.store(pos + 1, Ordering::Relaxed);
+        let _free = FreeSlot { sequence: &slot.sequence, next: pos + ring.mask + 1 };
+        unsafe { read(&*slot.value.get()) };
+        true
+    }
+}
+
+impl<T> Drop for RingConsumer<'_, T> {
+    fn drop(&mut self) {
+        self.ring.consumed.store(false, Ordering::Release);
+    }
+}
@@ -0,0 +1,359 @@
+use std::collections::HashMap;
+use std::sync::{Arc, Mutex};
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::thread;
+use std::time::Duration;
+use std::{ptr, slice};
+
+use crate::error::{ErrorType, makeErrorNone};
+use crate::handle::HandleType;
+use crate::histogram::LatencyHistogram;
+use crate::{qdb_perf_clear_all_profiles, qdb_perf_disable_client_tracking, qdb_perf_enable_client_tracking,
+            qdb_perf_get_profiles, qdb_perf_label_t, qdb_perf_profile_t, qdb_release};
+use crate::{qdb_perf_label_t_qdb_pl_undefined, qdb_perf_label_t_qdb_pl_accepted, qdb_perf_label_t_qdb_pl_received,
+            qdb_perf_label_t_qdb_pl_secured, qdb_perf_label_t_qdb_pl_deserialization_starts,
+            qdb_perf_label_t_qdb_pl_deserialization_ends, qdb_perf_label_t_qdb_pl_entering_chord,
+            qdb_perf_label_t_qdb_pl_processing_starts, qdb_perf_label_t_qdb_pl_dispatch,
+            qdb_perf_label_t_qdb_pl_serialization_starts, qdb_perf_label_t_qdb_pl_serialization_ends,
+            qdb_perf_label_t_qdb_pl_processing_ends, qdb_perf_label_t_qdb_pl_replying,
+            qdb_perf_label_t_qdb_pl_replied, qdb_perf_label_t_qdb_pl_entry_writing_starts,
+            qdb_perf_label_t_qdb_pl_entry_writing_ends, qdb_perf_label_t_qdb_pl_content_reading_starts,
+            qdb_perf_label_t_qdb_pl_content_reading_ends, qdb_perf_label_t_qdb_pl_content_writing_starts,
+            qdb_perf_label_t_qdb_pl_content_writing_ends, qdb_perf_label_t_qdb_pl_directory_reading_starts,
+            qdb_perf_label_t_qdb_pl_directory_reading_ends, qdb_perf_label_t_qdb_pl_directory_writing_starts,
+            qdb_perf_label_t_qdb_pl_directory_writing_ends, qdb_perf_label_t_qdb_pl_entry_trimming_starts,
+            qdb_perf_label_t_qdb_pl_entry_trimming_ends, qdb_perf_label_t_qdb_pl_ts_evaluating_starts,
+            qdb_perf_label_t_qdb_pl_ts_evaluating_ends, qdb_perf_label_t_qdb_pl_ts_bucket_updating_starts,
+            qdb_perf_label_t_qdb_pl_ts_bucket_updating_ends, qdb_perf_label_t_qdb_pl_affix_search_starts,
+            qdb_perf_label_t_qdb_pl_affix_search_ends, qdb_perf_label_t_qdb_pl_eviction_starts,
+            qdb_perf_label_t_qdb_pl_eviction_ends, qdb_perf_label_t_qdb_pl_time_vector_tracker_reading_starts,
+            qdb_perf_label_t_qdb_pl_time_vector_tracker_reading_ends, qdb_perf_label_t_qdb_pl_bucket_reading_starts,
+            qdb_perf_label_t_qdb_pl_bucket_reading_ends, qdb_perf_label_t_qdb_pl_entries_directory_reading_starts,
+            qdb_perf_label_t_qdb_pl_entries_directory_reading_ends, qdb_perf_label_t_qdb_pl_acl_reading_starts,
+            qdb_perf_label_t_qdb_pl_acl_reading_ends, qdb_perf_label_t_qdb_pl_time_vector_reading_starts,
+            qdb_perf_label_t_qdb_pl_time_vector_reading_ends};
+
+/// Measurement : A labelled point of a profile, elapsed is in nanoseconds since the first measurement.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct Measurement {
+    pub label: qdb_perf_label_t,
+    pub elapsed: i64,
+}
+
+/// Profile : The measurements taken while serving one request.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct Profile {
+    pub name: String,
+    pub measurements: Vec<Measurement>,
+}
+
+impl HandleType {
+    /// PerfEnableClientTracking : Starts recording performance profiles for the requests of this handle.
+    pub fn perf_enable_client_tracking(&self) -> Option<ErrorType> {
+        unsafe {
+            let err = qdb_perf_enable_client_tracking(self.handle);
+            makeErrorNone(err)
+        }
+    }
+
+    /// PerfDisableClientTracking : Stops recording performance profiles.
+    pub fn perf_disable_client_tracking(&self) -> Option<ErrorType> {
+        unsafe {
+            let err = qdb_perf_disable_client_tracking(self.handle);
+            makeErrorNone(err)
+        }
+    }
+
+    /// PerfClearAllProfiles : Discards every recorded performance profile.
+    pub fn perf_clear_all_profiles(&self) -> Option<ErrorType> {
+        unsafe {
+            let err = qdb_perf_clear_all_profiles(self.handle);
+            makeErrorNone(err)
+        }
+    }
+
+    /// PerfGetProfiles : Returns a copy of every recorded performance profile.
+    pub fn perf_get_profiles(&self) -> Result<Vec<Profile>, ErrorType> {
+        unsafe {
+            let mut profiles: *mut qdb_perf_profile_t = ptr::null_mut();
+            let mut count: usize = 0;
+
+            let err = qdb_perf_get_profiles(self.handle, &mut profiles, &mut count);
+            if let Some(err) = makeErrorNone(err) {
+                return Err(err);
+            }
+
+            if profiles.is_null() {
+                return Ok(Vec::new());
+            }
+
+            let result = slice::from_raw_parts(profiles, count)
+                .iter()
+                .map(|p| {
+                    let name = if p.name.data.is_null() {
+                        String::new()
+                    } else {
+                        String::from_utf8_lossy(slice::from_raw_parts(p.name.data as *const u8, p.name.length)).into_owned()
+                    };
+                    let measurements = if p.measurements.is_null() {
+                        Vec::new()
+                    } else {
+                        slice::from_raw_parts(p.measurements, p.count)
+                            .iter()
+                            .map(|m| Measurement { label: m.label, elapsed: m.elapsed as i64 })
+                            .collect()
+                    };
+                    Profile { name, measurements }
+                })
+                .collect();
+
+            qdb_release(self.handle, profiles as *const _);
+
+            Ok(result)
+        }
+    }
+}
+
+/// LabelName : Returns the name of a performance label without its qdb_pl_ prefix.
+pub fn label_name(label: qdb_perf_label_t) -> &'static str {
+    match label {
+        qdb_perf_label_t_qdb_pl_undefined => "undefined",
+        qdb_perf_label_t_qdb_pl_accepted => "accepted",
+        qdb_perf_label_t_qdb_pl_received => "received",
+        qdb_perf_label_t_qdb_pl_secured => "secured",
+        qdb_perf_label_t_qdb_pl_deserialization_starts => "deserialization_starts",
+        qdb_perf_label_t_qdb_pl_deserialization_ends => "deserialization_ends",
+        qdb_perf_label_t_qdb_pl_entering_chord => "entering_chord",
+        qdb_perf_label_t_qdb_pl_processing_starts => "processing_starts",
+        qdb_perf_label_t_qdb_pl_dispatch => "dispatch",
+        qdb_perf_label_t_qdb_pl_serialization_starts => "serialization_starts",
+        qdb_perf_label_t_qdb_pl_serialization_ends => "serialization_ends",
+        qdb_perf_label_t_qdb_pl_processing_ends => "processing_ends",
+        qdb_perf_label_t_qdb_pl_replying => "replying",
+        qdb_perf_label_t_qdb_pl_replied => "replied",
+        qdb_perf_label_t_qdb_pl_entry_writing_starts => "entry_writing_starts",
+        qdb_perf_label_t_qdb_pl_entry_writing_ends => "entry_writing_ends",
+        qdb_perf_label_t_qdb_pl_content_reading_starts => "content_reading_starts",
+        qdb_perf_label_t_qdb_pl_content_reading_ends => "content_reading_ends",
+        qdb_perf_label_t_qdb_pl_content_writing_starts => "content_writing_starts",
+        qdb_perf_label_t_qdb_pl_content_writing_ends => "content_writing_ends",
+        qdb_perf_label_t_qdb_pl_directory_reading_starts => "directory_reading_starts",
+        qdb_perf_label_t_qdb_pl_directory_reading_ends => "directory_reading_ends",
+        qdb_perf_label_t_qdb_pl_directory_writing_starts => "directory_writing_starts",
+        qdb_perf_label_t_qdb_pl_directory_writing_ends => "directory_writing_ends",
+        qdb_perf_label_t_qdb_pl_entry_trimming_starts => "entry_trimming_starts",
+        qdb_perf_label_t_qdb_pl_entry_trimming_ends => "entry_trimming_ends",
+        qdb_perf_label_t_qdb_pl_ts_evaluating_starts => "ts_evaluating_starts",
+        qdb_perf_label_t_qdb_pl_ts_evaluating_ends => "ts_evaluating_ends",
+        qdb_perf_label_t_qdb_pl_ts_bucket_updating_starts => "ts_bucket_updating_starts",
+        qdb_perf_label_t_qdb_pl_ts_bucket_updating_ends => "ts_bucket_updating_ends",
+        qdb_perf_label_t_qdb_pl_affix_search_starts => "affix_search_starts",
+        qdb_perf_label_t_qdb_pl_affix_search_ends => "affix_search_ends",
+        qdb_perf_label_t_qdb_pl_eviction_starts => "eviction_starts",
+        qdb_perf_label_t_qdb_pl_eviction_ends => "eviction_ends",
+        qdb_perf_label_t_qdb_pl_time_vector_tracker_reading_starts => "time_vector_tracker_reading_starts",
+        qdb_perf_label_t_qdb_pl_time_vector_tracker_reading_ends => "time_vector_tracker_reading_ends",
+        qdb_perf_label_t_qdb_pl_bucket_reading_starts => "bucket_reading_starts",
+        qdb_perf_label_t_qdb_pl_bucket_reading_ends => "bucket_reading_ends",
+        qdb_perf_label_t_qdb_pl_entries_directory_reading_starts => "entries_directory_reading_starts",
+        qdb_perf_label_t_qdb_pl_entries_directory_reading_ends => "entries_directory_reading_ends",
+        qdb_perf_label_t_qdb_pl_acl_reading_starts => "acl_reading_starts",
+        qdb_perf_label_t_qdb_pl_acl_reading_ends => "acl_reading_ends",
+        qdb_perf_label_t_qdb_pl_time_vector_reading_starts => "time_vector_reading_starts",
+        qdb_perf_label_t_qdb_pl_time_vector_reading_ends => "time_vector_reading_ends",
+        _ => "unknown",
+    }
+}
+
+/// Phase : An interval of a profile, either a span from a _starts label to its _ends label,
+///    or a step between two consecutive labels that are not part of a span.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash, PartialOrd, Ord)]
+pub struct Phase {
+    pub from: qdb_perf_label_t,
+    pub to: qdb_perf_label_t,
+}
+
+impl Phase {
+    /// Name : Returns the phase as from->to, e.g. bucket_reading_starts->bucket_reading_ends
+    pub fn name(&self) -> String {
+        format!("{}->{}", label_name(self.from), label_name(self.to))
+    }
+}
+
+/// PhaseSummary : Latency percentiles of one phase of one profile name, in nanoseconds.
+#[derive(Debug, Clone, PartialEq)]
+pub struct PhaseSummary {
+    pub profile: String,
+    pub phase: String,
+    pub count: u64,
+    pub mean: f64,
+    pub p50: u64,
+    pub p99: u64,
+    pub p999: u64,
+    pub max: u64,
+}
+
+// The histograms of one profile name.
+#[derive(Default)]
+struct ProfileHistograms {
+    // the whole duration, from the first to the last measurement
+    total: LatencyHistogram,
+    phases: HashMap<Phase, LatencyHistogram>,
+}
+
+/// PerfCollector : Aggregates performance profiles into per phase latency histograms.
+///    Every _starts label is matched with its _ends label through a stack, so that spans nested
+///    in others are measured too, and the span is recorded under the phase (starts, ends) of the profile name.
+///    The time between two consecutive labels outside spans, received and replied for instance,
+///    is recorded as a phase as well, and the whole duration of the profile in a total histogram of its own.
+#[derive(Default)]
+pub struct PerfCollector {
+    histograms: Mutex<HashMap<String, ProfileHistograms>>,
+}
+
+impl PerfCollector {
+    pub fn new() -> PerfCollector {
+        PerfCollector::default()
+    }
+
+    /// Record : Adds the phases of the profiles to the histograms.
+    pub fn record(&self, profiles: &[Profile]) {
+        let mut histograms = self.histograms.lock().unwrap();
+
+        for profile in profiles {
+            let histograms = histograms.entry(profile.name.clone()).or_default();
+            let mut record = |from: &Measurement, to: &Measurement| {
+                let phase = Phase { from: from.label, to: to.label };
+                histograms.phases.entry(phase).or_default().record((to.elapsed - from.elapsed).max(0) as u64);
+            };
+
+            // the spans opened and not closed yet, an _ends closes the innermost of its kind
+            let mut open: Vec<(&str, &Measurement)> = Vec::new();
+            let mut last_step: Option<&Measurement> = None;
+            for m in &profile.measurements {
+                let name = label_name(m.label);
+                if let Some(span) = name.strip_suffix("_starts") {
+                    open.push((span, m));
+                } else if let Some(span) = name.strip_suffix("_ends") {
+                    // an _ends without its _starts is left out
+                    if let Some(i) = open.iter().rposition(|(s, _)| *s == span) {
+                        let (_, starts) = open.remove(i);
+                        record(starts, m);
+                    }
+                } else {
+                    if let Some(from) = last_step {
+                        record(from, m);
+                    }
+                    last_step = Some(m);
+                }
+            }
+
+            if let (Some(first), Some(last)) = (profile.measurements.first(), profile.measurements.last()) {
+                histograms.total.record((last.elapsed - first.elapsed).max(0) as u64);
+            }
+        }
+    }
+
+    /// Drain : Fetches and clears the profiles of the handle, then records them.
+    ///    The API clears every profile, not only those fetched: the profiles of requests
+    ///    that complete between the two calls are lost.
+    pub fn drain(&self, handle: &HandleType) -> Option<ErrorType> {
+        let profiles = match handle.perf_get_profiles() {
+            Ok(p) => p,
+            Err(e) => return Some(e),
+        };
+
+        if let Some(e) = handle.perf_clear_all_profiles() {
+            return Some(e);
+        }
+
+        self.record(&profiles);
+        None
+    }
+
+    /// Histogram : Returns a copy of the histogram of a phase of a profile name.
+    pub fn histogram(&self, profile: &str, phase: Phase) -> Option<LatencyHistogram> {
+        let histograms = self.histograms.lock().unwrap();
+        histograms.get(profile).and_then(|p| p.phases.get(&phase)).cloned()
+    }
+
+    /// Total : Returns a copy of the histogram of the whole duration of a profile name.
+    pub fn total(&self, profile: &str) -> Option<LatencyHistogram> {
+        let histograms = self.histograms.lock().unwrap();
+        histograms.get(profile).filter(|p| p.total.count() > 0).map(|p| p.total.clone())
+    }
+
+    /// Summary : Returns p50, p99 and p999 of every recorded phase, sorted by profile then phase,
+    ///    the total of a profile first under the phase name "total".
+    pub fn summary(&self) -> Vec<PhaseSummary> {
+        let histograms = self.histograms.lock().unwrap();
+
+        let mut summary = Vec::new();
+        for (profile, histograms) in histograms.iter() {
+            let mut phases: Vec<_> = histograms.phases.iter().collect();
+            phases.sort_by_key(|(phase, _)| **phase);
+
+            let total = (histograms.total.count() > 0).then(|| ("total".to_string(), &histograms.total));
+            for (phase, h) in total.into_iter().chain(phases.into_iter().map(|(phase, h)| (phase.name(), h))) {
+                summary.push(PhaseSummary {
+                    profile: profile.clone(),
+                    phase,
+                    count: h.count(),
+                    mean: h.mean(),
+                    p50: h.percentile(50.0),
+                    p99: h.percentile(99.0),
+                    p999: h.percentile(99.9),
+                    max: h.max(),
+                });
+            }
+        }
+
+        summary.sort_by(|a, b| a.profile.cmp(&b.profile));
+        summary
+    }
+
+    /// Reset : Forgets every recorded phase.
+    pub fn reset(&self) {
+        self.histograms.lock().unwrap().clear();
+    }
+}
+
+/// PerfSampler : Drains the profiles of a handle into a collector at a fixed interval.
+///    Client tracking is enabled when the sampler starts and disabled when it is dropped.
+pub struct PerfSampler {
+    stopped: Arc<AtomicBool>,
+    worker: Option<thread::JoinHandle<()>>,
+}
+
+impl PerfSampler {
+    /// Start : Enables client tracking on the handle and starts draining it every interval.
+    pub fn start(handle: Arc<HandleType>, collector: Arc<PerfCollector>, interval: Duration) -> Result<PerfSampler, ErrorType> {
+        if let Some(e) = handle.perf_enable_client_tracking() {
+            return Err(e);
+        }
+
+        let stopped = Arc::new(AtomicBool::new(false));
+        let stop = stopped.clone();
+
+        let worker = thread::spawn(move || {
+            while !stop.load(Ordering::Acquire) {
+                thread::park_timeout(interval);
+                // a failed drain is retried on the next tick
+                let _ = collector.drain(&handle);
+            }
+            let _ = handle.perf_disable_client_tracking();
+        });
+
+        Ok(PerfSampler { stopped, worker: Some(worker) })
+    }
+}
+
+impl Drop for PerfSampler {
+    fn drop(&mut self) {
+        self.stopped.store(true, Ordering::Release);
+        if let Some(worker) = self.worker.take() {
+            worker.thread().unpark();
+            let _ = worker.join();
+        }
+    }
+}
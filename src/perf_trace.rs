@@ -0,0 +1,95 @@
+use serde_json::{json, Value};
+
+use crate::perf::{label_name, Profile};
+
+/// ChromeTrace : Converts performance profiles into the Chrome Trace Event format,
+///    which can be opened in Perfetto or chrome://tracing.
+///
+///    Every profile gets its own track named after the profile.
+///    Matching *_starts / *_ends labels become complete spans, nested spans are supported,
+///    every other label becomes an instant event and the whole profile is a span of its own.
+///    Profiles do not share a clock, hence every track starts at zero.
+pub fn chrome_trace(profiles: &[Profile]) -> Value {
+    let mut events: Vec<Value> = Vec::new();
+
+    for (tid, profile) in profiles.iter().enumerate() {
+        let tid = tid + 1;
+
+        events.push(json!({
+            "name": "thread_name",
+            "ph": "M",
+            "pid": 1,
+            "tid": tid,
+            "args": { "name": profile.name },
+        }));
+
+        let origin = match profile.measurements.first() {
+            Some(m) => m.elapsed,
+            None => continue,
+        };
+        let end = profile.measurements.last().map(|m| m.elapsed).unwrap_or(origin);
+
+        events.push(complete_event(&profile.name, "profile", tid, 0, end - origin));
+
+        // spans that have started but not ended yet, innermost last
+        let mut open: Vec<(&str, i64)> = Vec::new();
+
+        for m in &profile.measurements {
+            let name = label_name(m.label);
+            let at = m.elapsed - origin;
+
+            if let Some(base) = name.strip_suffix("_starts") {
+                open.push((base, at));
+            } else if let Some(base) = name.strip_suffix("_ends") {
+                match open.iter().rposition(|(b, _)| *b == base) {
+                    Some(i) => {
+                        let (_, started) = open.remove(i);
+                        events.push(complete_event(base, "phase", tid, started, at - started));
+                    }
+                    None => events.push(instant_event(name, tid, at)),
+                }
+            } else {
+                events.push(instant_event(name, tid, at));
+            }
+        }
+
+        // a span left open runs until the end of the profile
+        for (base, started) in open {
+            events.push(complete_event(base, "phase", tid, started, end - origin - started));
+        }
+    }
+
+    json!({
+        "traceEvents": events,
+        "displayTimeUnit": "ns",
+    })
+}
+
+// the trace format counts in microseconds, fractions keep the nanosecond precision
+fn micros(nanos: i64) -> f64 {
+    nanos as f64 / 1000.0
+}
+
+fn complete_event(name: &str, category: &str, tid: usize, start: i64, duration: i64) -> Value {
+    json!({
+        "name": name,
+        "cat": category,
+        "ph": "X",
+        "pid": 1,
+        "tid": tid,
+        "ts": micros(start),
+        "dur": micros(duration.max(0)),
+    })
+}
+
+fn instant_event(name: &str, tid: usize, at: i64) -> Value {
+    json!({
+        "name": name,
+        "cat": "label",
+        "ph": "i",
+        "s": "t",
+        "pid": 1,
+        "tid": tid,
+        "ts": micros(at),
+    })
+}
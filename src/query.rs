@@ -0,0 +1,313 @@
+use std::ffi::CString;
+use std::{ptr, slice, str};
+
+use crate::error::{ErrorType, makeErrorNone};
+use crate::handle::HandleType;
+use crate::{qdb_point_result_t, qdb_query, qdb_query_copy_results, qdb_query_result_t,
+            qdb_query_result_value_type_t_qdb_query_result_blob, qdb_query_result_value_type_t_qdb_query_result_count,
+            qdb_query_result_value_type_t_qdb_query_result_double, qdb_query_result_value_type_t_qdb_query_result_int64,
+            qdb_query_result_value_type_t_qdb_query_result_string, qdb_query_result_value_type_t_qdb_query_result_timestamp,
+            qdb_release, qdb_timespec_t};
+
+/// ColumnValues : The values of one result column, None where the point is null or of another type.
+///    Timestamps are expressed in nanoseconds since epoch.
+#[derive(Debug, Clone, PartialEq)]
+pub enum ColumnValues {
+    Double(Vec<Option<f64>>),
+    Int64(Vec<Option<i64>>),
+    Timestamp(Vec<Option<i64>>),
+    Count(Vec<Option<u64>>),
+    Blob(Vec<Option<Vec<u8>>>),
+    String(Vec<Option<String>>),
+    // Every point of the column is null
+    Null(usize),
+}
+
+/// Column : A named, typed column copied out of a query result.
+#[derive(Debug, Clone, PartialEq)]
+pub struct Column {
+    pub name: String,
+    pub values: ColumnValues,
+}
+
+impl ColumnValues {
+    /// Len : Returns the number of rows of the column.
+    pub fn len(&self) -> usize {
+        match self {
+            ColumnValues::Double(v) => v.len(),
+            ColumnValues::Int64(v) => v.len(),
+            ColumnValues::Timestamp(v) => v.len(),
+            ColumnValues::Count(v) => v.len(),
+            ColumnValues::Blob(v) => v.len(),
+            ColumnValues::String(v) => v.len(),
+            ColumnValues::Null(n) => *n,
+        }
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+}
+
+/// QueryResult : An API-allocated query result.
+///    The underlying buffer is released with qdb_release when the result is dropped,
+///    the result borrows the handle that produced it so that it cannot outlive it.
+///    Use columns to keep the values beyond the handle.
+pub struct QueryResult<'h> {
+    handle: &'h HandleType,
+    result: *mut qdb_query_result_t,
+}
+
+// The result is immutable once returned by the API, it is safe to read from several threads.
+unsafe impl Send for QueryResult<'_> {}
+unsafe impl Sync for QueryResult<'_> {}
+
+impl<'h> QueryResult<'h> {
+    /// FromRaw : Takes ownership of an API-allocated query result.
+    ///
+    /// The caller guarantees that result was allocated by the API for the given handle.
+    pub(crate) unsafe fn from_raw(handle: &'h HandleType, result: *mut qdb_query_result_t) -> QueryResult<'h> {
+        QueryResult { handle, result }
+    }
+
+    /// Handle : Returns the handle the result was produced by, and is released with.
+    pub fn handle(&self) -> &'h HandleType {
+        self.handle
+    }
+
+    /// AsRaw : Returns the underlying API structure, null for an empty result.
+    pub fn as_raw(&self) -> *const qdb_query_result_t {
+        self.result
+    }
+
+    /// ColumnCount : Returns the number of columns of the result.
+    pub fn column_count(&self) -> usize {
+        match unsafe { self.result.as_ref() } {
+            Some(r) => r.column_count,
+            None => 0,
+        }
+    }
+
+    /// RowCount : Returns the number of rows of the result.
+    pub fn row_count(&self) -> usize {
+        match unsafe { self.result.as_ref() } {
+            Some(r) => r.row_count,
+            None => 0,
+        }
+    }
+
+    /// ScannedPointCount : Returns the number of points the server scanned to answer the query.
+    pub fn scanned_point_count(&self) -> usize {
+        match unsafe { self.result.as_ref() } {
+            Some(r) => r.scanned_point_count,
+            None => 0,
+        }
+    }
+
+    /// ColumnNames : Returns the column names, borrowed from the API buffer.
+    pub fn column_names(&self) -> Vec<&str> {
+        let r = match unsafe { self.result.as_ref() } {
+            Some(r) => r,
+            None => return Vec::new(),
+        };
+
+        if r.column_names.is_null() {
+            return Vec::new();
+        }
+
+        let names = unsafe { slice::from_raw_parts(r.column_names, r.column_count) };
+        names.iter()
+            .map(|n| unsafe { qdb_string_as_str(n.data, n.length) })
+            .collect()
+    }
+
+    /// Row : Returns the points of the row at index row, or None when out of bounds.
+    pub fn row(&self, row: usize) -> Option<&[qdb_point_result_t]> {
+        let r = unsafe { self.result.as_ref() }?;
+        if row >= r.row_count || r.rows.is_null() {
+            return None;
+        }
+
+        unsafe {
+            let points = *r.rows.add(row);
+            if points.is_null() {
+                return None;
+            }
+            Some(slice::from_raw_parts(points, r.column_count))
+        }
+    }
+
+    /// ByteSize : Estimates the memory held by the result.
+    ///    Accounts for the point matrix, the column names and the blob and string payloads.
+    pub fn byte_size(&self) -> usize {
+        let r = match unsafe { self.result.as_ref() } {
+            Some(r) => r,
+            None => return 0,
+        };
+
+        let mut size = std::mem::size_of::<qdb_query_result_t>();
+        size += r.row_count * std::mem::size_of::<*mut qdb_point_result_t>();
+        size += r.row_count * r.column_count * std::mem::size_of::<qdb_point_result_t>();
+
+        for name in self.column_names() {
+            size += name.len();
+        }
+
+        for i in 0..r.row_count {
+            let points = match self.row(i) {
+                Some(p) => p,
+                None => continue,
+            };
+            for point in points {
+                size += unsafe { point_payload_size(point) };
+            }
+        }
+
+        size
+    }
+
+    /// Columns : Copies the result into typed columns.
+    pub fn columns(&self) -> Vec<Column> {
+        unsafe { result_columns(self.result) }
+    }
+
+    /// Snapshot : Creates a deep copy of the result with qdb_query_copy_results.
+    ///    The copy is independent of this result and may outlive it.
+    pub fn snapshot(&self) -> Result<QueryResult<'h>, ErrorType> {
+        unsafe {
+            let mut copy: *mut qdb_query_result_t = ptr::null_mut();
+            let err = qdb_query_copy_results(self.handle.handle, self.result, &mut copy);
+
+            return match makeErrorNone(err) {
+                None => Ok(QueryResult::from_raw(self.handle, copy)),
+                Some(err) => Err(err),
+            };
+        }
+    }
+}
+
+impl Drop for QueryResult<'_> {
+    fn drop(&mut self) {
+        if !self.result.is_null() {
+            unsafe { qdb_release(self.handle.handle, self.result as *const _) };
+        }
+    }
+}
+
+impl HandleType {
+    /// Query : Runs the provided query and returns the resulting table.
+    ///    Queries are transactional.
+    ///    The complexity of this function is dependent on the complexity of the query.
+    pub fn query(&self, query: &str) -> Result<QueryResult<'_>, ErrorType> {
+        let query = match CString::new(query) {
+            Ok(q) => q,
+            Err(_) => return Err(ErrorType::ErrInvalidArgument),
+        };
+
+        unsafe {
+            let mut result: *mut qdb_query_result_t = ptr::null_mut();
+            let err = qdb_query(self.handle, query.as_ptr(), &mut result);
+
+            return match makeErrorNone(err) {
+                None => Ok(QueryResult::from_raw(self, result)),
+                Some(err) => {
+                    if !result.is_null() {
+                        qdb_release(self.handle, result as *const _);
+                    }
+                    Err(err)
+                }
+            };
+        }
+    }
+}
+
+unsafe fn qdb_string_as_str<'a>(data: *const std::os::raw::c_char, length: usize) -> &'a str {
+    if data.is_null() || length == 0 {
+        return "";
+    }
+    let bytes = slice::from_raw_parts(data as *const u8, length);
+    str::from_utf8(bytes).unwrap_or("")
+}
+
+/// ResultColumns : Copies an API query result into typed columns.
+///    The type of a column is the type of its first non null point.
+pub(crate) unsafe fn result_columns(result: *const qdb_query_result_t) -> Vec<Column> {
+    let r = match result.as_ref() {
+        Some(r) => r,
+        None => return Vec::new(),
+    };
+
+    let row_count = if r.rows.is_null() { 0 } else { r.row_count };
+    let mut columns = Vec::with_capacity(r.column_count);
+
+    for col in 0..r.column_count {
+        let name = if r.column_names.is_null() {
+            String::new()
+        } else {
+            let n = &*r.column_names.add(col);
+            qdb_string_as_str(n.data, n.length).to_owned()
+        };
+
+        let point = |row: usize| -> Option<&qdb_point_result_t> {
+            let points = *r.rows.add(row);
+            if points.is_null() { None } else { Some(&*points.add(col)) }
+        };
+
+        let column_type = (0..row_count)
+            .filter_map(|row| point(row))
+            .map(|p| p.type_)
+            .find(|t| *t != crate::qdb_query_result_value_type_t_qdb_query_result_none);
+
+        let values = match column_type {
+            Some(t) if t == qdb_query_result_value_type_t_qdb_query_result_double => ColumnValues::Double(
+                (0..row_count).map(|row| point(row).filter(|p| p.type_ == t).map(|p| p.payload.double_.value)).collect()),
+            Some(t) if t == qdb_query_result_value_type_t_qdb_query_result_int64 => ColumnValues::Int64(
+                (0..row_count).map(|row| point(row).filter(|p| p.type_ == t).map(|p| p.payload.int64_.value)).collect()),
+            Some(t) if t == qdb_query_result_value_type_t_qdb_query_result_timestamp => ColumnValues::Timestamp(
+                (0..row_count).map(|row| point(row).filter(|p| p.type_ == t).map(|p| timespec_to_nanos(&p.payload.timestamp.value))).collect()),
+            Some(t) if t == qdb_query_result_value_type_t_qdb_query_result_count => ColumnValues::Count(
+                (0..row_count).map(|row| point(row).filter(|p| p.type_ == t).map(|p| p.payload.count.value as u64)).collect()),
+            Some(t) if t == qdb_query_result_value_type_t_qdb_query_result_blob => ColumnValues::Blob(
+                (0..row_count).map(|row| point(row).filter(|p| p.type_ == t).map(|p| {
+                    let blob = p.payload.blob;
+                    if blob.content.is_null() { Vec::new() } else { slice::from_raw_parts(blob.content as *const u8, blob.content_length).to_vec() }
+                })).collect()),
+            Some(t) if t == qdb_query_result_value_type_t_qdb_query_result_string => ColumnValues::String(
+                (0..row_count).map(|row| point(row).filter(|p| p.type_ == t).map(|p| {
+                    let string = p.payload.string;
+                    String::from_utf8_lossy(slice::from_raw_parts(string.content as *const u8, if string.content.is_null() { 0 } else { string.content_length })).into_owned()
+                })).collect()),
+            _ => ColumnValues::Null(row_count),
+        };
+
+        columns.push(Column { name, values });
+    }
+
+    columns
+}
+
+/// TimespecToNanos : Converts an API timestamp to nanoseconds since epoch.
+pub fn timespec_to_nanos(ts: &qdb_timespec_t) -> i64 {
+    ts.tv_sec as i64 * 1_000_000_000 + ts.tv_nsec as i64
+}
+
+/// MinTimestamp : The earliest time in nanoseconds since epoch converted to an API timestamp and back without overflowing.
+pub const MIN_TIMESTAMP: i64 = i64::MIN / 1_000_000_000 * 1_000_000_000;
+
+/// NanosToTimespec : Converts nanoseconds since epoch to an API timestamp.
+pub fn nanos_to_timespec(nanos: i64) -> qdb_timespec_t {
+    qdb_timespec_t {
+        tv_sec: nanos.div_euclid(1_000_000_000) as _,
+        tv_nsec: nanos.rem_euclid(1_000_000_000) as _,
+    }
+}
+
+unsafe fn point_payload_size(point: &qdb_point_result_t) -> usize {
+    if point.type_ == qdb_query_result_value_type_t_qdb_query_result_blob {
+        point.payload.blob.content_length
+    } else if point.type_ == qdb_query_result_value_type_t_qdb_query_result_string {
+        point.payload.string.content_length
+    } else {
+        0
+    }
+}
@@ -0,0 +1,310 @@
+use std::collections::{BTreeMap, HashMap};
+use std::sync::{Arc, Condvar, Mutex};
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::time::{Duration, Instant};
+
+use crate::error::ErrorType;
+use crate::handle::HandleType;
+use crate::query::QueryResult;
+
+/// QueryCacheConfig : Budgets of a query cache.
+///    max_bytes : upper bound of the estimated memory held by cached results.
+///    max_entries : upper bound of the number of cached results.
+///    ttl : how long a result is served from the cache before the query runs again.
+#[derive(Debug, Clone, Copy)]
+pub struct QueryCacheConfig {
+    pub max_bytes: usize,
+    pub max_entries: usize,
+    pub ttl: Duration,
+}
+
+impl Default for QueryCacheConfig {
+    fn default() -> Self {
+        QueryCacheConfig {
+            max_bytes: 64 * 1024 * 1024,
+            max_entries: 1024,
+            ttl: Duration::from_secs(5),
+        }
+    }
+}
+
+/// QueryCacheMetrics : A point in time copy of the cache counters.
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct QueryCacheMetrics {
+    pub hits: u64,
+    pub misses: u64,
+    pub coalesced: u64,
+    pub evictions: u64,
+    pub expirations: u64,
+    pub entries: u64,
+    pub bytes: u64,
+}
+
+struct CacheEntry<'h> {
+    result: Arc<QueryResult<'h>>,
+    bytes: usize,
+    inserted: Instant,
+    tick: u64,
+}
+
+struct InFlight<'h> {
+    state: Mutex<Option<Result<Arc<QueryResult<'h>>, ErrorType>>>,
+    ready: Condvar,
+}
+
+struct CacheState<'h> {
+    entries: HashMap<String, CacheEntry<'h>>,
+    // least recently used first
+    recency: BTreeMap<u64, String>,
+    in_flight: HashMap<String, Arc<InFlight<'h>>>,
+    tick: u64,
+    bytes: usize,
+}
+
+/// QueryCache : A client-side cache of query results keyed on the normalized query text.
+///    Results are evicted in least recently used order once either budget of the config is exceeded,
+///    and are never served after their ttl.
+///    Concurrent callers asking for the same query while it runs share a single request to the cluster.
+///    The cache runs its queries on one handle and borrows it, cached results are released with that handle
+///    and cannot outlive it.
+pub struct QueryCache<'h> {
+    handle: &'h HandleType,
+    config: QueryCacheConfig,
+    state: Mutex<CacheState<'h>>,
+    hits: AtomicU64,
+    misses: AtomicU64,
+    coalesced: AtomicU64,
+    evictions: AtomicU64,
+    expirations: AtomicU64,
+}
+
+impl<'h> QueryCache<'h> {
+    /// Creates a new, empty query cache running its queries on handle.
+    pub fn new(handle: &'h HandleType, config: QueryCacheConfig) -> QueryCache<'h> {
+        QueryCache {
+            handle,
+            config,
+            state: Mutex::new(CacheState {
+                entries: HashMap::new(),
+                recency: BTreeMap::new(),
+                in_flight: HashMap::new(),
+                tick: 0,
+                bytes: 0,
+            }),
+            hits: AtomicU64::new(0),
+            misses: AtomicU64::new(0),
+            coalesced: AtomicU64::new(0),
+            evictions: AtomicU64::new(0),
+            expirations: AtomicU64::new(0),
+        }
+    }
+
+    /// Query : Returns the cached result of the query, running it on the handle of the cache on a miss.
+    ///    Errors are returned to every caller waiting on the same query but are never cached.
+    pub fn query(&self, query: &str) -> Result<Arc<QueryResult<'h>>, ErrorType> {
+        let key = normalize_query(query);
+
+        let mut running = {
+            let mut state = self.state.lock().unwrap();
+
+            if let Some(result) = self.lookup(&mut state, &key) {
+                self.hits.fetch_add(1, Ordering::Relaxed);
+                return Ok(result);
+            }
+
+            if let Some(flight) = state.in_flight.get(&key) {
+                let flight = flight.clone();
+                drop(state);
+
+                self.coalesced.fetch_add(1, Ordering::Relaxed);
+                return wait_for(&flight);
+            }
+
+            self.misses.fetch_add(1, Ordering::Relaxed);
+
+            let flight = Arc::new(InFlight { state: Mutex::new(None), ready: Condvar::new() });
+            state.in_flight.insert(key.clone(), flight.clone());
+            Running { cache: self, key: Some(key), flight }
+        };
+
+        let result = self.handle.query(query).map(Arc::new);
+        running.complete(result.clone());
+        result
+    }
+
+    /// Invalidate : Drops the cached result of the query, if any.
+    pub fn invalidate(&self, query: &str) {
+        let key = normalize_query(query);
+        let mut state = self.state.lock().unwrap();
+        remove_entry(&mut state, &key);
+    }
+
+    /// Clear : Drops every cached result.
+    pub fn clear(&self) {
+        let mut state = self.state.lock().unwrap();
+        state.entries.clear();
+        state.recency.clear();
+        state.bytes = 0;
+    }
+
+    /// Metrics : Returns the hit, miss and memory counters of the cache.
+    pub fn metrics(&self) -> QueryCacheMetrics {
+        let (entries, bytes) = {
+            let state = self.state.lock().unwrap();
+            (state.entries.len() as u64, state.bytes as u64)
+        };
+
+        QueryCacheMetrics {
+            hits: self.hits.load(Ordering::Relaxed),
+            misses: self.misses.load(Ordering::Relaxed),
+            coalesced: self.coalesced.load(Ordering::Relaxed),
+            evictions: self.evictions.load(Ordering::Relaxed),
+            expirations: self.expirations.load(Ordering::Relaxed),
+            entries,
+            bytes,
+        }
+    }
+
+    fn lookup(&self, state: &mut CacheState<'h>, key: &str) -> Option<Arc<QueryResult<'h>>> {
+        let (expired, old_tick) = match state.entries.get(key) {
+            Some(entry) => (entry.inserted.elapsed() >= self.config.ttl, entry.tick),
+            None => return None,
+        };
+
+        if expired {
+            remove_entry(state, key);
+            self.expirations.fetch_add(1, Ordering::Relaxed);
+            return None;
+        }
+
+        state.tick += 1;
+        let tick = state.tick;
+        let key = state.recency.remove(&old_tick)?;
+        let entry = state.entries.get_mut(&key)?;
+        entry.tick = tick;
+        let result = entry.result.clone();
+        state.recency.insert(tick, key);
+
+        Some(result)
+    }
+
+    fn insert(&self, state: &mut CacheState<'h>, key: String, result: Arc<QueryResult<'h>>) {
+        let bytes = result.byte_size();
+        if bytes > self.config.max_bytes || self.config.max_entries == 0 {
+            return;
+        }
+
+        remove_entry(state, &key);
+
+        while state.bytes + bytes > self.config.max_bytes || state.entries.len() >= self.config.max_entries {
+            let oldest = match state.recency.keys().next() {
+                Some(tick) => *tick,
+                None => break,
+            };
+            if let Some(victim) = state.recency.remove(&oldest) {
+                if let Some(entry) = state.entries.remove(&victim) {
+                    state.bytes -= entry.bytes;
+                }
+                self.evictions.fetch_add(1, Ordering::Relaxed);
+            }
+        }
+
+        state.tick += 1;
+        let tick = state.tick;
+        state.bytes += bytes;
+        state.recency.insert(tick, key.clone());
+        state.entries.insert(key, CacheEntry { result, bytes, inserted: Instant::now(), tick });
+    }
+}
+
+fn remove_entry(state: &mut CacheState<'_>, key: &str) {
+    if let Some(entry) = state.entries.remove(key) {
+        state.recency.remove(&entry.tick);
+        state.bytes -= entry.bytes;
+    }
+}
+
+// The query a caller runs for the others, completed with ErrInternalLocal if the caller unwinds before
+// it completes it, so that the waiters never block forever.
+struct Running<'c, 'h> {
+    cache: &'c QueryCache<'h>,
+    key: Option<String>,
+    flight: Arc<InFlight<'h>>,
+}
+
+impl<'h> Running<'_, 'h> {
+    fn complete(&mut self, result: Result<Arc<QueryResult<'h>>, ErrorType>) {
+        let key = match self.key.take() {
+            Some(k) => k,
+            None => return,
+        };
+
+        {
+            let mut state = self.cache.state.lock().unwrap_or_else(|e| e.into_inner());
+            state.in_flight.remove(&key);
+            if let Ok(result) = &result {
+                self.cache.insert(&mut state, key, result.clone());
+            }
+        }
+
+        *self.flight.state.lock().unwrap_or_else(|e| e.into_inner()) = Some(result);
+        self.flight.ready.notify_all();
+    }
+}
+
+impl Drop for Running<'_, '_> {
+    fn drop(&mut self) {
+        self.complete(Err(ErrorType::ErrInternalLocal));
+    }
+}
+
+fn wait_for<'h>(flight: &InFlight<'h>) -> Result<Arc<QueryResult<'h>>, ErrorType> {
+    let mut state = flight.state.lock().unwrap();
+    loop {
+        if let Some(result) = state.as_ref() {
+            return result.clone();
+        }
+        state = flight.ready.wait(state).unwrap();
+    }
+}
+
+/// NormalizeQuery : Returns the cache key of a query.
+///    Whitespace runs outside of quoted literals collapse to a single space,
+///    whitespace next to commas and parentheses is dropped,
+///    and leading, trailing whitespace and trailing semicolons are removed.
+///    Identifiers and literals are kept as is since table names are case sensitive.
+pub fn normalize_query(query: &str) -> String {
+    let mut out = String::with_capacity(query.len());
+    let mut quote: Option<char> = None;
+    let mut pending_space = false;
+
+    for c in query.trim().trim_end_matches(|c: char| c == ';' || c.is_whitespace()).chars() {
+        if let Some(q) = quote {
+            out.push(c);
+            if c == q {
+                quote = None;
+            }
+            continue;
+        }
+
+        if c.is_whitespace() {
+            pending_space = true;
+            continue;
+        }
+
+        if pending_space {
+            let glued = matches!(c, ',' | '(' | ')') || out.ends_with(|p: char| p == ',' || p == '(');
+            if !glued && !out.is_empty() {
+                out.push(' ');
+            }
+            pending_space = false;
+        }
+
+        if c == '\'' || c == '"' {
+            quote = Some(c);
+        }
+        out.push(c);
+    }
+
+    out
+}
@@ -0,0 +1,285 @@
+use std::sync::Mutex;
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::thread;
+
+use crate::error::ErrorType;
+use crate::handle_pool::HandlePool;
+use crate::query::{Column, ColumnValues};
+
+/// SlicedQuery : A range query that may be split into disjoint time slices.
+///    The query text of a slice is `<select> from <table> in range(<begin>, <end>) [where <filter>]`,
+///    begin is inclusive and end exclusive, both in nanoseconds since epoch.
+#[derive(Debug, Clone)]
+pub struct SlicedQuery {
+    pub select: String,
+    pub table: String,
+    pub begin: i64,
+    pub end: i64,
+    pub filter: Option<String>,
+}
+
+/// Merge : How the slice results are combined into one.
+///    Concat appends the rows of every slice in time order.
+///    Aggregate folds the single row of every slice with one operation per column,
+///    which is only correct for aggregations that are decomposable over time.
+///    Columns without an operation are folded with Last. Timestamps cannot be summed or counted,
+///    strings and blobs only keep the First or Last value, query_sliced fails with ErrInvalidArgument otherwise.
+#[derive(Debug, Clone)]
+pub enum Merge {
+    Concat,
+    Aggregate(Vec<Aggregate>),
+}
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum Aggregate {
+    Count,
+    Sum,
+    Min,
+    Max,
+    First,
+    Last,
+}
+
+impl SlicedQuery {
+    /// Render : Returns the query text for the range [begin, end).
+    pub fn render(&self, begin: i64, end: i64) -> String {
+        let mut q = format!("{} from {} in range({}, {})",
+                            self.select, self.table, format_timestamp(begin), format_timestamp(end));
+        if let Some(filter) = &self.filter {
+            q.push_str(" where ");
+            q.push_str(filter);
+        }
+        q
+    }
+}
+
+impl HandlePool {
+    /// QuerySliced : Runs the query as about one slice per handle of the pool and merges the results.
+    ///    Slice boundaries are aligned to the shard size of the table so that no bucket is read twice.
+    ///    The first error returned by a slice is returned and the remaining slices are abandoned.
+    pub fn query_sliced(&self, query: &SlicedQuery, merge: &Merge) -> Result<Vec<Column>, ErrorType> {
+        let shard_size_ms = self.get().ts_shard_size(&query.table)?;
+        let slices = time_slices(query.begin, query.end, shard_size_ms as i64 * 1_000_000, self.size());
+
+        let results: Vec<Mutex<Option<Vec<Column>>>> = slices.iter().map(|_| Mutex::new(None)).collect();
+        let failure: Mutex<Option<ErrorType>> = Mutex::new(None);
+        let next = AtomicUsize::new(0);
+
+        thread::scope(|s| {
+            for worker in 0..self.size().min(slices.len()) {
+                let (slices, results, failure, next) = (&slices, &results, &failure, &next);
+                s.spawn(move || {
+                    let handle = self.handle(worker);
+                    loop {
+                        let i = next.fetch_add(1, Ordering::Relaxed);
+                        if i >= slices.len() || failure.lock().unwrap().is_some() {
+                            return;
+                        }
+
+                        let (begin, end) = slices[i];
+                        match handle.query(&query.render(begin, end)) {
+                            Ok(r) => *results[i].lock().unwrap() = Some(r.columns()),
+                            Err(e) => {
+                                failure.lock().unwrap().get_or_insert(e);
+                                return;
+                            }
+                        }
+                    }
+                });
+            }
+        });
+
+        if let Some(e) = failure.into_inner().unwrap() {
+            return Err(e);
+        }
+
+        let parts = results.into_iter().filter_map(|r| r.into_inner().unwrap());
+        merge_columns(parts, merge)
+    }
+}
+
+/// TimeSlices : Splits [begin, end) into about count disjoint ranges whose inner boundaries
+///    fall on multiples of shard_size, an unaligned begin may add one more slice.
+///    All durations are in nanoseconds.
+pub fn time_slices(begin: i64, end: i64, shard_size: i64, count: usize) -> Vec<(i64, i64)> {
+    if end <= begin {
+        return Vec::new();
+    }
+
+    let shard_size = shard_size.max(1);
+    let count = count.max(1) as i64;
+
+    // round the slice length up to whole shards
+    let span = end - begin;
+    let length = ((span + count - 1) / count + shard_size - 1) / shard_size * shard_size;
+
+    let mut slices = Vec::new();
+    let mut lower = begin;
+    // first boundary is the shard boundary after begin that leaves a slice of at most length
+    let mut upper = (begin.div_euclid(shard_size) * shard_size).saturating_add(length);
+
+    while lower < end {
+        let bound = upper.min(end);
+        if bound > lower {
+            slices.push((lower, bound));
+        }
+        lower = bound;
+        upper = upper.saturating_add(length);
+    }
+
+    slices
+}
+
+/// FormatTimestamp : Formats nanoseconds since epoch as a query timestamp literal,
+///    e.g. 2021-01-01T00:00:00.000000000
+pub fn format_timestamp(nanos: i64) -> String {
+    let secs = nanos.div_euclid(1_000_000_000);
+    let sub = nanos.rem_euclid(1_000_000_000);
+    let days = secs.div_euclid(86_400);
+    let rem = secs.rem_euclid(86_400);
+
+    // civil from days, http://howardhinnant.github.io/date_algorithms.html
+    let z = days + 719_468;
+    let era = z.div_euclid(146_097);
+    let doe = z.rem_euclid(146_097);
+    let yoe = (doe - doe / 1460 + doe / 36_524 - doe / 146_096) / 365;
+    let doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    let mp = (5 * doy + 2) / 153;
+    let day = doy - (153 * mp + 2) / 5 + 1;
+    let month = if mp < 10 { mp + 3 } else { mp - 9 };
+    let year = yoe + era * 400 + if month <= 2 { 1 } else { 0 };
+
+    format!("{:04}-{:02}-{:02}T{:02}:{:02}:{:02}.{:09}",
+            year, month, day, rem / 3600, rem % 3600 / 60, rem % 60, sub)
+}
+
+fn merge_columns<I>(parts: I, merge: &Merge) -> Result<Vec<Column>, ErrorType>
+    where I: Iterator<Item=Vec<Column>>
+{
+    let mut merged: Vec<Column> = Vec::new();
+
+    for part in parts {
+        // every slice is checked, whether an operation fails must not depend on the data
+        if let Merge::Aggregate(ops) = merge {
+            let op = |i: usize| ops.get(i).copied().unwrap_or(Aggregate::Last);
+            if !part.iter().enumerate().all(|(i, col)| foldable(&col.values, op(i))) {
+                return Err(ErrorType::ErrInvalidArgument);
+            }
+        }
+
+        if merged.is_empty() {
+            merged = part;
+            continue;
+        }
+
+        for (i, (acc, col)) in merged.iter_mut().zip(part).enumerate() {
+            match merge {
+                Merge::Concat => append(&mut acc.values, col.values),
+                Merge::Aggregate(ops) => {
+                    let op = ops.get(i).copied().unwrap_or(Aggregate::Last);
+                    fold(&mut acc.values, col.values, op)?;
+                }
+            }
+        }
+    }
+
+    Ok(merged)
+}
+
+fn append(acc: &mut ColumnValues, other: ColumnValues) {
+    match (acc, other) {
+        (ColumnValues::Double(a), ColumnValues::Double(b)) => a.extend(b),
+        (ColumnValues::Int64(a), ColumnValues::Int64(b)) => a.extend(b),
+        (ColumnValues::Timestamp(a), ColumnValues::Timestamp(b)) => a.extend(b),
+        (ColumnValues::Count(a), ColumnValues::Count(b)) => a.extend(b),
+        (ColumnValues::Blob(a), ColumnValues::Blob(b)) => a.extend(b),
+        (ColumnValues::String(a), ColumnValues::String(b)) => a.extend(b),
+        (ColumnValues::Null(a), ColumnValues::Null(b)) => *a += b,
+        (acc, other) => {
+            // the column was null in one of the slices, pad it to keep rows aligned
+            let n = other.len();
+            if let ColumnValues::Null(prefix) = acc {
+                let prefix = *prefix;
+                *acc = match other {
+                    ColumnValues::Double(b) => ColumnValues::Double(padded(prefix, b)),
+                    ColumnValues::Int64(b) => ColumnValues::Int64(padded(prefix, b)),
+                    ColumnValues::Timestamp(b) => ColumnValues::Timestamp(padded(prefix, b)),
+                    ColumnValues::Count(b) => ColumnValues::Count(padded(prefix, b)),
+                    ColumnValues::Blob(b) => ColumnValues::Blob(padded(prefix, b)),
+                    ColumnValues::String(b) => ColumnValues::String(padded(prefix, b)),
+                    ColumnValues::Null(b) => ColumnValues::Null(prefix + b),
+                };
+            } else {
+                match acc {
+                    ColumnValues::Double(a) => a.extend((0..n).map(|_| None)),
+                    ColumnValues::Int64(a) => a.extend((0..n).map(|_| None)),
+                    ColumnValues::Timestamp(a) => a.extend((0..n).map(|_| None)),
+                    ColumnValues::Count(a) => a.extend((0..n).map(|_| None)),
+                    ColumnValues::Blob(a) => a.extend((0..n).map(|_| None)),
+                    ColumnValues::String(a) => a.extend((0..n).map(|_| None)),
+                    ColumnValues::Null(a) => *a += n,
+                }
+            }
+        }
+    }
+}
+
+fn padded<T>(prefix: usize, values: Vec<Option<T>>) -> Vec<Option<T>> {
+    let mut out: Vec<Option<T>> = (0..prefix).map(|_| None).collect();
+    out.extend(values);
+    out
+}
+
+// Whether the values of the slices can be folded into one with op.
+fn foldable(values: &ColumnValues, op: Aggregate) -> bool {
+    match values {
+        ColumnValues::Double(_) | ColumnValues::Int64(_) | ColumnValues::Count(_) | ColumnValues::Null(_) => true,
+        // ordered but do not add up
+        ColumnValues::Timestamp(_) => !matches!(op, Aggregate::Count | Aggregate::Sum),
+        // the order of the client is not the one of the cluster
+        ColumnValues::Blob(_) | ColumnValues::String(_) => matches!(op, Aggregate::First | Aggregate::Last),
+    }
+}
+
+// Folds one slice into the accumulator, op was checked by foldable.
+fn fold(acc: &mut ColumnValues, other: ColumnValues, op: Aggregate) -> Result<(), ErrorType> {
+    match (acc, other) {
+        (ColumnValues::Double(a), ColumnValues::Double(b)) => fold_one(a, b, op, |x, y| x + y),
+        (ColumnValues::Int64(a), ColumnValues::Int64(b)) => fold_one(a, b, op, |x, y| x + y),
+        (ColumnValues::Count(a), ColumnValues::Count(b)) => fold_one(a, b, op, |x, y| x + y),
+        (ColumnValues::Timestamp(a), ColumnValues::Timestamp(b)) => fold_one(a, b, op, |_, _| unreachable!("summed timestamps")),
+        (ColumnValues::Blob(a), ColumnValues::Blob(b)) => fold_one(a, b, op, |_, _| unreachable!("summed blobs")),
+        (ColumnValues::String(a), ColumnValues::String(b)) => fold_one(a, b, op, |_, _| unreachable!("summed strings")),
+        (acc @ ColumnValues::Null(_), other) => *acc = other,
+        // null in this slice
+        (_, ColumnValues::Null(_)) => {}
+        // the slices disagree on the type of the column
+        _ => return Err(ErrorType::ErrInvalidArgument),
+    }
+    Ok(())
+}
+
+fn fold_one<T: PartialOrd + Clone>(acc: &mut Vec<Option<T>>, other: Vec<Option<T>>, op: Aggregate, add: fn(T, T) -> T) {
+    let b = match other.into_iter().next().flatten() {
+        Some(b) => b,
+        None => return,
+    };
+
+    let a = match acc.first().cloned().flatten() {
+        Some(a) => a,
+        None => {
+            *acc = vec![Some(b)];
+            return;
+        }
+    };
+
+    let folded = match op {
+        Aggregate::Count | Aggregate::Sum => add(a, b),
+        Aggregate::Min => if b < a { b } else { a },
+        Aggregate::Max => if b > a { b } else { a },
+        Aggregate::First => a,
+        Aggregate::Last => b,
+    };
+
+    *acc = vec![Some(folded)];
+}
@@ -0,0 +1,49 @@
+use std::time::{Duration, SystemTime, UNIX_EPOCH};
+
+/// Rng : xorshift64*, a fast generator good enough to draw keys, sizes and waits.
+#[derive(Debug, Clone)]
+pub struct Rng(u64);
+
+impl Rng {
+    pub fn new(seed: u64) -> Rng {
+        // splitmix64 of the seed, so that consecutive seeds give unrelated streams
+        let mut z = seed.wrapping_add(0x9e3779b97f4a7c15);
+        z = (z ^ (z >> 30)).wrapping_mul(0xbf58476d1ce4e5b9);
+        z = (z ^ (z >> 27)).wrapping_mul(0x94d049bb133111eb);
+        Rng((z ^ (z >> 31)) | 1)
+    }
+
+    pub fn next_u64(&mut self) -> u64 {
+        self.0 ^= self.0 >> 12;
+        self.0 ^= self.0 << 25;
+        self.0 ^= self.0 >> 27;
+        self.0.wrapping_mul(0x2545f4914f6cdd1d)
+    }
+
+    /// NextF64 : Returns a value uniformly distributed in [0, 1).
+    pub fn next_f64(&mut self) -> f64 {
+        (self.next_u64() >> 11) as f64 / (1u64 << 53) as f64
+    }
+
+    // standard normal, Box-Muller
+    pub(crate) fn next_gaussian(&mut self) -> f64 {
+        let u1 = 1.0 - self.next_f64();
+        let u2 = self.next_f64();
+        (-2.0 * u1.ln()).sqrt() * (2.0 * std::f64::consts::PI * u2).cos()
+    }
+}
+
+/// Seed : A seed different for every call, mixing the clock, salt and the stack of the calling thread,
+///    so that clients that collided draw different waits.
+pub fn seed(salt: u64) -> u64 {
+    let now = SystemTime::now().duration_since(UNIX_EPOCH).map(|d| d.as_nanos() as u64).unwrap_or(0);
+    let local = 0u8;
+    now ^ salt.wrapping_mul(0x9e37_79b9_7f4a_7c15) ^ (&local as *const u8 as u64).rotate_left(32)
+}
+
+/// Backoff : The wait before the retry following the n-th failed attempt, uniform in [0, min(max, base * 2^n)].
+///    Full jitter spreads the clients that collided instead of making them collide again.
+pub fn backoff(base: Duration, max: Duration, attempt: u32, rng: &mut Rng) -> Duration {
+    let ceiling = base.saturating_mul(1 << attempt.min(20)).min(max);
+    ceiling.mul_f64(rng.next_f64())
+}
@@ -0,0 +1,97 @@
+use std::cell::{Cell, UnsafeCell};
+use std::marker::PhantomData;
+use std::mem::MaybeUninit;
+use std::sync::Arc;
+use std::sync::atomic::{AtomicUsize, Ordering};
+
+struct Ring<T> {
+    slots: Box<[UnsafeCell<MaybeUninit<T>>]>,
+    // next slot to read, only written by the consumer
+    head: AtomicUsize,
+    // next slot to write, only written by the producer
+    tail: AtomicUsize,
+}
+
+// A slot is only ever accessed by the one producer or the one consumer, never both, see push and pop.
+unsafe impl<T: Send> Send for Ring<T> {}
+unsafe impl<T: Send> Sync for Ring<T> {}
+
+impl<T> Ring<T> {
+    fn next(&self, index: usize) -> usize {
+        if index + 1 == self.slots.len() { 0 } else { index + 1 }
+    }
+}
+
+impl<T> Drop for Ring<T> {
+    fn drop(&mut self) {
+        let (mut head, tail) = (*self.head.get_mut(), *self.tail.get_mut());
+        while head != tail {
+            unsafe { self.slots[head].get_mut().assume_init_drop() };
+            head = self.next(head);
+        }
+    }
+}
+
+/// Channel : Creates a bounded, lock-free, single producer single consumer queue holding at most capacity values.
+///    The producer and the consumer halves can each be moved to another thread, but not cloned nor shared,
+///    so there is never more than one thread pushing and one thread popping.
+///    A full queue rejects the value instead of blocking the producer.
+pub fn channel<T>(capacity: usize) -> (Producer<T>, Consumer<T>) {
+    // one slot stays empty to tell a full queue from an empty one
+    let slots = (0..capacity.max(1) + 1)
+        .map(|_| UnsafeCell::new(MaybeUninit::uninit()))
+        .collect();
+
+    let ring = Arc::new(Ring { slots, head: AtomicUsize::new(0), tail: AtomicUsize::new(0) });
+    (Producer { ring: ring.clone(), _unshared: PhantomData }, Consumer { ring, _unshared: PhantomData })
+}
+
+/// Producer : The pushing half of a single producer single consumer queue, Send but neither Sync nor Clone.
+pub struct Producer<T> {
+    ring: Arc<Ring<T>>,
+    _unshared: PhantomData<Cell<()>>,
+}
+
+impl<T> Producer<T> {
+    /// Push : Appends a value, returns it back when the queue is full.
+    pub fn push(&self, value: T) -> Result<(), T> {
+        let ring = &*self.ring;
+        let tail = ring.tail.load(Ordering::Relaxed);
+        let next = ring.next(tail);
+
+        if next == ring.head.load(Ordering::Acquire) {
+            return Err(value);
+        }
+
+        unsafe { (*ring.slots[tail].get()).write(value) };
+        ring.tail.store(next, Ordering::Release);
+        Ok(())
+    }
+}
+
+/// Consumer : The popping half of a single producer single consumer queue, Send but neither Sync nor Clone.
+pub struct Consumer<T> {
+    ring: Arc<Ring<T>>,
+    _unshared: PhantomData<Cell<()>>,
+}
+
+impl<T> Consumer<T> {
+    /// Pop : Removes the oldest value, None when the queue is empty.
+    pub fn pop(&self) -> Option<T> {
+        let ring = &*self.ring;
+        let head = ring.head.load(Ordering::Relaxed);
+
+        if head == ring.tail.load(Ordering::Acquire) {
+            return None;
+        }
+
+        let value = unsafe { (*ring.slots[head].get()).assume_init_read() };
+        ring.head.store(ring.next(head), Ordering::Release);
+        Some(value)
+    }
+
+    /// IsEmpty : Returns true when there is nothing left to pop.
+    pub fn is_empty(&self) -> bool {
+        self.ring.head.load(Ordering::Relaxed) == self.ring.tail.load(Ordering::Acquire)
+    }
+}
@@ -0,0 +1,249 @@
+use std::collections::HashMap;
+use std::time::{Duration, Instant};
+
+use crate::bitmap::Bitmap;
+use crate::error::ErrorType;
+use crate::handle::HandleType;
+
+/// TagQuery : A selection of aliases by their tags.
+///    AndNot : the aliases of the first query without those of the second, NOT is always relative to a set.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub enum TagQuery {
+    Tag(String),
+    And(Vec<TagQuery>),
+    Or(Vec<TagQuery>),
+    AndNot(Box<TagQuery>, Box<TagQuery>),
+}
+
+impl TagQuery {
+    pub fn tag(tag: &str) -> TagQuery {
+        TagQuery::Tag(tag.to_string())
+    }
+
+    pub fn and_not(self, other: TagQuery) -> TagQuery {
+        TagQuery::AndNot(Box::new(self), Box::new(other))
+    }
+
+    fn tags<'q>(&'q self, tags: &mut Vec<&'q str>) {
+        match self {
+            TagQuery::Tag(tag) => tags.push(tag),
+            TagQuery::And(queries) | TagQuery::Or(queries) => queries.iter().for_each(|q| q.tags(tags)),
+            TagQuery::AndNot(a, b) => {
+                a.tags(tags);
+                b.tags(tags);
+            }
+        }
+    }
+}
+
+/// TagIndexConfig : Settings of a tag index.
+///    max_age : a refresh fetches again the tags older than this, even when their count did not change.
+#[derive(Debug, Clone, Copy)]
+pub struct TagIndexConfig {
+    pub max_age: Duration,
+}
+
+impl Default for TagIndexConfig {
+    fn default() -> Self {
+        TagIndexConfig { max_age: Duration::from_secs(300) }
+    }
+}
+
+/// RefreshStats : What a refresh did.
+///    checked : tags whose count was compared with the snapshot.
+///    fetched : tags whose aliases were fetched again.
+///    added / removed : memberships gained and lost, over every tag fetched.
+#[derive(Debug, Default, Clone, Copy, PartialEq, Eq)]
+pub struct RefreshStats {
+    pub checked: u64,
+    pub fetched: u64,
+    pub added: u64,
+    pub removed: u64,
+}
+
+struct TagEntry {
+    members: Bitmap,
+    fetched: Instant,
+}
+
+/// TagIndex : A client-side snapshot of the aliases of some tags, to select aliases by several tags at once.
+///    Aliases are interned into dense u32 ids, every tag is the bitmap of the ids of its aliases,
+///    so AND/OR/NOT of tags are bitmap operations instead of set operations on strings.
+///    Ids are stable for the life of the index, aliases that lost all their tags keep theirs.
+///
+///    let mut index = TagIndex::new(TagIndexConfig::default());
+///    index.load(&handle, &["region.eu", "tier.gold", "suspended"])?;
+///    let query = TagQuery::And(vec![TagQuery::tag("region.eu"), TagQuery::tag("tier.gold")]).and_not(TagQuery::tag("suspended"));
+///    for alias in index.aliases(&index.select(&query)?) { .. }
+pub struct TagIndex {
+    config: TagIndexConfig,
+    ids: HashMap<Box<str>, u32>,
+    aliases: Vec<Box<str>>,
+    tags: HashMap<String, TagEntry>,
+}
+
+impl TagIndex {
+    pub fn new(config: TagIndexConfig) -> TagIndex {
+        TagIndex { config, ids: HashMap::new(), aliases: Vec::new(), tags: HashMap::new() }
+    }
+
+    /// Load : Fetches the aliases of every tag not in the index yet.
+    pub fn load<S: AsRef<str>>(&mut self, handle: &HandleType, tags: &[S]) -> Result<(), ErrorType> {
+        for tag in tags {
+            if !self.tags.contains_key(tag.as_ref()) {
+                self.fetch(handle, tag.as_ref())?;
+            }
+        }
+        Ok(())
+    }
+
+    /// Refresh : Brings the index up to date, fetching again only the tags that changed.
+    ///    A tag is fetched when its count differs from the snapshot or its snapshot is older than max_age;
+    ///    a change that keeps the count, an alias swapped for another, waits for max_age or refresh_tag.
+    pub fn refresh(&mut self, handle: &HandleType) -> Result<RefreshStats, ErrorType> {
+        let mut stats = RefreshStats::default();
+        let tags: Vec<String> = self.tags.keys().cloned().collect();
+        for tag in tags {
+            let entry = &self.tags[&tag];
+            let stale = entry.fetched.elapsed() >= self.config.max_age;
+            if !stale {
+                stats.checked += 1;
+                if tagged_count(handle, &tag)? == entry.members.len() {
+                    continue;
+                }
+            }
+            self.refresh_tag_into(handle, &tag, &mut stats)?;
+        }
+        Ok(stats)
+    }
+
+    /// RefreshTag : Fetches the aliases of tag again, whether it changed or not.
+    pub fn refresh_tag(&mut self, handle: &HandleType, tag: &str) -> Result<RefreshStats, ErrorType> {
+        let mut stats = RefreshStats::default();
+        self.refresh_tag_into(handle, tag, &mut stats)?;
+        Ok(stats)
+    }
+
+    fn refresh_tag_into(&mut self, handle: &HandleType, tag: &str, stats: &mut RefreshStats) -> Result<(), ErrorType> {
+        let previous = self.fetch(handle, tag)?.unwrap_or_default();
+        let members = &self.tags[tag].members;
+        stats.fetched += 1;
+        stats.added += members.and_not(&previous).len();
+        stats.removed += previous.and_not(members).len();
+        Ok(())
+    }
+
+    // Replaces the snapshot of tag, returns the previous one.
+    fn fetch(&mut self, handle: &HandleType, tag: &str) -> Result<Option<Bitmap>, ErrorType> {
+        let mut members = Bitmap::new();
+        match handle.get_tagged_list(tag) {
+            Ok(list) => {
+                for alias in list.iter() {
+                    members.insert(self.intern(alias));
+                }
+            }
+            // a tag is removed along with its last alias
+            Err(ErrorType::ErrAliasNotFound) => {}
+            Err(err) => return Err(err),
+        }
+        let entry = TagEntry { members, fetched: Instant::now() };
+        Ok(self.tags.insert(tag.to_string(), entry).map(|e| e.members))
+    }
+
+    fn intern(&mut self, alias: &str) -> u32 {
+        if let Some(&id) = self.ids.get(alias) {
+            return id;
+        }
+        let id = self.aliases.len() as u32;
+        self.aliases.push(alias.into());
+        self.ids.insert(alias.into(), id);
+        id
+    }
+
+    /// Tagged : Returns the ids of the aliases of tag, None when the tag is not in the index.
+    pub fn tagged(&self, tag: &str) -> Option<&Bitmap> {
+        self.tags.get(tag).map(|e| &e.members)
+    }
+
+    /// Select : Returns the ids of the aliases matching query.
+    ///    Every tag of the query must have been loaded, ErrInvalidArgument otherwise:
+    ///    a tag missing from the index would silently match nothing.
+    pub fn select(&self, query: &TagQuery) -> Result<Bitmap, ErrorType> {
+        match query {
+            TagQuery::Tag(tag) => self.tagged(tag).cloned().ok_or(ErrorType::ErrInvalidArgument),
+            TagQuery::And(queries) => {
+                let mut sets = queries.iter().map(|q| self.select(q)).collect::<Result<Vec<Bitmap>, ErrorType>>()?;
+                // the smallest first, every intersection is then at most its size
+                sets.sort_by_key(|s| s.len());
+                let mut sets = sets.into_iter();
+                let first = sets.next().unwrap_or_default();
+                Ok(sets.fold(first, |acc, s| if acc.is_empty() { acc } else { acc.and(&s) }))
+            }
+            TagQuery::Or(queries) => {
+                queries.iter().try_fold(Bitmap::new(), |acc, q| Ok(acc.or(&self.select(q)?)))
+            }
+            TagQuery::AndNot(a, b) => {
+                let a = self.select(a)?;
+                if a.is_empty() {
+                    return Ok(a);
+                }
+                Ok(a.and_not(&self.select(b)?))
+            }
+        }
+    }
+
+    /// Estimate : Returns an estimate of the number of aliases matching query, from the approximate count
+    ///    of every tag, without loading any. The counts are approximate, so it may be above or below the actual
+    ///    number. Worth calling to choose whether a selection is done on the client.
+    pub fn estimate(handle: &HandleType, query: &TagQuery) -> Result<u64, ErrorType> {
+        let mut tags = Vec::new();
+        query.tags(&mut tags);
+        let mut counts = HashMap::with_capacity(tags.len());
+        for tag in tags {
+            if !counts.contains_key(tag) {
+                let count = match handle.get_tagged_approximate_count(tag) {
+                    Err(ErrorType::ErrAliasNotFound) => 0,
+                    count => count?,
+                };
+                counts.insert(tag, count);
+            }
+        }
+        Ok(estimate(query, &counts))
+    }
+
+    pub fn alias(&self, id: u32) -> Option<&str> {
+        self.aliases.get(id as usize).map(|a| &**a)
+    }
+
+    pub fn id(&self, alias: &str) -> Option<u32> {
+        self.ids.get(alias).copied()
+    }
+
+    /// Aliases : Returns the aliases of the ids, in the order they were interned.
+    pub fn aliases<'a>(&'a self, ids: &'a Bitmap) -> impl Iterator<Item=&'a str> + 'a {
+        ids.iter().map(move |id| &*self.aliases[id as usize])
+    }
+
+    /// Bytes : Returns the memory held by the bitmaps of the tags, the interned aliases aside.
+    pub fn bytes(&self) -> usize {
+        self.tags.values().map(|e| e.members.bytes()).sum()
+    }
+}
+
+// Estimates query from the counts of its tags, as if every AND matched its smallest side, every OR the sum
+// of its sides and every NOT nothing: would be an upper bound with exact counts.
+fn estimate(query: &TagQuery, counts: &HashMap<&str, u64>) -> u64 {
+    match query {
+        TagQuery::Tag(tag) => counts[tag.as_str()],
+        TagQuery::And(queries) => queries.iter().map(|q| estimate(q, counts)).min().unwrap_or(0),
+        TagQuery::Or(queries) => queries.iter().map(|q| estimate(q, counts)).sum(),
+        TagQuery::AndNot(a, _) => estimate(a, counts),
+    }
+}
+
+fn tagged_count(handle: &HandleType, tag: &str) -> Result<u64, ErrorType> {
+    match handle.get_tagged_count(tag) {
+        Err(ErrorType::ErrAliasNotFound) => Ok(0),
+        count => count,
+    }
+}
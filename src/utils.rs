@@ -1,8 +1,5 @@
 use rug::Integer;
 use rug::rand::RandState;
-use std::ffi::CString;
-use std::ffi::CStr;
-use std::os::raw::c_char;
 
 // utils.go
 // https://github.com/bureau14/qdb-api-go/blob/master/utils.go
@@ -55,13 +52,3 @@ fn generate_alias<const n: u32>() -> String {
 
     return s.to_string();
 }
-
-pub unsafe fn str_to_cstr(input: &str) -> *mut c_char {
-    let c_str = CString::new(input).unwrap().into_raw();
-    return c_str;
-}
-
-pub unsafe fn cstr_to_str(c_buf: *const i8) -> &'static str {
-    let cstr = CStr::from_ptr(c_buf);
-    return cstr.to_str().expect("success");
-}
\ No newline at end of file
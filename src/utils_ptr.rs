@@ -1,48 +1,35 @@
-use std::{ffi, ptr};
+use std::ffi;
 use std::os::raw;
 
 use crate::cluster_endpoint::Endpoint;
 use crate::error::RawPointerError;
 use crate::qdb_remote_node_t;
 
-/// raw_pointer_to_vector: Converts  an FFI raw pointer to Vec<Endpoint>
+/// raw_pointer_to_vector: Converts an FFI array of endpoints to Vec<Endpoint>
 ///
+/// The array stays owned by the API, release it with qdb_release once converted.
 /// Returns Result type of either Vec<Endpoint> or an RawPointerError.
 /// RawPointerError maps to ErrorType: ErrSystemLocal / qdb_error_t = -486539263
-pub fn raw_pointer_to_vector(endpoints_ref: *mut *mut qdb_remote_node_t, endpoints_count: usize) -> Result<Vec<Endpoint>, RawPointerError> {
+///
+/// # Safety
+/// endpoints_ref must be null or point to endpoints_count valid qdb_remote_node_t,
+/// each with a null-terminated address, all of them alive for the duration of the call.
+pub unsafe fn raw_pointer_to_vector(endpoints_ref: *const qdb_remote_node_t, endpoints_count: usize) -> Result<Vec<Endpoint>, RawPointerError> {
+
+    if endpoints_count == 0 {
+        return Ok(vec![]);
+    }
 
     // Null check raw pointer
     if endpoints_ref.is_null() {
         return Err(RawPointerError("[raw_pointer_to_vector]: C Raw pointer is NULL ".to_string()));
     }
 
-    let mut output: Vec<Endpoint> = vec![];
-
-    unsafe {
-        if endpoints_count > 0 {
-            // https://stackoverflow.com/questions/27150652/how-can-i-get-an-array-or-a-slice-from-a-raw-pointer
-            let slice = std::slice::from_raw_parts(endpoints_ref, endpoints_count);
-
-            let mut i = 0;
-            while i < endpoints_count {
-                match raw_pointer_to_endpoint(slice[i]) {
-                    Ok(endpoint) => {
-                        output.push(endpoint)
-                    }
-                    Err(err) => {
-                        // drop the raw pointer to prevent memory leak https://doc.rust-lang.org/stable/std/ptr/fn.drop_in_place.html
-                        ptr::drop_in_place(slice[i]);
+    let mut output: Vec<Endpoint> = Vec::with_capacity(endpoints_count);
 
-                        return Err(err);
-                    }
-                }
-
-                i += 1;
-            }
-
-            // drop the raw pointer https://doc.rust-lang.org/stable/std/ptr/fn.drop_in_place.html
-            ptr::drop_in_place(slice[i]);
-        }
+    for i in 0..endpoints_count {
+        let endpoint = raw_pointer_to_endpoint(endpoints_ref.add(i))?;
+        output.push(endpoint);
     }
 
     Ok(output)
@@ -52,10 +39,11 @@ pub fn raw_pointer_to_vector(endpoints_ref: *mut *mut qdb_remote_node_t, endpoin
 ///
 /// Returns Result type of either an Endpoint or an RawPointerError.
 /// RawPointerError maps to ErrorType: ErrSystemLocal / qdb_error_t = -486539263
-fn raw_pointer_to_endpoint(endpoint_ptr: *const qdb_remote_node_t) -> Result<Endpoint, RawPointerError> {
+/// endpoint_ptr must be null or point to a valid qdb_remote_node_t.
+unsafe fn raw_pointer_to_endpoint(endpoint_ptr: *const qdb_remote_node_t) -> Result<Endpoint, RawPointerError> {
 
     // Converts an FFI raw pointer into a safe Rust reference: https://stackoverflow.com/questions/37466676/is-it-possible-to-match-against-a-null-pointer-in-rust
-    let convert_ptr_to_ref = unsafe { endpoint_ptr.as_ref() };
+    let convert_ptr_to_ref = endpoint_ptr.as_ref();
 
     let endpoint_ref = match convert_ptr_to_ref {
         None => {
@@ -70,7 +58,7 @@ fn raw_pointer_to_endpoint(endpoint_ptr: *const qdb_remote_node_t) -> Result<End
 
     // ffi::c_char is a mutable raw pointer with zero guarantees and const can't be enforced across the FFI boundary anyways
     // so we need to make a to-owned copy because the raw pointer may change after first access
-    let c_str = unsafe { ffi::CStr::from_ptr(endpoint_ref.address) };
+    let c_str = ffi::CStr::from_ptr(endpoint_ref.address);
 
     let result_string = c_str.to_str().map(|s| s.to_owned());
 
@@ -81,32 +69,42 @@ fn raw_pointer_to_endpoint(endpoint_ptr: *const qdb_remote_node_t) -> Result<End
     };
 }
 
- fn raw_pointer_to_string(raw_ptr: *const raw::c_char) -> Result<String, RawPointerError> {
-    let c_str = unsafe { ffi::CStr::from_ptr(raw_ptr) };
+// raw_ptr must be null or point to a null-terminated string.
+unsafe fn raw_pointer_to_string(raw_ptr: *const raw::c_char) -> Result<String, RawPointerError> {
+    if raw_ptr.is_null() {
+        return Err(RawPointerError("[raw_pointer_to_string]: C Raw pointer is NULL ".to_string()));
+    }
+
+    let c_str = ffi::CStr::from_ptr(raw_ptr);
 
     let conv_string = c_str.to_str().map(|s| s.to_owned());
 
     return match conv_string {
         Ok(string) => Ok(string),
-        Err(e) => Err(RawPointerError("[raw_pointer_to_endpoint]: Failed to convert C string to Rust string: ".to_string() + &*e.to_string())),
+        Err(e) => Err(RawPointerError("[raw_pointer_to_string]: Failed to convert C string to Rust string: ".to_string() + &*e.to_string())),
     };
 }
 
-pub fn raw_pointer_to_string_vector(
-    raw_ptr: *mut *mut *const ffi::c_char,
+/// raw_pointer_to_string_vector: Copies an FFI array of len null-terminated strings to Vec<String>
+///
+/// The array stays owned by the API, release it with qdb_release once converted.
+/// To read the strings without copying them see ffi_str::AliasList.
+///
+/// # Safety
+/// raw_ptr must be null or point to len pointers, each null or pointing to a null-terminated string,
+/// all of them alive for the duration of the call.
+pub unsafe fn raw_pointer_to_string_vector(
+    raw_ptr: *const *const ffi::c_char,
     len: usize)
     -> Result<Vec<String>, RawPointerError>
 {
-    unsafe {
-        let mut result: Vec<String> = Vec::new();
-
-        let slice = std::slice::from_raw_parts(raw_ptr, len);
-        for tag in slice {
-            let string_tag = raw_pointer_to_string(tag.read())
-                .expect("Failed to convert raw pointer to string");
-            result.push(string_tag);
-        }
-
-        Ok(result)
+    if len == 0 {
+        return Ok(Vec::new());
     }
+    if raw_ptr.is_null() {
+        return Err(RawPointerError("[raw_pointer_to_string_vector]: C Raw pointer is NULL ".to_string()));
+    }
+
+    let slice = std::slice::from_raw_parts(raw_ptr, len);
+    slice.iter().map(|s| raw_pointer_to_string(*s)).collect()
 }
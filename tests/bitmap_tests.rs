@@ -0,0 +1,48 @@
+use std::collections::BTreeSet;
+
+use quasar_rs::bitmap::Bitmap;
+use quasar_rs::loadgen::Rng;
+
+// Ids spread over a few chunks, dense enough in some of them to switch to bits.
+fn random_set(rng: &mut Rng, count: usize, range: u64) -> (Bitmap, BTreeSet<u32>) {
+    let ids: Vec<u32> = (0..count).map(|_| (rng.next_u64() % range) as u32).collect();
+    (ids.iter().copied().collect(), ids.into_iter().collect())
+}
+
+#[test]
+fn test_bitmap_set_operations() {
+    let mut rng = Rng::new(7);
+    for (count, range) in [(100, 1_000), (6_000, 70_000), (20_000, 200_000), (50_000, 65_536)] {
+        let (a, set_a) = random_set(&mut rng, count, range);
+        let (b, set_b) = random_set(&mut rng, count, range);
+        assert_eq!(a.len(), set_a.len() as u64);
+        assert_eq!(a.iter().collect::<Vec<u32>>(), set_a.iter().copied().collect::<Vec<u32>>());
+
+        assert_eq!(a.and(&b).iter().collect::<BTreeSet<u32>>(), &set_a & &set_b);
+        assert_eq!(a.or(&b).iter().collect::<BTreeSet<u32>>(), &set_a | &set_b);
+        assert_eq!(a.and_not(&b).iter().collect::<BTreeSet<u32>>(), &set_a - &set_b);
+        assert_eq!(a.and(&b).len(), (&set_a & &set_b).len() as u64);
+    }
+}
+
+#[test]
+fn test_bitmap_insert_remove() {
+    let mut bitmap = Bitmap::new();
+    assert!(bitmap.insert(70_000));
+    assert!(!bitmap.insert(70_000));
+    for id in 0..5_000 {
+        bitmap.insert(id * 2);
+    }
+    assert_eq!(bitmap.len(), 5_001);
+    assert!(bitmap.contains(9_998) && !bitmap.contains(9_999) && bitmap.contains(70_000));
+    // dense chunks take 8 KiB whatever their count
+    assert!(bitmap.bytes() < 5_000 * 2);
+
+    for id in 0..5_000 {
+        assert!(bitmap.remove(id * 2));
+    }
+    assert!(!bitmap.remove(2));
+    assert_eq!(bitmap.iter().collect::<Vec<u32>>(), vec![70_000]);
+    assert!(bitmap.remove(70_000));
+    assert!(bitmap.is_empty());
+}
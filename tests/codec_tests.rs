@@ -0,0 +1,80 @@
+use quasar_rs::codec::{self, BlobCodec, Codec, CodecConfig};
+use quasar_rs::error::ErrorType;
+
+fn json_document(records: usize) -> Vec<u8> {
+    let mut json = String::from("[");
+    for i in 0..records {
+        json += &format!("{{\"id\":{},\"symbol\":\"BTC-USD\",\"price\":{}.{},\"side\":\"{}\",\"tags\":[\"spot\",\"usd\"]}},",
+                         i, 29_000 + i * 7 % 113, i % 100, if i % 3 == 0 { "buy" } else { "sell" });
+    }
+    json.push(']');
+    json.into_bytes()
+}
+
+#[test]
+fn test_codec_round_trip() {
+    let json = json_document(200);
+    let noise: Vec<u8> = (0..5000u64).map(|i| (i.wrapping_mul(6_364_136_223_846_793_005) >> 56) as u8).collect();
+    let runs = vec![7u8; 100_000];
+
+    for content in [&json[..], &noise[..], &runs[..], b"", b"abc"] {
+        for c in [Codec::Stored, Codec::Fast, Codec::Best] {
+            let payload = codec::encode(c, content).unwrap();
+            assert!(payload.len() <= content.len() + 16);
+            assert_eq!(codec::decode(&payload).unwrap(), content);
+        }
+    }
+
+    let fast = codec::encode(Codec::Fast, &json).unwrap();
+    let best = codec::encode(Codec::Best, &json).unwrap();
+    assert!(fast.len() < json.len() / 3);
+    assert!(best.len() <= fast.len());
+}
+
+#[test]
+fn test_codec_untagged_and_damaged() {
+    // blobs written without the codec layer are returned as they are
+    assert_eq!(codec::decode(b"plain content").unwrap(), b"plain content");
+
+    // even when they start like a header, without its hash
+    let tagged = codec::encode(Codec::Fast, &json_document(50)).unwrap();
+    let mut plain = tagged[..12].to_vec();
+    plain.extend_from_slice(b"not a hash, only content");
+    assert_eq!(codec::decode(&plain).unwrap(), plain);
+    assert_eq!(codec::decode(&[0xD1, b'Q', b'Z', 0, 1, 2, 3, 4, 5]).unwrap(), [0xD1, b'Q', b'Z', 0, 1, 2, 3, 4, 5]);
+
+    // a valid header claiming a huge size is corruption, not a huge allocation
+    let mut huge = codec::encode(Codec::Fast, &vec![7u8; 1000]).unwrap();
+    let mut header = huge[..8].to_vec();
+    header.extend_from_slice(&u32::MAX.to_le_bytes());
+    let hash = header.iter().fold(0x811c_9dc5u32, |h, &b| (h ^ b as u32).wrapping_mul(0x0100_0193));
+    header.extend_from_slice(&hash.to_le_bytes());
+    huge.splice(..16, header);
+    assert_eq!(codec::decode(&huge), Err(ErrorType::ErrDataCorruption));
+
+    let mut payload = codec::encode(Codec::Fast, &json_document(50)).unwrap();
+    let last = payload.len() - 1;
+    payload.truncate(last);
+    assert_eq!(codec::decode(&payload), Err(ErrorType::ErrDataCorruption));
+}
+
+#[test]
+fn test_codec_prefixes() {
+    let codec = BlobCodec::new(CodecConfig {
+        prefixes: vec![("json.".into(), Codec::Fast), ("json.archive.".into(), Codec::Best), ("raw.".into(), Codec::Stored)],
+        ..CodecConfig::default()
+    });
+
+    assert_eq!(codec.codec_for("json.user"), Codec::Fast);
+    assert_eq!(codec.codec_for("json.archive.2021"), Codec::Best);
+    assert_eq!(codec.codec_for("raw.image"), Codec::Stored);
+    assert_eq!(codec.codec_for("other"), Codec::Fast);
+
+    let json = json_document(100);
+    codec.encode("json.user", &json).unwrap();
+    codec.encode("raw.image", &json).unwrap();
+    codec.encode("json.user", b"short").unwrap();
+    let stats = codec.stats();
+    assert_eq!((stats.compressed, stats.stored), (1, 2));
+    assert_eq!(stats.raw_bytes, 2 * json.len() as u64 + 5);
+}
@@ -0,0 +1,1310 @@
+#![cfg(feature = "fake-api")]
+
+use std::collections::BTreeSet;
+use std::ffi::CString;
+use std::io::{Read, Write};
+use std::future::Future;
+use std::pin::Pin;
+use std::ptr;
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::{mpsc, Arc, Mutex};
+use std::task::{Context, Poll, Wake, Waker};
+use std::thread;
+use std::time::{Duration, Instant};
+
+use quasar_rs::alias_scan::{ScanConfig, ScanKind};
+use quasar_rs::atomic_update::{AtomicUpdater, CasConfig};
+use quasar_rs::auto_tuner::{AutoTuner, AutoTunerConfig};
+use quasar_rs::async_client::{AsyncClient, AsyncConfig, OpFuture};
+use quasar_rs::blob_cache::{BlobCache, BlobCacheConfig};
+use quasar_rs::batch::{Batch, EntryValue};
+use quasar_rs::blob_stream::ChunkedConfig;
+use quasar_rs::continuous_query::{ContinuousQueryConfig, Delta};
+use quasar_rs::bulk_tag::{BulkTagConfig, BulkTagger, TagAction};
+use quasar_rs::counter_aggregator::{CounterAggregator, CounterConfig};
+use quasar_rs::fake_api::{self, FakeConfig};
+use quasar_rs::entry::ts_batch::{Deduplicate, PushMode, TsBatchTable};
+use quasar_rs::error::ErrorType;
+use quasar_rs::expiry::{self, Expiry, ExpirySweeper, SweepConfig, SweepRule};
+use quasar_rs::loadgen::{self, Op};
+use quasar_rs::memory_governor::{parse_memory_info, MemoryGovernor, MemoryGovernorConfig};
+use quasar_rs::log_sink::{self, LogSinkConfig, LOG_MESSAGE_CAPACITY};
+use quasar_rs::query_cache::{QueryCache, QueryCacheConfig};
+use quasar_rs::query_splitter::{Aggregate, Merge, SlicedQuery};
+use quasar_rs::tag_index::{RefreshStats, TagIndex, TagIndexConfig, TagQuery};
+use quasar_rs::{handle, handle_pool, qdb_attach_tag, qdb_blob_get, qdb_blob_put, qdb_connect, qdb_detach_tag, qdb_handle_t, qdb_open,
+                qdb_error_t_qdb_e_timeout, qdb_protocol_t_qdb_p_tcp, qdb_release, qdb_ts_column_info_t, qdb_ts_column_type_t_qdb_ts_column_double, qdb_ts_column_type_t_qdb_ts_column_int64,
+                qdb_ts_create, qdb_ts_double_insert, qdb_ts_double_point, query};
+
+// The fake cluster and its configuration are process wide.
+static SERIAL: Mutex<()> = Mutex::new(());
+
+fn raw_handle() -> qdb_handle_t {
+    let uri = CString::new("qdb://127.0.0.1:2836").unwrap();
+    let mut h: qdb_handle_t = ptr::null_mut();
+    unsafe {
+        assert_eq!(qdb_open(&mut h, qdb_protocol_t_qdb_p_tcp), 0);
+        assert_eq!(qdb_connect(h, uri.as_ptr()), 0);
+    }
+    h
+}
+
+#[test]
+fn test_fake_query_reads_inserted_points() {
+    let _serial = SERIAL.lock().unwrap_or_else(|e| e.into_inner());
+    let h = raw_handle();
+
+    let alias = CString::new("fake_api_tests.query").unwrap();
+    let column = CString::new("price").unwrap();
+    let info = qdb_ts_column_info_t { name: column.as_ptr(), type_: qdb_ts_column_type_t_qdb_ts_column_double };
+    let points: Vec<qdb_ts_double_point> = (0..10)
+        .map(|i| qdb_ts_double_point { timestamp: query::nanos_to_timespec(1_609_459_200_000_000_000 + i * 1_000_000_000), value: i as f64 })
+        .collect();
+    unsafe {
+        assert_eq!(qdb_ts_create(h, alias.as_ptr(), 86_400_000, &info, 1), 0);
+        assert_eq!(qdb_ts_double_insert(h, alias.as_ptr(), column.as_ptr(), points.as_ptr(), points.len()), 0);
+    }
+
+    let handle = handle::setup_handle("qdb://127.0.0.1:2836", 1000).unwrap();
+    let result = handle.query("select price from \"fake_api_tests.query\" in range(2021-01-01T00:00:05, +1h)").unwrap();
+
+    assert_eq!(result.column_names(), vec!["$timestamp", "price"]);
+    assert_eq!(result.row_count(), 5);
+}
+
+#[test]
+fn test_fake_prefix_count() {
+    let _serial = SERIAL.lock().unwrap_or_else(|e| e.into_inner());
+    let h = raw_handle();
+
+    let column = CString::new("v").unwrap();
+    let info = qdb_ts_column_info_t { name: column.as_ptr(), type_: qdb_ts_column_type_t_qdb_ts_column_double };
+    for i in 0..3 {
+        let alias = CString::new(format!("fake_api_tests.prefix.{}", i)).unwrap();
+        unsafe { assert_eq!(qdb_ts_create(h, alias.as_ptr(), 86_400_000, &info, 1), 0) };
+    }
+
+    let handle = handle::setup_handle("qdb://127.0.0.1:2836", 1000).unwrap();
+    assert_eq!(handle.prefix_count("fake_api_tests.prefix.").unwrap(), 3);
+}
+
+#[test]
+fn test_fake_error_injection() {
+    let _serial = SERIAL.lock().unwrap_or_else(|e| e.into_inner());
+    let handle = handle::setup_handle("qdb://127.0.0.1:2836", 1000).unwrap();
+
+    fake_api::configure(FakeConfig { error_rate: 1.0, ..FakeConfig::default() });
+    let err = handle.prefix_count("fake_api_tests.");
+    fake_api::configure(FakeConfig::default());
+
+    assert_eq!(err.unwrap_err(), ErrorType::ErrTryAgain);
+    assert!(fake_api::stats().injected_errors > 0);
+}
+
+#[test]
+fn test_fake_loadgen_run() {
+    let _serial = SERIAL.lock().unwrap_or_else(|e| e.into_inner());
+    let spec = loadgen::parse_workload(r#"{
+        "rate": 2000, "duration_ms": 200, "workers": 4,
+        "keys": { "count": 100, "prefix": "fake_api_tests.loadgen.", "distribution": { "zipfian": 0.9 } },
+        "mix": { "blob_get": 8, "blob_put": 1, "ts_insert": 1, "query": 1 },
+        "ts": { "table": "fake_api_tests.loadgen", "columns": 2, "rows_per_insert": 10 },
+        "queries": ["select * from \"{table}\" in range({now-1min}, {now})"]
+    }"#).unwrap();
+    let pool = handle_pool::new_handle_pool("qdb://127.0.0.1:2836", 1000, 4).unwrap();
+
+    loadgen::preload(&pool, &spec).unwrap();
+    let report = loadgen::run_workload(&pool, &spec);
+
+    let total: u64 = report.ops.iter().map(|r| r.count).sum();
+    assert_eq!(total, 400);
+    assert!(report.ops.iter().all(|r| r.errors == 0));
+    assert!(report.throughput(Op::BlobGet) > 0.0);
+}
+
+#[test]
+fn test_fake_prefix_get_list_releases_buffer() {
+    let _serial = SERIAL.lock().unwrap_or_else(|e| e.into_inner());
+    let h = raw_handle();
+
+    let column = CString::new("v").unwrap();
+    let info = qdb_ts_column_info_t { name: column.as_ptr(), type_: qdb_ts_column_type_t_qdb_ts_column_double };
+    for i in 0..3 {
+        let alias = CString::new(format!("fake_api_tests.list.{}", i)).unwrap();
+        unsafe { assert_eq!(qdb_ts_create(h, alias.as_ptr(), 86_400_000, &info, 1), 0) };
+    }
+
+    let handle = handle::setup_handle("qdb://127.0.0.1:2836", 1000).unwrap();
+    let live = fake_api::stats().live_allocations;
+    {
+        let list = handle.prefix_get_list("fake_api_tests.list.", 10).unwrap();
+        assert_eq!(list.iter().collect::<Vec<&str>>(), vec!["fake_api_tests.list.0", "fake_api_tests.list.1", "fake_api_tests.list.2"]);
+        assert!(list.contains("fake_api_tests.list.1"));
+        assert_eq!(fake_api::stats().live_allocations, live + 1);
+    }
+    assert_eq!(fake_api::stats().live_allocations, live);
+
+    assert_eq!(handle.prefix_get("fake_api_tests.list.", 2).unwrap().len(), 2);
+    assert_eq!(fake_api::stats().live_allocations, live);
+}
+
+fn create_table(h: qdb_handle_t, alias: &str) {
+    let alias = CString::new(alias).unwrap();
+    let names = [CString::new("price").unwrap(), CString::new("volume").unwrap()];
+    let info = [
+        qdb_ts_column_info_t { name: names[0].as_ptr(), type_: qdb_ts_column_type_t_qdb_ts_column_double },
+        qdb_ts_column_info_t { name: names[1].as_ptr(), type_: qdb_ts_column_type_t_qdb_ts_column_int64 },
+    ];
+    unsafe { assert_eq!(qdb_ts_create(h, alias.as_ptr(), 86_400_000, info.as_ptr(), info.len()), 0) };
+}
+
+#[test]
+fn test_fake_ts_batch_push() {
+    let _serial = SERIAL.lock().unwrap_or_else(|e| e.into_inner());
+    create_table(raw_handle(), "fake_api_tests.batch");
+    let handle = handle::setup_handle("qdb://127.0.0.1:2836", 1000).unwrap();
+
+    let t0 = 1_609_459_200_000_000_000i64;
+    let timestamps: Vec<i64> = (0..5).map(|i| t0 + i * 1_000_000_000).collect();
+    let prices = [1.0, 2.0, 3.0, 4.0, 5.0];
+    let volumes = [1, 2, 3, 4, 5];
+
+    let table = TsBatchTable::from_nanos("fake_api_tests.batch", &timestamps)
+        .double_column("price", &prices).unwrap()
+        .int64_column("volume", &volumes).unwrap();
+    assert_eq!(handle.ts_batch_push(PushMode::Transactional, &[table.clone()]), None);
+
+    // pushing the same rows again only adds rows without deduplication
+    let unique = table.clone().deduplicate(Deduplicate::Drop(vec![]));
+    assert_eq!(handle.ts_batch_push(PushMode::Fast, &[unique]), None);
+    let q = "select price from \"fake_api_tests.batch\"";
+    assert_eq!(handle.query(q).unwrap().row_count(), 5);
+
+    assert_eq!(handle.ts_batch_push(PushMode::Fast, &[table]), None);
+    assert_eq!(handle.query(q).unwrap().row_count(), 10);
+
+    // truncate replaces the range
+    let last = [t0 + 4_000_000_000];
+    let table = TsBatchTable::from_nanos("fake_api_tests.batch", &last)
+        .double_column("price", &[42.0]).unwrap()
+        .truncate(t0, t0 + 10_000_000_000);
+    assert_eq!(handle.ts_batch_push(PushMode::Truncate, &[table]), None);
+    assert_eq!(handle.query(q).unwrap().row_count(), 1);
+
+    let missing = TsBatchTable::from_nanos("fake_api_tests.batch", &last).double_column("nope", &[1.0]).unwrap();
+    assert_eq!(handle.ts_batch_push(PushMode::Fast, &[missing]), Some(ErrorType::ErrColumnNotFound));
+}
+
+#[test]
+fn test_fake_ts_view_reads_in_place() {
+    let _serial = SERIAL.lock().unwrap_or_else(|e| e.into_inner());
+    create_table(raw_handle(), "fake_api_tests.view");
+    let handle = handle::setup_handle("qdb://127.0.0.1:2836", 1000).unwrap();
+
+    let t0 = 1_609_459_200_000_000_000i64;
+    let timestamps: Vec<i64> = (0..10).map(|i| t0 + i * 1_000_000_000).collect();
+    let prices: Vec<f64> = (0..10).map(|i| i as f64).collect();
+    let volumes: Vec<i64> = (0..10).collect();
+    let table = TsBatchTable::from_nanos("fake_api_tests.view", &timestamps)
+        .double_column("price", &prices).unwrap()
+        .int64_column("volume", &volumes).unwrap();
+    assert_eq!(handle.ts_batch_push(PushMode::Transactional, &[table]), None);
+
+    let live = fake_api::stats().live_allocations;
+    let ranges = [(t0, t0 + 3_000_000_000), (t0 + 8_000_000_000, t0 + 20_000_000_000)];
+    {
+        let view = handle.ts_double_get_ranges("fake_api_tests.view", "price", &ranges).unwrap();
+        assert_eq!(view.len(), 5);
+        assert_eq!(view.values().collect::<Vec<f64>>(), vec![0.0, 1.0, 2.0, 8.0, 9.0]);
+        assert_eq!(view.timestamps().last(), Some(t0 + 9_000_000_000));
+        assert_eq!(fake_api::stats().live_allocations, live + 1);
+
+        let volumes = handle.ts_int64_get_ranges("fake_api_tests.view", "volume", &ranges).unwrap();
+        assert_eq!(volumes.values().sum::<i64>(), 20);
+    }
+    assert_eq!(fake_api::stats().live_allocations, live);
+
+    assert_eq!(handle.ts_double_get_ranges("fake_api_tests.view", "volume", &ranges).unwrap_err(), ErrorType::ErrIncompatibleType);
+
+    // the vector grows on the first read and is reused after
+    let mut points: Vec<qdb_ts_double_point> = Vec::new();
+    assert_eq!(handle.ts_get_ranges_into("fake_api_tests.view", "price", &ranges, &mut points), None);
+    assert_eq!(points.iter().map(|p| p.value).collect::<Vec<f64>>(), vec![0.0, 1.0, 2.0, 8.0, 9.0]);
+    let capacity = points.capacity();
+    assert_eq!(handle.ts_get_ranges_into("fake_api_tests.view", "price", &ranges[..1], &mut points), None);
+    assert_eq!(points.len(), 3);
+    assert_eq!(points.capacity(), capacity);
+    assert_eq!(fake_api::stats().live_allocations, live);
+}
+
+struct Unpark(thread::Thread);
+
+impl Wake for Unpark {
+    fn wake(self: Arc<Self>) {
+        self.0.unpark();
+    }
+}
+
+// Wakes the executor and marks the future to poll again.
+struct Flag {
+    woken: AtomicBool,
+    thread: thread::Thread,
+}
+
+impl Wake for Flag {
+    fn wake(self: Arc<Self>) {
+        self.woken.store(true, Ordering::Release);
+        self.thread.unpark();
+    }
+}
+
+// A minimal executor: polls a future only once its waker was called, as real executors do,
+// and fails instead of hanging when a wake up is lost.
+fn wait_all<T>(mut futures: Vec<OpFuture<T>>) -> Vec<Result<T, ErrorType>> {
+    let flags: Vec<Arc<Flag>> = futures.iter()
+        .map(|_| Arc::new(Flag { woken: AtomicBool::new(true), thread: thread::current() }))
+        .collect();
+    let wakers: Vec<Waker> = flags.iter().map(|f| Waker::from(Arc::clone(f))).collect();
+    let mut results: Vec<Option<Result<T, ErrorType>>> = futures.iter().map(|_| None).collect();
+
+    while results.iter().any(|r| r.is_none()) {
+        let mut polled = false;
+        for i in 0..futures.len() {
+            if results[i].is_none() && flags[i].woken.swap(false, Ordering::AcqRel) {
+                polled = true;
+                if let Poll::Ready(v) = Pin::new(&mut futures[i]).poll(&mut Context::from_waker(&wakers[i])) {
+                    results[i] = Some(v);
+                }
+            }
+        }
+        if !polled {
+            let parked = Instant::now();
+            thread::park_timeout(Duration::from_secs(5));
+            assert!(parked.elapsed() < Duration::from_secs(5) || flags.iter().any(|f| f.woken.load(Ordering::Acquire)),
+                    "a future was never woken");
+        }
+    }
+    results.into_iter().map(|r| r.unwrap()).collect()
+}
+
+#[test]
+fn test_fake_async_client() {
+    let _serial = SERIAL.lock().unwrap_or_else(|e| e.into_inner());
+    let pool = handle_pool::new_handle_pool("qdb://127.0.0.1:2836", 1000, 2).unwrap();
+    // queues much smaller than the number of futures, most of them wait for a slot
+    let client = AsyncClient::new(pool, AsyncConfig { queue_capacity: 1, workers_per_handle: 1 });
+
+    let puts = (0..200).map(|i| client.blob_update(format!("fake_api_tests.async.{}", i), vec![i as u8; 16], 0)).collect();
+    assert!(wait_all(puts).iter().all(|r| r.is_ok()));
+
+    let gets = (0..200).map(|i| client.blob_get(format!("fake_api_tests.async.{}", i))).collect();
+    for (i, content) in wait_all(gets).into_iter().enumerate() {
+        assert_eq!(content.unwrap(), vec![i as u8; 16]);
+    }
+
+    let missing = wait_all(vec![client.blob_get("fake_api_tests.async.missing")]);
+    assert_eq!(missing[0].as_ref().unwrap_err(), &ErrorType::ErrAliasNotFound);
+
+    assert_eq!(wait_all(vec![client.int_put("fake_api_tests.async.counter", 1, 0)])[0], Ok(()));
+    let adds = (0..10).map(|_| client.int_add("fake_api_tests.async.counter", 2)).collect();
+    assert!(wait_all(adds).iter().all(|r| r.is_ok()));
+    assert_eq!(wait_all(vec![client.int_get("fake_api_tests.async.counter")])[0], Ok(21));
+
+    let stats = client.stats();
+    assert_eq!(stats.submitted, stats.completed);
+    assert_eq!(stats.queued, 0);
+}
+
+#[test]
+fn test_fake_async_client_cancellation() {
+    let _serial = SERIAL.lock().unwrap_or_else(|e| e.into_inner());
+    let pool = handle_pool::new_handle_pool("qdb://127.0.0.1:2836", 1000, 1).unwrap();
+    let client = AsyncClient::new(pool, AsyncConfig { queue_capacity: 64, workers_per_handle: 1 });
+
+    fake_api::configure(FakeConfig { latency: Duration::from_millis(5), ..FakeConfig::default() });
+    let waker = Arc::new(Unpark(thread::current())).into();
+    let mut cx = Context::from_waker(&waker);
+    let mut futures: Vec<_> = (0..20).map(|i| client.int_update(format!("fake_api_tests.cancel.{}", i), i, 0)).collect();
+    for f in futures.iter_mut() {
+        assert!(Pin::new(f).poll(&mut cx).is_pending());
+    }
+    // the calls still queued are skipped by the worker
+    futures.truncate(1);
+    assert!(wait_all(futures)[0].is_ok());
+    fake_api::configure(FakeConfig::default());
+
+    let mut stats = client.stats();
+    for _ in 0..1000 {
+        if stats.completed + stats.cancelled == 20 {
+            break;
+        }
+        thread::sleep(Duration::from_millis(1));
+        stats = client.stats();
+    }
+    assert_eq!(stats.submitted, 20);
+    assert_eq!(stats.completed + stats.cancelled, 20);
+    assert!(stats.cancelled > 0);
+}
+
+#[test]
+fn test_fake_blob_cache() {
+    let _serial = SERIAL.lock().unwrap_or_else(|e| e.into_inner());
+    let handle = handle::setup_handle("qdb://127.0.0.1:2836", 1000).unwrap();
+    let cache = BlobCache::new(BlobCacheConfig::default());
+    let alias = "fake_api_tests.cache.a";
+
+    assert_eq!(cache.update(&handle, alias, b"one", 0), None);
+    assert_eq!(&*cache.get(&handle, alias).unwrap(), b"one");
+    let sent = fake_api::stats().calls;
+    assert_eq!(&*cache.get(&handle, alias).unwrap(), b"one");
+    assert_eq!(fake_api::stats().calls, sent);
+
+    // changes made through the cache are seen at once
+    assert_eq!(cache.update(&handle, alias, b"two", 0), None);
+    assert_eq!(&*cache.get(&handle, alias).unwrap(), b"two");
+    assert_eq!(cache.compare_and_swap(&handle, alias, b"three", b"two", 0), Ok(None));
+    assert_eq!(&*cache.get(&handle, alias).unwrap(), b"three");
+    assert_eq!(cache.remove(&handle, alias), None);
+    assert_eq!(cache.get(&handle, alias).unwrap_err(), ErrorType::ErrAliasNotFound);
+
+    // an expired blob is never served
+    let expiry = std::time::SystemTime::now().duration_since(std::time::UNIX_EPOCH).unwrap().as_millis() as i64 + 50;
+    assert_eq!(handle.blob_update("fake_api_tests.cache.b", b"short", expiry), None);
+    assert_eq!(&*cache.get(&handle, "fake_api_tests.cache.b").unwrap(), b"short");
+    thread::sleep(Duration::from_millis(60));
+    assert_eq!(cache.get(&handle, "fake_api_tests.cache.b").unwrap_err(), ErrorType::ErrAliasNotFound);
+
+    let metrics = cache.metrics();
+    assert_eq!(metrics.hits, 1);
+    assert_eq!(metrics.expirations, 1);
+    assert_eq!(metrics.invalidations, 3);
+}
+
+#[test]
+fn test_fake_blob_cache_revalidates() {
+    let _serial = SERIAL.lock().unwrap_or_else(|e| e.into_inner());
+    let handle = handle::setup_handle("qdb://127.0.0.1:2836", 1000).unwrap();
+    let cache = BlobCache::new(BlobCacheConfig { ttl: Duration::ZERO, revalidate: true, ..BlobCacheConfig::default() });
+    let alias = "fake_api_tests.cache.revalidate";
+
+    assert_eq!(handle.blob_update(alias, b"one", 0), None);
+    assert_eq!(&*cache.get(&handle, alias).unwrap(), b"one");
+    assert_eq!(&*cache.get(&handle, alias).unwrap(), b"one");
+    assert_eq!(cache.metrics().revalidated, 1);
+
+    // changed behind the cache back
+    assert_eq!(handle.blob_update(alias, b"two", 0), None);
+    assert_eq!(&*cache.get(&handle, alias).unwrap(), b"two");
+    assert_eq!(cache.metrics().revalidated, 1);
+}
+
+#[test]
+fn test_fake_blob_cache_admission() {
+    let _serial = SERIAL.lock().unwrap_or_else(|e| e.into_inner());
+    let handle = handle::setup_handle("qdb://127.0.0.1:2836", 1000).unwrap();
+    // room for four blobs
+    let cache = BlobCache::new(BlobCacheConfig { shards: 1, max_bytes: 4 * 100, ..BlobCacheConfig::default() });
+
+    for i in 0..20 {
+        assert_eq!(handle.blob_update(&format!("fake_api_tests.cache.hot.{}", i), &[0; 100], 0), None);
+    }
+    for _ in 0..5 {
+        for i in 0..4 {
+            cache.get(&handle, &format!("fake_api_tests.cache.hot.{}", i)).unwrap();
+        }
+    }
+    // a scan of blobs requested once does not evict the hot ones
+    for i in 4..20 {
+        cache.get(&handle, &format!("fake_api_tests.cache.hot.{}", i)).unwrap();
+    }
+    let hits = cache.metrics().hits;
+    for i in 0..4 {
+        cache.get(&handle, &format!("fake_api_tests.cache.hot.{}", i)).unwrap();
+    }
+
+    let metrics = cache.metrics();
+    assert_eq!(metrics.hits, hits + 4);
+    assert_eq!(metrics.rejected, 16);
+    assert_eq!(metrics.entries, 4);
+}
+
+#[test]
+fn test_fake_blob_cache_admission_all_or_none() {
+    let _serial = SERIAL.lock().unwrap_or_else(|e| e.into_inner());
+    let handle = handle::setup_handle("qdb://127.0.0.1:2836", 1000).unwrap();
+    let cache = BlobCache::new(BlobCacheConfig { shards: 1, max_bytes: 4 * 100, ..BlobCacheConfig::default() });
+    let alias = |name: &str| format!("fake_api_tests.cache.all_or_none.{}", name);
+
+    for name in ["cold", "hot.0", "hot.1", "hot.2"] {
+        assert_eq!(handle.blob_update(&alias(name), &[0; 100], 0), None);
+        cache.get(&handle, &alias(name)).unwrap();
+    }
+    for _ in 0..5 {
+        for name in ["hot.0", "hot.1", "hot.2"] {
+            cache.get(&handle, &alias(name)).unwrap();
+        }
+    }
+
+    // the candidate needs two victims: requested more than the cold blob, less than the hot one after it
+    assert_eq!(handle.blob_update(&alias("large"), &[0; 200], 0), None);
+    for _ in 0..3 {
+        cache.get(&handle, &alias("large")).unwrap();
+    }
+
+    // rejected without evicting the cold blob on the way
+    let metrics = cache.metrics();
+    assert_eq!((metrics.rejected, metrics.evictions, metrics.entries), (3, 0, 4));
+    let hits = metrics.hits;
+    cache.get(&handle, &alias("cold")).unwrap();
+    assert_eq!(cache.metrics().hits, hits + 1);
+}
+
+#[test]
+fn test_fake_blob_stream() {
+    let _serial = SERIAL.lock().unwrap_or_else(|e| e.into_inner());
+    let handle = handle::setup_handle("qdb://127.0.0.1:2836", 1000).unwrap();
+    let alias = "fake_api_tests.stream";
+    let config = ChunkedConfig { chunk_size: 100, batch_chunks: 3, expiry: 0 };
+    let content: Vec<u8> = (0..1050u32).map(|i| (i % 251) as u8).collect();
+
+    let live = fake_api::stats().live_allocations;
+    let mut writer = handle.blob_stream_writer(alias, config).unwrap();
+    for part in content.chunks(77) {
+        writer.write_all(part).unwrap();
+    }
+    assert_eq!(writer.finish().unwrap(), 1050);
+    let manifest = handle.blob_stream_manifest(alias).unwrap();
+    assert_eq!(manifest.chunk_count, 11);
+
+    let mut read = Vec::new();
+    handle.blob_stream_reader(alias, 4).unwrap().read_to_end(&mut read).unwrap();
+    assert_eq!(read, content);
+
+    let mut chunks = Vec::new();
+    assert_eq!(handle.blob_stream_for_each(alias, 2, |chunk| chunks.extend_from_slice(chunk)).unwrap(), 1050);
+    assert_eq!(chunks, content);
+    assert_eq!(fake_api::stats().live_allocations, live);
+
+    // a rewrite removes the chunks of the previous generation
+    let mut writer = handle.blob_stream_writer(alias, config).unwrap();
+    writer.write_all(b"short").unwrap();
+    writer.finish().unwrap();
+    assert_eq!(handle.prefix_count("fake_api_tests.stream.chunk.").unwrap(), 1);
+
+    // an unfinished writer leaves nothing behind
+    let mut writer = handle.blob_stream_writer(alias, config).unwrap();
+    writer.write_all(&content).unwrap();
+    drop(writer);
+    assert_eq!(handle.prefix_count("fake_api_tests.stream.chunk.").unwrap(), 1);
+
+    assert_eq!(handle.blob_stream_remove(alias), None);
+    assert_eq!(handle.prefix_count("fake_api_tests.stream").unwrap(), 0);
+    assert_eq!(handle.blob_stream_manifest(alias).err(), Some(ErrorType::ErrAliasNotFound));
+
+    // an empty manifest of a known generation, so that the chunks of the next writer can be found in advance
+    let generation: u64 = 1 << 62;
+    let mut empty = b"QDBCHNK1".to_vec();
+    empty.extend_from_slice(&0u64.to_le_bytes());
+    empty.extend_from_slice(&1u32.to_le_bytes());
+    empty.extend_from_slice(&0u32.to_le_bytes());
+    empty.extend_from_slice(&generation.to_le_bytes());
+    assert_eq!(handle.blob_update(alias, &empty, 0), None);
+    let chunks = format!("fake_api_tests.stream.chunk.{:x}.", generation + 1);
+    assert_eq!(handle.int_put(&format!("{}1", chunks), 0, 0), None);
+
+    // a batch that fails part way removes the chunks it wrote, not the entry in the way
+    let mut writer = handle.blob_stream_writer(alias, config).unwrap();
+    writer.write_all(&content[..250]).unwrap();
+    assert!(writer.flush().is_err());
+    assert_eq!(handle.prefix_count(&chunks).unwrap(), 1);
+    assert_eq!(writer.written(), 250);
+    drop(writer);
+    assert_eq!(handle.int_get(&format!("{}1", chunks)), Ok(0));
+    assert_eq!(handle.remove(&format!("{}1", chunks)), None);
+    assert_eq!(handle.remove(alias), None);
+}
+
+#[test]
+fn test_fake_counter_aggregator() {
+    let _serial = SERIAL.lock().unwrap_or_else(|e| e.into_inner());
+    let handle = handle::setup_handle("qdb://127.0.0.1:2836", 1000).unwrap();
+    let pool = handle_pool::new_handle_pool("qdb://127.0.0.1:2836", 1000, 1).unwrap();
+    // only explicit flushes and the one on drop
+    let counters = CounterAggregator::new(pool, CounterConfig { flush_interval: Duration::from_secs(3600), ..CounterConfig::default() });
+    assert_eq!(handle.int_put("fake_api_tests.counters.existing", 10, 0), None);
+
+    thread::scope(|scope| {
+        let threads: Vec<_> = (0..4)
+            .map(|_| scope.spawn(|| {
+                for i in 0..1000 {
+                    counters.add("fake_api_tests.counters.existing", 1);
+                    counters.add(&format!("fake_api_tests.counters.{}", i % 2), 2);
+                }
+            }))
+            .collect();
+        // joined explicitly, the end of the scope does not wait for the thread locals to be dropped
+        threads.into_iter().for_each(|t| t.join().unwrap());
+    });
+    let calls = fake_api::stats().calls;
+    assert_eq!(counters.flush(), None);
+    assert_eq!(fake_api::stats().calls - calls, 2);
+
+    assert_eq!(handle.int_get("fake_api_tests.counters.existing"), Ok(4010));
+    assert_eq!(handle.int_get("fake_api_tests.counters.0"), Ok(4000));
+    assert_eq!(handle.int_get("fake_api_tests.counters.1"), Ok(4000));
+    // the threads exited before the flush, their increments are kept but not their deltas maps
+    let stats = counters.stats();
+    assert_eq!((stats.increments, stats.threads), (8000, 0));
+    assert_eq!((stats.operations, stats.created, stats.failed), (5, 2, 0));
+
+    // asked to try again, nothing was applied: the delta is sent again by the next flush
+    fake_api::configure(FakeConfig { error_rate: 1.0, ..FakeConfig::default() });
+    counters.add("fake_api_tests.counters.1", 5);
+    assert_eq!(counters.flush(), Some(ErrorType::ErrTryAgain));
+    fake_api::configure(FakeConfig::default());
+    assert_eq!(counters.flush(), None);
+    assert_eq!(handle.int_get("fake_api_tests.counters.1"), Ok(4005));
+
+    // a timeout may come after the addition was applied: the delta is dropped rather than possibly counted twice
+    fake_api::configure(FakeConfig { error_rate: 1.0, error: qdb_error_t_qdb_e_timeout, ..FakeConfig::default() });
+    counters.add("fake_api_tests.counters.1", 5);
+    assert_eq!(counters.flush(), Some(ErrorType::ErrTimeout));
+    fake_api::configure(FakeConfig::default());
+    let calls = fake_api::stats().calls;
+    assert_eq!(counters.flush(), None);
+    assert_eq!(fake_api::stats().calls, calls);
+    assert_eq!(handle.int_get("fake_api_tests.counters.1"), Ok(4005));
+    let stats = counters.stats();
+    assert_eq!((stats.increments, stats.threads, stats.failed), (8002, 1, 2));
+
+    // double counters are created with a double_put then added to with double_add
+    let read_double = |alias: &str| {
+        let mut batch = Batch::new();
+        let i = batch.double_get(alias).unwrap();
+        let value = batch.run(&handle).double(i);
+        value
+    };
+    counters.add_double("fake_api_tests.counters.ratio", 0.25);
+    counters.add_double("fake_api_tests.counters.ratio", 0.5);
+    assert_eq!(counters.flush(), None);
+    assert_eq!(read_double("fake_api_tests.counters.ratio"), Ok(0.75));
+    counters.add_double("fake_api_tests.counters.ratio", -1.5);
+    assert_eq!(counters.flush(), None);
+    assert_eq!(read_double("fake_api_tests.counters.ratio"), Ok(-0.75));
+    let stats = counters.stats();
+    assert_eq!((stats.operations, stats.created, stats.failed), (11, 3, 2));
+
+    counters.add("fake_api_tests.counters.0", -1000);
+    drop(counters);
+    assert_eq!(handle.int_get("fake_api_tests.counters.0"), Ok(3000));
+}
+
+#[test]
+fn test_fake_atomic_update() {
+    let _serial = SERIAL.lock().unwrap_or_else(|e| e.into_inner());
+    let handle = handle::setup_handle("qdb://127.0.0.1:2836", 1000).unwrap();
+    let alias = "fake_api_tests.atomic.versioned";
+    // a u64 version then a u64 counter
+    let updater = AtomicUpdater::new(CasConfig { version_offset: Some(0), ..CasConfig::default() });
+    let increment = |current: Option<&[u8]>| {
+        let count = current.map_or(0, |c| u64::from_le_bytes(c[8..16].try_into().unwrap()));
+        let mut content = vec![0u8; 16];
+        content[8..16].copy_from_slice(&(count + 1).to_le_bytes());
+        Some(content)
+    };
+
+    thread::scope(|scope| {
+        for _ in 0..4 {
+            scope.spawn(|| {
+                for _ in 0..50 {
+                    updater.update(&handle, alias, increment).unwrap();
+                }
+            });
+        }
+    });
+    let content = handle.blob_get(alias).unwrap();
+    assert_eq!(u64::from_le_bytes(content[0..8].try_into().unwrap()), 200);
+    assert_eq!(u64::from_le_bytes(content[8..16].try_into().unwrap()), 200);
+    assert_eq!(updater.stats().updates, 200);
+
+    // the whole content is compared without a version
+    assert_eq!(handle.atomic_update("fake_api_tests.atomic.plain", |c| Some([c.unwrap_or(b""), b"+"].concat())), Ok(b"+".to_vec()));
+    assert_eq!(handle.atomic_update("fake_api_tests.atomic.plain", |c| Some([c.unwrap_or(b""), b"+"].concat())), Ok(b"++".to_vec()));
+    assert_eq!(handle.atomic_update("fake_api_tests.atomic.plain", |_| None), Ok(b"++".to_vec()));
+
+    // a writer sneaking in before every swap exhausts the attempts
+    let updater = AtomicUpdater::new(CasConfig { max_attempts: 3, version_offset: Some(0), ..CasConfig::default() });
+    let mut sneaked = 0u64;
+    let result = updater.update(&handle, alias, |current| {
+        sneaked += 1;
+        let mut other = current.unwrap().to_vec();
+        other[0..8].copy_from_slice(&(1000 + sneaked).to_le_bytes());
+        assert_eq!(handle.blob_update(alias, &other, 0), None);
+        Some(vec![0u8; 16])
+    });
+    assert_eq!(result, Err(ErrorType::ErrConflict));
+    let stats = updater.stats();
+    assert_eq!((stats.conflicts, stats.exhausted, stats.max_attempts), (3, 1, 3));
+}
+
+#[test]
+fn test_fake_multi_get() {
+    let _serial = SERIAL.lock().unwrap_or_else(|e| e.into_inner());
+    let handle = handle::setup_handle("qdb://127.0.0.1:2836", 1000).unwrap();
+    let aliases: Vec<String> = (0..2500).map(|i| format!("fake_api_tests.multi.{}", i)).collect();
+    let mut doubles = Batch::new();
+    for (i, alias) in aliases.iter().enumerate() {
+        match i % 4 {
+            0 => assert_eq!(handle.blob_update(alias, format!("blob {}", i).as_bytes(), 0), None),
+            1 => assert_eq!(handle.int_update(alias, i as i64, 0), None),
+            2 => {
+                doubles.double_update(alias, i as f64 / 4.0, 0).unwrap();
+            }
+            _ => {}
+        }
+    }
+    assert_eq!(doubles.run(&handle).succeeded(), 625);
+
+    let live = fake_api::stats().live_allocations;
+    let calls = fake_api::stats().calls;
+    let table = handle.multi_get(&aliases).unwrap();
+    assert_eq!(fake_api::stats().calls - calls, 3);
+    assert_eq!(fake_api::stats().live_allocations, live);
+
+    assert_eq!(table.len(), 2500);
+    assert_eq!(table.found(), 1875);
+    for i in 0..2500 {
+        match i % 4 {
+            0 => assert_eq!(table.get(i), Ok(EntryValue::Blob(format!("blob {}", i).as_bytes()))),
+            1 => assert_eq!(table.get(i), Ok(EntryValue::Integer(i as i64))),
+            2 => assert_eq!(table.get(i), Ok(EntryValue::Double(i as f64 / 4.0))),
+            _ => assert_eq!(table.get(i), Err(ErrorType::ErrAliasNotFound)),
+        }
+    }
+}
+
+#[test]
+fn test_fake_bulk_expire() {
+    let _serial = SERIAL.lock().unwrap_or_else(|e| e.into_inner());
+    let handle = handle::setup_handle("qdb://127.0.0.1:2836", 1000).unwrap();
+    let pool = handle_pool::new_handle_pool("qdb://127.0.0.1:2836", 1000, 3).unwrap();
+    let mut aliases: Vec<String> = (0..10).map(|i| format!("fake_api_tests.expire.{}", i)).collect();
+    for alias in &aliases {
+        assert_eq!(handle.blob_update(alias, b"x", 0), None);
+    }
+    aliases.push("fake_api_tests.expire.missing".to_string());
+
+    let at = 4_102_444_800_000; // 2100-01-01
+    let result = expiry::bulk_expire(&pool, &aliases, Expiry::At(at));
+    assert_eq!(result.updated, 10);
+    assert_eq!(result.failed, vec![(10, ErrorType::ErrAliasNotFound)]);
+    assert_eq!(handle.get_expiry_time("fake_api_tests.expire.7"), Ok(at));
+
+    let result = expiry::bulk_expire_prefix(&pool, "fake_api_tests.expire.", 100, Expiry::Never).unwrap();
+    assert_eq!((result.updated, result.failed.len()), (10, 0));
+    assert_eq!(handle.get_expiry_time("fake_api_tests.expire.7"), Ok(0));
+}
+
+#[test]
+fn test_fake_expiry_sweeper() {
+    let _serial = SERIAL.lock().unwrap_or_else(|e| e.into_inner());
+    create_table(raw_handle(), "fake_api_tests.sweep");
+    let handle = handle::setup_handle("qdb://127.0.0.1:2836", 1000).unwrap();
+
+    // ten points two hours old, ten points from now on
+    let now = std::time::SystemTime::now().duration_since(std::time::UNIX_EPOCH).unwrap().as_nanos() as i64;
+    let timestamps: Vec<i64> = (0..20).map(|i| if i < 10 { now - 7_200_000_000_000 + i } else { now + i }).collect();
+    let prices: Vec<f64> = (0..20).map(|i| i as f64).collect();
+    let volumes: Vec<i64> = (0..20).collect();
+    let table = TsBatchTable::from_nanos("fake_api_tests.sweep", &timestamps)
+        .double_column("price", &prices).unwrap()
+        .int64_column("volume", &volumes).unwrap();
+    assert_eq!(handle.ts_batch_push(PushMode::Transactional, &[table]), None);
+
+    const HOUR: i64 = 3_600_000_000_000;
+    let pool = handle_pool::new_handle_pool("qdb://127.0.0.1:2836", 1000, 1).unwrap();
+    let columns = vec!["price".to_string(), "volume".to_string()];
+    let rules = vec![
+        SweepRule::Retention { table: "fake_api_tests.sweep".into(), columns: columns.clone(), keep: Duration::from_secs(3600) },
+        SweepRule::Size { table: "fake_api_tests.sweep".into(), bytes: 15 * 16 },
+    ];
+    let config = SweepConfig {
+        interval: Duration::from_secs(3600),
+        ops_per_second: 20.0,
+        slice: Duration::from_secs(3600),
+        horizon: Duration::from_secs(3 * 3600),
+    };
+    let sweeper = ExpirySweeper::start(pool, rules, config);
+    while sweeper.stats().sweeps == 0 {
+        thread::sleep(Duration::from_millis(5));
+    }
+    // per column, the slices from the horizon to the cutoff and one slice of the rescan, then the size rule
+    let slices = (config.horizon.as_nanos() / config.slice.as_nanos()) as u64;
+    let first = columns.len() as u64 * (slices + 1) + 1;
+    let stats = sweeper.stats();
+    assert_eq!((stats.operations, stats.erased, stats.errors), (first, 10 * columns.len() as u64, 0));
+    // every operation but the first waited for its slot
+    assert!(stats.throttled >= Duration::from_secs_f64((first - 1) as f64 / config.ops_per_second * 0.9));
+
+    let far = (0, now + HOUR);
+    // retention left the ten recent rows, the size rule trimmed the oldest ones down to about 15 points
+    assert_eq!(handle.ts_double_get_ranges("fake_api_tests.sweep", "price", &[far]).unwrap().len(), 8);
+    assert_eq!(handle.ts_int64_get_ranges("fake_api_tests.sweep", "volume", &[far]).unwrap().len(), 8);
+
+    // a point backfilled behind the watermark, in the second slice of the rescan
+    let table = TsBatchTable::from_nanos("fake_api_tests.sweep", &[now - 5 * HOUR / 2])
+        .double_column("price", &[1.0]).unwrap()
+        .int64_column("volume", &[1]).unwrap();
+    assert_eq!(handle.ts_batch_push(PushMode::Transactional, &[table]), None);
+    sweeper.sweep_now();
+    while sweeper.stats().sweeps < 2 {
+        thread::sleep(Duration::from_millis(5));
+    }
+    // per column, the slice that expired since the first sweep and one slice of the rescan
+    let second = columns.len() as u64 * 2 + 1;
+    let stats = sweeper.stats();
+    assert_eq!((stats.operations, stats.erased, stats.errors), (first + second, 11 * columns.len() as u64, 0));
+    drop(sweeper);
+
+    // a retention too long for nanoseconds keeps everything
+    let before = fake_api::stats().calls;
+    let rules = vec![SweepRule::Retention { table: "fake_api_tests.sweep".into(), columns: columns.clone(), keep: Duration::MAX }];
+    let sweeper = ExpirySweeper::start(handle_pool::new_handle_pool("qdb://127.0.0.1:2836", 1000, 1).unwrap(), rules, SweepConfig { ops_per_second: 1000.0, ..config });
+    while sweeper.stats().sweeps == 0 {
+        thread::sleep(Duration::from_millis(5));
+    }
+    assert_eq!(sweeper.stats().erased, 0);
+    assert!(fake_api::stats().calls > before);
+    drop(sweeper);
+
+    // a horizon reaching before the epoch
+    let table = TsBatchTable::from_nanos("fake_api_tests.sweep", &[-5_000_000_000])
+        .double_column("price", &[1.0]).unwrap()
+        .int64_column("volume", &[1]).unwrap();
+    assert_eq!(handle.ts_batch_push(PushMode::Transactional, &[table]), None);
+    let century = Duration::from_secs(100 * 365 * 86_400);
+    let rules = vec![SweepRule::Retention { table: "fake_api_tests.sweep".into(), columns: columns.clone(), keep: Duration::from_secs(3600) }];
+    let sweeper = ExpirySweeper::start(handle_pool::new_handle_pool("qdb://127.0.0.1:2836", 1000, 1).unwrap(), rules, SweepConfig { ops_per_second: 1000.0, slice: century, horizon: century, ..config });
+    while sweeper.stats().sweeps == 0 {
+        thread::sleep(Duration::from_millis(5));
+    }
+    assert_eq!(sweeper.stats().erased, columns.len() as u64);
+    let all = (-HOUR, now + HOUR);
+    assert_eq!(handle.ts_double_get_ranges("fake_api_tests.sweep", "price", &[all]).unwrap().len(), 8);
+}
+
+#[test]
+fn test_fake_alias_scan() {
+    let _serial = SERIAL.lock().unwrap_or_else(|e| e.into_inner());
+    let handle = handle::setup_handle("qdb://127.0.0.1:2836", 1000).unwrap();
+    let mut expected = BTreeSet::new();
+    for i in 0..300 {
+        let alias = format!("fake_api_tests.scan.{}", i);
+        assert_eq!(handle.blob_put(&alias, b"x", 0), None);
+        expected.insert(alias);
+    }
+
+    let live = fake_api::stats().live_allocations;
+    let config = ScanConfig { page_size: 16, ..ScanConfig::default() };
+    let mut scan = handle.prefix_scan("fake_api_tests.scan.", config.clone());
+    assert_eq!(scan.estimate(), Ok(300));
+    let mut seen = BTreeSet::new();
+    for page in &mut scan {
+        let page = page.unwrap();
+        assert!(!page.is_empty() && page.len() <= 16);
+        // one page held at a time
+        assert!(fake_api::stats().live_allocations <= live + 1);
+        for alias in page.iter() {
+            assert!(seen.insert(alias.to_string()), "{} seen twice", alias);
+        }
+    }
+    assert_eq!(seen, expected);
+    let stats = scan.stats();
+    assert_eq!((stats.aliases, stats.oversized), (300, 0));
+    assert!(stats.pages >= 300 / 16);
+    // the estimates of the fake are exact, the scan pattern is the only exact count
+    assert_eq!(stats.counts, 1);
+    assert!(stats.estimates > 0);
+    assert_eq!(fake_api::stats().live_allocations, live);
+
+    for i in 0..40 {
+        assert_eq!(handle.blob_put(&format!("{}.fake_api_tests.sfx", i), b"x", 0), None);
+    }
+    let mut seen = Vec::new();
+    let stats = handle.for_each_page(ScanKind::Suffix, ".fake_api_tests.sfx", ScanConfig { page_size: 8, ..config }, |page| {
+        assert!(page.len() <= 8);
+        // the page read and the one prefetched
+        assert!(fake_api::stats().live_allocations <= live + 2);
+        seen.extend(page.iter().map(|a| a.to_string()));
+    }).unwrap();
+    seen.sort();
+    let mut expected: Vec<String> = (0..40).map(|i| format!("{}.fake_api_tests.sfx", i)).collect();
+    expected.sort();
+    assert_eq!(seen, expected);
+    assert_eq!((stats.aliases, stats.oversized), (40, 0));
+    assert_eq!(fake_api::stats().live_allocations, live);
+
+    assert_eq!(handle.prefix_scan("fake_api_tests.scan.none", ScanConfig::default()).count(), 0);
+}
+
+fn tag(h: qdb_handle_t, alias: &str, tag: &str, attach: bool) {
+    let (alias, tag) = (CString::new(alias).unwrap(), CString::new(tag).unwrap());
+    let err = unsafe {
+        if attach { qdb_attach_tag(h, alias.as_ptr(), tag.as_ptr()) } else { qdb_detach_tag(h, alias.as_ptr(), tag.as_ptr()) }
+    };
+    assert_eq!(err, 0);
+}
+
+#[test]
+fn test_fake_tag_index() {
+    let _serial = SERIAL.lock().unwrap_or_else(|e| e.into_inner());
+    let h = raw_handle();
+    let handle = handle::setup_handle("qdb://127.0.0.1:2836", 1000).unwrap();
+    for i in 0..100 {
+        let alias = format!("fake_api_tests.tagidx.{}", i);
+        assert_eq!(handle.blob_put(&alias, b"x", 0), None);
+        if i % 2 == 0 {
+            tag(h, &alias, "tagidx.even", true);
+        }
+        if i % 3 == 0 {
+            tag(h, &alias, "tagidx.three", true);
+        }
+        if i >= 90 {
+            tag(h, &alias, "tagidx.last", true);
+        }
+    }
+
+    let even_three = TagQuery::And(vec![TagQuery::tag("tagidx.even"), TagQuery::tag("tagidx.three")]);
+    let query = TagQuery::Or(vec![even_three.clone(), TagQuery::tag("tagidx.last")]).and_not(TagQuery::tag("tagidx.three"));
+    assert_eq!(TagIndex::estimate(&handle, &even_three), Ok(34));
+    assert_eq!(TagIndex::estimate(&handle, &query), Ok(44));
+
+    let mut index = TagIndex::new(TagIndexConfig::default());
+    assert_eq!(index.select(&query), Err(ErrorType::ErrInvalidArgument));
+    index.load(&handle, &["tagidx.even", "tagidx.three", "tagidx.last"]).unwrap();
+    assert_eq!(index.select(&even_three).unwrap().len(), 17);
+    let ids = index.select(&query).unwrap();
+    let mut selected: Vec<&str> = index.aliases(&ids).collect();
+    selected.sort();
+    // 90..100 without 90, 93, 96 and 99
+    assert_eq!(selected, ["91", "92", "94", "95", "97", "98"].map(|i| format!("fake_api_tests.tagidx.{}", i)));
+
+    tag(h, "fake_api_tests.tagidx.1", "tagidx.last", true);
+    tag(h, "fake_api_tests.tagidx.98", "tagidx.last", false);
+    tag(h, "fake_api_tests.tagidx.5", "tagidx.even", true);
+    // last kept its count, only even is fetched again
+    let stats = index.refresh(&handle).unwrap();
+    assert_eq!(stats, RefreshStats { checked: 3, fetched: 1, added: 1, removed: 0 });
+    assert!(index.tagged("tagidx.even").unwrap().contains(index.id("fake_api_tests.tagidx.5").unwrap()));
+    assert_eq!(index.refresh_tag(&handle, "tagidx.last").unwrap(), RefreshStats { checked: 0, fetched: 1, added: 1, removed: 1 });
+    assert!(!index.tagged("tagidx.last").unwrap().contains(index.id("fake_api_tests.tagidx.98").unwrap()));
+}
+
+#[test]
+fn test_fake_bulk_tagging() {
+    let _serial = SERIAL.lock().unwrap_or_else(|e| e.into_inner());
+    let handle = handle::setup_handle("qdb://127.0.0.1:2836", 1000).unwrap();
+    for i in 0..200 {
+        assert_eq!(handle.blob_put(&format!("fake_api_tests.bulktag.{}", i), b"x", 0), None);
+    }
+    let tags = vec!["bulktag.a".to_string(), "bulktag.b".to_string()];
+    let input = (0..201).map(|i| (format!("fake_api_tests.bulktag.{}", i), tags.clone()));
+
+    let pool = handle_pool::new_handle_pool("qdb://127.0.0.1:2836", 1000, 2).unwrap();
+    let config = BulkTagConfig { workers: 4, max_in_flight: 8, max_attempts: 16, backoff_base: Duration::from_micros(10), ..BulkTagConfig::default() };
+    let tagger = BulkTagger::new(pool, config);
+    // a third of the calls pushed back, retried until they pass
+    fake_api::configure(FakeConfig { error_rate: 0.3, ..FakeConfig::default() });
+    let report = tagger.run(TagAction::Attach, input.clone());
+    fake_api::configure(FakeConfig::default());
+
+    assert_eq!((report.stats.entries, report.stats.tags), (201, 402));
+    assert!(report.stats.retries > 0);
+    assert_eq!(report.failed, vec![("fake_api_tests.bulktag.200".to_string(), ErrorType::ErrAliasNotFound)]);
+    assert!(report.stats.entries_per_second() > 0.0);
+    assert_eq!(handle.get_tagged_count("bulktag.b"), Ok(200));
+    assert_eq!(handle.has_tag("fake_api_tests.bulktag.7", "bulktag.a"), Ok(true));
+
+    // attaching again is not an error
+    assert_eq!(tagger.run(TagAction::Attach, input.clone().take(10)).failed, vec![]);
+    let report = tagger.run(TagAction::Detach, input.take(100));
+    assert_eq!((report.stats.entries, report.stats.failed), (100, 0));
+    assert_eq!(handle.get_tagged_count("bulktag.a"), Ok(100));
+    assert_eq!(handle.has_tag("fake_api_tests.bulktag.7", "bulktag.a"), Ok(false));
+    assert_eq!(tagger.stats().entries, 311);
+}
+
+#[test]
+fn test_fake_query_cache() {
+    let _serial = SERIAL.lock().unwrap_or_else(|e| e.into_inner());
+    create_table(raw_handle(), "fake_api_tests.qcache");
+    let handle = handle::setup_handle("qdb://127.0.0.1:2836", 1000).unwrap();
+    let timestamps: Vec<i64> = (0..10).map(|i| 1_609_459_200_000_000_000 + i * 1_000_000_000).collect();
+    let table = TsBatchTable::from_nanos("fake_api_tests.qcache", &timestamps)
+        .double_column("price", &[1.0; 10]).unwrap()
+        .int64_column("volume", &[1; 10]).unwrap();
+    assert_eq!(handle.ts_batch_push(PushMode::Transactional, &[table]), None);
+    let q = |second: usize| format!("select price from \"fake_api_tests.qcache\" in range(2021-01-01T00:00:0{}, +1h)", second);
+    let live = fake_api::stats().live_allocations;
+
+    // least recently used first out
+    let cache = QueryCache::new(&handle, QueryCacheConfig { max_entries: 2, ttl: Duration::from_secs(3600), ..QueryCacheConfig::default() });
+    assert_eq!(cache.query(&q(1)).unwrap().row_count(), 9);
+    cache.query(&q(2)).unwrap();
+    let hit = cache.query(&format!("  {} ;", q(1))).unwrap();
+    cache.query(&q(3)).unwrap();
+    cache.query(&q(1)).unwrap();
+    cache.query(&q(2)).unwrap();
+    let metrics = cache.metrics();
+    assert_eq!((metrics.hits, metrics.misses, metrics.evictions, metrics.entries), (2, 4, 2, 2));
+    assert!(metrics.bytes > 0);
+    // an evicted result stays valid for whoever holds it
+    drop(cache);
+    assert_eq!(hit.row_count(), 9);
+    drop(hit);
+    assert_eq!(fake_api::stats().live_allocations, live);
+
+    let cache = QueryCache::new(&handle, QueryCacheConfig { ttl: Duration::from_millis(30), ..QueryCacheConfig::default() });
+    cache.query(&q(4)).unwrap();
+    thread::sleep(Duration::from_millis(40));
+    cache.query(&q(4)).unwrap();
+    let metrics = cache.metrics();
+    assert_eq!((metrics.hits, metrics.misses, metrics.expirations, metrics.entries), (0, 2, 1, 1));
+
+    // callers asking while the query runs share it
+    fake_api::configure(FakeConfig { latency: Duration::from_millis(50), ..FakeConfig::default() });
+    let calls = fake_api::stats().calls;
+    thread::scope(|scope| {
+        for _ in 0..4 {
+            scope.spawn(|| assert_eq!(cache.query(&q(5)).unwrap().row_count(), 5));
+        }
+    });
+    fake_api::configure(FakeConfig::default());
+    let metrics = cache.metrics();
+    assert_eq!(fake_api::stats().calls - calls, 1);
+    assert_eq!(metrics.misses, 3);
+    assert_eq!(metrics.coalesced + metrics.hits, 3);
+    drop(cache);
+    assert_eq!(fake_api::stats().live_allocations, live);
+}
+
+#[test]
+fn test_fake_continuous_query() {
+    let _serial = SERIAL.lock().unwrap_or_else(|e| e.into_inner());
+    create_table(raw_handle(), "fake_api_tests.continuous");
+    let handle = handle::setup_handle("qdb://127.0.0.1:2836", 1000).unwrap();
+    let live = fake_api::stats().live_allocations;
+
+    // recent rows, older ones would be pruned from the deduplication window and reported again
+    let now = std::time::SystemTime::now().duration_since(std::time::UNIX_EPOCH).unwrap().as_nanos() as i64;
+    let push = |from: i64, count: i64| {
+        let timestamps: Vec<i64> = (from..from + count).map(|i| now - 60_000_000_000 + i * 1_000_000_000).collect();
+        let prices: Vec<f64> = (from..from + count).map(|i| i as f64).collect();
+        let table = TsBatchTable::from_nanos("fake_api_tests.continuous", &timestamps).double_column("price", &prices).unwrap();
+        assert_eq!(handle.ts_batch_push(PushMode::Fast, &[table]), None);
+    };
+    let prices = |delta: &Delta| -> Vec<f64> {
+        match &delta.columns.iter().find(|c| c.name == "price").unwrap().values {
+            query::ColumnValues::Double(values) => values.iter().map(|v| v.unwrap()).collect(),
+            values => panic!("price is not a double column: {:?}", values),
+        }
+    };
+
+    push(0, 5);
+    let (sender, receiver) = mpsc::channel();
+    let config = ContinuousQueryConfig { refresh_rate: Duration::from_millis(10), ..ContinuousQueryConfig::default() };
+    let continuous = handle.continuous_query("select price from \"fake_api_tests.continuous\"", config, move |delta| {
+        let _ = sender.send(delta);
+    }).unwrap();
+
+    // every refresh reports the whole table, only the rows not seen yet reach the consumer
+    let first = receiver.recv_timeout(Duration::from_secs(5)).unwrap().unwrap();
+    assert_eq!(first.row_count, 5);
+    assert_eq!(prices(&first), vec![0.0, 1.0, 2.0, 3.0, 4.0]);
+
+    push(5, 3);
+    let second = receiver.recv_timeout(Duration::from_secs(5)).unwrap().unwrap();
+    assert_eq!(prices(&second), vec![5.0, 6.0, 7.0]);
+
+    thread::sleep(Duration::from_millis(50));
+    assert!(receiver.try_recv().is_err());
+    assert_eq!((continuous.delivered(), continuous.dropped()), (2, 0));
+
+    // no refresh runs once dropped, and every buffer is back
+    drop(continuous);
+    let calls = fake_api::stats().calls;
+    thread::sleep(Duration::from_millis(50));
+    assert_eq!(fake_api::stats().calls, calls);
+    assert_eq!(fake_api::stats().live_allocations, live);
+
+    // the window follows the rows received, not the clock: rows before 1970 more than 2.5 s older than the newest
+    // are forgotten, and reported again by the next refresh since the fake reports the whole table
+    create_table(raw_handle(), "fake_api_tests.continuous.old");
+    let timestamps: Vec<i64> = (0..5).map(|i| -60_000_000_000 + i * 1_000_000_000).collect();
+    let table = TsBatchTable::from_nanos("fake_api_tests.continuous.old", &timestamps).double_column("price", &[0.0, 1.0, 2.0, 3.0, 4.0]).unwrap();
+    assert_eq!(handle.ts_batch_push(PushMode::Fast, &[table]), None);
+    let (sender, receiver) = mpsc::channel();
+    let config = ContinuousQueryConfig { dedup_window: Duration::from_millis(2500), ..config };
+    let continuous = handle.continuous_query("select price from \"fake_api_tests.continuous.old\"", config, move |delta| {
+        let _ = sender.send(delta);
+    }).unwrap();
+    assert_eq!(prices(&receiver.recv_timeout(Duration::from_secs(5)).unwrap().unwrap()), vec![0.0, 1.0, 2.0, 3.0, 4.0]);
+    assert_eq!(prices(&receiver.recv_timeout(Duration::from_secs(5)).unwrap().unwrap()), vec![0.0, 1.0]);
+    drop(continuous);
+    assert_eq!(fake_api::stats().live_allocations, live);
+}
+
+// A writer whose output stays readable once the sink owning it is gone.
+#[derive(Clone, Default)]
+struct SharedOutput(Arc<Mutex<Vec<u8>>>);
+
+impl Write for SharedOutput {
+    fn write(&mut self, buf: &[u8]) -> std::io::Result<usize> {
+        self.0.lock().unwrap().write(buf)
+    }
+
+    fn flush(&mut self) -> std::io::Result<()> {
+        Ok(())
+    }
+}
+
+#[test]
+fn test_fake_log_sink() {
+    let _serial = SERIAL.lock().unwrap_or_else(|e| e.into_inner());
+    let output = SharedOutput::default();
+    let before = log_sink::log_sink_metrics();
+
+    let config = LogSinkConfig { min_level: quasar_rs::qdb_log_level_t_qdb_log_info, ..LogSinkConfig::default() };
+    let sink = log_sink::install_log_sink(config, output.clone()).unwrap();
+    assert_eq!(log_sink::install_log_sink(config, output.clone()).err(), Some(ErrorType::ErrResourceLocked));
+
+    fake_api::log(quasar_rs::qdb_log_level_t_qdb_log_warning, "node unreachable");
+    fake_api::log(quasar_rs::qdb_log_level_t_qdb_log_debug, "filtered out");
+    fake_api::log(quasar_rs::qdb_log_level_t_qdb_log_error, &"x".repeat(LOG_MESSAGE_CAPACITY + 10));
+    sink.set_min_level(quasar_rs::qdb_log_level_t_qdb_log_detailed);
+    fake_api::log(quasar_rs::qdb_log_level_t_qdb_log_debug, "now kept");
+
+    let metrics = sink.metrics();
+    assert_eq!((metrics.accepted - before.accepted, metrics.filtered - before.filtered, metrics.dropped - before.dropped), (3, 1, 0));
+
+    // dropping the sink flushes what is left, and nothing is accepted afterwards
+    drop(sink);
+    fake_api::log(quasar_rs::qdb_log_level_t_qdb_log_error, "after the sink");
+    assert_eq!(log_sink::log_sink_metrics().accepted - before.accepted, 3);
+
+    let text = String::from_utf8(output.0.lock().unwrap().clone()).unwrap();
+    let lines: Vec<&str> = text.lines().collect();
+    assert_eq!(lines.len(), 3, "{}", text);
+    assert!(lines[0].contains("warning") && lines[0].ends_with(" node unreachable"), "{}", lines[0]);
+    assert!(lines[1].contains("error") && lines[1].ends_with(&format!("{}...", "x".repeat(LOG_MESSAGE_CAPACITY))), "{}", lines[1]);
+    assert!(lines[2].contains("debug") && lines[2].ends_with(" now kept"), "{}", lines[2]);
+    assert!(lines.iter().all(|l| l.contains(&format!("pid={}", std::process::id()))));
+
+    // the ring and its consumer are handed to the next sink
+    let sink = log_sink::install_log_sink(config, output.clone()).unwrap();
+    fake_api::log(quasar_rs::qdb_log_level_t_qdb_log_info, "second sink");
+    drop(sink);
+    assert!(String::from_utf8_lossy(&output.0.lock().unwrap()).ends_with(" second sink\n"));
+}
+
+#[test]
+fn test_fake_memory_governor() {
+    let _serial = SERIAL.lock().unwrap_or_else(|e| e.into_inner());
+    let h = raw_handle();
+    let handle = Arc::new(handle::setup_handle("qdb://127.0.0.1:2836", 1000).unwrap());
+
+    assert_eq!(parse_memory_info("{\"allocated\":12,\"allocations\":1}", "/allocated"), Some(12));
+    assert_eq!(parse_memory_info("{\"heap\":{\"in_use\":7.0}}", "/heap/in_use"), Some(7));
+    assert_eq!(parse_memory_info("42", ""), Some(42));
+    assert_eq!(parse_memory_info("{\"allocated\":12}", "/used"), None);
+    assert_eq!(parse_memory_info("{\"allocated\":-1}", "/allocated"), None);
+
+    // the fake reports the bytes of the buffers handed out and not released yet
+    let base = fake_api::stats().allocated_bytes as u64;
+    let config = MemoryGovernorConfig {
+        soft_limit: base + 1000,
+        hard_limit: base + 100_000,
+        sample_interval: Duration::from_secs(3600),
+        tidy_interval: Duration::ZERO,
+        usage_pointer: "/allocated".into(),
+    };
+    let invalid = MemoryGovernorConfig { soft_limit: config.hard_limit + 1, ..config.clone() };
+    assert_eq!(MemoryGovernor::start(handle.clone(), invalid).err(), Some(ErrorType::ErrInvalidArgument));
+
+    let governor = MemoryGovernor::start(handle.clone(), config.clone()).unwrap();
+    let gate = governor.gate();
+    // the first sample is taken by the sampler as it starts
+    while governor.metrics().samples == 0 {
+        thread::sleep(Duration::from_millis(1));
+    }
+
+    // below the soft limit nothing is done
+    assert_eq!(governor.sample(), Ok(base));
+    assert_eq!(governor.metrics().tidies, 0);
+    assert!(!gate.is_throttled());
+
+    // holds blobs fetched from the cluster, as a reader would
+    let hold = |alias: &str, size: usize| -> *const std::os::raw::c_void {
+        let alias = CString::new(alias).unwrap();
+        let content = vec![7u8; size];
+        let mut buffer: *const std::os::raw::c_void = ptr::null();
+        let mut length = 0;
+        unsafe {
+            assert_eq!(qdb_blob_put(h, alias.as_ptr(), content.as_ptr() as *const _, size, 0), 0);
+            assert_eq!(qdb_blob_get(h, alias.as_ptr(), &mut buffer, &mut length), 0);
+        }
+        buffer
+    };
+
+    // above the soft limit the API is asked to tidy, the gate stays open
+    let small = hold("fake_api_tests.governor.small", 2000);
+    assert_eq!(governor.sample(), Ok(base + 2000));
+    assert_eq!(governor.metrics().tidies, 1);
+    assert!(!gate.is_throttled());
+    assert!(gate.admit_timeout(Duration::ZERO));
+
+    // above the hard limit the gate closes until usage drops back
+    let large = hold("fake_api_tests.governor.large", 200_000);
+    assert_eq!(governor.sample(), Ok(base + 202_000));
+    assert!(gate.is_throttled());
+    assert!(!gate.admit_timeout(Duration::from_millis(10)));
+
+    // batches and readers on the handle wait at the gate too
+    let reader = {
+        let handle = handle.clone();
+        thread::spawn(move || handle.multi_get(&["fake_api_tests.governor.small"]).map(|m| m.len()))
+    };
+    while governor.metrics().throttled_waits < 2 {
+        thread::sleep(Duration::from_millis(1));
+    }
+    assert!(!reader.is_finished());
+
+    let waiter = {
+        let gate = gate.clone();
+        thread::spawn(move || gate.admit_timeout(Duration::from_secs(5)))
+    };
+    while governor.metrics().throttled_waits < 3 {
+        thread::sleep(Duration::from_millis(1));
+    }
+    unsafe {
+        qdb_release(h, large);
+        qdb_release(h, small);
+    }
+    assert_eq!(governor.sample(), Ok(base));
+    assert!(waiter.join().unwrap());
+    assert_eq!(reader.join().unwrap(), Ok(1));
+    assert!(!gate.is_throttled());
+
+    let metrics = governor.metrics();
+    assert_eq!((metrics.tidies, metrics.throttled_waits, metrics.peak, metrics.sample_errors), (2, 3, base + 202_000, 0));
+
+    // usage staying above the soft limit is tidied once per tidy interval, not on every sample
+    drop(governor);
+    let governor = MemoryGovernor::start(handle.clone(), MemoryGovernorConfig { tidy_interval: Duration::from_secs(3600), ..config.clone() }).unwrap();
+    let small = hold("fake_api_tests.governor.tidy", 2000);
+    for _ in 0..3 {
+        assert_eq!(governor.sample(), Ok(base + 2000));
+    }
+    assert_eq!(governor.metrics().tidies, 1);
+    unsafe {
+        qdb_release(h, small);
+    }
+
+    // a document without the usage field is a failed sample, not a guess, and leaves the gate open
+    drop(governor);
+    let governor = MemoryGovernor::start(handle, MemoryGovernorConfig { hard_limit: 0, soft_limit: 0, usage_pointer: "/resident".into(), ..config }).unwrap();
+    assert_eq!(governor.sample(), Err(ErrorType::ErrInvalidReply));
+    assert!(governor.metrics().sample_errors >= 1);
+    assert!(governor.gate().admit_timeout(Duration::ZERO));
+}
+
+#[test]
+fn test_fake_auto_tuner() {
+    let _serial = SERIAL.lock().unwrap_or_else(|e| e.into_inner());
+    let handle = Arc::new(handle::setup_handle("qdb://127.0.0.1:2836", 1000).unwrap());
+    assert_eq!(handle.set_client_max_parallelism(16), None);
+
+    let config = AutoTunerConfig { min_parallelism: 1, max_parallelism: 64, window: 4, min_gain: 0.05, ..AutoTunerConfig::default() };
+    let tuner = AutoTuner::new(handle.clone(), config).unwrap();
+    assert_eq!(tuner.state().parallelism, 16);
+
+    // 0 leaves the choice to the API, which uses all the cores
+    assert_eq!(handle.set_client_max_parallelism(0), None);
+    let cores = thread::available_parallelism().unwrap().get();
+    assert_eq!(AutoTuner::new(handle.clone(), config).unwrap().state().parallelism, cores.min(64));
+    assert_eq!(handle.set_client_max_parallelism(16), None);
+
+    // one window of operations of latency each, ended one after the other with gap in between,
+    // on a clock of its own so that the decisions do not depend on the machine
+    let mut clock = Instant::now();
+    let mut window = |latency: Duration, bytes: u64, gap: Duration| {
+        for _ in 0..4 {
+            clock += gap + latency;
+            tuner.observe_at(clock, latency, bytes, None);
+        }
+        let state = tuner.state();
+        assert_eq!(handle.get_client_max_parallelism(), Ok(state.parallelism));
+        state
+    };
+    let ms = Duration::from_millis;
+
+    // first window, probes upwards by a quarter
+    let state = window(ms(10), 1000, Duration::ZERO);
+    assert_eq!((state.parallelism, state.decisions), (20, 1));
+    assert_eq!(state.last_throughput, 100_000.0);
+
+    // faster, keeps going
+    assert_eq!(window(ms(5), 1000, Duration::ZERO).parallelism, 25);
+
+    // slower, turns around
+    assert_eq!(window(ms(10), 1000, Duration::ZERO).parallelism, 19);
+
+    // the same throughput measured over busy time, idle time between operations is not a slowdown: settles
+    let state = window(ms(10), 1000, ms(100));
+    assert_eq!(state.parallelism, 19);
+    assert_eq!(state.last_throughput, 100_000.0);
+
+    // flat throughput at a p99 more than doubled, backs off
+    assert_eq!(window(ms(30), 3000, Duration::ZERO).parallelism, 15);
+
+    // operations running at once count their common time once
+    let started = clock;
+    for _ in 0..4 {
+        tuner.observe_at(started + ms(10), ms(10), 1000, None);
+    }
+    let state = tuner.state();
+    assert_eq!((state.last_throughput, state.best_throughput, state.decisions), (400_000.0, 400_000.0, 6));
+}
+
+#[test]
+fn test_fake_query_sliced() {
+    let _serial = SERIAL.lock().unwrap_or_else(|e| e.into_inner());
+    create_table(raw_handle(), "fake_api_tests.sliced");
+    let handle = handle::setup_handle("qdb://127.0.0.1:2836", 1000).unwrap();
+
+    // one point in the middle of each of four daily shards
+    const DAY: i64 = 86_400_000_000_000;
+    let t0 = 1_609_459_200_000_000_000i64;
+    let timestamps: Vec<i64> = (0..4).map(|i| t0 + i * DAY + DAY / 2).collect();
+    let table = TsBatchTable::from_nanos("fake_api_tests.sliced", &timestamps)
+        .double_column("price", &[1.0, 2.0, 3.0, 4.0]).unwrap()
+        .int64_column("volume", &[5, 3, 7, 4]).unwrap();
+    assert_eq!(handle.ts_batch_push(PushMode::Transactional, &[table]), None);
+
+    // one slice per handle, one row per slice
+    let pool = handle_pool::new_handle_pool("qdb://127.0.0.1:2836", 1000, 4).unwrap();
+    let query = SlicedQuery { select: "select price, volume".into(), table: "fake_api_tests.sliced".into(), begin: t0, end: t0 + 4 * DAY, filter: None };
+
+    let rows = pool.query_sliced(&query, &Merge::Concat).unwrap();
+    assert_eq!(rows[0].values, query::ColumnValues::Timestamp(timestamps.iter().map(|&t| Some(t)).collect()));
+    assert_eq!(rows[1].values, query::ColumnValues::Double(vec![Some(1.0), Some(2.0), Some(3.0), Some(4.0)]));
+
+    let merged = pool.query_sliced(&query, &Merge::Aggregate(vec![Aggregate::Max, Aggregate::Sum, Aggregate::Min])).unwrap();
+    assert_eq!(merged[0].values, query::ColumnValues::Timestamp(vec![Some(timestamps[3])]));
+    assert_eq!(merged[1].values, query::ColumnValues::Double(vec![Some(10.0)]));
+    assert_eq!(merged[2].values, query::ColumnValues::Int64(vec![Some(3)]));
+
+    // a sum of timestamps means nothing
+    let sum = Merge::Aggregate(vec![Aggregate::Sum, Aggregate::Sum, Aggregate::Sum]);
+    assert_eq!(pool.query_sliced(&query, &sum).map(|_| ()), Err(ErrorType::ErrInvalidArgument));
+}
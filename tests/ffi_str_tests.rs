@@ -0,0 +1,36 @@
+use std::ffi::CStr;
+
+use quasar_rs::error::ErrorType;
+use quasar_rs::ffi_str::{with_c_str, CStrArena};
+
+#[test]
+fn test_with_c_str() {
+    let short = with_c_str("btc-usd", |p| unsafe { CStr::from_ptr(p) }.to_str().unwrap().to_string()).unwrap();
+    assert_eq!(short, "btc-usd");
+
+    let long_alias = "x".repeat(1000);
+    let long = with_c_str(&long_alias, |p| unsafe { CStr::from_ptr(p) }.to_bytes().len()).unwrap();
+    assert_eq!(long, 1000);
+
+    assert_eq!(with_c_str("a\0b", |_| ()).unwrap_err(), ErrorType::ErrInvalidArgument);
+}
+
+#[test]
+fn test_c_str_arena() {
+    let mut arena = CStrArena::with_capacity(3, 16);
+    assert_eq!(arena.push("alpha").unwrap(), 0);
+    assert_eq!(arena.push("").unwrap(), 1);
+    assert_eq!(arena.push("gamma").unwrap(), 2);
+    assert!(arena.push("de\0lta").is_err());
+
+    assert_eq!(arena.len(), 3);
+    assert_eq!(arena.get(0), "alpha");
+    assert_eq!(arena.get(1), "");
+    assert_eq!(arena.get(2), "gamma");
+
+    let names: Vec<&str> = arena.ptrs().iter().map(|p| unsafe { CStr::from_ptr(*p) }.to_str().unwrap()).collect();
+    assert_eq!(names, vec!["alpha", "", "gamma"]);
+
+    arena.clear();
+    assert!(arena.is_empty());
+}
@@ -0,0 +1,101 @@
+use std::time::Duration;
+
+use quasar_rs::loadgen::{self, Burst, KeyChooser, KeyDistribution, KeySpec, Rng, Schedule, SizeDistribution, Zipfian};
+
+#[test]
+fn test_parse_workload() {
+    let spec = loadgen::parse_workload(r#"{
+        "rate": 500, "duration_ms": 1000,
+        "keys": { "count": 1000, "distribution": { "zipfian": 0.99 } },
+        "value_size": { "uniform": [16, 64] },
+        "mix": { "blob_get": 9, "blob_put": 1 }
+    }"#).unwrap();
+
+    assert_eq!(spec.workers, 8);
+    assert_eq!(spec.keys.prefix, "loadgen.blob.");
+    assert!(matches!(spec.keys.distribution, KeyDistribution::Zipfian(t) if t == 0.99));
+    assert!(matches!(spec.value_size, SizeDistribution::Uniform(16, 64)));
+    assert!(spec.preload);
+}
+
+#[test]
+fn test_parse_workload_rejects_invalid_specs() {
+    assert!(loadgen::parse_workload(r#"{ "rate": 0, "duration_ms": 1, "mix": { "blob_get": 1 } }"#).is_err());
+    assert!(loadgen::parse_workload(r#"{ "rate": 1, "duration_ms": 1, "mix": {} }"#).is_err());
+    assert!(loadgen::parse_workload(r#"{ "rate": 1, "duration_ms": 1, "mix": { "query": 1 } }"#).is_err());
+    assert!(loadgen::parse_workload(r#"{ "rate": 1, "duration_ms": 1, "mix": { "blob_get": 1 },
+        "keys": { "count": 10, "distribution": { "zipfian": 1.5 } } }"#).is_err());
+    assert!(loadgen::parse_workload(r#"{ "rate": 1, "duration_ms": 1, "mix": { "blob_gets": 1 } }"#).is_err());
+}
+
+#[test]
+fn test_schedule_is_open_loop() {
+    let schedule = Schedule::new(1000.0, None);
+
+    assert_eq!(schedule.arrival(0), (Duration::ZERO, false));
+    assert_eq!(schedule.arrival(1000).0, Duration::from_secs(1));
+    assert_eq!(schedule.arrival(2500).0, Duration::from_millis(2500));
+}
+
+#[test]
+fn test_schedule_bursts() {
+    // 100 op/s, 400 op/s for the first 100ms of every second: 40 + 90 operations per period
+    let burst = Burst { period_ms: 1000, on_ms: 100, multiplier: 4.0, mix: None };
+    let schedule = Schedule::new(100.0, Some(burst));
+
+    let (t, bursting) = schedule.arrival(20);
+    assert!(bursting);
+    assert!((t.as_secs_f64() - 0.05).abs() < 1e-9);
+
+    let (t, bursting) = schedule.arrival(40);
+    assert!(!bursting);
+    assert!((t.as_secs_f64() - 0.1).abs() < 1e-9);
+
+    let (t, bursting) = schedule.arrival(130);
+    assert!(bursting);
+    assert!((t.as_secs_f64() - 1.0).abs() < 1e-9);
+}
+
+#[test]
+fn test_zipfian_is_skewed() {
+    let zipfian = Zipfian::new(1000, 0.99);
+    let mut rng = Rng::new(42);
+    let mut counts = vec![0u32; 1000];
+    for _ in 0..100_000 {
+        counts[zipfian.next(&mut rng) as usize] += 1;
+    }
+
+    assert!(counts[0] > counts[1]);
+    assert!(counts[1] > counts[10]);
+    // the hottest key gets about 1 / zeta(1000, 0.99), some 13% of the draws
+    assert!(counts[0] > 10_000 && counts[0] < 16_000, "{}", counts[0]);
+}
+
+#[test]
+fn test_key_chooser_stays_in_range() {
+    let spec = KeySpec { count: 37, prefix: String::new(), distribution: KeyDistribution::Latest(0.9) };
+    let chooser = KeyChooser::new(&spec);
+    let mut rng = Rng::new(7);
+
+    for latest in 0..37 {
+        assert!(chooser.next(&mut rng, latest) < 37);
+    }
+}
+
+#[test]
+fn test_size_distributions() {
+    let mut rng = Rng::new(1);
+    for _ in 0..1000 {
+        let size = SizeDistribution::Uniform(10, 20).sample(&mut rng);
+        assert!((10..=20).contains(&size));
+    }
+    assert_eq!(SizeDistribution::Fixed(5).sample(&mut rng), 5);
+}
+
+#[test]
+fn test_render_query() {
+    let now = 1_609_459_200_000_000_000;
+    let query = loadgen::render_query("select * from \"{table}\" in range({now-1min}, {now}) {other}", "t", now);
+
+    assert_eq!(query, "select * from \"t\" in range(2020-12-31T23:59:00.000000000, 2021-01-01T00:00:00.000000000) {other}");
+}
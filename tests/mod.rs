@@ -1,3 +1,26 @@
-
 #[cfg(test)]
-mod handle_tests;
\ No newline at end of file
+mod handle_tests;
+#[cfg(test)]
+mod query_cache_tests;
+#[cfg(test)]
+mod spsc_queue_tests;
+#[cfg(test)]
+mod query_splitter_tests;
+#[cfg(test)]
+mod perf_tests;
+#[cfg(test)]
+mod perf_trace_tests;
+#[cfg(test)]
+mod mpsc_ring_tests;
+#[cfg(test)]
+mod loadgen_tests;
+#[cfg(test)]
+mod ffi_str_tests;
+#[cfg(test)]
+mod ts_batch_tests;
+#[cfg(test)]
+mod codec_tests;
+#[cfg(test)]
+mod bitmap_tests;
+#[cfg(all(test, feature = "fake-api"))]
+mod fake_api_tests;
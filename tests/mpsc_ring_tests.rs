@@ -0,0 +1,87 @@
+use std::panic::{self, AssertUnwindSafe};
+use std::sync::Arc;
+use std::thread;
+
+use quasar_rs::mpsc_ring::MpscRing;
+
+#[test]
+fn test_mpsc_ring_full() {
+    let ring: MpscRing<u64> = MpscRing::with_capacity(4);
+    let mut consumer = ring.consumer().unwrap();
+
+    for i in 0..4 {
+        assert!(ring.push_with(|v| *v = i));
+    }
+    assert!(!ring.push_with(|v| *v = 4));
+
+    let mut out = Vec::new();
+    while consumer.pop_with(|v| out.push(*v)) {}
+    assert_eq!(out, vec![0, 1, 2, 3]);
+}
+
+#[test]
+fn test_mpsc_ring_one_consumer() {
+    let ring: MpscRing<u64> = MpscRing::with_capacity(4);
+
+    let consumer = ring.consumer().unwrap();
+    assert!(ring.consumer().is_none());
+    drop(consumer);
+    assert!(ring.consumer().is_some());
+}
+
+#[test]
+fn test_mpsc_ring_read_panics() {
+    let ring: MpscRing<u64> = MpscRing::with_capacity(2);
+    assert!(ring.push_with(|v| *v = 1));
+    assert!(ring.push_with(|v| *v = 2));
+
+    let panicked = panic::catch_unwind(AssertUnwindSafe(|| {
+        let mut consumer = ring.consumer().unwrap();
+        consumer.pop_with(|_| panic!("read failed"));
+    }));
+    assert!(panicked.is_err());
+
+    // the slot read when the panic happened is free again, and so is the consumer
+    assert!(ring.push_with(|v| *v = 3));
+    let mut consumer = ring.consumer().unwrap();
+    let mut out = Vec::new();
+    while consumer.pop_with(|v| out.push(*v)) {}
+    assert_eq!(out, vec![2, 3]);
+}
+
+#[test]
+fn test_mpsc_ring_producers() {
+    let ring: Arc<MpscRing<u64>> = Arc::new(MpscRing::with_capacity(64));
+    let producers: Vec<_> = (0..4u64)
+        .map(|p| {
+            let ring = ring.clone();
+            thread::spawn(move || {
+                for i in 0..1000u64 {
+                    while !ring.push_with(|v| *v = p * 1000 + i) {
+                        thread::yield_now();
+                    }
+                }
+            })
+        })
+        .collect();
+
+    let mut consumer = ring.consumer().unwrap();
+    let mut seen = vec![false; 4000];
+    let mut last = [None::<u64>; 4];
+    let mut count = 0;
+    while count < 4000 {
+        consumer.pop_with(|v| {
+            let p = (*v / 1000) as usize;
+            // values of one producer come out in order
+            assert!(last[p].map_or(true, |l| l < *v));
+            last[p] = Some(*v);
+            seen[*v as usize] = true;
+            count += 1;
+        });
+    }
+
+    for p in producers {
+        p.join().unwrap();
+    }
+    assert!(seen.iter().all(|s| *s));
+}
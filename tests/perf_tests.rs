@@ -0,0 +1,113 @@
+use quasar_rs::histogram::LatencyHistogram;
+use quasar_rs::perf::{Measurement, Phase, PerfCollector, Profile};
+use quasar_rs::{qdb_perf_label_t_qdb_pl_bucket_reading_ends, qdb_perf_label_t_qdb_pl_bucket_reading_starts,
+                qdb_perf_label_t_qdb_pl_content_writing_ends, qdb_perf_label_t_qdb_pl_content_writing_starts,
+                qdb_perf_label_t_qdb_pl_entry_writing_ends, qdb_perf_label_t_qdb_pl_entry_writing_starts,
+                qdb_perf_label_t_qdb_pl_processing_ends, qdb_perf_label_t_qdb_pl_processing_starts,
+                qdb_perf_label_t_qdb_pl_received, qdb_perf_label_t_qdb_pl_replied};
+
+#[test]
+fn test_histogram_percentiles() {
+    let mut h = LatencyHistogram::new();
+    for v in 1..=100_000u64 {
+        h.record(v);
+    }
+
+    assert_eq!(h.count(), 100_000);
+    assert_eq!(h.min(), 1);
+    assert_eq!(h.max(), 100_000);
+
+    for (p, expected) in [(50.0, 50_000.0), (99.0, 99_000.0), (99.9, 99_900.0)] {
+        let v = h.percentile(p) as f64;
+        assert!((v - expected).abs() / expected < 0.02, "p{} = {}", p, v);
+    }
+}
+
+#[test]
+fn test_histogram_small_values_exact() {
+    let mut h = LatencyHistogram::new();
+    h.record(3);
+    h.record(7);
+
+    assert_eq!(h.percentile(50.0), 3);
+    assert_eq!(h.percentile(100.0), 7);
+}
+
+#[test]
+fn test_perf_collector_phases() {
+    let collector = PerfCollector::new();
+    let profile = Profile {
+        name: "ts.get".to_string(),
+        measurements: vec![
+            Measurement { label: qdb_perf_label_t_qdb_pl_bucket_reading_starts, elapsed: 0 },
+            Measurement { label: qdb_perf_label_t_qdb_pl_bucket_reading_ends, elapsed: 1_000 },
+            Measurement { label: qdb_perf_label_t_qdb_pl_replied, elapsed: 1_500 },
+        ],
+    };
+
+    collector.record(&[profile.clone(), profile]);
+
+    let phase = Phase { from: qdb_perf_label_t_qdb_pl_bucket_reading_starts, to: qdb_perf_label_t_qdb_pl_bucket_reading_ends };
+    let bucket = collector.histogram("ts.get", phase).unwrap();
+    assert_eq!(bucket.count(), 2);
+    assert_eq!(bucket.max(), 1_000);
+
+    // the end of a span and the next label are not a phase
+    let summary = collector.summary();
+    assert_eq!(summary.len(), 2);
+    assert!(summary.iter().any(|s| s.phase == "bucket_reading_starts->bucket_reading_ends"));
+    assert!(summary.iter().any(|s| s.phase == "total" && s.max == 1_500));
+}
+
+#[test]
+fn test_perf_collector_total_apart_from_phases() {
+    let collector = PerfCollector::new();
+    // undefined->undefined is a phase like any other, not the total
+    let profile = Profile {
+        name: "blob.get".to_string(),
+        measurements: vec![
+            Measurement { label: quasar_rs::qdb_perf_label_t_qdb_pl_undefined, elapsed: 0 },
+            Measurement { label: quasar_rs::qdb_perf_label_t_qdb_pl_undefined, elapsed: 200 },
+            Measurement { label: quasar_rs::qdb_perf_label_t_qdb_pl_replied, elapsed: 1_500 },
+        ],
+    };
+    collector.record(&[profile]);
+
+    let undefined = quasar_rs::qdb_perf_label_t_qdb_pl_undefined;
+    assert_eq!(collector.histogram("blob.get", Phase { from: undefined, to: undefined }).unwrap().max(), 200);
+    assert_eq!(collector.total("blob.get").unwrap().max(), 1_500);
+    assert!(collector.total("ts.get").is_none());
+
+    let phases: Vec<_> = collector.summary().into_iter().map(|s| (s.phase, s.max)).collect();
+    assert_eq!(phases, vec![("total".to_string(), 1_500), ("undefined->undefined".to_string(), 200), ("undefined->replied".to_string(), 1_300)]);
+    assert_eq!(quasar_rs::perf::label_name(quasar_rs::qdb_perf_label_t_qdb_pl_unknown), "unknown");
+}
+
+#[test]
+fn test_perf_collector_nested_spans() {
+    let collector = PerfCollector::new();
+    let labels = [
+        (qdb_perf_label_t_qdb_pl_received, 0),
+        (qdb_perf_label_t_qdb_pl_processing_starts, 10),
+        (qdb_perf_label_t_qdb_pl_entry_writing_starts, 100),
+        (qdb_perf_label_t_qdb_pl_content_writing_starts, 200),
+        (qdb_perf_label_t_qdb_pl_content_writing_ends, 700),
+        (qdb_perf_label_t_qdb_pl_entry_writing_ends, 800),
+        // closes nothing, its _starts was not recorded
+        (qdb_perf_label_t_qdb_pl_bucket_reading_ends, 850),
+        (qdb_perf_label_t_qdb_pl_processing_ends, 900),
+        (qdb_perf_label_t_qdb_pl_replied, 1_000),
+    ];
+    let profile = Profile {
+        name: "blob.put".to_string(),
+        measurements: labels.iter().map(|(label, elapsed)| Measurement { label: *label, elapsed: *elapsed }).collect(),
+    };
+    collector.record(&[profile]);
+
+    let max = |from, to| collector.histogram("blob.put", Phase { from, to }).map(|h| h.max());
+    assert_eq!(max(qdb_perf_label_t_qdb_pl_processing_starts, qdb_perf_label_t_qdb_pl_processing_ends), Some(890));
+    assert_eq!(max(qdb_perf_label_t_qdb_pl_entry_writing_starts, qdb_perf_label_t_qdb_pl_entry_writing_ends), Some(700));
+    assert_eq!(max(qdb_perf_label_t_qdb_pl_content_writing_starts, qdb_perf_label_t_qdb_pl_content_writing_ends), Some(500));
+    assert_eq!(max(qdb_perf_label_t_qdb_pl_received, qdb_perf_label_t_qdb_pl_replied), Some(1_000));
+    assert_eq!(collector.summary().len(), 5);
+}
@@ -0,0 +1,30 @@
+use quasar_rs::perf::{Measurement, Profile};
+use quasar_rs::perf_trace;
+use quasar_rs::{qdb_perf_label_t_qdb_pl_bucket_reading_ends, qdb_perf_label_t_qdb_pl_bucket_reading_starts,
+                qdb_perf_label_t_qdb_pl_processing_ends, qdb_perf_label_t_qdb_pl_processing_starts,
+                qdb_perf_label_t_qdb_pl_received};
+
+#[test]
+fn test_chrome_trace_spans() {
+    let profile = Profile {
+        name: "query".to_string(),
+        measurements: vec![
+            Measurement { label: qdb_perf_label_t_qdb_pl_received, elapsed: 100 },
+            Measurement { label: qdb_perf_label_t_qdb_pl_processing_starts, elapsed: 200 },
+            Measurement { label: qdb_perf_label_t_qdb_pl_bucket_reading_starts, elapsed: 300 },
+            Measurement { label: qdb_perf_label_t_qdb_pl_bucket_reading_ends, elapsed: 1_300 },
+            Measurement { label: qdb_perf_label_t_qdb_pl_processing_ends, elapsed: 2_100 },
+        ],
+    };
+
+    let trace = perf_trace::chrome_trace(&[profile]);
+    let events = trace["traceEvents"].as_array().unwrap();
+
+    let span = |name: &str| events.iter().find(|e| e["name"] == name && e["ph"] == "X").unwrap();
+
+    assert_eq!(span("bucket_reading")["ts"], 0.2);
+    assert_eq!(span("bucket_reading")["dur"], 1.0);
+    assert_eq!(span("processing")["dur"], 1.9);
+    assert_eq!(span("query")["dur"], 2.0);
+    assert!(events.iter().any(|e| e["name"] == "received" && e["ph"] == "i"));
+}
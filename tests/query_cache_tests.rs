@@ -0,0 +1,18 @@
+use quasar_rs::query_cache;
+
+#[test]
+fn test_normalize_query() {
+    let a = query_cache::normalize_query("select  *\n from \"btc\"  in range(2021, +1d) ;");
+    let b = query_cache::normalize_query("select * from \"btc\" in range( 2021 , +1d )");
+
+    assert_eq!(a, b);
+    assert_eq!(a, "select * from \"btc\" in range(2021,+1d)");
+}
+
+#[test]
+fn test_normalize_query_keeps_literals() {
+    let a = query_cache::normalize_query("select * from t where tag = 'a  b'");
+    let b = query_cache::normalize_query("select * from t where tag = 'a b'");
+
+    assert_ne!(a, b);
+}
@@ -0,0 +1,31 @@
+use quasar_rs::query_splitter;
+
+const DAY: i64 = 86_400 * 1_000_000_000;
+
+#[test]
+fn test_time_slices_aligned() {
+    let slices = query_splitter::time_slices(0, 10 * DAY, DAY, 4);
+
+    assert_eq!(slices, vec![(0, 3 * DAY), (3 * DAY, 6 * DAY), (6 * DAY, 9 * DAY), (9 * DAY, 10 * DAY)]);
+}
+
+#[test]
+fn test_time_slices_cover_range() {
+    let begin = DAY / 2;
+    let end = 12 * DAY + 7;
+    let slices = query_splitter::time_slices(begin, end, DAY, 4);
+
+    assert_eq!(slices.first().unwrap().0, begin);
+    assert_eq!(slices.last().unwrap().1, end);
+    for w in slices.windows(2) {
+        assert_eq!(w[0].1, w[1].0);
+        assert_eq!(w[0].1 % DAY, 0);
+    }
+}
+
+#[test]
+fn test_format_timestamp() {
+    assert_eq!(query_splitter::format_timestamp(0), "1970-01-01T00:00:00.000000000");
+    assert_eq!(query_splitter::format_timestamp(1_609_459_200_000_000_001), "2021-01-01T00:00:00.000000001");
+    assert_eq!(query_splitter::format_timestamp(951_782_400 * 1_000_000_000), "2000-02-29T00:00:00.000000000");
+}
@@ -0,0 +1,63 @@
+use std::sync::Arc;
+use std::thread;
+
+use quasar_rs::spsc_queue;
+
+#[test]
+fn test_spsc_queue_full() {
+    let (producer, consumer) = spsc_queue::channel(2);
+
+    assert!(producer.push(1).is_ok());
+    assert!(producer.push(2).is_ok());
+    assert_eq!(producer.push(3), Err(3));
+
+    assert_eq!(consumer.pop(), Some(1));
+    assert!(producer.push(3).is_ok());
+    assert_eq!(consumer.pop(), Some(2));
+    assert_eq!(consumer.pop(), Some(3));
+    assert_eq!(consumer.pop(), None);
+    assert!(consumer.is_empty());
+}
+
+#[test]
+fn test_spsc_queue_threads() {
+    let (producer, consumer) = spsc_queue::channel(16);
+
+    let t = thread::spawn(move || {
+        for i in 0..10_000u64 {
+            let mut v = i;
+            while let Err(back) = producer.push(v) {
+                v = back;
+                thread::yield_now();
+            }
+        }
+    });
+
+    let mut expected = 0u64;
+    while expected < 10_000 {
+        match consumer.pop() {
+            Some(v) => {
+                assert_eq!(v, expected);
+                expected += 1;
+            }
+            None => thread::yield_now(),
+        }
+    }
+
+    t.join().unwrap();
+}
+
+#[test]
+fn test_spsc_queue_drops_left_values() {
+    let value = Arc::new(());
+    {
+        let (producer, consumer) = spsc_queue::channel(4);
+        producer.push(value.clone()).unwrap();
+        producer.push(value.clone()).unwrap();
+        producer.push(value.clone()).unwrap();
+        drop(consumer.pop());
+        drop(producer);
+        assert_eq!(Arc::strong_count(&value), 3);
+    }
+    assert_eq!(Arc::strong_count(&value), 1);
+}
@@ -0,0 +1,35 @@
+use quasar_rs::entry::ts_batch::{ColumnData, TsBatchTable};
+use quasar_rs::error::ErrorType;
+use quasar_rs::query;
+
+#[test]
+fn test_ts_batch_table_builder() {
+    let timestamps: Vec<i64> = (0..4).map(|i| 1_609_459_200_000_000_000 + i).collect();
+    let prices = [1.0, 2.0, 3.0, 4.0];
+    let volumes = [10, 20, 30, 40];
+    let symbols = ["a", "b", "c", "d"];
+
+    let table = TsBatchTable::from_nanos("btc", &timestamps)
+        .double_column("price", &prices).unwrap()
+        .int64_column("volume", &volumes).unwrap()
+        .string_column("symbol", &symbols).unwrap();
+
+    assert_eq!(table.name(), "btc");
+    assert_eq!(table.row_count(), 4);
+    assert_eq!(table.column_count(), 3);
+}
+
+#[test]
+fn test_ts_batch_table_rejects_ragged_columns() {
+    let timestamps: Vec<_> = (0..3).map(query::nanos_to_timespec).collect();
+    let short = [1.0, 2.0];
+
+    let err = TsBatchTable::new("btc", &timestamps).double_column("price", &short).unwrap_err();
+    assert_eq!(err, ErrorType::ErrInvalidArgument);
+
+    let err = TsBatchTable::new("btc", &timestamps).column("volume", ColumnData::Int64(&[1, 2, 3, 4])).unwrap_err();
+    assert_eq!(err, ErrorType::ErrInvalidArgument);
+
+    let err = TsBatchTable::new("btc", &timestamps).blob_column("payload", &[b"a".to_vec()]).unwrap_err();
+    assert_eq!(err, ErrorType::ErrInvalidArgument);
+}